@@ -73,6 +73,7 @@
 
 #include "absmi.h"
 
+#include "attvar.h"
 #include "heapgc.h"
 
 #if 1
@@ -258,6 +259,20 @@ static int code_overflow(CELL *yenv USES_REGS) {
   return INT_HANDLER_GO_ON;
 }
 
+static int trail_overflow(USES_REGS1) {
+  if (Yap_get_signal(YAP_TROVF_SIGNAL) ||
+      Unsigned(CurrentTrailTop) < Unsigned(TR)) {
+    if (!Yap_growtrail(0, false)) {
+      Yap_ThrowError(RESOURCE_ERROR_TRAIL, TermNil,
+		     "YAP failed to reserve %ld bytes in growtrail",
+		     sizeof(CELL) * K16);
+      return INT_HANDLER_FAIL;
+    }
+    return INT_HANDLER_RET_JMP;
+  }
+  return INT_HANDLER_GO_ON;
+}
+
 /*
   Imagine we are interrupting the execution, say, because we have a spy
   point or because we have goals to wake up. This routine saves the current
@@ -287,35 +302,25 @@ static Term save_xregs(yamop *pco) {
 
     lab += 2;
     for (i = 0; i <= max; i++) {
-      if (curr) break;
-      if (i == 8 * CellSize) {
+      if (i && i % (8 * CellSize) == 0) {
         curr = lab[0];
 	lab++;
       }
       CELL ocurr = curr;
       curr >>= 1;
       if (ocurr & 1) {
-        CELL d1;
+        Term d1 = Deref(XREGS[i]);
 
-	d1 = XREGS[i];
 	HR[0] = MkIntTerm(i);
-	HR+=2;
-	tot+=2;       deref_head(d1, mkglobal_unk);
-	RESET_VARIABLE(HR - 1);
-      mkglobal_nonvar:
-        YapBind(HR-1,d1);
-	if (false)
-	  {
-	    CELL *pt0;
-	    deref_body(d1, pt0, mkglobal_unk, mkglobal_nonvar);
-	    /* bind it, in case it is a local variable */
-	    if (pt0 > ASP) {            /* variable is safe */
-	      d1 = Unsigned(HR - 1);
-	      Bind_Local(pt0, d1);
-	    } else {
-	      YapBind(HR-1,d1);
-	    }
-	  }
+	/* globalise local variables, the environment may go away */
+	if (IsVarTerm(d1) && VarOfTerm(d1) > HR && VarOfTerm(d1) < LCL0) {
+	  RESET_VARIABLE(HR + 1);
+	  Bind_Local(VarOfTerm(d1), (CELL)(HR + 1));
+	} else {
+	  HR[1] = d1;
+	}
+	HR += 2;
+	tot += 2;
       }
     }
     if (tot == 4)
@@ -361,6 +366,7 @@ static PredEntry* interrupt_wake_up(Term nextg USES_REGS) {
   Term tg=nextg ;
 
   if (wk) {
+    Yap_CloseWokenBatch(PASS_REGS1);
     Term td = Yap_ReadTimedVar(LOCAL_WokenGoals);
 #if 0    
     if (IsApplTerm(td) && FunctorOfTerm(td)== FunctorComma)
@@ -424,6 +430,14 @@ static PredEntry* interrupt_wake_up(Term nextg USES_REGS) {
 
 
 
+/* the call restarts once the stacks have room: the signals still
+   pending, such as goals to wake, must interrupt it again */
+static void restart_after_overflow(USES_REGS1) {
+  CalculateStackGap(PASS_REGS1);
+  if (Yap_has_a_signal() && !LOCAL_InterruptsDisabled)
+    CreepFlag = Unsigned(LCL0);
+}
+
 static PredEntry * interrupt_main(op_numbers op, yamop *pc USES_REGS) {
   bool late_creep = false;
   gc_entry_info_t info;
@@ -443,8 +457,19 @@ static PredEntry * interrupt_main(op_numbers op, yamop *pc USES_REGS) {
     return pe;
 
   }
+  if (Yap_has_signal(YAP_WAKEUP_SIGNAL)) {
+    /* before the collection below; growing the stacks moves the
+       environment */
+    Yap_CloseWokenBatch(PASS_REGS1);
+    Yap_track_cpred( op, pc, 0, &info);
+    SET_ASP(YENV,info.env_size);
+  }
   if ((v = code_overflow(YENV PASS_REGS)) != INT_HANDLER_GO_ON  ) {
-    CalculateStackGap(PASS_REGS1);
+    restart_after_overflow(PASS_REGS1);
+    return pe;
+  }
+  if ((v = trail_overflow(PASS_REGS1)) != INT_HANDLER_GO_ON) {
+    restart_after_overflow(PASS_REGS1);
     return pe;
   }
 
@@ -452,7 +477,7 @@ static PredEntry * interrupt_main(op_numbers op, yamop *pc USES_REGS) {
       INT_HANDLER_GO_ON) {
 
     SET_ASP(info.env ,info.env_size);
-    CalculateStackGap(PASS_REGS1);
+    restart_after_overflow(PASS_REGS1);
     return pe; // restart
   }
    
@@ -474,9 +499,30 @@ static PredEntry * interrupt_main(op_numbers op, yamop *pc USES_REGS) {
      
   if (op == _dexecute || op  ==  _execute || op == _call || op == _p_execute || op == _op_fail) {
     CalculateStackGap(PASS_REGS1);
-    return newp;  
+    return newp;
   }
-     
+  if (op == _call_cpred || op == _call_usercpred) {
+    /* call the woken goals, and then the C predicate, from the current
+       environment, as the call instruction would */
+    CP = NEXTOP(info.p, Osbpp);
+    ENV = YENV;
+    YENV = (CELL *)((char *)YENV + info.p->y_u.Osbpp.s);
+#ifdef FROZEN_STACKS
+    {
+      choiceptr top_b = PROTECT_FROZEN_B(B);
+      if (YENV > (CELL *)top_b)
+        YENV = (CELL *)top_b;
+    }
+#else
+    if (YENV > (CELL *)B)
+      YENV = (CELL *)B;
+#endif /* FROZEN_STACKS */
+    YENV[E_CB] = (CELL)B;
+    P = newp->CodeOfPred;
+    CalculateStackGap(PASS_REGS1);
+    return newp;
+  }
+
   size_t sz = (size_t)NEXTOP(NEXTOP(((yamop*)NULL),Osbpp),l);
     
   ASP -= (sz+sizeof(CELL)-1)/sizeof(CELL);
@@ -490,10 +536,6 @@ static PredEntry * interrupt_main(op_numbers op, yamop *pc USES_REGS) {
     buf->opc = Yap_opcode(_execute);
     op = _execute;
     break;
-  case _call_cpred:
-    buf->opc = Yap_opcode(_call);
-    op = _call;
-    break;
   case _p_execute:
     buf->opc = Yap_opcode(_call);
     buf->y_u.Osbpp.p = PredMetaCall;
@@ -591,101 +633,116 @@ static PredEntry * interrupt_pexecute(USES_REGS1) {
 
 
 
-static bool interrupt_prune(op_numbers op, Term cut_t, yamop *p USES_REGS) {
-  yamop *cp = CP;
+/// run the goals woken before a cut or a choice point, keeping the
+/// temporaries the restore label at _live_ says are live.
+static bool wake_up_in_place(yamop *live USES_REGS) {
+  yamop *p = P, *cp = CP;
+  Int env = LCL0 - ENV, yenv = LCL0 - YENV;
+  yhandle_t sl = Yap_StartSlots();
+  yhandle_t regs = Yap_InitSlot(save_xregs(live));
+  /* interrupts in the woken goals reboot the handles down to NSlots:
+     keep our slot below that */
+  yhandle_t nslots = LOCAL_NSlots;
+  LOCAL_NSlots = LOCAL_CurHandle;
+  /* link the woken goals to a frame continuing at _live_, so that the
+     garbage collector sees which permanent variables are still alive */
+  CELL *frame = ASP;
+  frame[E_CP] = (CELL)live;
+  frame[E_CB] = (CELL)B;
+  frame[E_E] = (CELL)YENV;
+#ifdef TABLING
+  frame[E_B] = (CELL)B;
+#endif
+#ifdef DEPTH_LIMIT
+  frame[E_DEPTH] = DEPTH;
+#endif
+  ENV = frame;
+  ASP -= EnvSizeInCells;
+  PredEntry *newp = interrupt_wake_up(TermTrue PASS_REGS);
+  bool rc = newp == NULL || Yap_execute_pred(newp, NULL, true PASS_REGS);
+
+  LOCAL_NSlots = nslots;
+  if (rc)
+    Yap_restore_regs(Yap_GetFromSlot(regs) PASS_REGS);
+  Yap_CloseSlots(sl);
+  P = p;
+  CP = cp;
+  ENV = LCL0 - env;
+  YENV = LCL0 - yenv;
+  return rc;
+}
+
+/// _sz_ is the environment size of the cut instruction, and _next_ the
+/// Osbpp instruction that follows it.
+static bool interrupt_prune(Term cut_t, COUNT sz, yamop *next USES_REGS) {
   DEBUG_INTERRUPTS();
   if (LOCAL_PrologMode & InErrorMode) {
     return false;
   }
   Yap_RebootHandles(worker_id);
  
-  SET_ASP(YREG, AS_CELLS(p->y_u.s.s));
-  if (LOCAL_PrologMode & InErrorMode) {
-    CalculateStackGap(PASS_REGS1);
-      
-  }
+  /* the cut's own size may leave out variables the continuation reads:
+     keep the environment the following Osbpp describes */
+  SET_ASP(YREG, AS_CELLS(next->y_u.Osbpp.s));
   code_overflow(YENV PASS_REGS);
-
-  Term td;
-
-  td= save_xregs(NEXTOP(NEXTOP(P,s),Osbpp));
-  if (td != TermTrue)
-    td = Yap_MkApplTerm(FunctorRestoreRegs1, 1, &td);
-  //    Term tg = addgs(Yap_MkApplTerm(FunctorCutBy, 1, &cut_t), td);
-  PredEntry *newp = interrupt_wake_up( TermTrue PASS_REGS);
-							     if ( newp==NULL || Yap_execute_pred(newp, NULL, true PASS_REGS)) {
-							       SET_ASP(YENV, AS_CELLS(p->y_u.s.s));
-							       P = NEXTOP(NEXTOP(NEXTOP(p, s),Osbpp),l);
-							       CP = cp;
-							       /* assume cut is always in stack */
-							       prune((choiceptr)(LCL0-IntegerOfTerm(cut_t)) PASS_REGS);
-							       return true;
-							     } else {
-							       P = FAILCODE;
-							       return false;
-							     }
+  if (wake_up_in_place(NEXTOP(next, Osbpp) PASS_REGS)) {
+    SET_ASP(YENV, AS_CELLS(sz));
+    P = NEXTOP(NEXTOP(next, Osbpp),l);
+    /* assume cut is always in stack */
+    prune((choiceptr)(LCL0-IntegerOfTerm(cut_t)) PASS_REGS);
+    return true;
+  }
+  P = FAILCODE;
+  return false;
 }
 
 
 
 static bool interrupt_cut(USES_REGS1) {
-  return interrupt_prune(_cut, MkIntTerm(LCL0-(CELL  *)YENV[E_CB]), P PASS_REGS);
+  return interrupt_prune(MkIntTerm(LCL0-(CELL  *)YENV[E_CB]), P->y_u.s.s,
+                         NEXTOP(P, s) PASS_REGS);
 }
 
 static bool interrupt_cut_t(USES_REGS1) {
-  return interrupt_prune(_cut_t, MkIntTerm(LCL0-(CELL  *)YENV[E_CB]), P PASS_REGS);
+  return interrupt_prune(MkIntTerm(LCL0-(CELL  *)YENV[E_CB]), P->y_u.s.s,
+                         NEXTOP(P, s) PASS_REGS);
 }
 
 
 static bool interrupt_cut_e(USES_REGS1) {
-  return interrupt_prune(_cut_e, MkIntTerm(LCL0-(CELL  *)S[E_CB]),  P PASS_REGS);
+  return interrupt_prune(MkIntTerm(LCL0-(CELL  *)S[E_CB]), P->y_u.s.s,
+                         NEXTOP(P, s) PASS_REGS);
 }
 
 
 static bool interrupt_commit_y(USES_REGS1) {
-  return interrupt_prune(_commit_b_y, YENV[P->y_u.yps.y], P PASS_REGS);
-
+  return interrupt_prune(Deref(YENV[P->y_u.yps.y]), P->y_u.yps.s,
+                         NEXTOP(P, yps) PASS_REGS);
 }
 
 static bool interrupt_commit_x(USES_REGS1) {
-  return interrupt_prune(_commit_b_x, XREG(P->y_u.xps.x), P PASS_REGS);
+  return interrupt_prune(Deref(XREG(P->y_u.xps.x)), P->y_u.xps.s,
+                         NEXTOP(P, xps) PASS_REGS);
 }
 
-#if 0
-static yamop *interrupt_either(USES_REGS1) {
-
-  PredEntry *v;
-  PredEntry *ap =  P->y_u.Osblp.p0;
+/// goals woken before a disjunction must run before its choice point
+/// exists, otherwise their failure would take the next alternative.
+static bool interrupt_either(USES_REGS1) {
   yamop *p = P;
-  //  yamop *p = P;
-  DEBUG_INTERRUPTS();
-  if (PP) {
-    UNLOCKPE(1, PP);
-    PP = NULL;
-  }
 
+  DEBUG_INTERRUPTS();
   if (LOCAL_PrologMode & InErrorMode) {
-    PP = ap;
-    return p;
-  }
-  //if ( (v=check_yalarm_fail_int(true PASS_REGS)) != NULL) {
-  // PP = v; return p;
-  //}
-  if (Yap_only_has_signal(YAP_CREEP_SIGNAL)) {
-    PP = ap;
-    return p;
+    return true;
   }
-  // find something to fool S
-  if ((v = code_overflow(YENV PASS_REGS)) != INT_HANDLER_GO_ON) {
-    return v == INT_HANDLER_FAIL ? FailPred : ??;
+  Yap_RebootHandles(worker_id);
+  SET_ASP(YREG, AS_CELLS(p->y_u.Osblp.s));
+  code_overflow(YENV PASS_REGS);
+  if (wake_up_in_place(NEXTOP(p, Osblp) PASS_REGS)) {
+    return true;
   }
-  */
-    P = CP = FAILCODE;
-    PredEntry *newp = interrupt_wake_up( TermTrue PASS_REGS);
-    if (newp) return newp->CodeOfPred;
-    return p;
+  P = FAILCODE;
+  return false;
 }
-#endif
 
 static void undef_goal(PredEntry *pe USES_REGS) {
   /* avoid trouble with undefined dynamic procedures */
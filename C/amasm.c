@@ -2941,7 +2941,7 @@ static yamop *do_pass(int pass_no, yamop **entry_codep, int assembling,
           cl_u->sc.ClFlags |= HasCutMask;
         cl_u->sc.ClNext = NULL;
 	        cl_u->sc.ClSize = size;
-	    cl_u->sc.ClOwner = Yap_ConsultingFile();
+	    cl_u->sc.ClOwner = Yap_ConsultingFile(PASS_REGS1);
         cl_u->sc.usc.ClLine = cip->pos;
         cl_u->sc.usc.ClSource = NULL;
         if (*clause_has_blobsp) {
@@ -3818,7 +3818,7 @@ yamop *Yap_assemble(int mode, Term t, PredEntry *ap, int is_fact,
     cl->ClFlags |= SrcMask;
     x->ag.line_number = Yap_source_line_no();
     cl->ClSize = osize;
-    cl->ClOwner = Yap_ConsultingFile();
+    cl->ClOwner = Yap_ConsultingFile(PASS_REGS1);
     cip->code_addr = (yamop *)cl;
   } else if (mode == ASSEMBLING_CLAUSE &&
 	      (ap->PredFlags &  MultiFileFlag ||
@@ -56,12 +56,17 @@ In order to efficiently manage space elements in a static array must
 have a type. Currently, elements of static arrays in YAP should
 have one of the following predefined types:
 
-+ `byte`: an 8-bit signed character.
-+ `unsigned_byte`: an 8-bit unsigned character.
++ `byte`: an 8-bit signed character, also `char` or `int8`.
++ `unsigned_byte`: an 8-bit unsigned character, also
+`unsigned_char` or `uint8`.
++ `int16`: a 16-bit signed integer.
++ `int32`: a 32-bit signed integer.
 + `int`: Prolog integers. Size would be the natural size for
 the machine's architecture.
 + `float`: Prolog floating point number. Size would be equivalent
 to a double in `C`.
++ `float32`: a single precision floating point number, a `float` in
+`C`. A finite number too large for it raises a representation error.
 + `atom`: a Prolog atom.
 + `dbref`: an internal database reference.
 + `term`: a generic Prolog term. Note that this will term will
@@ -98,6 +103,12 @@ dynamic arrays; and, the heap size for static (not memory mapped)
 arrays. Memory mapped arrays are limited by available space in the file
 system and in the virtual memory space.
 
+Static arrays of numbers can also be read and written a slice at a
+time, with static_array_slice/4 and update_array_slice/3, and reduced
+in C, with static_array_sum/2, static_array_min/2, static_array_max/2
+and static_array_argmax/2. These loop over the array in its own
+representation, without building a term per element.
+
 The following predicates manipulate arrays:
 
 [toc]
@@ -119,6 +130,8 @@ extern int errno;
 #if HAVE_STRING_H
 #include <string.h>
 #endif
+#include <float.h>
+#include <math.h>
 
 #if __simplescalar__
 #ifdef HAVE_MMAP
@@ -244,31 +257,32 @@ typedef struct MMAP_ARRAY_BLOCK {
 } mmap_array_block;
 
 static Int CloseMmappedArray(StaticArrayEntry *pp, void *area USES_REGS) {
-  mmap_array_block *ptr = GLOBAL_mmap_arrays, *optr = GLOBAL_mmap_arrays;
+  mmap_array_block *ptr = GLOBAL_mmap_arrays, *optr = NULL;
 
   while (ptr != NULL && ptr->start != area) {
-    ptr = ptr->next;
     optr = ptr;
+    ptr = ptr->next;
   }
   if (ptr == NULL) {
-#if !defined(USE_SYSTEM_MALLOC)
-    Yap_FullError(SYSTEM_ERROR_INTERNAL, ARG1,
-                  "close_mmapped_array (array chain incoherent)",
-                  strerror(errno));
-#endif
+    Yap_ThrowError(SYSTEM_ERROR_INTERNAL, ARG1,
+                   "close_mmapped_array (array chain incoherent)");
     return FALSE;
   }
   if (munmap(ptr->start, ptr->size) == -1) {
-    Yap_FullError(SYSTEM_ERROR_INTERNAL, ARG1,
-                  "close_mmapped_array (munmap: %s)", strerror(errno));
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
+                   "close_mmapped_array (munmap: %s)", strerror(errno));
     return (FALSE);
   }
-  optr->next = ptr->next;
+  if (optr == NULL)
+    GLOBAL_mmap_arrays = ptr->next;
+  else
+    optr->next = ptr->next;
   pp->ValueOfVE.ints = NULL;
   pp->ArrayEArity = 0;
+  pp->TypeOfAE = STATIC_ARRAY;
   if (close(ptr->fd) < 0) {
-    Yap_FullError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-                  "close_mmapped_array (close: %s)", strerror(errno));
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
+                   "close_mmapped_array (close: %s)", strerror(errno));
     return (FALSE);
   }
   Yap_FreeAtomSpace((char *)ptr);
@@ -290,31 +304,21 @@ static void ResizeMmappedArray(StaticArrayEntry *pp, Int dim,
      and last we initialize again
   */
   if (munmap(ptr->start, ptr->size) == -1) {
-    Yap_FullError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-                  "resize_mmapped_array (munmap: %s)", strerror(errno));
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
+                   "resize_mmapped_array (munmap: %s)", strerror(errno));
     return;
   }
   total_size = (ptr->size / ptr->items) * dim;
+  /* ftruncate fills whatever it adds with zeros */
   if (ftruncate(ptr->fd, total_size) < 0) {
-    Yap_FullError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-                  "resize_mmapped_array (ftruncate: %s)", strerror(errno));
-    return;
-  }
-  if (lseek(ptr->fd, total_size - 1, SEEK_SET) < 0) {
     Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-              "resize_mmapped_array (lseek: %s)", strerror(errno));
-    return;
-  }
-  if (write(ptr->fd, "", 1) < 0) {
-    Yap_FullError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-                  "resize_mmapped_array (write: %s)", strerror(errno));
+                   "resize_mmapped_array (ftruncate: %s)", strerror(errno));
     return;
   }
   if ((ptr->start = (void *)mmap(0, (size_t)total_size, PROT_READ | PROT_WRITE,
-                                 MAP_SHARED, ptr->fd, 0)) == (void *)-1) {
-    Yap_FullError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
-                  "resize_mmapped_array (mmap: %s)", ___LINE__, __FUNCTION__,
-                  -__FILE__, strerror(errno));
+                                 MAP_SHARED, ptr->fd, 0)) == MAP_FAILED) {
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, ARG1,
+                   "resize_mmapped_array (mmap: %s)", strerror(errno));
     return;
   }
   ptr->size = total_size;
@@ -461,6 +465,24 @@ static Term AccessNamedArray(Atom a, Int indx USES_REGS) {
         READ_UNLOCK(ptr->ArRWLock);
         return out;
       }
+      case array_of_int16s: {
+        Term out;
+        out = MkIntegerTerm((Int)(ptr->ValueOfVE.int16s[indx]));
+        READ_UNLOCK(ptr->ArRWLock);
+        return out;
+      }
+      case array_of_int32s: {
+        Term out;
+        out = MkIntegerTerm((Int)(ptr->ValueOfVE.int32s[indx]));
+        READ_UNLOCK(ptr->ArRWLock);
+        return out;
+      }
+      case array_of_floats32: {
+        Term out;
+        out = MkEvalFl(ptr->ValueOfVE.floats32[indx]);
+        READ_UNLOCK(ptr->ArRWLock);
+        return out;
+      }
       case array_of_dbrefs: {
         /* The object is now in use */
         Term TRef = ptr->ValueOfVE.dbrefs[indx];
@@ -649,35 +671,364 @@ static void CreateNamedArray(PropEntry *pp, Int dim, AtomEntry *ae USES_REGS) {
   InitNamedArray(p, dim PASS_REGS);
 }
 
-static void AllocateStaticArraySpace(StaticArrayEntry *p,
-                                     static_array_types atype, void *old,
-                                     size_t array_size USES_REGS) {
-  size_t asize = 0;
-  switch (atype) {
+/* size in bytes of an element of a static array */
+static size_t ArrayElementSize(static_array_types type) {
+  switch (type) {
+  case array_of_doubles:
+    return sizeof(Float);
+  case array_of_floats32:
+    return sizeof(float);
+  case array_of_ints:
+    return sizeof(Int);
+  case array_of_int32s:
+    return sizeof(int32_t);
+  case array_of_int16s:
+    return sizeof(int16_t);
+  case array_of_chars:
+    return sizeof(char);
+  case array_of_uchars:
+    return sizeof(unsigned char);
+  case array_of_ptrs:
+    return sizeof(AtomEntry *);
+  case array_of_atoms:
+  case array_of_terms:
+  case array_of_nb_terms:
+    return sizeof(live_term);
+  case array_of_dbrefs:
+    return sizeof(DBRef);
+  }
+  return 0;
+}
+
+/* the type of a static array, from the name of its elements; the
+   plural, say `ints`, is fine too */
+static bool ArrayTypeOfTerm(Term tprops, static_array_types *props,
+                            const char *caller) {
+  const char *atname;
+  char name[32];
+  size_t sz;
+
+  if (IsVarTerm(tprops)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, tprops, "%s", caller);
+    return false;
+  }
+  if (!IsAtomTerm(tprops)) {
+    Yap_ThrowError(TYPE_ERROR_ATOM, tprops, "%s", caller);
+    return false;
+  }
+  atname = RepAtom(AtomOfTerm(tprops))->StrOfAE;
+  if ((sz = strlen(atname)) == 0 || sz >= sizeof(name)) {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, tprops, "%s", caller);
+    return false;
+  }
+  strcpy(name, atname);
+  if (name[sz - 1] == 's')
+    name[sz - 1] = '\0';
+  if (!strcmp(name, "int"))
+    *props = array_of_ints;
+  else if (!strcmp(name, "int32"))
+    *props = array_of_int32s;
+  else if (!strcmp(name, "int16"))
+    *props = array_of_int16s;
+  else if (!strcmp(name, "char") || !strcmp(name, "byte") ||
+           !strcmp(name, "int8"))
+    *props = array_of_chars;
+  else if (!strcmp(name, "unsigned_char") || !strcmp(name, "unsigned_byte") ||
+           !strcmp(name, "uint8"))
+    *props = array_of_uchars;
+  else if (!strcmp(name, "float"))
+    *props = array_of_doubles;
+  else if (!strcmp(name, "float32"))
+    *props = array_of_floats32;
+  else if (!strcmp(name, "dbref"))
+    *props = array_of_dbrefs;
+  else if (!strcmp(name, "ptr"))
+    *props = array_of_ptrs;
+  else if (!strcmp(name, "atom"))
+    *props = array_of_atoms;
+  else if (!strcmp(name, "term"))
+    *props = array_of_terms;
+  else if (!strcmp(name, "nb_term"))
+    *props = array_of_nb_terms;
+  else {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, tprops, "%s", caller);
+    return false;
+  }
+  return true;
+}
+
+/* whether an integer fits an element of a static array of integers */
+static yap_error_number IntegerFitsArray(static_array_types type, Int i) {
+  switch (type) {
+  case array_of_chars:
+    return (i > 127 || i < -128 ? TYPE_ERROR_CHAR : YAP_NO_ERROR);
+  case array_of_uchars:
+    return (i > 255 || i < 0 ? TYPE_ERROR_UCHAR : YAP_NO_ERROR);
+  case array_of_int16s:
+    return (i > INT16_MAX || i < INT16_MIN ? REPRESENTATION_ERROR_INT
+                                           : YAP_NO_ERROR);
+  case array_of_int32s:
+    return (i > INT32_MAX || i < INT32_MIN ? REPRESENTATION_ERROR_INT
+                                           : YAP_NO_ERROR);
+  default:
+    return YAP_NO_ERROR;
+  }
+}
+
+/* a finite float must stay finite when it is narrowed to the array */
+static yap_error_number FloatFitsArray(static_array_types type, Float f) {
+  if (type == array_of_floats32 && isfinite(f) && (f > FLT_MAX || f < -FLT_MAX))
+    return REPRESENTATION_ERROR_FLOAT;
+  return YAP_NO_ERROR;
+}
+
+/* convert a number to an element of a static array of numbers: the
+   element goes to *ip for integer arrays and to *fp for float arrays.
+   Return the error to raise if t does not fit. */
+static yap_error_number NumberToElement(static_array_types type, Term t,
+                                        Int *ip, Float *fp) {
+  if (IsVarTerm(t))
+    return INSTANTIATION_ERROR;
+  switch (type) {
   case array_of_doubles:
-    asize = array_size * sizeof(Float);
+  case array_of_floats32:
+    if (IsFloatTerm(t))
+      *fp = FloatOfTerm(t);
+    else if (IsIntegerTerm(t))
+      *fp = IntegerOfTerm(t);
+    else
+      return TYPE_ERROR_FLOAT;
+    return FloatFitsArray(type, *fp);
+  case array_of_ints:
+  case array_of_int32s:
+  case array_of_int16s:
+  case array_of_chars:
+  case array_of_uchars:
+    if (!IsIntegerTerm(t))
+      return TYPE_ERROR_INTEGER;
+    *ip = IntegerOfTerm(t);
+    return IntegerFitsArray(type, *ip);
+  default:
+    return DOMAIN_ERROR_ARRAY_TYPE;
+  }
+}
+
+/* store a number converted by NumberToElement() */
+static void StoreNumber(StaticArrayEntry *pp, size_t indx, Int i, Float f) {
+  switch (pp->ArrayType) {
+  case array_of_ints:
+    pp->ValueOfVE.ints[indx] = i;
+    break;
+  case array_of_int32s:
+    pp->ValueOfVE.int32s[indx] = i;
+    break;
+  case array_of_int16s:
+    pp->ValueOfVE.int16s[indx] = i;
+    break;
+  case array_of_chars:
+    pp->ValueOfVE.chars[indx] = i;
+    break;
+  case array_of_uchars:
+    pp->ValueOfVE.uchars[indx] = i;
     break;
+  case array_of_doubles:
+    pp->ValueOfVE.floats[indx] = f;
+    break;
+  case array_of_floats32:
+    pp->ValueOfVE.floats32[indx] = f;
+    break;
+  default:
+    break;
+  }
+}
+
+/* whether the elements of a static array are numbers */
+static bool ArrayOfNumbers(static_array_types type) {
+  switch (type) {
   case array_of_ints:
-    asize = array_size * sizeof(Int);
+  case array_of_int32s:
+  case array_of_int16s:
+  case array_of_chars:
+  case array_of_uchars:
+  case array_of_doubles:
+  case array_of_floats32:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* find the static array named t, or raise an error */
+static StaticArrayEntry *GetStaticArray(Term t, const char *caller) {
+  AtomEntry *ae;
+  StaticArrayEntry *pp;
+
+  if (IsVarTerm(t)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, t, "%s", caller);
+    return NULL;
+  }
+  if (!IsAtomTerm(t)) {
+    Yap_ThrowError(TYPE_ERROR_ATOM, t, "%s", caller);
+    return NULL;
+  }
+  ae = RepAtom(AtomOfTerm(t));
+  READ_LOCK(ae->ARWLock);
+  pp = RepStaticArrayProp(ae->PropsOfAE);
+  while (!EndOfPAEntr(pp) && pp->KindOfPE != ArrayProperty)
+    pp = RepStaticArrayProp(pp->NextOfPE);
+  READ_UNLOCK(ae->ARWLock);
+  if (EndOfPAEntr(pp) || ArrayIsDynamic((ArrayEntry *)pp) ||
+      pp->ValueOfVE.ints == NULL) {
+    Yap_ThrowError(EXISTENCE_ERROR_ARRAY, t, "%s", caller);
+    return NULL;
+  }
+  return pp;
+}
+
+/* the loops over static arrays of numbers, one set for each type of
+   element. They are kept simple, and sums go to four accumulators,
+   so that the compiler can unroll and vectorise them. */
+#define ARRAY_LOOPS(NAME, T)                                                   \
+  static void fill_##NAME(T *v, size_t n, T x) {                               \
+    size_t i;                                                                  \
+    for (i = 0; i < n; i++)                                                    \
+      v[i] = x;                                                                \
+  }                                                                            \
+  static T min_##NAME(const T *v, size_t n) {                                  \
+    T m = v[0];                                                                \
+    size_t i;                                                                  \
+    for (i = 1; i < n; i++)                                                    \
+      m = (v[i] < m ? v[i] : m);                                               \
+    return m;                                                                  \
+  }                                                                            \
+  static T max_##NAME(const T *v, size_t n) {                                  \
+    T m = v[0];                                                                \
+    size_t i;                                                                  \
+    for (i = 1; i < n; i++)                                                    \
+      m = (v[i] > m ? v[i] : m);                                               \
+    return m;                                                                  \
+  }                                                                            \
+  /* a second pass finds the maximum, so that the first one vectorises */     \
+  static size_t argmax_##NAME(const T *v, size_t n) {                          \
+    T m = max_##NAME(v, n);                                                    \
+    size_t i;                                                                  \
+    for (i = 0; i < n; i++)                                                    \
+      if (v[i] == m)                                                           \
+        return i;                                                              \
+    return 0;                                                                  \
+  }
+
+/* sums of elements narrower than the accumulator */
+#define ARRAY_SUM(NAME, T, ACC, MK)                                            \
+  static Term sum_##NAME(const T *v, size_t n USES_REGS) {                     \
+    ACC s0 = 0, s1 = 0, s2 = 0, s3 = 0;                                        \
+    size_t i;                                                                  \
+    for (i = 0; i + 4 <= n; i += 4) {                                          \
+      s0 += v[i];                                                              \
+      s1 += v[i + 1];                                                          \
+      s2 += v[i + 2];                                                          \
+      s3 += v[i + 3];                                                          \
+    }                                                                          \
+    for (; i < n; i++)                                                         \
+      s0 += v[i];                                                              \
+    return MK((s0 + s1) + (s2 + s3));                                          \
+  }
+
+ARRAY_LOOPS(ints, Int)
+ARRAY_LOOPS(int32s, int32_t)
+ARRAY_LOOPS(int16s, int16_t)
+ARRAY_LOOPS(chars, signed char)
+ARRAY_LOOPS(uchars, unsigned char)
+ARRAY_LOOPS(doubles, Float)
+ARRAY_LOOPS(floats32, float)
+
+ARRAY_SUM(int32s, int32_t, Int, MkIntegerTerm)
+ARRAY_SUM(int16s, int16_t, Int, MkIntegerTerm)
+ARRAY_SUM(chars, signed char, Int, MkIntegerTerm)
+ARRAY_SUM(uchars, unsigned char, Int, MkIntegerTerm)
+ARRAY_SUM(doubles, Float, Float, MkFloatTerm)
+ARRAY_SUM(floats32, float, Float, MkFloatTerm)
+
+/* t0 + t1, going to big integers if need be */
+static Term AddNumbers(Term t0, Term t1 USES_REGS) {
+  Term t2[2];
+
+  t2[0] = t0;
+  t2[1] = t1;
+  return Yap_Eval(Yap_MkApplTerm(FunctorPlus, 2, t2));
+}
+
+/* Int elements can overflow an Int sum. The sum checks for it, and
+   when it happens it is done again in big integers: the partial sum is
+   added to the total each time the next element would overflow it */
+static Term sum_ints(const Int *v, size_t n USES_REGS) {
+  Int s0 = 0, s1 = 0, s2 = 0, s3 = 0, s;
+  bool ovf = false;
+  size_t i;
+  Term t;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    ovf |= __builtin_add_overflow(s0, v[i], &s0);
+    ovf |= __builtin_add_overflow(s1, v[i + 1], &s1);
+    ovf |= __builtin_add_overflow(s2, v[i + 2], &s2);
+    ovf |= __builtin_add_overflow(s3, v[i + 3], &s3);
+  }
+  for (; i < n; i++)
+    ovf |= __builtin_add_overflow(s0, v[i], &s0);
+  ovf |= __builtin_add_overflow(s0, s1, &s0);
+  ovf |= __builtin_add_overflow(s2, s3, &s2);
+  ovf |= __builtin_add_overflow(s0, s2, &s);
+  if (!ovf)
+    return MkIntegerTerm(s);
+  t = MkIntTerm(0);
+  s = 0;
+  for (i = 0; i < n; i++) {
+    if (__builtin_add_overflow(s, v[i], &s0)) {
+      t = AddNumbers(t, MkIntegerTerm(s) PASS_REGS);
+      s = v[i];
+    } else {
+      s = s0;
+    }
+  }
+  return AddNumbers(t, MkIntegerTerm(s) PASS_REGS);
+}
+
+/* set n elements of a static array of numbers, from the first, to a
+   number converted by NumberToElement() */
+static void FillNumbers(StaticArrayEntry *pp, size_t first, size_t n, Int i,
+                        Float f) {
+  switch (pp->ArrayType) {
+  case array_of_ints:
+    fill_ints(pp->ValueOfVE.ints + first, n, i);
+    break;
+  case array_of_int32s:
+    fill_int32s(pp->ValueOfVE.int32s + first, n, i);
+    break;
+  case array_of_int16s:
+    fill_int16s(pp->ValueOfVE.int16s + first, n, i);
     break;
   case array_of_chars:
-    asize = array_size * sizeof(char);
+    fill_chars((signed char *)pp->ValueOfVE.chars + first, n, i);
     break;
   case array_of_uchars:
-    asize = array_size * sizeof(unsigned char);
+    fill_uchars(pp->ValueOfVE.uchars + first, n, i);
     break;
-  case array_of_ptrs:
-    asize = array_size * sizeof(AtomEntry *);
+  case array_of_doubles:
+    fill_doubles(pp->ValueOfVE.floats + first, n, f);
     break;
-  case array_of_atoms:
-  case array_of_terms:
-  case array_of_nb_terms:
-    asize = array_size * sizeof(live_term);
+  case array_of_floats32:
+    fill_floats32(pp->ValueOfVE.floats32 + first, n, f);
     break;
-  case array_of_dbrefs:
-    asize = array_size * sizeof(DBRef);
+  default:
     break;
   }
+}
+
+static void AllocateStaticArraySpace(StaticArrayEntry *p,
+                                     static_array_types atype, void *old,
+                                     size_t array_size USES_REGS) {
+  size_t asize = array_size * ArrayElementSize(atype);
+
   if (old == NULL) {
     while ((p->ValueOfVE.floats = (Float *)Yap_AllocCodeSpace(asize)) == NULL) {
       YAPLeaveCriticalSection();
@@ -731,94 +1082,71 @@ if (p->ArrayType ==
 return NULL;
 }
 
-static Int update_all( USES_REGS1) {
-    Term t1, t;
-  StaticArrayEntry *p;
-  t = Deref(ARG2);
-  t1 = Deref(ARG1);
-  if (IsVarTerm(t1)) {
-    Yap_ThrowError(INSTANTIATION_ERROR, t1, "update_array");
-    return (FALSE);
-  }
+/** @pred  update_whole_array(+ _Name_, + _Value_)
 
-    AtomEntry *ae = RepAtom(AtomOfTerm(t1));
+Set every element of the static array  _Name_ to  _Value_. The value
+is checked once, and arrays of numbers are then filled by a loop in C.
+*/
+static Int update_all(USES_REGS1) {
+  Term t1 = Deref(ARG1), t = Deref(ARG2);
+  StaticArrayEntry *p;
+  Int dim;
 
-    READ_LOCK(ae->ARWLock);
-    p = RepStaticArrayProp(ae->PropsOfAE);
-    while (!EndOfPAEntr(p) && p->KindOfPE != ArrayProperty)
-      p = RepStaticArrayProp(p->NextOfPE);
+  if ((p = GetStaticArray(t1, "update_whole_array")) == NULL)
+    return FALSE;
+  WRITE_LOCK(p->ArRWLock);
+  if (p->TypeOfAE & READ_ONLY_ARRAY) {
+    WRITE_UNLOCK(p->ArRWLock);
+    Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, t1, "update_whole_array");
+    return FALSE;
+  }
+  dim = p->ArrayEArity;
+  switch (p->ArrayType) {
+  case array_of_ints:
+  case array_of_int32s:
+  case array_of_int16s:
+  case array_of_chars:
+  case array_of_uchars:
+  case array_of_doubles:
+  case array_of_floats32: {
+    Int n = 0;
+    Float f = 0.0;
+    yap_error_number err = NumberToElement(p->ArrayType, t, &n, &f);
 
-    if (EndOfPAEntr(p)) {
-      READ_UNLOCK(ae->ARWLock);
-      Yap_ThrowError(EXISTENCE_ERROR_ARRAY, t1, "assign_static %s",
-                RepAtom(AtomOfTerm(t1))->StrOfAE);
+    if (err != YAP_NO_ERROR) {
+      WRITE_UNLOCK(p->ArRWLock);
+      Yap_ThrowError(err, t, "update_whole_array");
       return FALSE;
     }
-    Int dim = p->ArrayEArity;
-    switch (p->ArrayType) {
-    case array_of_ints:
-      {
-	Int n = IntegerOfTerm(t), i;
-      for (i = 0; i < dim; i++)
-        p->ValueOfVE.ints[i] = n;
-      }
-      break;
-    case array_of_chars:
-      {
-	Int c = IntegerOfTerm(t), i;
-      for (i = 0; i < dim; i++)
-        p->ValueOfVE.chars[i] = c;
-      }
-      break;
-    case array_of_uchars:
-      { Int i;
-	UInt c = IntegerOfTerm(t);
-      for (i = 0; i < dim; i++)
-        p->ValueOfVE.uchars[i] = c;
-      }
-       break;
-    case array_of_doubles:
-       {
-	 Int i;
-	 Float f = FloatOfTerm(t);
-      for (i = 0; i < dim; i++)
-        p->ValueOfVE.uchars[i] = f;
-      }
-       break;
-    case array_of_ptrs:
-        {
-	 Int i;
-	 void *pt = AddressOfTerm(t);
-     for (i = 0; i < dim; i++)
-        p->ValueOfVE.ptrs[i] = pt;
-	}
-      break;
-    case array_of_atoms:
-      {
-	Int i;
-	for (i = 0; i < dim; i++)
-	  p->ValueOfVE.atoms[i] = t;
-      }
-      break;
-    case array_of_dbrefs:
-    case array_of_terms:
-      {
-	int i;
-	for (i = 0; i < dim; i++)
-	  p->ValueOfVE.terms[i] = TermToDBTerm(t);
-      }
-      break;
-    case array_of_nb_terms:
-      {
-	int i;
-      Term tn = Yap_SaveTerm(t);
-      for (i = 0; i < dim; i++) {
-        p->ValueOfVE.lterms[i].tstore = tn;
-      }
-      }
-      break;
+    FillNumbers(p, 0, dim, n, f);
+  } break;
+  case array_of_ptrs: {
+    Int i;
+    void *pt = AddressOfTerm(t);
+    for (i = 0; i < dim; i++)
+      p->ValueOfVE.ptrs[i] = pt;
+  } break;
+  case array_of_atoms: {
+    Int i;
+    for (i = 0; i < dim; i++)
+      p->ValueOfVE.atoms[i] = t;
+  } break;
+  case array_of_dbrefs:
+  case array_of_terms: {
+    Int i;
+    for (i = 0; i < dim; i++)
+      p->ValueOfVE.terms[i] = TermToDBTerm(t);
+  } break;
+  case array_of_nb_terms: {
+    Int i;
+    Term tn = Yap_SaveTerm(t);
+    for (i = 0; i < dim; i++) {
+      p->ValueOfVE.lterms[i].tstore = tn;
     }
-    return true;
+  } break;
+  }
+  WRITE_UNLOCK(p->ArRWLock);
+  return true;
 }
 
 /* ae and p are assumed to be locked, if they exist */
@@ -864,10 +1192,22 @@ static StaticArrayEntry *CreateStaticArray(AtomEntry *ae, size_t dim,
       for (i = 0; i < dim; i++)
         p->ValueOfVE.uchars[i] = '\0';
       break;
+    case array_of_int16s:
+      for (i = 0; i < dim; i++)
+        p->ValueOfVE.int16s[i] = 0;
+      break;
+    case array_of_int32s:
+      for (i = 0; i < dim; i++)
+        p->ValueOfVE.int32s[i] = 0;
+      break;
     case array_of_doubles:
       for (i = 0; i < dim; i++)
         p->ValueOfVE.floats[i] = 0.0;
       break;
+    case array_of_floats32:
+      for (i = 0; i < dim; i++)
+        p->ValueOfVE.floats32[i] = 0.0;
+      break;
     case array_of_ptrs:
       for (i = 0; i < dim; i++)
         p->ValueOfVE.ptrs[i] = NULL;
@@ -946,10 +1286,22 @@ static void ResizeStaticArray(StaticArrayEntry *pp, size_t dim USES_REGS) {
     for (i = mindim; i < dim; i++)
       pp->ValueOfVE.uchars[i] = '\0';
     break;
+  case array_of_int16s:
+    for (i = mindim; i < dim; i++)
+      pp->ValueOfVE.int16s[i] = 0;
+    break;
+  case array_of_int32s:
+    for (i = mindim; i < dim; i++)
+      pp->ValueOfVE.int32s[i] = 0;
+    break;
   case array_of_doubles:
     for (i = mindim; i < dim; i++)
       pp->ValueOfVE.floats[i] = 0.0;
     break;
+  case array_of_floats32:
+    for (i = mindim; i < dim; i++)
+      pp->ValueOfVE.floats32[i] = 0.0;
+    break;
   case array_of_ptrs:
     for (i = mindim; i < dim; i++)
       pp->ValueOfVE.ptrs[i] = NULL;
@@ -994,7 +1346,10 @@ static void ClearStaticArray(StaticArrayEntry *pp) {
     memset((void *)pp->ValueOfVE.chars, 0, sizeof(char) * dim);
     break;
   case array_of_uchars:
-    memset((void *)pp->ValueOfVE.uchars, 0, sizeof(unsigned char) * dim);
+  case array_of_int16s:
+  case array_of_int32s:
+  case array_of_floats32:
+    memset((void *)pp->ValueOfVE.uchars, 0, ArrayElementSize(type) * dim);
     break;
   case array_of_doubles:
     memset((void *)pp->ValueOfVE.floats, 0, sizeof(double) * dim);
@@ -1210,50 +1565,10 @@ static_array(USES_REGS1) {
     }
   }
 
-  if (IsVarTerm(tprops)) {
-    Yap_ThrowError(INSTANTIATION_ERROR, tprops, "create static array");
-    return (FALSE);
-  } else if (IsAtomTerm(tprops)) {
-    char *atname = (char *)RepAtom(AtomOfTerm(tprops))->StrOfAE;
-    size_t sz;
-    int l=push_text_stack();
-    if((sz=strlen(atname))==0)
-            Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, tprops, "create static array");
-    if(atname[sz-1]=='s')
-      {
-	char *natname = malloc(sz);
-	strncpy(natname,atname,sz-1);
-	atname = natname;
-      }
-    if (!strcmp(atname, "int"))
-      props = array_of_ints;
-    else if (!strcmp(atname, "dbref"))
-      props = array_of_dbrefs;
-    else if (!strcmp(atname, "float"))
-      props = array_of_doubles;
-    else if (!strcmp(atname, "ptr"))
-      props = array_of_ptrs;
-    else if (!strcmp(atname, "atom"))
-      props = array_of_atoms;
-    else if (!strcmp(atname, "char"))
-      props = array_of_chars;
-    else if (!strcmp(atname, "unsigned_char"))
-      props = array_of_uchars;
-    else if (!strcmp(atname, "term"))
-      props = array_of_terms;
-    else if (!strcmp(atname, "nb_term"))
-      props = array_of_nb_terms;
-    else {
-      Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, tprops, "create static array");
-      return (FALSE);
-    }
-    pop_text_stack(l);
-  } else {
-    Yap_ThrowError(TYPE_ERROR_ATOM, tprops, "create static array");
+  if (!ArrayTypeOfTerm(tprops, &props, "create static array"))
     return (FALSE);
-  }
 
-    StaticArrayEntry *pp;
+  StaticArrayEntry *pp;
   if (IsVarTerm(t)) {
     Yap_ThrowError(INSTANTIATION_ERROR, t, "create static array");
     return (FALSE);
@@ -1363,6 +1678,12 @@ static Int static_array_properties(USES_REGS1) {
         return (Yap_unify(ARG3, MkAtomTerm(AtomChar)));
       case array_of_uchars:
         return (Yap_unify(ARG3, MkAtomTerm(AtomUnsignedChar)));
+      case array_of_int16s:
+        return (Yap_unify(ARG3, MkAtomTerm(Yap_LookupAtom("int16"))));
+      case array_of_int32s:
+        return (Yap_unify(ARG3, MkAtomTerm(Yap_LookupAtom("int32"))));
+      case array_of_floats32:
+        return (Yap_unify(ARG3, MkAtomTerm(Yap_LookupAtom("float32"))));
       case array_of_terms:
         return (Yap_unify(ARG3, TermTerm));
       case array_of_nb_terms:
@@ -1409,6 +1730,9 @@ static Int resize_static_array(USES_REGS1) {
     if (EndOfPAEntr(pp) || pp->ValueOfVE.ints == NULL) {
       Yap_ThrowError(PERMISSION_ERROR_RESIZE_ARRAY, t, "resize a static array");
       return (FALSE);
+    } else if (pp->TypeOfAE & READ_ONLY_ARRAY) {
+      Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, t, "resize a static array");
+      return (FALSE);
     } else {
       size_t osize = pp->ArrayEArity;
       ResizeStaticArray(pp, size PASS_REGS);
@@ -1445,6 +1769,9 @@ static Int clear_static_array(USES_REGS1) {
     if (EndOfPAEntr(pp) || pp->ValueOfVE.ints == NULL) {
       Yap_ThrowError(PERMISSION_ERROR_RESIZE_ARRAY, t, "clear a static array");
       return FALSE;
+    } else if (pp->TypeOfAE & READ_ONLY_ARRAY) {
+      Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, t, "clear a static array");
+      return FALSE;
     } else {
       ClearStaticArray(pp);
       return TRUE;
@@ -1488,15 +1815,9 @@ static Int close_static_array(USES_REGS1) {
       StaticArrayEntry *ptr = (StaticArrayEntry *)pp;
       if (ptr->ValueOfVE.ints != NULL) {
 #if HAVE_MMAP
-        Int val =
-            CloseMmappedArray(ptr, (void *)ptr->ValueOfVE.chars PASS_REGS);
-#if USE_SYSTEM_MALLOC
-        if (val) {
-#endif
-          return (val);
-#if USE_SYSTEM_MALLOC
-        }
-#endif
+        if (ptr->TypeOfAE & MMAP_ARRAY)
+          return CloseMmappedArray(ptr,
+                                   (void *)ptr->ValueOfVE.chars PASS_REGS);
 #endif
         Yap_FreeAtomSpace((char *)(ptr->ValueOfVE.ints));
         ptr->ValueOfVE.ints = NULL;
@@ -1512,34 +1833,39 @@ static Int close_static_array(USES_REGS1) {
   }
 }
 
-/** @pred  mmapped_array(+ _Name_, + _Size_, + _Type_, + _File_)
-
-
-Similar to static_array/3, but the array is memory mapped to file
- _File_. This means that the array is initialized from the file, and
-that any changes to the array will also be stored in the file.
-
-This built-in is only available in operating systems that support the
-system call `mmap`. Moreover, mmapped arrays do not store generic
-terms (type `term`).
-
-
-*/
-static Int create_mmapped_array(USES_REGS1) {
+/* map File to the static array Name: the common code for
+   mmapped_array/4 and mmapped_array/5 */
+static Int open_mmapped_array(bool read_only USES_REGS) {
 #ifdef HAVE_MMAP
   Term ti = Deref(ARG2);
   Term t = Deref(ARG1);
-  Term tprops = Deref(ARG3);
   Term tfile = Deref(ARG4);
-  Int size;
+  Int size = -1;
   static_array_types props;
-  size_t total_size;
+  size_t elsize, total_size;
   CODEADDR array_addr;
+  struct stat st;
   int fd;
 
-  if (IsVarTerm(ti)) {
-    Yap_ThrowError(INSTANTIATION_ERROR, ti, "create_mmapped_array");
+  if (IsVarTerm(t)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, t, "create_mmapped_array");
+    return (FALSE);
+  } else if (!IsAtomTerm(t)) {
+    Yap_ThrowError(TYPE_ERROR_ATOM, t, "create_mmapped_array");
+    return (FALSE);
+  }
+  if (!ArrayTypeOfTerm(Deref(ARG3), &props, "create_mmapped_array"))
     return (FALSE);
+  if (props == array_of_terms || props == array_of_nb_terms) {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, ARG3, "create_mmapped_array");
+    return (FALSE);
+  }
+  elsize = (props == array_of_atoms ? sizeof(Term) : ArrayElementSize(props));
+  if (IsVarTerm(ti)) {
+    if (!read_only) {
+      Yap_ThrowError(INSTANTIATION_ERROR, ti, "create_mmapped_array");
+      return (FALSE);
+    }
   } else {
     Term nti;
 
@@ -1549,117 +1875,102 @@ static Int create_mmapped_array(USES_REGS1) {
       Yap_ThrowError(TYPE_ERROR_INTEGER, ti, "create_mmapped_array");
       return (FALSE);
     }
-  }
-
-  if (IsVarTerm(tprops)) {
-    Yap_ThrowError(INSTANTIATION_ERROR, tprops, "create_mmapped_array");
-    return (FALSE);
-  } else if (IsAtomTerm(tprops)) {
-    char *atname = RepAtom(AtomOfTerm(tprops))->StrOfAE;
-    if (!strcmp(atname, "int")) {
-      props = array_of_ints;
-      total_size = size * sizeof(Int);
-    } else if (!strcmp(atname, "dbref")) {
-      props = array_of_dbrefs;
-      total_size = size * sizeof(Int);
-    } else if (!strcmp(atname, "float")) {
-      props = array_of_doubles;
-      total_size = size * sizeof(Float);
-    } else if (!strcmp(atname, "ptr")) {
-      props = array_of_ptrs;
-      total_size = size * sizeof(AtomEntry *);
-    } else if (!strcmp(atname, "atom")) {
-      props = array_of_atoms;
-      total_size = size * sizeof(Term);
-    } else if (!strcmp(atname, "char")) {
-      props = array_of_chars;
-      total_size = size * sizeof(char);
-    } else if (!strcmp(atname, "unsigned_char")) {
-      props = array_of_uchars;
-      total_size = size * sizeof(unsigned char);
-    } else {
-      Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, tprops, "create_mmapped_array");
+    if (size <= 0) {
+      Yap_ThrowError(DOMAIN_ERROR_NOT_ZERO, ti, "create_mmapped_array");
       return (FALSE);
     }
-  } else {
-    Yap_ThrowError(TYPE_ERROR_ATOM, tprops, "create_mmapped_array");
-    return (FALSE);
   }
 
   if (IsVarTerm(tfile)) {
     Yap_ThrowError(INSTANTIATION_ERROR, tfile, "create_mmapped_array");
     return (FALSE);
-  } else if (IsAtomTerm(tfile)) {
-    char *filename = RepAtom(AtomOfTerm(tfile))->StrOfAE;
-
-    fd = open(filename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-    if (fd == -1) {
-      Yap_ThrowError(SYSTEM_ERROR_INTERNAL, ARG1, "create_mmapped_array (open: %s)",
-                strerror(errno));
+  } else if (!IsAtomTerm(tfile)) {
+    Yap_ThrowError(TYPE_ERROR_ATOM, tfile, "create_mmapped_array");
+    return (FALSE);
+  }
+  fd = open(RepAtom(AtomOfTerm(tfile))->StrOfAE,
+            (read_only ? O_RDONLY : O_RDWR | O_CREAT), S_IRUSR | S_IWUSR);
+  if (fd == -1) {
+    Yap_ThrowError(PERMISSION_ERROR_OPEN_SOURCE_SINK, tfile,
+                   "create_mmapped_array (open: %s)", strerror(errno));
+    return (FALSE);
+  }
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, tfile,
+                   "create_mmapped_array (fstat: %s)", strerror(errno));
+    return (FALSE);
+  }
+  if (size < 0)
+    size = st.st_size / elsize;
+  total_size = size * elsize;
+  if (total_size == 0) {
+    close(fd);
+    Yap_ThrowError(DOMAIN_ERROR_NOT_ZERO, MkIntTerm(0), "create_mmapped_array");
+    return (FALSE);
+  }
+  if ((size_t)st.st_size < total_size) {
+    /* a new file, or one that must grow: ftruncate fills it with zeros */
+    if (read_only) {
+      close(fd);
+      Yap_ThrowError(DOMAIN_ERROR_ARRAY_OVERFLOW, ti,
+                     "create_mmapped_array (file holds %ld elements)",
+                     (long int)(st.st_size / elsize));
       return (FALSE);
     }
-    if (lseek(fd, total_size - 1, SEEK_SET) < 0)
-      Yap_ThrowError(SYSTEM_ERROR_INTERNAL, tfile,
-                "create_mmapped_array (lseek: %s)", strerror(errno));
-    if (write(fd, "", 1) < 0)
-      Yap_ThrowError(SYSTEM_ERROR_INTERNAL, tfile,
-                "create_mmapped_array (write: %s)", strerror(errno));
-    /*
-      if (ftruncate(fd, total_size) < 0)
-      Yap_ThrowError(SYSTEM_ERROR_INTERNAL,tfile,"create_mmapped_array");
-    */
-    if ((array_addr =
-             (CODEADDR)mmap(0, (size_t)total_size, PROT_READ | PROT_WRITE,
-                            MAP_SHARED, fd, 0)) == (CODEADDR)-1)
-      Yap_ThrowError(SYSTEM_ERROR_INTERNAL, tfile, "create_mmapped_array (mmap: %s)",
-                strerror(errno));
-  } else {
-    Yap_ThrowError(TYPE_ERROR_ATOM, tfile, "create_mmapped_array");
+    if (ftruncate(fd, total_size) < 0) {
+      close(fd);
+      Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, tfile,
+                     "create_mmapped_array (ftruncate: %s)", strerror(errno));
+      return (FALSE);
+    }
+  }
+  if ((array_addr = (CODEADDR)mmap(
+           0, total_size, (read_only ? PROT_READ : PROT_READ | PROT_WRITE),
+           MAP_SHARED, fd, 0)) == (CODEADDR)MAP_FAILED) {
+    close(fd);
+    Yap_ThrowError(SYSTEM_ERROR_OPERATING_SYSTEM, tfile,
+                   "create_mmapped_array (mmap: %s)", strerror(errno));
     return (FALSE);
   }
 
-  if (IsVarTerm(t)) {
-    Yap_ThrowError(INSTANTIATION_ERROR, t, "create_mmapped_array");
-    return (FALSE);
-  } else if (IsAtomTerm(t)) {
+  {
     /* Create a named array */
     AtomEntry *ae = RepAtom(AtomOfTerm(t));
     StaticArrayEntry *pp;
+    mmap_array_block *ptr;
 
     WRITE_LOCK(ae->ARWLock);
     pp = RepStaticArrayProp(ae->PropsOfAE);
     while (!EndOfPAEntr(pp) && pp->KindOfPE != ArrayProperty)
       pp = RepStaticArrayProp(pp->NextOfPE);
-    if (EndOfPAEntr(pp) || pp->ValueOfVE.ints == NULL) {
-      mmap_array_block *ptr;
-
-      if (EndOfPAEntr(pp)) {
-        WRITE_UNLOCK(ae->ARWLock);
-        return FALSE;
-      } else {
-        WRITE_LOCK(pp->ArRWLock);
-      }
-      CreateStaticArray(ae, size, props, array_addr, pp PASS_REGS);
-      ptr = (mmap_array_block *)Yap_AllocAtomSpace(sizeof(mmap_array_block));
-      ptr->name = AbsAtom(ae);
-      ptr->size = total_size;
-      ptr->items = size;
-      ptr->start = (void *)array_addr;
-      ptr->fd = fd;
-      ptr->next = GLOBAL_mmap_arrays;
-      GLOBAL_mmap_arrays = ptr;
-      WRITE_UNLOCK(pp->ArRWLock);
+    if (!EndOfPAEntr(pp) &&
+        (ArrayIsDynamic((ArrayEntry *)pp) || pp->ValueOfVE.ints != NULL)) {
       WRITE_UNLOCK(ae->ARWLock);
-      return TRUE;
-    } else {
+      munmap(array_addr, total_size);
+      close(fd);
+      Yap_ThrowError(PERMISSION_ERROR_CREATE_ARRAY, t, "create_mmapped_array");
+      return (FALSE);
+    }
+    pp = CreateStaticArray(ae, size, props, array_addr, pp PASS_REGS);
+    if (pp == NULL) {
       WRITE_UNLOCK(ae->ARWLock);
-      Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, t, "create_mmapped_array",
-                ae->StrOfAE);
+      munmap(array_addr, total_size);
+      close(fd);
       return (FALSE);
     }
-  } else {
-    Yap_ThrowError(TYPE_ERROR_ATOM, t, "create_mmapped_array");
-    return FALSE;
+    if (read_only)
+      pp->TypeOfAE |= READ_ONLY_ARRAY;
+    ptr = (mmap_array_block *)Yap_AllocAtomSpace(sizeof(mmap_array_block));
+    ptr->name = AbsAtom(ae);
+    ptr->size = total_size;
+    ptr->items = size;
+    ptr->start = (void *)array_addr;
+    ptr->fd = fd;
+    ptr->next = GLOBAL_mmap_arrays;
+    GLOBAL_mmap_arrays = ptr;
+    WRITE_UNLOCK(ae->ARWLock);
+    return Yap_unify(ARG2, MkIntegerTerm(size));
   }
 #else
   Yap_ThrowError(SYSTEM_ERROR_INTERNAL, ARG1, "create_mmapped_array (mmap)");
@@ -1667,6 +1978,77 @@ static Int create_mmapped_array(USES_REGS1) {
 #endif
 }
 
+/** @pred  mmapped_array(+ _Name_, + _Size_, + _Type_, + _File_)
+
+
+Similar to static_array/3, but the array is memory mapped to file
+ _File_. This means that the array is initialized from the file, and
+that any changes to the array will also be stored in the file. The
+file is created if it does not exist, and grows to hold  _Size_
+elements if it is smaller, so that an array can be opened again, with
+its contents, by a later run.
+
+This built-in is only available in operating systems that support the
+system call `mmap`. Moreover, mmapped arrays do not store generic
+terms (type `term`).
+
+
+*/
+static Int create_mmapped_array(USES_REGS1) {
+  return open_mmapped_array(false PASS_REGS);
+}
+
+/** @pred  mmapped_array(+ _Name_, ? _Size_, + _Type_, + _File_, + _Options_)
+
+As mmapped_array/4, with options:
+
+  + access(read): map an existing file for reading only. If  _Size_
+  is unbound it is unified with the number of elements in the
+  file. The pages of the file are shared by all the processes that map
+  it, so that a large array is loaded once, and only the parts that
+  are used are ever read from disk. The array cannot be updated,
+  resized or reset.
+  + access(read_write): the default, as in mmapped_array/4.
+*/
+static Int create_mmapped_array_with_options(USES_REGS1) {
+  Term opts = Deref(ARG5);
+  bool read_only = false;
+
+  while (!IsVarTerm(opts) && IsPairTerm(opts)) {
+    Term opt = Deref(HeadOfTerm(opts));
+
+    if (IsVarTerm(opt)) {
+      Yap_ThrowError(INSTANTIATION_ERROR, opt, "mmapped_array/5");
+      return FALSE;
+    }
+    if (IsApplTerm(opt) && FunctorOfTerm(opt) == Yap_MkFunctor(AtomAccess, 1) &&
+        IsAtomTerm(Deref(ArgOfTerm(1, opt)))) {
+      const char *mode = RepAtom(AtomOfTerm(Deref(ArgOfTerm(1, opt))))->StrOfAE;
+
+      if (!strcmp(mode, "read"))
+        read_only = true;
+      else if (!strcmp(mode, "read_write"))
+        read_only = false;
+      else {
+        Yap_ThrowError(DOMAIN_ERROR_OPEN_OPTION, opt, "mmapped_array/5");
+        return FALSE;
+      }
+    } else {
+      Yap_ThrowError(DOMAIN_ERROR_OPEN_OPTION, opt, "mmapped_array/5");
+      return FALSE;
+    }
+    opts = Deref(TailOfTerm(opts));
+  }
+  if (IsVarTerm(opts)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, opts, "mmapped_array/5");
+    return FALSE;
+  } else if (opts != TermNil) {
+    Yap_ThrowError(TYPE_ERROR_LIST, opts, "mmapped_array/5");
+    return FALSE;
+  }
+  return open_mmapped_array(read_only PASS_REGS);
+}
+
 /* This routine removes array references from complex terms? */
 static void replace_array_references_complex(register CELL *pt0,
                                              register CELL *pt0_end,
@@ -1929,6 +2311,11 @@ static Int assign_static(USES_REGS1) {
       Yap_ThrowError(DOMAIN_ERROR_ARRAY_OVERFLOW, t2, "assign_static");
       return FALSE;
     }
+    if (ptr->TypeOfAE & READ_ONLY_ARRAY) {
+      WRITE_UNLOCK(ptr->ArRWLock);
+      Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, t1, "assign_static");
+      return FALSE;
+    }
     switch (ptr->ArrayType) {
     case array_of_ints: {
       Int i;
@@ -2018,6 +2405,27 @@ static Int assign_static(USES_REGS1) {
       ptr->ValueOfVE.floats[indx] = f;
     } break;
 
+    case array_of_int16s:
+    case array_of_int32s:
+    case array_of_floats32: {
+      Int i = 0;
+      Float f = 0.0;
+      yap_error_number err;
+
+      if (IsVarTerm(t3)) {
+        WRITE_UNLOCK(ptr->ArRWLock);
+        Yap_ThrowError(INSTANTIATION_ERROR, t3, "assign_static");
+        return FALSE;
+      }
+      err = NumberToElement(ptr->ArrayType, Yap_Eval(t3), &i, &f);
+      if (err != YAP_NO_ERROR) {
+        WRITE_UNLOCK(ptr->ArRWLock);
+        Yap_ThrowError(err, t3, "assign_static");
+        return FALSE;
+      }
+      StoreNumber(ptr, indx, i, f);
+    } break;
+
     case array_of_ptrs: {
       Int r;
 
@@ -2242,7 +2650,10 @@ static Int assign_dynamic(USES_REGS1) {
   case array_of_ints:
   case array_of_chars:
   case array_of_uchars:
+  case array_of_int16s:
+  case array_of_int32s:
   case array_of_doubles:
+  case array_of_floats32:
   case array_of_ptrs:
   case array_of_atoms:
   case array_of_dbrefs:
@@ -2450,6 +2861,11 @@ static Int add_to_array_element(USES_REGS1) {
     Yap_ThrowError(DOMAIN_ERROR_ARRAY_OVERFLOW, t2, "add_to_array_element");
     return FALSE;
   }
+  if (ptr->TypeOfAE & READ_ONLY_ARRAY) {
+    WRITE_UNLOCK(ptr->ArRWLock);
+    Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, t1, "add_to_array_element");
+    return FALSE;
+  }
   switch (ptr->ArrayType) {
   case array_of_ints: {
     Int i = ptr->ValueOfVE.ints[indx];
@@ -2479,6 +2895,49 @@ static Int add_to_array_element(USES_REGS1) {
     WRITE_UNLOCK(ptr->ArRWLock);
     return Yap_unify(ARG4, MkFloatTerm(fl));
   } break;
+  case array_of_int32s:
+  case array_of_int16s: {
+    Int i = (ptr->ArrayType == array_of_int32s ? ptr->ValueOfVE.int32s[indx]
+                                                : ptr->ValueOfVE.int16s[indx]);
+    yap_error_number err;
+
+    if (!IsIntegerTerm(t3)) {
+      WRITE_UNLOCK(ptr->ArRWLock);
+      Yap_ThrowError(TYPE_ERROR_INTEGER, t3, "add_to_array_element");
+      return FALSE;
+    }
+    i += IntegerOfTerm(t3);
+    if ((err = IntegerFitsArray(ptr->ArrayType, i)) != YAP_NO_ERROR) {
+      WRITE_UNLOCK(ptr->ArRWLock);
+      Yap_ThrowError(err, t3, "add_to_array_element");
+      return FALSE;
+    }
+    StoreNumber(ptr, indx, i, 0.0);
+    WRITE_UNLOCK(ptr->ArRWLock);
+    return Yap_unify(ARG4, MkIntegerTerm(i));
+  } break;
+  case array_of_floats32: {
+    Float fl = ptr->ValueOfVE.floats32[indx];
+    yap_error_number err;
+
+    if (IsFloatTerm(t3)) {
+      fl += FloatOfTerm(t3);
+    } else if (IsIntegerTerm(t3)) {
+      fl += IntegerOfTerm(t3);
+    } else {
+      WRITE_UNLOCK(ptr->ArRWLock);
+      Yap_ThrowError(TYPE_ERROR_NUMBER, t3, "add_to_array_element");
+      return FALSE;
+    }
+    if ((err = FloatFitsArray(ptr->ArrayType, fl)) != YAP_NO_ERROR) {
+      WRITE_UNLOCK(ptr->ArRWLock);
+      Yap_ThrowError(err, t3, "add_to_array_element");
+      return FALSE;
+    }
+    fl = ptr->ValueOfVE.floats32[indx] = fl;
+    WRITE_UNLOCK(ptr->ArRWLock);
+    return Yap_unify(ARG4, MkFloatTerm(fl));
+  } break;
   default:
     WRITE_UNLOCK(ptr->ArRWLock);
     Yap_ThrowError(TYPE_ERROR_NUMBER, t2, "add_to_array_element");
@@ -2486,6 +2945,274 @@ static Int add_to_array_element(USES_REGS1) {
   }
 }
 
+/* an integer argument to the bulk operations */
+static bool IntegerArg(Term t, Int *ip, const char *caller USES_REGS) {
+  Term nti;
+
+  if (IsVarTerm(t)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, t, "%s", caller);
+    return false;
+  }
+  if (!IsIntegerTerm(nti = Yap_Eval(t))) {
+    Yap_ThrowError(TYPE_ERROR_INTEGER, t, "%s", caller);
+    return false;
+  }
+  *ip = IntegerOfTerm(nti);
+  return true;
+}
+
+/* make room for cells cells in the global stack */
+static bool EnoughGlobal(size_t cells USES_REGS) {
+  while (HR + cells > ASP - 1024) {
+    if (!Yap_dogc(PASS_REGS1)) {
+      Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+      return false;
+    }
+    if (HR + cells > ASP - 1024 &&
+        !Yap_growstack(sizeof(CELL) * (cells + 1024))) {
+      Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+      return false;
+    }
+  }
+  return true;
+}
+
+/** @pred  static_array_slice(+ _Name_, + _Offset_, + _Length_, - _List_)
+
+
+Unify  _List_ with the  _Length_ elements of the static array  _Name_
+that start at  _Offset_. The array must hold numbers.
+
+
+*/
+static Int static_array_slice(USES_REGS1) {
+  StaticArrayEntry *pp;
+  Int offset, len, i;
+  CELL *pt;
+
+  if (!IntegerArg(Deref(ARG2), &offset, "static_array_slice" PASS_REGS) ||
+      !IntegerArg(Deref(ARG3), &len, "static_array_slice" PASS_REGS))
+    return FALSE;
+  if (len < 0) {
+    Yap_ThrowError(DOMAIN_ERROR_NOT_LESS_THAN_ZERO, ARG3, "static_array_slice");
+    return FALSE;
+  }
+  if ((pp = GetStaticArray(Deref(ARG1), "static_array_slice")) == NULL)
+    return FALSE;
+  if (!ArrayOfNumbers(pp->ArrayType)) {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, ARG1, "static_array_slice");
+    return FALSE;
+  }
+  if (len == 0)
+    return Yap_unify(ARG4, TermNil);
+  /* a pair per element, and three cells for a float or a large integer */
+  if (!EnoughGlobal(5 * len PASS_REGS))
+    return FALSE;
+  READ_LOCK(pp->ArRWLock);
+  if (offset < 0 || len > pp->ArrayEArity - offset) {
+    READ_UNLOCK(pp->ArRWLock);
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_OVERFLOW, ARG2, "static_array_slice");
+    return FALSE;
+  }
+  pt = HR;
+  HR += 2 * len;
+#define SLICE(V, MK)                                                           \
+  for (i = 0; i < len; i++)                                                    \
+    pt[2 * i] = MK((V)[offset + i]);                                           \
+  break;
+  switch (pp->ArrayType) {
+  case array_of_ints:
+    SLICE(pp->ValueOfVE.ints, MkIntegerTerm)
+  case array_of_int32s:
+    SLICE(pp->ValueOfVE.int32s, MkIntegerTerm)
+  case array_of_int16s:
+    SLICE(pp->ValueOfVE.int16s, MkIntTerm)
+  case array_of_chars:
+    SLICE((signed char *)pp->ValueOfVE.chars, MkIntTerm)
+  case array_of_uchars:
+    SLICE(pp->ValueOfVE.uchars, MkIntTerm)
+  case array_of_doubles:
+    SLICE(pp->ValueOfVE.floats, MkFloatTerm)
+  case array_of_floats32:
+    SLICE(pp->ValueOfVE.floats32, MkFloatTerm)
+  default:
+    break;
+  }
+#undef SLICE
+  READ_UNLOCK(pp->ArRWLock);
+  for (i = 0; i < len - 1; i++)
+    pt[2 * i + 1] = AbsPair(pt + 2 * i + 2);
+  pt[2 * len - 1] = TermNil;
+  return Yap_unify(ARG4, AbsPair(pt));
+}
+
+/** @pred  update_array_slice(+ _Name_, + _Offset_, + _List_)
+
+
+Store the numbers in  _List_ in the static array  _Name_, from
+ _Offset_ on. Every number is checked before the first one is stored,
+so that an error leaves the array as it was.
+
+
+*/
+static Int update_array_slice(USES_REGS1) {
+  StaticArrayEntry *pp;
+  Int offset, len, k, i = 0;
+  Float f = 0.0;
+  yap_error_number err;
+  Term l;
+
+  if (!IntegerArg(Deref(ARG2), &offset, "update_array_slice" PASS_REGS))
+    return FALSE;
+  if ((pp = GetStaticArray(Deref(ARG1), "update_array_slice")) == NULL)
+    return FALSE;
+  if (!ArrayOfNumbers(pp->ArrayType)) {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, ARG1, "update_array_slice");
+    return FALSE;
+  }
+  if (pp->TypeOfAE & READ_ONLY_ARRAY) {
+    Yap_ThrowError(PERMISSION_ERROR_MODIFY_ARRAY, ARG1, "update_array_slice");
+    return FALSE;
+  }
+  for (l = Deref(ARG3), len = 0; IsPairTerm(l);
+       l = Deref(TailOfTerm(l)), len++) {
+    Term th = Deref(HeadOfTerm(l));
+
+    if ((err = NumberToElement(pp->ArrayType, th, &i, &f)) != YAP_NO_ERROR) {
+      Yap_ThrowError(err, th, "update_array_slice");
+      return FALSE;
+    }
+  }
+  if (IsVarTerm(l)) {
+    Yap_ThrowError(INSTANTIATION_ERROR, ARG3, "update_array_slice");
+    return FALSE;
+  } else if (l != TermNil) {
+    Yap_ThrowError(TYPE_ERROR_LIST, ARG3, "update_array_slice");
+    return FALSE;
+  }
+  WRITE_LOCK(pp->ArRWLock);
+  if (offset < 0 || len > pp->ArrayEArity - offset) {
+    WRITE_UNLOCK(pp->ArRWLock);
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_OVERFLOW, ARG2, "update_array_slice");
+    return FALSE;
+  }
+  for (l = Deref(ARG3), k = offset; IsPairTerm(l);
+       l = Deref(TailOfTerm(l)), k++) {
+    NumberToElement(pp->ArrayType, Deref(HeadOfTerm(l)), &i, &f);
+    StoreNumber(pp, k, i, f);
+  }
+  WRITE_UNLOCK(pp->ArRWLock);
+  return TRUE;
+}
+
+typedef enum { ARRAY_SUM, ARRAY_MIN, ARRAY_MAX, ARRAY_ARGMAX } array_reduction;
+
+/* reduce a static array of numbers to a number */
+static Int ReduceArray(array_reduction op, const char *caller USES_REGS) {
+  StaticArrayEntry *pp;
+  size_t n;
+  Term out = TermNil;
+
+  if ((pp = GetStaticArray(Deref(ARG1), caller)) == NULL)
+    return FALSE;
+  if (!ArrayOfNumbers(pp->ArrayType)) {
+    Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, ARG1, "%s", caller);
+    return FALSE;
+  }
+  READ_LOCK(pp->ArRWLock);
+  n = pp->ArrayEArity;
+  if (n == 0 && op != ARRAY_SUM) {
+    READ_UNLOCK(pp->ArRWLock);
+    return FALSE;
+  }
+#define REDUCE(NAME, V, MK)                                                    \
+  switch (op) {                                                                \
+  case ARRAY_SUM:                                                              \
+    out = sum_##NAME(V, n PASS_REGS);                                          \
+    break;                                                                     \
+  case ARRAY_MIN:                                                              \
+    out = MK(min_##NAME(V, n));                                                \
+    break;                                                                     \
+  case ARRAY_MAX:                                                              \
+    out = MK(max_##NAME(V, n));                                                \
+    break;                                                                     \
+  case ARRAY_ARGMAX:                                                           \
+    out = MkIntegerTerm(argmax_##NAME(V, n));                                  \
+    break;                                                                     \
+  }                                                                            \
+  break;
+  switch (pp->ArrayType) {
+  case array_of_ints:
+    REDUCE(ints, pp->ValueOfVE.ints, MkIntegerTerm)
+  case array_of_int32s:
+    REDUCE(int32s, pp->ValueOfVE.int32s, MkIntegerTerm)
+  case array_of_int16s:
+    REDUCE(int16s, pp->ValueOfVE.int16s, MkIntegerTerm)
+  case array_of_chars:
+    REDUCE(chars, (signed char *)pp->ValueOfVE.chars, MkIntegerTerm)
+  case array_of_uchars:
+    REDUCE(uchars, pp->ValueOfVE.uchars, MkIntegerTerm)
+  case array_of_doubles:
+    REDUCE(doubles, pp->ValueOfVE.floats, MkFloatTerm)
+  case array_of_floats32:
+    REDUCE(floats32, pp->ValueOfVE.floats32, MkFloatTerm)
+  default:
+    break;
+  }
+#undef REDUCE
+  READ_UNLOCK(pp->ArRWLock);
+  return Yap_unify(ARG2, out);
+}
+
+/** @pred  static_array_sum(+ _Name_, - _Sum_)
+
+
+Unify  _Sum_ with the sum of the elements of the static array of
+numbers  _Name_: an integer for arrays of integers, and a float for
+arrays of floats.
+
+
+*/
+static Int static_array_sum(USES_REGS1) {
+  return ReduceArray(ARRAY_SUM, "static_array_sum" PASS_REGS);
+}
+
+/** @pred  static_array_min(+ _Name_, - _Min_)
+
+
+Unify  _Min_ with the least element of the static array of numbers
+ _Name_. Fails if the array is empty.
+
+
+*/
+static Int static_array_min(USES_REGS1) {
+  return ReduceArray(ARRAY_MIN, "static_array_min" PASS_REGS);
+}
+
+/** @pred  static_array_max(+ _Name_, - _Max_)
+
+
+Unify  _Max_ with the greatest element of the static array of numbers
+ _Name_. Fails if the array is empty.
+
+
+*/
+static Int static_array_max(USES_REGS1) {
+  return ReduceArray(ARRAY_MAX, "static_array_max" PASS_REGS);
+}
+
+/** @pred  static_array_argmax(+ _Name_, - _Index_)
+
+
+Unify  _Index_ with the index of the first greatest element of the
+static array of numbers  _Name_. Fails if the array is empty.
+
+
+*/
+static Int static_array_argmax(USES_REGS1) {
+  return ReduceArray(ARRAY_ARGMAX, "static_array_argmax" PASS_REGS);
+}
+
 static Int compile_array_refs(USES_REGS1) {
   compile_arrays = TRUE;
   return (TRUE);
@@ -2535,15 +3262,19 @@ static Int static_array_to_term(USES_REGS1) {
     } else {
       static_array_types tp = pp->ArrayType;
       Int dim = pp->ArrayEArity, indx;
+      /* floats take a cell in the term and three more for themselves */
+      Int need = 1 + (tp == array_of_doubles || tp == array_of_floats32
+                          ? 4 * dim
+                          : dim);
       CELL *base;
 
-      while (HR + 1 + dim > ASP - 1024) {
+      while (HR + need > ASP - 1024) {
         if (!Yap_dogc(PASS_REGS1)) {
           Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
           return (FALSE);
         } else {
-          if (HR + 1 + dim > ASP - 1024) {
-            if (!Yap_growstack(sizeof(CELL) * (dim + 1 - (HR - ASP - 1024)))) {
+          if (HR + need > ASP - 1024) {
+            if (!Yap_growstack(sizeof(CELL) * (need + 1024))) {
               Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
               return FALSE;
             }
@@ -2616,6 +3347,27 @@ static Int static_array_to_term(USES_REGS1) {
           *sptr++ = MkIntTerm(pp->ValueOfVE.uchars[indx]);
         }
       } break;
+      case array_of_int16s: {
+        CELL *sptr = HR;
+        HR += dim;
+        for (indx = 0; indx < dim; indx++) {
+          *sptr++ = MkIntTerm(pp->ValueOfVE.int16s[indx]);
+        }
+      } break;
+      case array_of_int32s: {
+        CELL *sptr = HR;
+        HR += dim;
+        for (indx = 0; indx < dim; indx++) {
+          *sptr++ = MkIntegerTerm(pp->ValueOfVE.int32s[indx]);
+        }
+      } break;
+      case array_of_floats32: {
+        CELL *sptr = HR;
+        HR += dim;
+        for (indx = 0; indx < dim; indx++) {
+          *sptr++ = MkEvalFl(pp->ValueOfVE.floats32[indx]);
+        }
+      } break;
       case array_of_terms: {
         CELL *sptr = HR;
         HR += dim;
@@ -2706,6 +3458,8 @@ static Int static_array_location(USES_REGS1) {
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("mmapped_array", 4, create_mmapped_array,
                 SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("mmapped_array", 5, create_mmapped_array_with_options,
+                SafePredFlag | SyncPredFlag);
   Yap_InitCPred("update_array", 3, assign_static, SafePredFlag);
   Yap_InitCPred("update_whole_array", 2, update_all, SafePredFlag);
   Yap_InitCPred("dynamic_update_array", 3, assign_dynamic, SafePredFlag);  Yap_InitCPred("add_to_array_element", 4, add_to_array_element, SafePredFlag);
@@ -2719,6 +3473,12 @@ static Int static_array_location(USES_REGS1) {
                 SafePredFlag);
   Yap_InitCPred("static_array_to_term", 2, static_array_to_term, 0L);
   Yap_InitCPred("static_array_location", 2, static_array_location, 0L);
+  Yap_InitCPred("static_array_slice", 4, static_array_slice, 0L);
+  Yap_InitCPred("update_array_slice", 3, update_array_slice, SafePredFlag);
+  Yap_InitCPred("static_array_sum", 2, static_array_sum, 0L);
+  Yap_InitCPred("static_array_min", 2, static_array_min, 0L);
+  Yap_InitCPred("static_array_max", 2, static_array_max, 0L);
+  Yap_InitCPred("static_array_argmax", 2, static_array_argmax, 0L);
 }
 
 /**
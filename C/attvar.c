@@ -52,28 +52,64 @@ void Yap_wake_goal(Term tg USES_REGS) {
       if (!LOCAL_DoNotWakeUp)
 	Yap_signal(YAP_WAKEUP_SIGNAL);
     } else {
-      CELL *pt = HR;
-      Term nt;
-      HR += 3;
-      while (IsApplTerm(WGs) && FunctorOfTerm((nt = ArgOfTerm(2, WGs))) == FunctorComma) {
+      Term t[2], nt;
+      while (IsApplTerm((nt = ArgOfTerm(2, WGs))) &&
+             FunctorOfTerm(nt) == FunctorComma) {
         WGs = nt;
       }
-      Term newTail = AbsAppl(HR);
-      *pt++ = (CELL)FunctorComma;
-      *pt++ = TermTrue;
-      MaBind(RepAppl(WGs) + 2, newTail);
+      t[0] = nt;
+      t[1] = tg;
+      MaBind(RepAppl(WGs) + 2, Yap_MkApplTerm(FunctorComma, 2, t));
     }
   }
 }
 
+/* the list of bindings of the last woken goal, if that goal is a batch
+   of attributed variables */
+static CELL *WokenBatch(Term WGs) {
+  while (IsApplTerm(WGs) && FunctorOfTerm(WGs) == FunctorComma)
+    WGs = ArgOfTerm(2, WGs);
+  if (IsApplTerm(WGs) && FunctorOfTerm(WGs) == FunctorAttGoals)
+    return RepAppl(WGs) + 1;
+  return NULL;
+}
+
+/* attributed variables bound before the next wake-up go to one
+   unify_attributed_variables/1 goal, newest first.
+
+   We are inside a unification, which holds pointers to the stacks, so
+   we can neither grow them nor collect garbage. The last call left a
+   stack gap: once the records have used half of it, the batch becomes
+   `all`, and Yap_CloseWokenBatch() lists the variables at the next
+   interrupt, where the stacks may grow. */
 void AddToQueue(attvar_record *attv USES_REGS) {
-  Term t[2];
-  Term ng;
+  Term t[2], pair;
+  CELL *batch;
 
+  LOCAL_WokenAttVars++;
+  batch = WokenBatch(Yap_ReadTimedVar(LOCAL_WokenGoals));
+  if (batch && *batch == TermAll)
+    return;
+  if (Unsigned(HR) > Unsigned(ASP) - StackGap(PASS_REGS1) / 2) {
+    if (batch) {
+      MaBind(batch, TermAll);
+    } else {
+      LOCAL_WakeUpBatches++;
+      pair = TermAll;
+      Yap_wake_goal(Yap_MkApplTerm(FunctorAttGoals, 1, &pair) PASS_REGS);
+    }
+    return;
+  }
   t[0] = (CELL) & (attv->Done);
   t[1] = attv->Future;
-  ng = Yap_MkApplTerm(FunctorAttGoal, 2, t);
-  Yap_wake_goal(ng PASS_REGS);
+  pair = Yap_MkApplTerm(FunctorMinus, 2, t);
+  if (batch) {
+    MaBind(batch, MkPairTerm(pair, *batch));
+    return;
+  }
+  LOCAL_WakeUpBatches++;
+  pair = MkPairTerm(pair, TermNil);
+  Yap_wake_goal(Yap_MkApplTerm(FunctorAttGoals, 1, &pair) PASS_REGS);
 }
 void AddCompareToQueue(Term Cmp, Term t1, Term t2 USES_REGS) {
   Term ts[3];
@@ -618,6 +654,12 @@ static Int put_atts(USES_REGS1) {
   if (IsVarTerm(inp)) {
     attvar_record *attv;
     Term tatts = Deref(ARG2);
+    if (IsAttachedTerm(inp)) {
+      /* replace the old attributes, as undone on backtracking */
+      attv = RepAttVar(VarOfTerm(inp));
+      MaBind(&(attv->Atts), tatts);
+      return TRUE;
+    }
     while (!(attv = BuildNewAttVar(PASS_REGS1))) {
         LOCAL_Error_Size = sizeof(attvar_record);
         if (!Yap_dogc(PASS_REGS1)) {
@@ -837,6 +879,16 @@ static Int wake_up_start(USES_REGS1) {
      LOCAL_DoNotWakeUp = true;
   return true;
 }
+
+/** @pred $attvar_wakeups(- _Woken_, - _Batches_)
+
+Number of attributed variables woken so far, and of the batches they
+were woken in.
+*/
+static Int attvar_wakeups(USES_REGS1) {
+  return Yap_unify(ARG1, MkIntegerTerm(LOCAL_WokenAttVars)) &&
+         Yap_unify(ARG2, MkIntegerTerm(LOCAL_WakeUpBatches));
+}
 static Int unbind_attvar(USES_REGS1) {
   /* receive a variable in ARG1 */
   Term inp = Deref(ARG1);
@@ -998,8 +1050,6 @@ static Int put_attr(USES_REGS1) {
 
     if (IsAttachedTerm(inp)) {
       attv = RepAttVar(VarOfTerm(inp));
-      ts[2] = attv->Atts;
-      MaBind(&attv->Atts,  Yap_MkApplTerm(FunctorAtt1, 3, ts));
       Term start = attv->Atts;
   do {
     if (IsVarTerm(start))
@@ -1089,7 +1139,7 @@ static Int del_attr(USES_REGS1) {
   Term inp = Deref(ARG1);
   Term mod = must_be_module(ARG2);
   /* if this is unbound, ok */
-  if (!IsVarTerm(inp) || IsAttachedTerm(inp)) {
+  if (!IsVarTerm(inp) || !IsAttachedTerm(inp)) {
     return true;
   }
   attvar_record *attv = RepAttVar(VarOfTerm(inp));
@@ -1161,24 +1211,39 @@ static Int swi_all_atts(USES_REGS1) {
   }
 }
 
-static Term AllAttVars(USES_REGS1) {
+/* the attributed variables on the global stack that are still active,
+   oldest first, or, if bound is set, those bound and not yet woken, as
+   Var-Value pairs, newest first */
+static Term AttVarsOnGlobal(bool bound USES_REGS) {
   CELL *pt = H0;
   CELL *myH = HR;
+  Term out = TermNil, *tail = &out;
 
-  while (pt < myH) {
+  while (pt < HR) {
     Term reg = *pt;
     Functor f = (Functor)reg;
     if (reg == (CELL)FunctorAttVar) {
-      if (IsUnboundVar(pt + 1)) {
+      attvar_record *attv = (attvar_record *)pt;
+      if (IsUnboundVar(&attv->Done) &&
+          (!bound || !IsUnboundVar(&attv->Future))) {
         if (ASP - myH < 1024) {
           LOCAL_Error_Size = (ASP - HR) * sizeof(CELL);
           return 0L;
         }
-        if (myH != HR) {
-          myH[-1] = AbsPair(myH);
+        if (bound) {
+          myH[0] = AbsAppl(myH + 2);
+          myH[1] = out;
+          myH[2] = (CELL)FunctorMinus;
+          myH[3] = AbsAttVar(attv);
+          myH[4] = attv->Future;
+          out = AbsPair(myH);
+          myH += 5;
+        } else {
+          *tail = AbsPair(myH);
+          myH[0] = AbsAttVar(attv);
+          tail = myH + 1;
+          myH += 2;
         }
-        myH[0] = AbsAttVar((attvar_record *)pt);
-        myH += 2;
       }
       pt += (1 + ATT_RECORD_ARITY);
     } else if (IsExtensionFunctor(f) && reg > 0 && reg % sizeof(CELL) == 0) {
@@ -1194,21 +1259,36 @@ static Term AllAttVars(USES_REGS1) {
       pt++;
     }
   }
-  if (myH != HR) {
-    Term out = AbsPair(HR);
-    myH[-1] = TermNil;
-    HR = myH;
-    return out;
-  } else {
-    return TermNil;
+  if (!bound)
+    *tail = TermNil;
+  HR = myH;
+  return out;
+}
+
+/* A batch that ran out of room is `all`: before a collection could lose
+   the variables only the batch knew about, list them in its place. */
+void Yap_CloseWokenBatch(USES_REGS1) {
+  CELL *batch = WokenBatch(Yap_ReadTimedVar(LOCAL_WokenGoals));
+  Term out;
+
+  if (!batch || *batch != TermAll)
+    return;
+  while (!(out = AttVarsOnGlobal(true PASS_REGS))) {
+    if (!Yap_growstack(2 * (ASP - HR) * sizeof(CELL))) {
+      Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+      return;
+    }
+    /* the global stack may have moved */
+    batch = WokenBatch(Yap_ReadTimedVar(LOCAL_WokenGoals));
   }
+  MaBind(batch, out);
 }
 
 static Int all_attvars(USES_REGS1) {
   do {
     Term out;
 
-    if (!(out = AllAttVars(PASS_REGS1))) {
+    if (!(out = AttVarsOnGlobal(false PASS_REGS))) {
       Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
       return FALSE;
     } else {
@@ -1300,5 +1380,6 @@ void Yap_InitAttVarPreds(void) {
   Yap_InitCPred("$att_bound", 1, attvar_bound, SafePredFlag | TestPredFlag);
   Yap_InitCPred("$wake_up_start", 0, wake_up_start, 0);
   Yap_InitCPred("$wake_up_done", 0, wake_up_done, 0);
+  Yap_InitCPred("$attvar_wakeups", 2, attvar_wakeups, SafePredFlag);
 }
 /** @} */
@@ -352,15 +352,14 @@ CELL *Yap_HeapStoreOpaqueTerm(Term t) {
   void *new;
 
   sz = SizeOfOpaqueTerm(ptr,ptr[0]);
-  new = Yap_AllocCodeSpace(sz);
+  new = Yap_AllocCodeSpace(sz * sizeof(CELL));
   if (!new) {
     Yap_Error(RESOURCE_ERROR_HEAP, TermNil,
               "subgoal_search_loop: no space for %s", StringOfTerm(t));
   } else {
-    if (ptr[0] == (CELL)FunctorBlob) {
-      CELL *new = ptr + 3;
-    memmove(new, ptr, sz);
-    }
+    memmove(new, ptr, sz * sizeof(CELL));
+    /* the closing mark points back to the start of the copy */
+    ((CELL *)new)[sz - 1] = CloseExtension((CELL *)new);
   }
   return new;
 }
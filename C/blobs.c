@@ -51,20 +51,10 @@ char *Yap_blob_to_string(AtomEntry *ref, const char *s0, size_t sz) {
     return s;
   } else {
 #endif
-#if __APPLE__
-    size_t sz0 = strlcpy(s, (char *)RepAtom(AtomSWIStream)->StrOfAE, sz);
-#else
-  size_t sz0;
-  char *f = (char *)memcpy(s, (char *)RepAtom(AtomSWIStream)->StrOfAE, sz);
-  f[0] = '\0';
-  sz0 = f - s;
-#endif
-    s = s + sz0;
-    sz -= sz0;
 #if defined(__linux__) || defined(__APPLE__)
-    snprintf(s + strlen(s), sz0, "(%p)", ref);
+    snprintf(s, sz, "\'%s\'(%p)", RepAtom(AtomSWIStream)->StrOfAE, ref);
 #else
-  snprintf(s + strlen(s), sz0, "(0x%p)", ref);
+    snprintf(s, sz, "\'%s\'(0x%p)", RepAtom(AtomSWIStream)->StrOfAE, ref);
 #endif
     return s;
 #if HAVE_FMEMOPEN
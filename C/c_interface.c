@@ -221,12 +221,8 @@ static arity_t current_arity(void) {
 static int doexpand(UInt sz) {
   CACHE_REGS
 
-  gc_entry_info_t info;
-  Yap_track_cpred(0, P, 0, &info);
-  if (!Yap_gc(&info)) {
-    return FALSE;
-  }
-  return TRUE;
+  /* collect, and grow the stacks if that does not free sz bytes */
+  return Yap_dogcl(sz PASS_REGS);
 }
 
 X_API YAP_Term YAP_A(int i) {
@@ -1157,7 +1153,7 @@ X_API Int YAP_Execute(PredEntry *pe, CPredicate exec_code) {
   else {
     complete_fail(((choiceptr)(LCL0 - OASP)), FALSE PASS_REGS);
   }
-  Yap_RecoverHandles(0, hdl);
+  Yap_CloseHandles(hdl);
   pop_text_stack(lvl);
   // CurrentModule = omod;
   RECOVER_MACHINE_REGS();
@@ -3103,6 +3099,15 @@ X_API Int YAP_AtomToInt(YAP_Atom At) {
   TranslationEntry *te = Yap_GetTranslationProp(At, 0);
   if (te != NIL)
     return te->Translation;
+  if (TR_Atoms == NULL) {
+    MaxAtomTranslations = 1024;
+    TR_Atoms = (atom_t *)malloc(sizeof(atom_t) * MaxAtomTranslations);
+    if (TR_Atoms == NULL) {
+      Yap_Error(SYSTEM_ERROR_INTERNAL, MkAtomTerm(At),
+                "No more room for translations");
+      return -1;
+    }
+  }
   TR_Atoms[AtomTranslations] = At;
   Yap_PutAtomTranslation(At, 0, AtomTranslations);
   AtomTranslations++;
@@ -3122,7 +3127,11 @@ X_API Int YAP_AtomToInt(YAP_Atom At) {
   return AtomTranslations - 1;
 }
 
-X_API YAP_Atom YAP_IntToAtom(Int i) { return TR_Atoms[i]; }
+X_API YAP_Atom YAP_IntToAtom(Int i) {
+  if (i < 0 || i >= AtomTranslations)
+    return NULL;
+  return TR_Atoms[i];
+}
 
 X_API Int YAP_FunctorToInt(YAP_Functor f) {
   YAP_Atom At = NameOfFunctor(f);
@@ -3130,6 +3139,15 @@ X_API Int YAP_FunctorToInt(YAP_Functor f) {
   TranslationEntry *te = Yap_GetTranslationProp(At, arity);
   if (te != NIL)
     return te->Translation;
+  if (TR_Functors == NULL) {
+    MaxFunctorTranslations = 1024;
+    TR_Functors = (functor_t *)malloc(sizeof(functor_t) * MaxFunctorTranslations);
+    if (TR_Functors == NULL) {
+      Yap_Error(SYSTEM_ERROR_INTERNAL, MkAtomTerm(At),
+                "No more room for translations");
+      return -1;
+    }
+  }
   TR_Functors[FunctorTranslations] = f;
   Yap_PutAtomTranslation(At, arity, FunctorTranslations);
   FunctorTranslations++;
@@ -3154,7 +3172,11 @@ X_API void *YAP_foreign_stream(int sno) {
   return GLOBAL_Stream[sno].u.private_data;
 }
 
-X_API YAP_Functor YAP_IntToFunctor(Int i) { return TR_Functors[i]; }
+X_API YAP_Functor YAP_IntToFunctor(Int i) {
+  if (i < 0 || i >= FunctorTranslations)
+    return NULL;
+  return TR_Functors[i];
+}
 
 X_API YAP_PredEntryPtr YAP_TopGoal(void) {
   Functor f = Yap_MkFunctor(Yap_LookupAtom("yap_query"), 3);
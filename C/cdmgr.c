@@ -1865,7 +1865,7 @@ bool Yap_addclause(Term t, yamop *cp, Term tmode, Term mod, Term *t5ref)
     return false;
   }
   if (pflags & UDIPredFlag) {
-    Yap_new_udi_clause(p, cp, t);
+    Yap_new_udi_clause(p, cp, tf);
   }
   if (!is_dynamic(p)) {
     if (pflags & LogUpdatePredFlag) {
@@ -2640,30 +2640,24 @@ static Int p_is_exo(USES_REGS1) { /* '$is_dynamic'(+P)	 */
 }
 static  Term gpred(PredEntry *pe)
 {
-    Term out = TermStaticProcedure;
-    MegaClause *mcl;
+    Term out;
     if ( pe->OpcodeOfPred == UNDEF_OPCODE)
         return TermUndefined;
     PELOCK(28, pe);
     if (pe->PredFlags & SystemPredFlags)
-	return  TermSystemProcedure;
-    if (pe->PredFlags & LogUpdatePredFlag)
-      return TermUpdatableProcedure;
-    if (pe->PredFlags & MegaClausePredFlag)
-	return  TermMegaProcedure;
-    if (out==TermMegaProcedure) {
-        mcl = ClauseCodeToMegaClause(pe->cs.p_code.FirstClause);
-        if ( mcl->ClFlags & ExoMask)
-	return  TermExoProcedure;
-    }
-    if (pe->PredFlags & SourcePredFlag)
-	return  TermSourceProcedure;
+	out = TermSystemProcedure;
+    else if (pe->PredFlags & LogUpdatePredFlag)
+      out = TermUpdatableProcedure;
+    else if (pe->PredFlags & MegaClausePredFlag)
+	out = TermMegaProcedure;
+    else if (pe->PredFlags & SourcePredFlag)
+	out = TermSourceProcedure;
+    else
     //    if (pe->PredFlags & NoTracePredFlag)
-    UNLOCKPE(45, pe);
-	return  TermPrivateProcedure;
+	out = TermPrivateProcedure;
 	//    return TermStaticProcedure;
-
-
+    UNLOCKPE(45, pe);
+    return out;
 }
 static Int predicate_type(USES_REGS1) { /* '$is_dynamic'(+P)	 */
   PredEntry *pe;
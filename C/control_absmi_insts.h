@@ -179,7 +179,7 @@
 	CACHE_Y_AS_ENV(YREG);
 #ifndef NO_CHECKING
         /* check stacks */
-        check_stack(NoStackExecute, HR);
+        check_stack_and_trail(NoStackExecute, HR);
 #endif
 
  #ifdef LOW_LEVEL_TRACER
@@ -234,7 +234,7 @@
         PredEntry *pt0;
 #ifndef NO_CHECKING
         /* check stacks */
-        check_stack(NoStackDExecute, HR);
+        check_stack_and_trail(NoStackDExecute, HR);
 #endif
         pt0 = PREG->y_u.Osbpp.p;
       continue_dexecute:
@@ -311,7 +311,7 @@
         PredEntry *pt;
        CACHE_Y_AS_ENV(YREG);
 #ifndef NO_CHECKING
-        check_stack(NoStackCall, HR);
+        check_stack_and_trail(NoStackCall, HR);
 #endif
          pt = PREG->y_u.Osbpp.p;
    call_direct:
@@ -121,8 +121,9 @@ bool Yap_ArenaExpand(size_t sz, CELL *arenap) {
             nsz = Yap_InsertInGlobal(a_max-1 , sz * CellSize, &shifted_max) /
                   CellSize+1;
             if (nsz >= sz) {
+                /* the hole opens just below the last cell of the arena */
                 CELL *ar_max = shifted_max + nsz;
-                CELL *ar_min = shifted_max - sz0;
+                CELL *ar_min = shifted_max - (sz0 - 1);
                 Yap_PopHandle(yh);
                 *arenap = Yap_MkArena(ar_min, ar_max);
                 return true;
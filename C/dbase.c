@@ -220,20 +220,6 @@ typedef struct db_globs {
   UInt sz;         /* total size */
 } dbglobs;
 
-#ifdef SUPPORT_HASH_TABLES
-typedef struct {
-  CELL key;
-  DBRef entry;
-} hash_db_entry;
-
-typedef table {
-  Int NOfEntries;
-  Int HashArg;
-  hash_db_entry *table;
-}
-hash_db_table;
-#endif
-
 static CELL *cpcells(CELL *, CELL *, Int);
 static void linkblk(link_entry *, CELL *, CELL);
 static Int cmpclls(CELL *, CELL *, Int);
@@ -356,39 +342,6 @@ recover_record:
   return TRUE;
 }
 
-#ifdef SUPPORT_HASH_TABLES
-/* related property and hint on number of entries */
-static void create_hash_table(DBProp p, Int hint) {
-  int off = sizeof(CELL) * 4, out;
-  Int size;
-
-  if (hint < p->NOfEntries)
-    hint = p->NOfEntries;
-  while (off) {
-    Int limit = ((CELL)1) << (off);
-    if (inp >= limit) {
-      out += off;
-      inp >>= off;
-    }
-    off >>= 1;
-  }
-  if ((size = ((CELL)1) << out) < hint)
-    hint <<= 1;
-  /* clean up the table */
-  pt = tbl = (hash_db_entry *)AllocDBSpace(hint * sizeof(hash_db_entry));
-  Yap_LUClauseSpace += hint * sizeof(hash_db_entry);
-  for (i = 0; i < hint; i++) {
-    pt->key = NULL;
-    pt++;
-  }
-  /* next insert the entries */
-}
-
-static void insert_in_table() {}
-
-static void remove_from_table() {}
-#endif
-
 inline static CELL *cpcells(CELL *to, CELL *from, Int n) {
 #if HAVE_MEMMOVE
   memmove((void *)to, (void *)from, (size_t)(n * sizeof(CELL)));
@@ -576,6 +529,172 @@ static CELL EvalMasks(register Term tm, CELL *keyp) {
 
 CELL Yap_EvalMasks(register Term tm, CELL *keyp) { return EvalMasks(tm, keyp); }
 
+/*
+ * Keys in immediate update mode with many entries keep a hash table on
+ * the principal functor and first argument of their terms, so that
+ * recorded/3 with both bound visits only the entries that may match.
+ * Each bucket chains its entries in the order of the key, and the table
+ * doubles when it gets twice as many entries as buckets. An entry that
+ * is a variable, or has an unbound first argument, matches any lookup:
+ * a key with such entries is searched from its first entry.
+ */
+#define DB_INDEX_MIN 8
+
+/* the index hash of a term, false if it has none */
+static bool IndexKey(Term t, CELL *keyp) {
+  Term t1;
+
+  if (IsVarTerm(t)) {
+    return false;
+  } else if (IsAtomOrIntTerm(t)) {
+    *keyp = CalcKey(t);
+    return true;
+  } else if (IsPairTerm(t)) {
+    t1 = Deref(HeadOfTerm(t));
+    if (IsVarTerm(t1))
+      return false;
+    *keyp = FunctorHash(FunctorList) * 31 + CalcKey(t1);
+    return true;
+  } else {
+    Functor f = FunctorOfTerm(t);
+
+    if (IsExtensionFunctor(f)) {
+      *keyp = CalcKey(t);
+      return true;
+    }
+    t1 = Deref(ArgOfTerm(1, t));
+    if (IsVarTerm(t1))
+      return false;
+    *keyp = FunctorHash(f) * 31 + CalcKey(t1);
+    return true;
+  }
+}
+
+static DBHashBucket *IndexBucket(DBProp p, CELL key) {
+  return p->Index + (key & (p->IndexSize - 1));
+}
+
+static void InsertInIndex(DBProp p, DBRef x, bool first) {
+  DBHashBucket *b = IndexBucket(p, x->HashKey);
+
+  if (b->First == NULL) {
+    b->First = b->Last = x;
+    x->HashPrev = x->HashNext = NULL;
+  } else if (first) {
+    x->HashPrev = NULL;
+    x->HashNext = b->First;
+    b->First->HashPrev = x;
+    b->First = x;
+  } else {
+    x->HashNext = NULL;
+    x->HashPrev = b->Last;
+    b->Last->HashNext = x;
+    b->Last = x;
+  }
+}
+
+static void RemoveFromIndex(DBProp p, DBRef x) {
+  DBHashBucket *b = IndexBucket(p, x->HashKey);
+
+  if (x->HashPrev != NULL)
+    x->HashPrev->HashNext = x->HashNext;
+  else
+    b->First = x->HashNext;
+  if (x->HashNext != NULL)
+    x->HashNext->HashPrev = x->HashPrev;
+  else
+    b->Last = x->HashPrev;
+}
+
+static void FreeIndex(DBProp p) {
+  if (p->Index != NULL) {
+    Yap_FreeCodeSpace((char *)p->Index);
+    Yap_LUClauseSpace -= p->IndexSize * sizeof(DBHashBucket);
+    p->Index = NULL;
+    p->IndexSize = 0;
+  }
+}
+
+/* (re)build the index of p from its entries; on failure keep scanning */
+static void BuildIndex(DBProp p) {
+  UInt size = DB_INDEX_MIN, i;
+  DBHashBucket *tbl;
+  DBRef ref;
+
+  while (size < p->NOfEntries)
+    size <<= 1;
+  tbl = (DBHashBucket *)Yap_AllocCodeSpace(size * sizeof(DBHashBucket));
+  if (tbl == NULL)
+    return;
+  FreeIndex(p);
+  Yap_LUClauseSpace += size * sizeof(DBHashBucket);
+  for (i = 0; i < size; i++)
+    tbl[i].First = tbl[i].Last = NULL;
+  p->Index = tbl;
+  p->IndexSize = size;
+  for (ref = p->First; ref != NULL; ref = ref->Next)
+    InsertInIndex(p, ref, false);
+}
+
+/* a new entry x was linked into p, after or before all others */
+static void IndexNewEntry(DBProp p, DBRef x, Term t, bool first) {
+  p->NOfEntries++;
+  if (!IndexKey(t, &x->HashKey)) {
+    x->Flags |= DBNoIndex;
+    p->NOfUnindexed++;
+    FreeIndex(p);
+  } else if (p->Index != NULL) {
+    if (p->NOfEntries > 2 * p->IndexSize)
+      BuildIndex(p);
+    else
+      InsertInIndex(p, x, first);
+  }
+}
+
+/* x is leaving the entries of p */
+static void UnindexEntry(DBProp p, DBRef x) {
+  p->NOfEntries--;
+  if (x->Flags & DBNoIndex)
+    p->NOfUnindexed--;
+  else if (p->Index != NULL)
+    RemoveFromIndex(p, x);
+}
+
+/* the first live entry of p for a term with index hash key, or NULL */
+static DBRef FirstIndexed(DBProp p, CELL key) {
+  DBRef ref = IndexBucket(p, key)->First;
+
+  while (ref != NULL && ref->HashKey != key)
+    ref = ref->HashNext;
+  return ref;
+}
+
+static DBRef NextIndexed(DBRef ref) {
+  CELL key = ref->HashKey;
+
+  while ((ref = ref->HashNext) != NULL && ref->HashKey != key)
+    ;
+  return ref;
+}
+
+/* should recorded/3 on p with pattern t use the index? */
+static bool UseIndex(DBProp p, Term t, CELL *keyp) {
+  if (p->NOfUnindexed != 0 || p->NOfEntries < DB_INDEX_MIN ||
+      !IndexKey(t, keyp))
+    return false;
+  if (p->Index == NULL) {
+    WRITE_LOCK(p->DBRWLock);
+    if (p->Index == NULL)
+      BuildIndex(p);
+    WRITE_UNLOCK(p->DBRWLock);
+  }
+  return p->Index != NULL;
+}
+
+static DBRef NextCandidate(DBRef ref, bool indexed) {
+  return indexed ? NextIndexed(ref) : NextDBRef(ref);
+}
+
 /* Called to inform that a new pointer to a data base entry has been added */
 #define MarkThisRef(Ref) ((Ref)->NOfRefsTo++)
 
@@ -1467,7 +1586,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
       LOCAL_Error_Size = (UInt)(extra_size + sizeof(ppt0));
       LOCAL_Error_TYPE = RESOURCE_ERROR_AUXILIARY_STACK;
       Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-      LOCAL_Error_TYPE = oerr;
       return NULL;
     }
     ntp0 = ppt0->Contents;
@@ -1475,8 +1593,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
       LOCAL_Error_Size = 0;
       LOCAL_Error_TYPE = RESOURCE_ERROR_TRAIL;
       Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-      LOCAL_Error_TYPE = oerr;
-
       return NULL;
     }
     dbg->lr = dbg->LinkAr = (link_entry *)TR;
@@ -1488,7 +1604,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
                      &attachments, &vars_found, dbg);
       if (ntp == NULL) {
         Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-        LOCAL_Error_TYPE = oerr;
         return NULL;
       }
     } else
@@ -1503,7 +1618,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
                      &vars_found, dbg);
       if (ntp == NULL) {
         Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-        LOCAL_Error_TYPE = oerr;
         return NULL;
       }
     } else {
@@ -1568,7 +1682,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
                        &vars_found, dbg);
         if (ntp == NULL) {
           Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-          LOCAL_Error_TYPE = oerr;
           return NULL;
         }
       }
@@ -1576,7 +1689,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
     CodeAbs = (CELL *)((CELL)ntp - (CELL)ntp0);
     if (LOCAL_Error_TYPE) {
       Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-      LOCAL_Error_TYPE = oerr;
       return NULL; /* Error Situation */
     }
     NOfCells = ntp - ntp0; /* End Of Code Info */
@@ -1595,7 +1707,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
         LOCAL_Error_Size = (UInt)DBLength(CodeAbs);
         LOCAL_Error_TYPE = RESOURCE_ERROR_AUXILIARY_STACK;
         Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-        LOCAL_Error_TYPE = oerr;
         return NULL;
       }
       if ((InFlag & MkIfNot) &&
@@ -1619,7 +1730,6 @@ static DBRef CreateDBStruct(Term Tm, DBProp p, int InFlag, int *pstat,
         LOCAL_Error_Size = (UInt)DBLength(CodeAbs);
         LOCAL_Error_TYPE = RESOURCE_ERROR_AUXILIARY_STACK;
         Yap_ReleasePreAllocCodeSpace((ADDR)pp0);
-        LOCAL_Error_TYPE = oerr;
         return NULL;
       }
       flag |= DBWithRefs;
@@ -1797,6 +1907,7 @@ static DBRef record(int Flag, Term key, Term t_data, Term t_code USES_REGS) {
     x->Prev = p->Last;
     p->Last = x;
   }
+  IndexNewEntry(p, x, t_data, Flag & MkFirst);
   if (Flag & MkCode) {
     x->Code = (yamop *)IntegerOfTerm(t_code);
   }
@@ -1874,6 +1985,9 @@ static DBRef record_at(int Flag, DBRef r0, Term t_data, Term t_code USES_REGS) {
     }
     r0->Next = x;
   }
+  /* the buckets follow the order of the key: rebuild them when needed */
+  FreeIndex(p);
+  IndexNewEntry(p, x, t_data, false);
   if (Flag & WithRef) {
     x->Code = (yamop *)IntegerOfTerm(t_code);
   }
@@ -2052,8 +2166,6 @@ restart_record:
       return FALSE;
     }
   }
-  if (!pe)
-    return FALSE;
   return Yap_unify(ARG3, TRef);
 }
 
@@ -2172,8 +2284,6 @@ restart_record:
       return FALSE;
     }
   }
-  if (!pe)
-    return FALSE;
   return Yap_unify(ARG3, TRef);
 }
 
@@ -2859,6 +2969,9 @@ static DBProp FetchIntDBPropFromKey(Int key, int flag, int new,
     p = (DBProp)Yap_AllocAtomSpace(sizeof(*p));
     p->KindOfPE = DBProperty | flag;
     p->F0 = p->L0 = NULL;
+    p->NOfEntries = p->NOfUnindexed = 0;
+    p->Index = NULL;
+    p->IndexSize = 0;
     p->ArityOfDB = 0;
     p->First = p->Last = NULL;
     p->ModuleOfDB = 0;
@@ -2951,6 +3064,9 @@ static DBProp FetchDBPropFromKey(Term twork, int flag, int new,
       p = (DBProp)Yap_AllocAtomSpace(sizeof(*p));
       p->KindOfPE = DBProperty | flag;
       p->F0 = p->L0 = NULL;
+      p->NOfEntries = p->NOfUnindexed = 0;
+      p->Index = NULL;
+      p->IndexSize = 0;
       UPDATE_MODE = OLD_UPDATE_MODE;
       p->ArityOfDB = arity;
       p->First = p->Last = NIL;
@@ -3057,17 +3173,18 @@ static Int p_db_key(USES_REGS1) {
 static Int i_recorded(DBProp AtProp, Term t3 USES_REGS) {
   Term TermDB, TRef;
   Register DBRef ref;
-  Term twork;
+  Term twork = Deref(ARG2); /* now working with ARG2 */
+  CELL hkey;
+  bool indexed = UseIndex(AtProp, twork, &hkey);
 
   READ_LOCK(AtProp->DBRWLock);
-  ref = AtProp->First;
+  ref = indexed ? FirstIndexed(AtProp, hkey) : AtProp->First;
   while (ref != NULL && DEAD_REF(ref))
     ref = NextDBRef(ref);
   READ_UNLOCK(AtProp->DBRWLock);
   if (ref == NULL) {
     cut_fail();
   }
-  twork = Deref(ARG2); /* now working with ARG2 */
   if (IsVarTerm(twork)) {
     EXTRA_CBACK_ARG(3, 2) = MkIntegerTerm(0);
     EXTRA_CBACK_ARG(3, 3) = MkIntegerTerm(0);
@@ -3106,7 +3223,7 @@ static Int i_recorded(DBProp AtProp, Term t3 USES_REGS) {
       if (((twork == ref->DBT.Entry) || IsVarTerm(ref->DBT.Entry)) &&
           !DEAD_REF(ref))
         break;
-      ref = NextDBRef(ref);
+      ref = NextCandidate(ref, indexed);
       if (ref == NIL) {
         READ_UNLOCK(AtProp->DBRWLock);
         cut_fail();
@@ -3121,7 +3238,7 @@ static Int i_recorded(DBProp AtProp, Term t3 USES_REGS) {
     READ_LOCK(AtProp->DBRWLock);
     do {
       while ((mask & ref->Key) != (key & ref->Mask) && !DEAD_REF(ref)) {
-        ref = NextDBRef(ref);
+        ref = NextCandidate(ref, indexed);
         if (ref == NULL) {
           READ_UNLOCK(AtProp->DBRWLock);
           cut_fail();
@@ -3135,7 +3252,7 @@ static Int i_recorded(DBProp AtProp, Term t3 USES_REGS) {
           B->cp_h = HR;
           break;
         } else {
-          while ((ref = NextDBRef(ref)) != NULL && DEAD_REF(ref))
+          while ((ref = NextCandidate(ref, indexed)) != NULL && DEAD_REF(ref))
             ;
           if (ref == NULL) {
             READ_UNLOCK(AtProp->DBRWLock);
@@ -3192,11 +3309,17 @@ static Int c_recorded(int flags USES_REGS) {
   CELL *PreviousHeap = HR;
   CELL mask, key;
   Term t1;
+  CELL hkey;
+  bool indexed;
 
   t1 = EXTRA_CBACK_ARG(3, 1);
   ref0 = (DBRef)t1;
+  /* go on in the index if it was used to find ref0 */
+  indexed = !(ref0->Flags & (ErasedMask | DBNoIndex)) &&
+            ref0->Parent->Index != NULL && ref0->Parent->NOfUnindexed == 0 &&
+            IndexKey(Deref(ARG2), &hkey) && hkey == ref0->HashKey;
   READ_LOCK(ref0->Parent->DBRWLock);
-  ref = NextDBRef(ref0);
+  ref = indexed ? NextIndexed(ref0) : NextDBRef(ref0);
   if (ref == NIL) {
     if (ref0->Flags & ErasedMask) {
       ref = ref0;
@@ -3231,7 +3354,7 @@ static Int c_recorded(int flags USES_REGS) {
       key = (CELL)IntOfTerm(ttmp);
   }
   while (ref != NIL && DEAD_REF(ref))
-    ref = NextDBRef(ref);
+    ref = NextCandidate(ref, indexed);
   if (ref == NIL) {
     READ_UNLOCK(ref0->Parent->DBRWLock);
     cut_fail();
@@ -3264,7 +3387,7 @@ static Int c_recorded(int flags USES_REGS) {
       if (((key == Unsigned(ref->DBT.Entry)) || (ref->Flags & DBVar)) &&
           !DEAD_REF(ref))
         break;
-      ref = NextDBRef(ref);
+      ref = NextCandidate(ref, indexed);
     } while (ref != NIL);
     if (ref == NIL) {
       READ_UNLOCK(ref0->Parent->DBRWLock);
@@ -3274,7 +3397,7 @@ static Int c_recorded(int flags USES_REGS) {
     do { /* ARG2 is a structure */
       HR = PreviousHeap;
       while ((mask & ref->Key) != (key & ref->Mask)) {
-        while ((ref = NextDBRef(ref)) != NIL && DEAD_REF(ref))
+        while ((ref = NextCandidate(ref, indexed)) != NIL && DEAD_REF(ref))
           ;
         if (ref == NIL) {
           READ_UNLOCK(ref0->Parent->DBRWLock);
@@ -3304,7 +3427,7 @@ static Int c_recorded(int flags USES_REGS) {
       }
       if (Yap_unify(ARG2, TermDB))
         break;
-      while ((ref = NextDBRef(ref)) != NIL && DEAD_REF(ref))
+      while ((ref = NextCandidate(ref, indexed)) != NIL && DEAD_REF(ref))
         ;
       if (ref == NIL) {
         READ_UNLOCK(ref0->Parent->DBRWLock);
@@ -3448,9 +3571,17 @@ static Int p_recorded(USES_REGS1) {
   if (EndOfPAEntr(AtProp = FetchDBPropFromKey(twork, 0, FALSE, "recorded/3"))) {
     return FALSE;
   }
+  /* continue in '$recorded_with_key'/3, which leaves a choice point */
   ARG1 = MkIntegerTerm((Int)AtProp);
+  if (Yap_op_from_opcode(P->opc) != _procceed &&
+      P->opc != Yap_opcode(_execute_cpred)) {
+    CP = P;
+    ENV = YENV;
+    YENV = ASP;
+    YENV[E_CB] = (CELL)B;
+  }
   P = PredRecordedWithKey->CodeOfPred;
-  return (i_recorded(AtProp, t3 PASS_REGS));
+  return TRUE;
 }
 
 static Int co_rded(USES_REGS1) { return (c_recorded(0 PASS_REGS)); }
@@ -4210,6 +4341,7 @@ static void EraseEntry(DBRef entryref) {
   entryref->Flags |= ErasedMask;
   /* update FirstNEr */
   p = entryref->Parent;
+  UnindexEntry(p, entryref);
   /* exit the db chain */
   if (entryref->Next != NIL) {
     entryref->Next->Prev = entryref->Prev;
@@ -4392,6 +4524,7 @@ static Int p_eraseall(USES_REGS1) {
     if (entryref == NIL)
       break;
     next_entryref = NextDBRef(entryref);
+    UnindexEntry(p, entryref);
     /* exit the db chain */
     if (entryref->Next != NIL) {
       entryref->Next->Prev = entryref->Prev;
@@ -4989,35 +5122,85 @@ void Yap_init_tqueue(db_queue *dbq) {
 void Yap_destroy_tqueue(db_queue *dbq USES_REGS) {
   QueueEntry *cur_instance = dbq->FirstInQueue;
   while (cur_instance) {
-    /* release space for cur_instance */
-    keepdbrefs(cur_instance->DBT PASS_REGS);
-    ErasePendingRefs(cur_instance->DBT PASS_REGS);
-    FreeDBSpace((char *)cur_instance->DBT);
-    FreeDBSpace((char *)cur_instance);
+    QueueEntry *next = cur_instance->next;
+    Yap_free_tqueue_entry(cur_instance PASS_REGS);
+    cur_instance = next;
   }
   dbq->FirstInQueue = dbq->LastInQueue = NULL;
 }
 
-bool Yap_enqueue_tqueue(db_queue *father_key, Term t USES_REGS) {
+/* copy t to a queue entry that is not in any queue yet: the copy is
+   the expensive part of enqueuing, and it does not need the queue. */
+QueueEntry *Yap_new_tqueue_entry(Term t USES_REGS) {
   QueueEntry *x;
   while ((x = (QueueEntry *)AllocDBSpace(sizeof(QueueEntry))) == NULL) {
     if (!Yap_growheap(FALSE, sizeof(QueueEntry), NULL)) {
       Yap_ThrowError(RESOURCE_ERROR_HEAP, TermNil, "in findall");
-      return false;
+      return NULL;
     }
   }
   /* Yap_LUClauseSpace += sizeof(QueueEntry); */
   x->DBT = StoreTermInDB(Deref(t), 2 PASS_REGS);
   if (x->DBT == NULL) {
-    return false;
+    FreeDBSpace((char *)x);
+    return NULL;
   }
   x->next = NULL;
+  return x;
+}
+
+void Yap_free_tqueue_entry(QueueEntry *x USES_REGS) {
+  /* release space for x */
+  keepdbrefs(x->DBT PASS_REGS);
+  ErasePendingRefs(x->DBT PASS_REGS);
+  FreeDBSpace((char *)x->DBT);
+  FreeDBSpace((char *)x);
+}
+
+/* build the term in an entry that was taken out of its queue, and
+   release the entry. Returns 0 if the stacks could not grow. */
+Term Yap_pop_tqueue_entry(QueueEntry *x USES_REGS) {
+  Term TDB;
+
+  while ((TDB = GetDBTerm(x->DBT, false PASS_REGS)) == 0L) {
+    if (LOCAL_Error_TYPE == RESOURCE_ERROR_ATTRIBUTED_VARIABLES) {
+      LOCAL_Error_TYPE = YAP_NO_ERROR;
+      if (!Yap_growglobal(NULL)) {
+        Yap_ThrowError(RESOURCE_ERROR_ATTRIBUTED_VARIABLES, TermNil,
+                       LOCAL_ErrorMessage);
+        return 0L;
+      }
+    } else {
+      LOCAL_Error_TYPE = YAP_NO_ERROR;
+      if (!Yap_growstack((x->DBT->NOfCells + 1024) * CellSize)) {
+        Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+        return 0L;
+      }
+    }
+  }
+  Yap_free_tqueue_entry(x PASS_REGS);
+  return TDB;
+}
+
+/* append the chain first..last to the queue */
+void Yap_append_tqueue(db_queue *father_key, QueueEntry *first,
+                       QueueEntry *last) {
+  last->next = NULL;
   if (father_key->LastInQueue != NULL)
-    father_key->LastInQueue->next = x;
-  father_key->LastInQueue = x;
+    father_key->LastInQueue->next = first;
+  father_key->LastInQueue = last;
   if (father_key->FirstInQueue == NULL) {
-    father_key->FirstInQueue = x;
+    father_key->FirstInQueue = first;
   }
+}
+
+bool Yap_enqueue_tqueue(db_queue *father_key, Term t USES_REGS) {
+  QueueEntry *x = Yap_new_tqueue_entry(t PASS_REGS);
+
+  if (x == NULL) {
+    return false;
+  }
+  Yap_append_tqueue(father_key, x, x);
   return true;
 }
 
@@ -5027,6 +5210,8 @@ bool Yap_dequeue_tqueue(db_queue *father_key, Term t, bool first,
   CELL *oldH = HR;
   tr_fr_ptr oldTR = TR;
   QueueEntry *cur_instance = father_key->FirstInQueue, *prev = NULL;
+  /* t must survive garbage collection */
+  yhandle_t sl = Yap_InitSlot(t);
   while (cur_instance) {
     HR = oldH;
     HB = LCL0;
@@ -5036,19 +5221,23 @@ bool Yap_dequeue_tqueue(db_queue *father_key, Term t, bool first,
         if (!Yap_growglobal(NULL)) {
           Yap_ThrowError(RESOURCE_ERROR_ATTRIBUTED_VARIABLES, TermNil,
                     LOCAL_ErrorMessage);
+          Yap_RecoverSlots(1, sl);
           return false;
         }
       } else {
         LOCAL_Error_TYPE = YAP_NO_ERROR;
-        if (!Yap_dogc(PASS_REGS1)) {
+        /* the receiver is inside a C call, so grow rather than collect */
+        if (!Yap_growstack((cur_instance->DBT->NOfCells + 1024) * CellSize)) {
           Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+          Yap_RecoverSlots(1, sl);
           return false;
         }
       }
       oldTR = TR;
       oldH = HR;
+      HB = LCL0;
     }
-    if (Yap_unify(t, TDB)) {
+    if (Yap_unify(Yap_GetFromSlot(sl), TDB)) {
       if (release) {
         if (cur_instance == father_key->FirstInQueue) {
           father_key->FirstInQueue = cur_instance->next;
@@ -5059,30 +5248,27 @@ bool Yap_dequeue_tqueue(db_queue *father_key, Term t, bool first,
         if (prev) {
           prev->next = cur_instance->next;
         }
-        /* release space for cur_instance */
-        keepdbrefs(cur_instance->DBT PASS_REGS);
-        ErasePendingRefs(cur_instance->DBT PASS_REGS);
-        FreeDBSpace((char *)cur_instance->DBT);
-        FreeDBSpace((char *)cur_instance);
-      } else {
-        // undo if you'rejust peeking
-        while (oldTR < TR) {
-          CELL d1 = TrailTerm(TR - 1);
-          TR--;
-          /* normal variable */
-          RESET_VARIABLE(d1);
-        }
+        Yap_free_tqueue_entry(cur_instance PASS_REGS);
       }
+      Yap_RecoverSlots(1, sl);
       return true;
     } else {
+      // undo what the failed unification bound
+      while (oldTR < TR) {
+        CELL d1 = TrailTerm(TR - 1);
+        TR--;
+        /* normal variable */
+        RESET_VARIABLE(d1);
+      }
       // just getting the first
       if (first)
-        return false;
+        break;
       // but keep on going, if we want to check everything.
       prev = cur_instance;
       cur_instance = cur_instance->next;
     }
   }
+  Yap_RecoverSlots(1, sl);
   return false;
 }
 
@@ -94,7 +94,11 @@ void Yap_RestartYap(int flag) {
     if (!LOCAL_RestartEnv)
       return;
 #if PUSH_REGS
+#ifdef THREADS
+  restore_absmi_regs(LOCAL_ThreadHandle.default_yaam_regs);
+#else
   restore_absmi_regs(&Yap_standard_regs);
+#endif
 #endif
   siglongjmp(*LOCAL_RestartEnv, flag);
 }
@@ -1591,8 +1591,8 @@ static int exec_absmi(bool top, yap_reset_t reset_mode USES_REGS)
   int lval, out;
 
    Int OldBorder = LOCAL_CBorder;
-   //Int OldSlots = LOCAL_CurSlot;
-   LOCAL_CurSlot = 0;
+   /* keep the caller's slots, as in Yap_execute_pred() from C */
+   yhandle_t OldSlots = LOCAL_CurSlot;
   LOCAL_CBorder = LCL0 - (CELL *)B;
   sigjmp_buf signew, *sighold = LOCAL_RestartEnv;
   LOCAL_RestartEnv = &signew;
@@ -1666,7 +1666,7 @@ static int exec_absmi(bool top, yap_reset_t reset_mode USES_REGS)
     break;
     case 3:
     { /* saved state */
-      LOCAL_CurSlot = 0;
+      LOCAL_CurSlot = OldSlots;
       LOCAL_CBorder = OldBorder;
       LOCAL_Error_TYPE = YAP_NO_ERROR;
       LOCAL_RestartEnv = sighold;
@@ -1684,7 +1684,7 @@ static int exec_absmi(bool top, yap_reset_t reset_mode USES_REGS)
     }
     }
      Yap_CloseTemporaryStreams(top_stream);
-    LOCAL_CurSlot = 0;
+    LOCAL_CurSlot = OldSlots;
     LOCAL_CBorder = OldBorder;
     LOCAL_RestartEnv = sighold;
     if (LOCAL_RestartEnv && LOCAL_PrologMode & AbortMode)
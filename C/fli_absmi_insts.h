@@ -22,7 +22,7 @@
 
       LOG(" %s ", s);
 #endif
-      check_trail(TR);
+      call_check_trail(TR, AS_CELLS(PREG->y_u.Osbpp.s));
       if (!(PREG->y_u.Osbpp.p->PredFlags &
             (SafePredFlag | NoTracePredFlag | HiddenPredFlag))) {
         CACHE_Y_AS_ENV(YREG);
@@ -215,10 +215,11 @@ static Int nb_add_to_accumulator(USES_REGS1) {
         Yap_ThrowError(INSTANTIATION_ERROR, tadd, "nb_create_accumulator");
         return FALSE;
     }
-    if (IsIntegerTerm(t0) && IsIntegerTerm(tadd)) {
-        Int i0 = IntegerOfTerm(t0);
-        Int i1 = IntegerOfTerm(tadd);
-        Term new = MkIntegerTerm(i0 + i1);
+    Int sum;
+    /* sums that overflow go to big integers, below */
+    if (IsIntegerTerm(t0) && IsIntegerTerm(tadd) &&
+        !__builtin_add_overflow(IntegerOfTerm(t0), IntegerOfTerm(tadd), &sum)) {
+        Term new = MkIntegerTerm(sum);
 
         if (IsIntTerm(new)) {
             /* forget it if it was something else */
@@ -788,49 +789,147 @@ static Int nb_queue_close(USES_REGS1) {
     return FALSE;
 }
 
+/* Copy a ground term to *hp, storing the copy at *to. Arguments are
+   followed on the C stack, up to a small depth, and list tails in a
+   loop. Fails on variables, on terms too deep, and on terms that do not
+   fit below max, which also stops cyclic terms; the caller then goes
+   through CopyTermToArena. */
+static bool CopyGroundTerm(Term t, CELL *to, CELL **hp, CELL *max, int depth) {
+    while (true) {
+        CELL *h = *hp, *pt;
+
+        t = Deref(t);
+        if (IsVarTerm(t)) {
+            return false;
+        } else if (IsAtomOrIntTerm(t)) {
+            *to = t;
+            return true;
+        } else if (depth == 0) {
+            return false;
+        } else if (IsPairTerm(t)) {
+            if (h + 2 > max)
+                return false;
+            pt = RepPair(t);
+            *hp = h + 2;
+            *to = AbsPair(h);
+            if (!CopyGroundTerm(pt[0], h, hp, max, depth - 1))
+                return false;
+            t = pt[1];
+            to = h + 1;
+        } else {
+            Functor f = FunctorOfTerm(t);
+            UInt i, arity;
+
+            pt = RepAppl(t);
+            if (IsExtensionFunctor(f)) {
+                size_t szop;
+
+                if (f == FunctorDBRef)
+                    return false;
+                szop = SizeOfOpaqueTerm(pt, (CELL) f);
+                if (h + szop > max)
+                    return false;
+                memmove(h, pt, szop * CellSize);
+                h[szop - 1] = CloseExtension(h);
+                *hp = h + szop;
+                *to = AbsAppl(h);
+                return true;
+            }
+            arity = ArityOfFunctor(f);
+            if (h + arity + 1 > max)
+                return false;
+            *hp = h + arity + 1;
+            *to = AbsAppl(h);
+            h[0] = (CELL) f;
+            for (i = 1; i < arity; i++) {
+                if (!CopyGroundTerm(pt[i], h + i, hp, max, depth - 1))
+                    return false;
+            }
+            t = pt[arity];
+            to = h + arity;
+        }
+    }
+}
+
+/* Move the queue to a fresh chunk at the top of the global stack, as
+   large as what the queue has taken so far. The rest of the current
+   arena is left behind, which is cheaper than opening a hole in the
+   global stack under the goal that produces the answers. Choice-points
+   younger than the queue backtrack to the end of the new chunk, so that
+   the answers survive the failure that asks for the next one. */
+static Term NewQueueChunk(Term queue USES_REGS) {
+    CELL *q0 = RepAppl(queue);
+    size_t sz = HR - q0;
+    choiceptr bb;
+
+    if (sz > MAX_ARENA_SIZE)
+        sz = MAX_ARENA_SIZE;
+    if (sz < 2 * MIN_ARENA_SIZE)
+        sz = 2 * MIN_ARENA_SIZE;
+    if (HR + sz + MinStackGap / CellSize > ASP) {
+        yhandle_t yq = Yap_InitHandle(queue);
+        /* the answers are alive, so collecting garbage would not help */
+        if (!Yap_growstack(sz * CellSize)) {
+            Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil,
+                           "No Stack Space for findall/3 answers");
+        }
+        queue = Yap_PopHandle(yq);
+        q0 = RepAppl(queue);
+    }
+    q0[1 + QUEUE_ARENA] = Yap_MkArena(HR, HR + sz);
+    bb = B;
+    while (bb && bb->cp_h > q0) {
+        bb->cp_h = HR;
+        bb = bb->cp_b;
+    }
+    HB = B->cp_h;
+    return queue;
+}
+
 static Int nb_queue_enqueue(USES_REGS1) {
-  size_t ex = 2*MIN_ARENA_SIZE;
-    CELL *qd;
-        qd = GetQueue(ARG1, "enqueue");
-        if (!qd)
-            return FALSE;
-    Int qsize = IntegerOfTerm(qd[QUEUE_SIZE]);
-    /* garbage collection ? */
+    CELL *qd, *a0, *af, *h;
+    Term t, to, arena;
 
-	CELL arena = qd[QUEUE_ARENA];
-	CELL *a0=ArenaPt(arena), *af = ArenaLimit(arena);
-	if (af-a0< MIN_ARENA_SIZE) {
-	  size_t nsize, osz=af-a0;
-	  CELL *new_max=af;
-	  ex = 2*MIN_ARENA_SIZE+osz*2;
-	  if (ex < 4*MIN_ARENA_SIZE)
-	    ex = 4*MIN_ARENA_SIZE;
-	  if ((nsize = Yap_InsertInGlobal(af-1, ex * CellSize, &new_max) /
-                         CellSize) >= ex) {
-               af = new_max+1;
-                ex = nsize+osz;
-                a0 = af -ex;
-		qd=GetQueue(Deref(ARG1), "enqueue");
-            }
-	}
-	//a0[0] = AbsPair(a0+2);
-	RESET_VARIABLE(a0);
-	RESET_VARIABLE(a0+1);
-	qd[QUEUE_ARENA] = arena = Yap_MkArena(a0+2,af);
-	if (qsize == 0) {   
-	  qd[QUEUE_HEAD] = AbsPair(a0);
-	} else {
-	}
-	*(CELL*)(qd[QUEUE_TAIL]) = AbsPair(a0);
-	qd[QUEUE_TAIL]=(CELL)(a0+1);
-        Term to;
-	if ((to=CopyTermToArena(Deref(ARG2), false, true, NULL, & arena , NULL PASS_REGS))==0) return false;
-	qd = GetQueue(ARG1, "enqueue");
+    qd = GetQueue(ARG1, "enqueue");
+    if (!qd)
+        return FALSE;
+    Int qsize = IntegerOfTerm(qd[QUEUE_SIZE]);
+    t = Deref(ARG2);
+    arena = qd[QUEUE_ARENA];
+    a0 = ArenaPt(arena);
+    af = ArenaLimit(arena);
+    if (af - a0 < 2 + MIN_ARENA_SIZE) {
+        yhandle_t yt = Yap_InitHandle(t);
+        Term queue = NewQueueChunk(Deref(ARG1) PASS_REGS);
+        t = Yap_PopHandle(yt);
+        qd = RepAppl(queue) + 1;
+        arena = qd[QUEUE_ARENA];
+        a0 = ArenaPt(arena);
+        af = ArenaLimit(arena);
+    }
+    /* the new list cell goes first, so that the answers make a list */
+    RESET_VARIABLE(a0);
+    RESET_VARIABLE(a0 + 1);
+    if (qsize == 0) {
+        qd[QUEUE_HEAD] = AbsPair(a0);
+    }
+    *(CELL *) (qd[QUEUE_TAIL]) = AbsPair(a0);
+    qd[QUEUE_TAIL] = (CELL) (a0 + 1);
+    h = a0 + 2;
+    /* most answers are small and ground: copy them without a visitor */
+    if (CopyGroundTerm(t, a0, &h, af - 4, 64)) {
+        to = a0[0];
+        arena = Yap_MkArena(h, af);
+    } else {
+        RESET_VARIABLE(a0);
+        arena = Yap_MkArena(a0 + 2, af);
+        if ((to = CopyTermToArena(t, false, true, NULL, &arena, NULL PASS_REGS)) == 0)
+            return false;
+        qd = GetQueue(ARG1, "enqueue");
+    }
     qd[QUEUE_ARENA] = arena;
     qd[QUEUE_SIZE] = MkIntegerTerm(++qsize);
-    ((CELL*)qd[QUEUE_TAIL])[-1] = to;
-    // RESET_VARIABLE(RepPair(to)+1);
-
+    ((CELL *) qd[QUEUE_TAIL])[-1] = to;
     return true;
 }
 
@@ -1635,6 +1734,729 @@ static Int nb_beam_size(USES_REGS1) {
     return Yap_unify(ARG2, qd[HEAP_SIZE]);
 }
 
+/* A hash table is a term '$nb_hash'(Count,Deleted,Slots,Arena). Slots
+   is a term '$nb_hash_slots'(H1,K1,V1,...,Hn,Kn,Vn), where n is a power
+   of two and Hi is the hash code of the key Ki, NB_HASH_FREE in slots
+   never used, or NB_HASH_TOMB in slots whose key was deleted. Keys are
+   looked for by linear probing from their hash code, and the slots are
+   rebuilt before more than three in four are taken. Keys and values
+   are copied to the arena of the table, as nb_setval/2 copies values to
+   the global arena, so that they survive backtracking. */
+#define NB_HASH_COUNT 0
+#define NB_HASH_DELETED 1
+#define NB_HASH_SLOTS 2
+#define NB_HASH_ARENA 3
+
+#define NB_HASH_FREE MkIntTerm(-1)
+#define NB_HASH_TOMB MkIntTerm(-2)
+
+#define NB_HASH_MIN_SLOTS 16
+#define NB_HASH_CODES (((Int) 1) << 30)
+
+static bool IsSharedHash(Term t) {
+    t = Deref(t);
+    return IsApplTerm(t) && FunctorOfTerm(t) == FunctorNBSharedHash;
+}
+
+static CELL *GetNBHash(Term t, char *caller) {
+    t = Deref(t);
+
+    if (IsVarTerm(t)) {
+        Yap_ThrowError(INSTANTIATION_ERROR, t, caller);
+        return NULL;
+    }
+    if (!IsApplTerm(t)) {
+        Yap_ThrowError(TYPE_ERROR_COMPOUND, t, caller);
+        return NULL;
+    }
+    if (FunctorOfTerm(t) != FunctorNBHash) {
+        Yap_ThrowError(DOMAIN_ERROR_ARRAY_TYPE, t, caller);
+        return NULL;
+    }
+    return RepAppl(t) + 1;
+}
+
+static inline CELL *NBHashSlots(CELL *qd) { return RepAppl(qd[NB_HASH_SLOTS]) + 1; }
+
+static inline UInt NBHashCapacity(CELL *qd) {
+    return ArityOfFunctor(FunctorOfTerm(qd[NB_HASH_SLOTS])) / 3;
+}
+
+/* the hash code of a key, or -1 if the key is not ground */
+static Int NBHashCode(Term k, char *caller USES_REGS) {
+    Int h = Yap_TermHash(Deref(k), NB_HASH_CODES, -1, false);
+
+    /* Yap_TermHash() gives 0 for terms with variables, too */
+    if (h == 0 && !Yap_IsGroundTerm(k)) {
+        Yap_ThrowError(INSTANTIATION_ERROR, k, caller);
+        return -1;
+    }
+    return h;
+}
+
+static void NBHashInitSlots(CELL *slots, UInt cap) {
+    UInt i;
+
+    slots[0] = (CELL) Yap_MkFunctor(AtomNbHashSlots, 3 * cap);
+    for (i = 1; i <= 3 * cap; i += 3) {
+        slots[i] = NB_HASH_FREE;
+        slots[i + 1] = TermNil;
+        slots[i + 2] = TermNil;
+    }
+}
+
+/* the slot of key k, with hash code h, or, if k is not in the table,
+   the slot where it should go: the first deleted slot on the way or the
+   free slot that ends the search. */
+static UInt NBHashFind(CELL *slots, UInt cap, Int h, Term k, bool *found) {
+    UInt i = h & (cap - 1), tomb = cap;
+    Term th = MkIntTerm(h);
+
+    while (true) {
+        CELL *pt = slots + 3 * i;
+
+        if (pt[0] == NB_HASH_FREE) {
+            *found = false;
+            return tomb < cap ? tomb : i;
+        } else if (pt[0] == NB_HASH_TOMB) {
+            if (tomb == cap)
+                tomb = i;
+        } else if (pt[0] == th && (pt[1] == k || Yap_eq(pt[1], k))) {
+            *found = true;
+            return i;
+        }
+        i = (i + 1) & (cap - 1);
+    }
+}
+
+/* The arena of a table grows by as much as the table has taken so far,
+   so that the global stack above it moves a few times only. The table
+   sits just below its arena. */
+static size_t NBHashGrowth(CELL *qd, size_t need) {
+    size_t sz = ArenaLimit(qd[NB_HASH_ARENA]) - (qd - 1);
+
+    if (sz > MAX_ARENA_SIZE)
+        sz = MAX_ARENA_SIZE;
+    return sz > need ? sz : need;
+}
+
+/* Move the entries of the table in ARG1 to cap fresh slots taken from
+   its arena, dropping deleted slots. */
+static CELL *NBHashResize(UInt cap USES_REGS) {
+    CELL *qd = RepAppl(Deref(ARG1)) + 1, *os, *ns, *af;
+    Term arena = qd[NB_HASH_ARENA];
+    UInt ocap, i, need = 3 * cap + 1;
+
+    if (ArenaSzW(arena) < need + MIN_ARENA_SIZE) {
+        if (!Yap_ArenaExpand(NBHashGrowth(qd, need + MIN_ARENA_SIZE), &arena))
+            return NULL;
+        qd = RepAppl(Deref(ARG1)) + 1;
+    }
+    ns = ArenaPt(arena);
+    af = ArenaLimit(arena);
+    os = NBHashSlots(qd);
+    ocap = NBHashCapacity(qd);
+    NBHashInitSlots(ns, cap);
+    for (i = 0; i < ocap; i++) {
+        CELL *pt = os + 3 * i;
+
+        if (pt[0] != NB_HASH_FREE && pt[0] != NB_HASH_TOMB) {
+            UInt j = IntOfTerm(pt[0]) & (cap - 1);
+
+            while (ns[1 + 3 * j] != NB_HASH_FREE)
+                j = (j + 1) & (cap - 1);
+            ns[1 + 3 * j] = pt[0];
+            ns[2 + 3 * j] = pt[1];
+            ns[3 + 3 * j] = pt[2];
+        }
+    }
+    qd[NB_HASH_SLOTS] = AbsAppl(ns);
+    qd[NB_HASH_DELETED] = MkIntTerm(0);
+    qd[NB_HASH_ARENA] = Yap_MkArena(ns + need, af);
+    return qd;
+}
+
+/* copy t to the arena of the table in ARG1 */
+static Term NBHashCopy(Term t USES_REGS) {
+    CELL *qd = RepAppl(Deref(ARG1)) + 1, *a0, *af, *h;
+    Term arena = qd[NB_HASH_ARENA], to;
+
+    if (ArenaSzW(arena) < MIN_ARENA_SIZE) {
+        yhandle_t yt = Yap_InitHandle(t);
+
+        if (!Yap_ArenaExpand(NBHashGrowth(qd, MIN_ARENA_SIZE), &arena))
+            return 0;
+        t = Yap_PopHandle(yt);
+    }
+    a0 = h = ArenaPt(arena);
+    af = ArenaLimit(arena);
+    if (CopyGroundTerm(t, &to, &h, af - 4, 64)) {
+        arena = Yap_MkArena(h, af);
+    } else {
+        arena = Yap_MkArena(a0, af);
+        if ((to = CopyTermToArena(t, false, true, NULL, &arena, NULL PASS_REGS)) == 0)
+            return 0;
+    }
+    qd = RepAppl(Deref(ARG1)) + 1;
+    qd[NB_HASH_ARENA] = arena;
+    return to;
+}
+
+/* A shared hash table is a term '$nb_shared_hash'(Address) for a table
+   outside the stacks, which every thread sees. Keys and values are
+   stored as in the internal data base, and entries are chained from a
+   power of two number of buckets. Lookups share a read-write lock, so
+   that they go in parallel. Closing a table releases its entries but
+   not the table itself, so that later calls find it closed. */
+typedef struct nb_shared_entry {
+    struct nb_shared_entry *next;
+    Int hash;
+    DBTerm *key, *value;
+} nb_shared_entry_t;
+
+typedef struct nb_shared_hash {
+#if defined(YAPOR) || defined(THREADS)
+    rwlock_t HRWLock;
+#endif
+    UInt count, nbuckets;
+    nb_shared_entry_t **buckets; /* NULL once the table is closed */
+} nb_shared_hash_t;
+
+static nb_shared_hash_t *GetSharedHash(Term t) {
+    return AddressOfTerm(ArgOfTerm(1, Deref(t)));
+}
+
+static nb_shared_entry_t **SharedHashFind(nb_shared_hash_t *ht, Int h, Term k) {
+    nb_shared_entry_t **ep = ht->buckets + (h & (ht->nbuckets - 1));
+
+    while (*ep) {
+        nb_shared_entry_t *e = *ep;
+
+        /* ground keys can be compared where the data base keeps them */
+        if (e->hash == h && Yap_eq(e->key->Entry, k))
+            return ep;
+        ep = &e->next;
+    }
+    return ep;
+}
+
+static void SharedHashGrow(nb_shared_hash_t *ht) {
+    UInt n = 2 * ht->nbuckets, i;
+    nb_shared_entry_t **nb = calloc(n, sizeof(nb_shared_entry_t *));
+
+    if (!nb)
+        return;
+    for (i = 0; i < ht->nbuckets; i++) {
+        nb_shared_entry_t *e = ht->buckets[i];
+
+        while (e) {
+            nb_shared_entry_t *next = e->next;
+            UInt j = e->hash & (n - 1);
+
+            e->next = nb[j];
+            nb[j] = e;
+            e = next;
+        }
+    }
+    free(ht->buckets);
+    ht->buckets = nb;
+    ht->nbuckets = n;
+}
+
+/* make room on the stacks for a term from a shared table that did not
+   fit */
+static bool SharedHashRoom(size_t cells USES_REGS) {
+    if (LOCAL_Error_TYPE == RESOURCE_ERROR_ATTRIBUTED_VARIABLES) {
+        LOCAL_Error_TYPE = YAP_NO_ERROR;
+        if (!Yap_growglobal(NULL)) {
+            Yap_ThrowError(RESOURCE_ERROR_ATTRIBUTED_VARIABLES, TermNil,
+                           LOCAL_ErrorMessage);
+            return false;
+        }
+    } else {
+        LOCAL_Error_TYPE = YAP_NO_ERROR;
+        if (!Yap_dogcl(cells * CellSize PASS_REGS)) {
+            Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+            return false;
+        }
+    }
+    return true;
+}
+
+static Term FetchSharedTerm(DBTerm *d USES_REGS) {
+    Term t;
+
+    while ((t = Yap_FetchTermFromDB(d)) == 0) {
+        if (!SharedHashRoom(d->NOfCells PASS_REGS))
+            return 0;
+    }
+    return t;
+}
+
+static bool SharedHashClosed(nb_shared_hash_t *ht, char *caller USES_REGS) {
+    if (ht->buckets)
+        return false;
+    Yap_ThrowError(EXISTENCE_ERROR_ARRAY, Deref(ARG1), caller);
+    return true;
+}
+
+static Int nb_shared_hash_sized(UInt n USES_REGS) {
+    nb_shared_hash_t *ht = malloc(sizeof(nb_shared_hash_t));
+    UInt nb = NB_HASH_MIN_SLOTS;
+    Term t;
+
+    while (nb < n)
+        nb *= 2;
+    if (!ht || !(ht->buckets = calloc(nb, sizeof(nb_shared_entry_t *)))) {
+        free(ht);
+        Yap_ThrowError(RESOURCE_ERROR_HEAP, TermNil, "nb_shared_hash/2");
+        return false;
+    }
+    INIT_RWLOCK(ht->HRWLock);
+    ht->count = 0;
+    ht->nbuckets = nb;
+    t = MkAddressTerm(ht);
+    return Yap_unify(ARG1, Yap_MkApplTerm(FunctorNBSharedHash, 1, &t));
+}
+
+static Int nb_shared_hash_put(USES_REGS1) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+    nb_shared_entry_t **ep, *e;
+    DBTerm *key = NULL, *value, *old;
+    Int h;
+
+    if ((h = NBHashCode(ARG2, "nb_hash_put/3" PASS_REGS)) < 0)
+        return false;
+    /* copy outside the lock: storing a term may collect garbage */
+    if (!(value = Yap_StoreTermInDB(Deref(ARG3), 3)))
+        return false;
+    while (true) {
+        WRITE_LOCK(ht->HRWLock);
+        if (!ht->buckets) {
+            WRITE_UNLOCK(ht->HRWLock);
+            Yap_ReleaseTermFromDB(value);
+            if (key)
+                Yap_ReleaseTermFromDB(key);
+            SharedHashClosed(ht, "nb_hash_put/3" PASS_REGS);
+            return false;
+        }
+        ep = SharedHashFind(ht, h, Deref(ARG2));
+        if ((e = *ep)) {
+            old = e->value;
+            e->value = value;
+            WRITE_UNLOCK(ht->HRWLock);
+            Yap_ReleaseTermFromDB(old);
+            if (key)
+                Yap_ReleaseTermFromDB(key);
+            return true;
+        }
+        if (key) {
+            break;
+        }
+        /* a new key: copy it, and look again, as another thread may
+           have added it meanwhile */
+        WRITE_UNLOCK(ht->HRWLock);
+        if (!(key = Yap_StoreTermInDB(Deref(ARG2), 3))) {
+            Yap_ReleaseTermFromDB(value);
+            return false;
+        }
+    }
+    if (!(e = malloc(sizeof(nb_shared_entry_t)))) {
+        WRITE_UNLOCK(ht->HRWLock);
+        Yap_ReleaseTermFromDB(key);
+        Yap_ReleaseTermFromDB(value);
+        Yap_ThrowError(RESOURCE_ERROR_HEAP, TermNil, "nb_hash_put/3");
+        return false;
+    }
+    e->next = NULL;
+    e->hash = h;
+    e->key = key;
+    e->value = value;
+    *ep = e;
+    if (++ht->count > 2 * ht->nbuckets)
+        SharedHashGrow(ht);
+    WRITE_UNLOCK(ht->HRWLock);
+    return true;
+}
+
+static Int nb_shared_hash_get(USES_REGS1) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+    nb_shared_entry_t *e;
+    Term t;
+    Int h;
+    size_t sz;
+
+    if ((h = NBHashCode(ARG2, "nb_hash_get/3" PASS_REGS)) < 0)
+        return false;
+    while (true) {
+        READ_LOCK(ht->HRWLock);
+        if (!ht->buckets) {
+            READ_UNLOCK(ht->HRWLock);
+            SharedHashClosed(ht, "nb_hash_get/3" PASS_REGS);
+            return false;
+        }
+        if (!(e = *SharedHashFind(ht, h, Deref(ARG2)))) {
+            READ_UNLOCK(ht->HRWLock);
+            return false;
+        }
+        t = Yap_FetchTermFromDB(e->value);
+        sz = e->value->NOfCells;
+        READ_UNLOCK(ht->HRWLock);
+        if (t)
+            return Yap_unify(ARG3, t);
+        /* collect garbage without the lock, and look again */
+        if (!SharedHashRoom(sz PASS_REGS))
+            return false;
+    }
+}
+
+static Int nb_shared_hash_del(USES_REGS1) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+    nb_shared_entry_t **ep, *e;
+    Term t;
+    Int h;
+
+    if ((h = NBHashCode(ARG2, "nb_hash_del/3" PASS_REGS)) < 0)
+        return false;
+    WRITE_LOCK(ht->HRWLock);
+    if (!ht->buckets) {
+        WRITE_UNLOCK(ht->HRWLock);
+        SharedHashClosed(ht, "nb_hash_del/3" PASS_REGS);
+        return false;
+    }
+    ep = SharedHashFind(ht, h, Deref(ARG2));
+    if (!(e = *ep)) {
+        WRITE_UNLOCK(ht->HRWLock);
+        return false;
+    }
+    *ep = e->next;
+    ht->count--;
+    WRITE_UNLOCK(ht->HRWLock);
+    /* the entry is ours now */
+    t = FetchSharedTerm(e->value PASS_REGS);
+    Yap_ReleaseTermFromDB(e->key);
+    Yap_ReleaseTermFromDB(e->value);
+    free(e);
+    return t && Yap_unify(ARG3, t);
+}
+
+static Int nb_shared_hash_size(USES_REGS1) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+    UInt n;
+
+    READ_LOCK(ht->HRWLock);
+    n = ht->count;
+    READ_UNLOCK(ht->HRWLock);
+    if (SharedHashClosed(ht, "nb_hash_size/2" PASS_REGS))
+        return false;
+    return Yap_unify(ARG2, MkIntegerTerm(n));
+}
+
+static Int nb_shared_hash_to_list(USES_REGS1) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+
+    while (true) {
+        CELL *h0 = HR;
+        Term l = TermNil;
+        size_t sz;
+        UInt i;
+
+        READ_LOCK(ht->HRWLock);
+        if (!ht->buckets) {
+            READ_UNLOCK(ht->HRWLock);
+            SharedHashClosed(ht, "nb_hash_to_list/2" PASS_REGS);
+            return false;
+        }
+        for (i = 0; i < ht->nbuckets; i++) {
+            nb_shared_entry_t *e;
+
+            for (e = ht->buckets[i]; e; e = e->next) {
+                Term k, v;
+
+                if ((k = Yap_FetchTermFromDB(e->key)) == 0 ||
+                    (v = Yap_FetchTermFromDB(e->value)) == 0)
+                    goto no_space;
+                if (HR + 5 > ASP - 1024) {
+                    LOCAL_Error_TYPE = RESOURCE_ERROR_STACK;
+                    goto no_space;
+                }
+                HR[0] = (CELL) FunctorMinus;
+                HR[1] = k;
+                HR[2] = v;
+                HR[3] = AbsAppl(HR);
+                HR[4] = l;
+                l = AbsPair(HR + 3);
+                HR += 5;
+            }
+        }
+        READ_UNLOCK(ht->HRWLock);
+        return Yap_unify(ARG2, l);
+    no_space:
+        /* start again, with at least twice the room */
+        sz = 2 * (HR - h0) + 5 * ht->count;
+        HR = h0;
+        READ_UNLOCK(ht->HRWLock);
+        if (!SharedHashRoom(sz PASS_REGS))
+            return false;
+    }
+}
+
+static Int nb_shared_hash_clear(bool close USES_REGS) {
+    nb_shared_hash_t *ht = GetSharedHash(ARG1);
+    nb_shared_entry_t *entries = NULL;
+    UInt i;
+
+    WRITE_LOCK(ht->HRWLock);
+    if (!ht->buckets) {
+        WRITE_UNLOCK(ht->HRWLock);
+        SharedHashClosed(ht, close ? "nb_hash_close/1" : "nb_hash_clear/1" PASS_REGS);
+        return false;
+    }
+    /* unlink the entries, and release them without the lock */
+    for (i = 0; i < ht->nbuckets; i++) {
+        nb_shared_entry_t *e = ht->buckets[i];
+
+        while (e) {
+            nb_shared_entry_t *next = e->next;
+
+            e->next = entries;
+            entries = e;
+            e = next;
+        }
+        ht->buckets[i] = NULL;
+    }
+    ht->count = 0;
+    if (close) {
+        free(ht->buckets);
+        ht->buckets = NULL;
+    }
+    WRITE_UNLOCK(ht->HRWLock);
+    while (entries) {
+        nb_shared_entry_t *next = entries->next;
+
+        Yap_ReleaseTermFromDB(entries->key);
+        Yap_ReleaseTermFromDB(entries->value);
+        free(entries);
+        entries = next;
+    }
+    return true;
+}
+
+static Int nb_hash_sized(UInt n USES_REGS) {
+    UInt cap = NB_HASH_MIN_SLOTS;
+    size_t sz;
+    CELL *ar;
+
+    while (4 * n > 3 * cap)
+        cap *= 2;
+    /* the table, its slots, and an arena for about as many entries */
+    sz = 5 + 3 * cap + 1 + 4 * cap + MIN_ARENA_SIZE;
+    if (HR + sz > ASP - 1024) {
+        if (!Yap_dogcl(sz * CellSize PASS_REGS)) {
+            Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil,
+                           "No Stack Space for Non-Backtrackable terms");
+            return false;
+        }
+    }
+    ar = HR;
+    ar[0] = (CELL) FunctorNBHash;
+    ar[1 + NB_HASH_COUNT] = MkIntTerm(0);
+    ar[1 + NB_HASH_DELETED] = MkIntTerm(0);
+    ar[1 + NB_HASH_SLOTS] = AbsAppl(ar + 5);
+    NBHashInitSlots(ar + 5, cap);
+    ar[1 + NB_HASH_ARENA] = Yap_MkArena(ar + 5 + 3 * cap + 1, ar + sz);
+    return Yap_unify(AbsAppl(ar), ARG1);
+}
+
+static UInt NBHashSizeArg(Term t, char *caller) {
+    t = Deref(t);
+    if (IsVarTerm(t)) {
+        Yap_ThrowError(INSTANTIATION_ERROR, t, caller);
+        return 0;
+    }
+    if (!IsIntegerTerm(t)) {
+        Yap_ThrowError(TYPE_ERROR_INTEGER, t, caller);
+        return 0;
+    }
+    if (IntegerOfTerm(t) < 0) {
+        Yap_ThrowError(DOMAIN_ERROR_NOT_LESS_THAN_ZERO, t, caller);
+        return 0;
+    }
+    return IntegerOfTerm(t);
+}
+
+static Int nb_hash(USES_REGS1) { return nb_hash_sized(0 PASS_REGS); }
+
+static Int nb_hash2(USES_REGS1) {
+    return nb_hash_sized(NBHashSizeArg(ARG2, "nb_hash/2") PASS_REGS);
+}
+
+static Int nb_shared_hash(USES_REGS1) {
+    return nb_shared_hash_sized(0 PASS_REGS);
+}
+
+static Int nb_shared_hash2(USES_REGS1) {
+    return nb_shared_hash_sized(NBHashSizeArg(ARG2, "nb_shared_hash/2") PASS_REGS);
+}
+
+static Int nb_hash_put(USES_REGS1) {
+    CELL *qd, *pt;
+    Term key, value;
+    Int h, count;
+    UInt cap, i;
+    bool found;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_put(PASS_REGS1);
+    if (!GetNBHash(ARG1, "nb_hash_put/3") ||
+        (h = NBHashCode(ARG2, "nb_hash_put/3" PASS_REGS)) < 0)
+        return false;
+    qd = RepAppl(Deref(ARG1)) + 1;
+    cap = NBHashCapacity(qd);
+    count = IntOfTerm(qd[NB_HASH_COUNT]);
+    if (4 * (count + IntOfTerm(qd[NB_HASH_DELETED]) + 1) > 3 * cap) {
+        /* double if at least half the slots are alive, otherwise just
+           drop the deleted ones */
+        if (2 * (count + 1) > cap)
+            cap *= 2;
+        if (!(qd = NBHashResize(cap PASS_REGS)))
+            return false;
+    }
+    i = NBHashFind(NBHashSlots(qd), cap, h, Deref(ARG2), &found);
+    if (found) {
+        if ((value = NBHashCopy(Deref(ARG3) PASS_REGS)) == 0)
+            return false;
+        qd = RepAppl(Deref(ARG1)) + 1;
+        NBHashSlots(qd)[3 * i + 2] = value;
+        return true;
+    }
+    if ((key = NBHashCopy(Deref(ARG2) PASS_REGS)) == 0)
+        return false;
+    yhandle_t yk = Yap_InitHandle(key);
+    value = NBHashCopy(Deref(ARG3) PASS_REGS);
+    key = Yap_PopHandle(yk);
+    if (value == 0)
+        return false;
+    qd = RepAppl(Deref(ARG1)) + 1;
+    pt = NBHashSlots(qd) + 3 * i;
+    if (pt[0] == NB_HASH_TOMB)
+        qd[NB_HASH_DELETED] = MkIntTerm(IntOfTerm(qd[NB_HASH_DELETED]) - 1);
+    pt[0] = MkIntTerm(h);
+    pt[1] = key;
+    pt[2] = value;
+    qd[NB_HASH_COUNT] = MkIntTerm(count + 1);
+    return true;
+}
+
+static Int nb_hash_get(USES_REGS1) {
+    CELL *qd;
+    Int h;
+    UInt i;
+    bool found;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_get(PASS_REGS1);
+    if (!GetNBHash(ARG1, "nb_hash_get/3") ||
+        (h = NBHashCode(ARG2, "nb_hash_get/3" PASS_REGS)) < 0)
+        return false;
+    qd = RepAppl(Deref(ARG1)) + 1;
+    i = NBHashFind(NBHashSlots(qd), NBHashCapacity(qd), h, Deref(ARG2), &found);
+    if (!found)
+        return false;
+    return Yap_unify(ARG3, NBHashSlots(qd)[3 * i + 2]);
+}
+
+static Int nb_hash_del(USES_REGS1) {
+    CELL *qd, *pt;
+    Term value;
+    Int h;
+    UInt i;
+    bool found;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_del(PASS_REGS1);
+    if (!GetNBHash(ARG1, "nb_hash_del/3") ||
+        (h = NBHashCode(ARG2, "nb_hash_del/3" PASS_REGS)) < 0)
+        return false;
+    qd = RepAppl(Deref(ARG1)) + 1;
+    i = NBHashFind(NBHashSlots(qd), NBHashCapacity(qd), h, Deref(ARG2), &found);
+    if (!found)
+        return false;
+    pt = NBHashSlots(qd) + 3 * i;
+    value = pt[2];
+    pt[0] = NB_HASH_TOMB;
+    pt[1] = TermNil;
+    pt[2] = TermNil;
+    qd[NB_HASH_COUNT] = MkIntTerm(IntOfTerm(qd[NB_HASH_COUNT]) - 1);
+    qd[NB_HASH_DELETED] = MkIntTerm(IntOfTerm(qd[NB_HASH_DELETED]) + 1);
+    return Yap_unify(ARG3, value);
+}
+
+static Int nb_hash_size(USES_REGS1) {
+    CELL *qd;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_size(PASS_REGS1);
+    if (!(qd = GetNBHash(ARG1, "nb_hash_size/2")))
+        return false;
+    return Yap_unify(ARG2, qd[NB_HASH_COUNT]);
+}
+
+static Int nb_hash_to_list(USES_REGS1) {
+    CELL *qd, *slots;
+    UInt cap, i;
+    size_t sz;
+    Term l = TermNil;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_to_list(PASS_REGS1);
+    if (!(qd = GetNBHash(ARG1, "nb_hash_to_list/2")))
+        return false;
+    sz = 5 * IntOfTerm(qd[NB_HASH_COUNT]);
+    if (HR + sz > ASP - 1024) {
+        if (!Yap_dogcl(sz * CellSize PASS_REGS)) {
+            Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, "nb_hash_to_list/2");
+            return false;
+        }
+        qd = RepAppl(Deref(ARG1)) + 1;
+    }
+    slots = NBHashSlots(qd);
+    cap = NBHashCapacity(qd);
+    for (i = cap; i > 0; i--) {
+        CELL *pt = slots + 3 * (i - 1);
+
+        if (pt[0] != NB_HASH_FREE && pt[0] != NB_HASH_TOMB) {
+            HR[0] = (CELL) FunctorMinus;
+            HR[1] = pt[1];
+            HR[2] = pt[2];
+            HR[3] = AbsAppl(HR);
+            HR[4] = l;
+            l = AbsPair(HR + 3);
+            HR += 5;
+        }
+    }
+    return Yap_unify(ARG2, l);
+}
+
+static Int nb_hash_clear(USES_REGS1) {
+    CELL *qd;
+
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_clear(false PASS_REGS);
+    if (!(qd = GetNBHash(ARG1, "nb_hash_clear/1")))
+        return false;
+    NBHashInitSlots(NBHashSlots(qd) - 1, NBHashCapacity(qd));
+    qd[NB_HASH_COUNT] = MkIntTerm(0);
+    qd[NB_HASH_DELETED] = MkIntTerm(0);
+    return true;
+}
+
+static Int nb_hash_close(USES_REGS1) {
+    if (IsSharedHash(ARG1))
+        return nb_shared_hash_clear(true PASS_REGS);
+    return nb_hash_clear(PASS_REGS1);
+}
+
 static Int cont_current_nb(USES_REGS1) {
     Int unif;
     GlobalEntry *ge = (GlobalEntry *) IntegerOfTerm(EXTRA_CBACK_ARG(1, 1));
@@ -1723,6 +2545,17 @@ void Yap_InitGlobals(void) {
     Yap_InitCPred("nb_beam_check", 1, nb_beam_check, SafePredFlag);
 #endif
     Yap_InitCPred("nb_beam_size", 2, nb_beam_size, SafePredFlag);
+    Yap_InitCPred("nb_hash", 1, nb_hash, 0L);
+    Yap_InitCPred("nb_hash", 2, nb_hash2, 0L);
+    Yap_InitCPred("nb_shared_hash", 1, nb_shared_hash, 0L);
+    Yap_InitCPred("nb_shared_hash", 2, nb_shared_hash2, 0L);
+    Yap_InitCPred("nb_hash_put", 3, nb_hash_put, 0L);
+    Yap_InitCPred("nb_hash_get", 3, nb_hash_get, 0L);
+    Yap_InitCPred("nb_hash_del", 3, nb_hash_del, 0L);
+    Yap_InitCPred("nb_hash_size", 2, nb_hash_size, SafePredFlag);
+    Yap_InitCPred("nb_hash_to_list", 2, nb_hash_to_list, 0L);
+    Yap_InitCPred("nb_hash_clear", 1, nb_hash_clear, SafePredFlag);
+    Yap_InitCPred("nb_hash_close", 1, nb_hash_close, SafePredFlag);
     CurrentModule = cm;
 }
 
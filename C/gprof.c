@@ -1084,6 +1084,48 @@ static Int profinit( USES_REGS1 )
   return(TRUE);
 }
 
+/*
+ * Stack sampling: at every tick record the whole chain of predicates,
+ * from the one running to the top-level goal. The handler can not
+ * allocate, so stacks go to a table and a pool of frames set up when
+ * sampling starts, and identical stacks share one entry and a counter.
+ *
+ * A frame is a PredEntry, a code address with the low bit set, mapped
+ * to its predicate only when the samples are read, or one of the
+ * SPROF_* pseudo frames for time spent outside Prolog code.
+ */
+
+#define SPROF_DEFAULT_INTERVAL 1000 /* usec */
+#define SPROF_MAX_DEPTH 256
+#define SPROF_TABLE_SIZE (1<<14)
+#define SPROF_POOL_SIZE (1<<20)
+
+#define SPROF_GC ((void *)2)
+#define SPROF_STACK_GROWTH ((void *)4)
+#define SPROF_HEAP_GROWTH ((void *)6)
+#define SPROF_MALLOC ((void *)8)
+#define SPROF_SYSTEM ((void *)10)
+#define SPROF_TRUNCATED ((void *)12)
+#define SPROF_PSEUDO_MAX ((void *)16)
+
+#define SPROF_IS_CODE(f) ((CELL)(f) & 1)
+
+typedef struct sprof_entry {
+  UInt hash;
+  UInt count;
+  UInt depth; /* 0 for a free entry */
+  UInt frames; /* offset in the pool, leaf first */
+} sprof_entry;
+
+static struct {
+  sprof_entry *table;
+  void **pool;
+  UInt pool_top, entries;
+  UInt samples, lost;
+  int interval; /* 0 when off */
+  volatile int busy;
+} sprof;
+
 static Int start_profilers(int msec)
 {
   struct itimerval t;
@@ -1092,6 +1134,7 @@ static Int start_profilers(int msec)
   if (GLOBAL_ProfilerOn!=-1) {
     return FALSE; /* have to go through profinit */
   }
+  sprof.interval = 0;
   sa.sa_sigaction=prof_alrm;
   sigemptyset(&sa.sa_mask);
   sa.sa_flags=SA_SIGINFO;
@@ -1156,6 +1199,8 @@ static Int profend( USES_REGS1 )
   return TRUE;
 }
 
+static void pred_indicator(PredEntry *pp, Term *mod, Term *name, UInt *arity);
+
 static Int getpredinfo( USES_REGS1 ) 
 {
   PredEntry *pp = (PredEntry *)IntegerOfTerm(Deref(ARG1));
@@ -1164,36 +1209,359 @@ static Int getpredinfo( USES_REGS1 )
 
   if (!pp)
     return FALSE;
+  pred_indicator(pp, &mod, &name, &arity);
+  return Yap_unify(ARG2, mod) &&
+    Yap_unify(ARG3, name) &&
+    Yap_unify(ARG4, MkIntegerTerm(arity));
+}
+
+static Int profres0( USES_REGS1 ) { 
+  return(showprofres( PASS_REGS1 ));
+}
+
+static int
+sprof_init_buffers(void)
+{
+  if (sprof.table)
+    return TRUE;
+  sprof.table = calloc(SPROF_TABLE_SIZE, sizeof(sprof_entry));
+  sprof.pool = malloc(SPROF_POOL_SIZE*sizeof(void *));
+  if (!sprof.table || !sprof.pool) {
+    free(sprof.table);
+    free(sprof.pool);
+    sprof.table = NULL;
+    sprof.pool = NULL;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* walk the environments as mark_environments does, but only trust a
+   frame if it is older than the previous one and inside the local stack */
+static UInt
+sprof_collect(void **frames, void *scv USES_REGS)
+{
+  void *oldpc = (void *) CONTEXT_PC(scv);
+  UInt n = 0;
+  CELL *env = ENV, *env0 = NULL;
+  yamop *cp = CP;
+
+  if (LOCAL_PrologMode & TestMode) {
+    /* the stacks may be half-moved, just say where the time went */
+    if (LOCAL_PrologMode & GCMode)
+      frames[0] = SPROF_GC;
+    else if (LOCAL_PrologMode & GrowStackMode)
+      frames[0] = SPROF_STACK_GROWTH;
+    else if (LOCAL_PrologMode & GrowHeapMode)
+      frames[0] = SPROF_HEAP_GROWTH;
+    else if (LOCAL_PrologMode & MallocMode)
+      frames[0] = SPROF_MALLOC;
+    else
+      frames[0] = SPROF_SYSTEM;
+    return 1;
+  }
+  if (oldpc > (void *) &Yap_absmi && oldpc <= (void *) &Yap_absmiEND) {
+    frames[n++] = (void *)((CELL)P | 1);
+  } else {
+    yamop *pc = PREVOP(P,Osbpp);
+    op_numbers oop = Yap_op_from_opcode(pc->opc);
+
+    if (oop == _call_cpred || oop == _call_usercpred) {
+      /* a built-in called from the body of the current clause */
+      frames[n++] = pc->y_u.Osbpp.p;
+      if (pc->y_u.Osbpp.p0)
+	frames[n++] = pc->y_u.Osbpp.p0;
+    } else if (Yap_op_from_opcode(P->opc) == _execute_cpred) {
+      frames[n++] = P->y_u.Osbpp.p;
+    } else {
+      frames[n++] = (void *)((CELL)P | 1);
+    }
+  }
+  /* CP points inside the clause that owns ENV, unless that clause did
+     not call anything yet */
+  if (env && cp && env < LCL0 && (yamop *)env[E_CP] != cp) {
+    PredEntry *pe = EnvPreg(cp);
+    if (pe && pe != frames[n-1])
+      frames[n++] = pe;
+  }
+  while (env && env > env0 && env < LCL0) {
+    PredEntry *pe;
+
+    cp = (yamop *)env[E_CP];
+    /* the bottom frames continue to YESCODE or TRUSTFAILCODE */
+    if (!cp || !(pe = EnvPreg(cp)) || pe == PredFail)
+      break;
+    if (n == SPROF_MAX_DEPTH-1) {
+      frames[n++] = SPROF_TRUNCATED;
+      break;
+    }
+    frames[n++] = pe;
+    env0 = env;
+    env = (CELL *)env[E_E];
+  }
+  return n;
+}
+
+static void
+sprof_alrm(int signo, siginfo_t *si, void *scv)
+{
+  CACHE_REGS
+  void *frames[SPROF_MAX_DEPTH];
+  UInt n, i, h = 2166136261UL, slot;
+  sprof_entry *e;
+
+  /* another thread is in, or the samples are being read */
+  if (__sync_lock_test_and_set(&sprof.busy, 1))
+    return;
+  sprof.samples++;
+  n = sprof_collect(frames, scv PASS_REGS);
+  for (i = 0; i < n; i++)
+    h = (h ^ (CELL)frames[i]) * 16777619UL;
+  slot = h & (SPROF_TABLE_SIZE-1);
+  while ((e = sprof.table+slot)->depth) {
+    if (e->hash == h && e->depth == n &&
+	!memcmp(sprof.pool+e->frames, frames, n*sizeof(void *))) {
+      e->count++;
+      __sync_lock_release(&sprof.busy);
+      return;
+    }
+    slot = (slot+1) & (SPROF_TABLE_SIZE-1);
+  }
+  /* keep the table at most 3/4 full so that probes stay short */
+  if (sprof.pool_top+n > SPROF_POOL_SIZE ||
+      4*(sprof.entries+1) > 3*SPROF_TABLE_SIZE) {
+    sprof.lost++;
+  } else {
+    memcpy(sprof.pool+sprof.pool_top, frames, n*sizeof(void *));
+    e->hash = h;
+    e->count = 1;
+    e->depth = n;
+    e->frames = sprof.pool_top;
+    sprof.pool_top += n;
+    sprof.entries++;
+  }
+  __sync_lock_release(&sprof.busy);
+}
+
+static void
+sprof_timer(int usec)
+{
+  struct itimerval t;
+
+  t.it_interval.tv_sec = usec/1000000;
+  t.it_interval.tv_usec = usec%1000000;
+  t.it_value = t.it_interval;
+  setitimer(ITIMER_PROF,&t,NULL);
+}
+
+static Int
+sprof_start(int usec USES_REGS)
+{
+  struct sigaction sa;
+
+  /* both profilers use SIGPROF */
+  profoff( PASS_REGS1 );
+  if (!sprof_init_buffers()) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "while initializing the stack profiler");
+    return FALSE;
+  }
+  sa.sa_sigaction=sprof_alrm;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags=SA_SIGINFO|SA_RESTART;
+  if (sigaction(SIGPROF,&sa,NULL)== -1) return FALSE;
+  sprof.interval = usec;
+  sprof_timer(usec);
+  return TRUE;
+}
+
+static Int
+stack_profile_on( USES_REGS1 ) {
+  return sprof_start(SPROF_DEFAULT_INTERVAL PASS_REGS);
+}
+
+static Int
+stack_profile_on1( USES_REGS1 ) {
+  Term t = Deref(ARG1);
+
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, "stack_profile_on/1");
+    return FALSE;
+  }
+  if (!IsIntegerTerm(t)) {
+    Yap_Error(TYPE_ERROR_INTEGER, t, "stack_profile_on/1");
+    return FALSE;
+  }
+  if (IntegerOfTerm(t) <= 0 || IntegerOfTerm(t) > 60*1000000) {
+    Yap_Error(DOMAIN_ERROR_OUT_OF_RANGE, t, "stack_profile_on/1");
+    return FALSE;
+  }
+  return sprof_start(IntegerOfTerm(t) PASS_REGS);
+}
+
+static Int
+stack_profile_off( USES_REGS1 ) {
+  if (!sprof.interval)
+    return FALSE;
+  sprof_timer(0);
+  sprof.interval = 0;
+  return TRUE;
+}
+
+static Int
+stack_profile_reset( USES_REGS1 ) {
+  while (__sync_lock_test_and_set(&sprof.busy, 1));
+  if (sprof.table)
+    memset(sprof.table, 0, SPROF_TABLE_SIZE*sizeof(sprof_entry));
+  sprof.pool_top = sprof.entries = 0;
+  sprof.samples = sprof.lost = 0;
+  __sync_lock_release(&sprof.busy);
+  return TRUE;
+}
+
+static void
+pred_indicator(PredEntry *pp, Term *mod, Term *name, UInt *arity)
+{
+  CACHE_REGS
   if (pp->ModuleOfPred == PROLOG_MODULE)
-    mod = TermProlog;
+    *mod = TermProlog;
   else
-    mod = pp->ModuleOfPred;
+    *mod = pp->ModuleOfPred;
   if (pp->ModuleOfPred == IDB_MODULE) {
     if (pp->PredFlags & NumberDBPredFlag) {
-      arity = 0;
-      name = MkIntegerTerm(pp->src.IndxId);
+      *arity = 0;
+      *name = MkIntegerTerm(pp->src.IndxId);
     } else  if (pp->PredFlags & AtomDBPredFlag) {
-      arity = 0;
-      name = MkAtomTerm((Atom)pp->FunctorOfPred);
+      *arity = 0;
+      *name = MkAtomTerm((Atom)pp->FunctorOfPred);
     } else {
-      name = MkAtomTerm(NameOfFunctor(pp->FunctorOfPred));
-      arity = ArityOfFunctor(pp->FunctorOfPred);
+      *name = MkAtomTerm(NameOfFunctor(pp->FunctorOfPred));
+      *arity = ArityOfFunctor(pp->FunctorOfPred);
     }
   } else {
-    arity = pp->ArityOfPE;
+    *arity = pp->ArityOfPE;
     if (pp->ArityOfPE) {
-      name = MkAtomTerm(NameOfFunctor(pp->FunctorOfPred));
+      *name = MkAtomTerm(NameOfFunctor(pp->FunctorOfPred));
     } else {
-      name = MkAtomTerm((Atom)(pp->FunctorOfPred));
-    }  
+      *name = MkAtomTerm((Atom)(pp->FunctorOfPred));
+    }
   }
-  return Yap_unify(ARG2, mod) &&
-    Yap_unify(ARG3, name) &&
-    Yap_unify(ARG4, MkIntegerTerm(arity));
 }
 
-static Int profres0( USES_REGS1 ) { 
-  return(showprofres( PASS_REGS1 ));
+/* frames already turned into terms, so that each predicate is built once */
+typedef struct sprof_term {
+  void *frame;
+  Term t;
+} sprof_term;
+
+static Term
+sprof_frame_term(void *f, sprof_term *cache, UInt size USES_REGS)
+{
+  UInt slot = (((CELL)f) >> 3) & (size-1);
+  PredEntry *pe;
+  Term t;
+
+  while (cache[slot].frame) {
+    if (cache[slot].frame == f)
+      return cache[slot].t;
+    slot = (slot+1) & (size-1);
+  }
+  if (f == SPROF_GC) {
+    t = MkAtomTerm(Yap_LookupAtom("[gc]"));
+  } else if (f == SPROF_STACK_GROWTH) {
+    t = MkAtomTerm(Yap_LookupAtom("[stack expansion]"));
+  } else if (f == SPROF_HEAP_GROWTH) {
+    t = MkAtomTerm(Yap_LookupAtom("[code expansion]"));
+  } else if (f == SPROF_MALLOC) {
+    t = MkAtomTerm(Yap_LookupAtom("[heap allocation]"));
+  } else if (f == SPROF_TRUNCATED) {
+    t = MkAtomTerm(Yap_LookupAtom("[truncated]"));
+  } else if (f < SPROF_PSEUDO_MAX) {
+    t = MkAtomTerm(Yap_LookupAtom("[system]"));
+  } else {
+    pe = f;
+    if (SPROF_IS_CODE(f))
+      pe = Yap_PredForCode((yamop *)((CELL)f & ~1), FIND_PRED_FROM_ANYWHERE, NULL);
+    if (pe == NULL) {
+      t = MkAtomTerm(Yap_LookupAtom("[unknown]"));
+    } else {
+      Term ts[2], mod, name;
+      UInt arity;
+
+      pred_indicator(pe, &mod, &name, &arity);
+      ts[0] = name;
+      ts[1] = MkIntegerTerm(arity);
+      ts[1] = Yap_MkApplTerm(FunctorSlash, 2, ts);
+      ts[0] = mod;
+      t = Yap_MkApplTerm(FunctorModule, 2, ts);
+    }
+  }
+  cache[slot].frame = f;
+  cache[slot].t = t;
+  return t;
+}
+
+/** '$stack_profile_data'(-Stacks, -Samples, -Lost)
+
+Stacks is a list of Count-Frames, Frames root first. Different entries
+may give the same list, when ticks hit different code of a predicate.
+*/
+static Int
+stack_profile_data( USES_REGS1 ) {
+  UInt i, size, need, tried = 0;
+  sprof_term *cache;
+  Term out = TermNil;
+
+  if (!sprof.table)
+    return Yap_unify(ARG1, TermNil) &&
+      Yap_unify(ARG2, MkIntTerm(0)) &&
+      Yap_unify(ARG3, MkIntTerm(0));
+  for (;;) {
+    while (__sync_lock_test_and_set(&sprof.busy, 1));
+    /* a list cell per frame, a pair and a list cell per stack and the
+       module, name and arity of every different frame */
+    need = 2*sprof.pool_top + 5*sprof.entries + 6*sprof.pool_top + 1024;
+    if (ASP-HR >= need+4096)
+      break;
+    /* the table may grow while we collect, so measure it again; give
+       up if collecting did not make room for what it was asked */
+    __sync_lock_release(&sprof.busy);
+    if (need <= tried || !Yap_dogcl(need*sizeof(CELL) PASS_REGS)) {
+      Yap_Error(RESOURCE_ERROR_STACK, TermNil, "$stack_profile_data/3");
+      return FALSE;
+    }
+    tried = need;
+  }
+  for (size = 1024; size < 2*sprof.pool_top; size *= 2);
+  if (!(cache = calloc(size, sizeof(sprof_term)))) {
+    __sync_lock_release(&sprof.busy);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "$stack_profile_data/3");
+    return FALSE;
+  }
+  for (i = 0; i < SPROF_TABLE_SIZE; i++) {
+    sprof_entry *e = sprof.table+i;
+    void **fs = sprof.pool+e->frames;
+    Term frames = TermNil, ts[2];
+    UInt j;
+
+    if (!e->depth)
+      continue;
+    for (j = 0; j < e->depth; j++) {
+      Term t = sprof_frame_term(fs[j], cache, size PASS_REGS);
+      /* the clause running and the one owning the environment are
+         often the same predicate */
+      if (j == 1 && SPROF_IS_CODE(fs[0]) && HeadOfTerm(frames) == t)
+	continue;
+      frames = MkPairTerm(t, frames);
+    }
+    ts[0] = MkIntegerTerm(e->count);
+    ts[1] = frames;
+    out = MkPairTerm(Yap_MkApplTerm(FunctorMinus, 2, ts), out);
+  }
+  __sync_lock_release(&sprof.busy);
+  free(cache);
+  return Yap_unify(ARG1, out) &&
+    Yap_unify(ARG2, MkIntegerTerm(sprof.samples)) &&
+    Yap_unify(ARG3, MkIntegerTerm(sprof.lost));
 }
 
 #endif /* LOW_PROF */
@@ -1216,6 +1584,11 @@ Yap_InitLowProf(void)
   Yap_InitCPred("$profison",0 , profison, SafePredFlag);
   Yap_InitCPred("$get_pred_pinfo", 4, getpredinfo, SafePredFlag);
   Yap_InitCPred("showprofres", 4, getpredinfo, SafePredFlag);
+  Yap_InitCPred("stack_profile_on", 0, stack_profile_on, SafePredFlag);
+  Yap_InitCPred("stack_profile_on", 1, stack_profile_on1, SafePredFlag);
+  Yap_InitCPred("stack_profile_off", 0, stack_profile_off, SafePredFlag);
+  Yap_InitCPred("stack_profile_reset", 0, stack_profile_reset, SafePredFlag);
+  Yap_InitCPred("$stack_profile_data", 3, stack_profile_data, SafePredFlag);
 #endif
 }
 
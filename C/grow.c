@@ -1793,16 +1793,21 @@ Yap_shift_visit(CELL **tovisit, CELL ***tovisit_maxp, CELL ***tovisit_base)
     CELL **tovisit_max = *tovisit_maxp;
   /* relative position of top of stack */
   Int off = (ADDR)tovisit-AuxBase;
+  /* the callers make room for the new entry before they check, so
+     the top stack may already reach below tovisit_max */
+  CELL **top = (tovisit < tovisit_max ? tovisit : tovisit_max);
+  /* where the top stack starts */
+  Int offtop = (ADDR)top-AuxBase;
   /* how much space the top stack was using */
-  Int sz = AuxTop - (ADDR)tovisit_max;
+  Int sz = AuxTop - (ADDR)top;
   /* how much space the bottom stack was using */
   Int szlow = (ADDR)tovisit_max-AuxBase;
   /* original size for AuxSpace */
-  Int totalsz0 = AuxTop - AuxBase; /* totalsz0 == szlow+sz */
+  Int totalsz0 = AuxTop - AuxBase; /* totalsz0 == offtop+sz */
   /* new size for AuxSpace */
   Int totalsz;
   /* how much we grow */
-  Int dsz; /* totalsz == szlow+dsz+sz */
+  Int dsz; /* totalsz == offtop+dsz+sz */
   char *newb = Yap_ExpandPreAllocCodeSpace(0, NULL, FALSE);
 
   if (newb == NULL) {
@@ -1818,7 +1823,7 @@ Yap_shift_visit(CELL **tovisit, CELL ***tovisit_maxp, CELL ***tovisit_base)
     return tovisit;
   }
   /* copy whole block to end */
-  cpcellsd((CELL *)(newb+(dsz+szlow)), (CELL *)(newb+szlow), sz/sizeof(CELL));
+  cpcellsd((CELL *)(newb+(dsz+offtop)), (CELL *)(newb+offtop), sz/sizeof(CELL));
   /* base pointer is block start */
   *tovisit_maxp = (CELL **)(newb+szlow);
   /* base pointer is block start */
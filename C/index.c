@@ -6671,7 +6671,7 @@ LogUpdClause *Yap_FollowIndexingCode(PredEntry *ap, yamop *ipc, yhandle_t yht,
 	  h2 =    Yap_InitHandle( t );
 	}
 #if defined(YAPOR) || defined(THREADS)
-	if (!same_lu_block(jlbl, ipc)) {
+	if (jlbl && !same_lu_block(jlbl, ipc)) {
 	  ipc = *jlbl;
 	  break;
 	}
@@ -6715,7 +6715,7 @@ LogUpdClause *Yap_FollowIndexingCode(PredEntry *ap, yamop *ipc, yhandle_t yht,
 	  h2 =   Yap_InitHandle( t );
 	}
 #if defined(YAPOR) || defined(THREADS)
-	if (!same_lu_block(jlbl, ipc)) {
+	if (jlbl && !same_lu_block(jlbl, ipc)) {
 	  ipc = *jlbl;
 	  break;
 	}
@@ -6973,7 +6973,7 @@ LogUpdClause *Yap_NthClause(PredEntry *ap, Int ncls) {
     case _expand_index:
     case _expand_clauses:
 #if defined(YAPOR) || defined(THREADS)
-      if (*jlbl != (yamop *)&(ap->cs.p_code.ExpandCode)) {
+      if (jlbl && *jlbl != (yamop *)&(ap->cs.p_code.ExpandCode)) {
         ipc = *jlbl;
         break;
       }
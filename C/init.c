@@ -1198,10 +1198,17 @@ static void InitThreadHandle(int wid) {
     condp = &mboxp->cond;
     pthread_cond_init(condp, NULL);
     mutexp = &mboxp->mutex;
+    pthread_cond_init(&mboxp->room, NULL);
     pthread_mutex_init(mutexp, NULL);
     msgsp = &mboxp->msgs;
+    mboxp->incoming = NULL;
     mboxp->nmsgs = 0;
     mboxp->nclients = 0;
+    mboxp->nsleepers = 0;
+    mboxp->npatterns = 0;
+    mboxp->nsenders = 0;
+    mboxp->sending = 0;
+    mboxp->max_size = 0;
     mboxp->open = true;
     Yap_init_tqueue(msgsp);
   }
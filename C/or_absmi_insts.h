@@ -35,11 +35,10 @@
         low_level_trace(try_or, PREG->y_u.Osblp.p0, NULL);
       }
 #endif
-   #if 0
       CACHE_Y_AS_ENV(YREG);
       check_stack(NoStackEither, HR);
       ENDCACHE_Y_AS_ENV();
-#endif
+    either_body:
       BEGD(d0);
       //reset_or:
       /* Try to preserve the environment */
@@ -74,12 +73,12 @@
        ENDD(d0);
      GONext();
 
-#if 0
     NoStackEither:
-         
-   PROCESS_INT(interrupt_either, reset_or);
-      JMPNext();
-     #endif 
+      if (!Yap_has_a_signal()) {
+        /* just short of stack: the next call will collect */
+        goto either_body;
+      }
+      PROCESS_INTERRUPTED_PRUNE(interrupt_either);
       ENDOp();
 
       Op(or_else, Osblp);
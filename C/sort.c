@@ -22,6 +22,15 @@
 #include "Yatom.h"
 #include "YapHeap.h"
 #include "amiops.h"
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 /* fill in the even or the odd elements */
 #define M_EVEN  0
@@ -31,6 +40,8 @@ static void simple_mergesort(CELL *, Int, int);
 static Int compact_mergesort(CELL *, Int, int);
 static int key_mergesort(CELL *, Int, int, Functor);
 static void adjust_vector(CELL *, Int);
+static int sort_keys(CELL *, Int, Functor);
+static Int vector_sort(CELL *, Int, Functor, int);
 static Int p_sort( USES_REGS1 );
 static Int p_msort( USES_REGS1 );
 static Int p_ksort( USES_REGS1 );
@@ -306,6 +317,482 @@ adjust_vector(CELL *pt, Int size)
   pt[0] = TermNil;
 }
 
+/*
+ * Vectors whose keys are all atomic are sorted apart: comparing them does
+ * not visit subterms, so it needs no scratch space on the global stack
+ * and leaves the terms alone. That lets large vectors be cut in chunks
+ * sorted by separate threads and then merged, and allows cheaper
+ * comparisons, or no comparisons at all, when all keys are of one type.
+ */
+
+/* what the keys have in common */
+#define KEYS_ANY    0 /* some key is compound, use the recursive sorts */
+#define KEYS_ATOMIC 1
+#define KEYS_INTS   2 /* integers that fit an Int, radix sorted */
+#define KEYS_ATOMS  3 /* sorted on cached name prefixes */
+#define KEYS_FLOATS 4 /* floats but NaN, radix sorted */
+
+#define SORT_RUN     16       /* insertion sorted runs */
+#define RADIX_MIN    64       /* smaller vectors are merge sorted */
+#define SORT_PAR_MIN (1<<16)  /* elements per thread */
+#define SORT_MAX_THREADS 16
+
+static inline Term
+sort_key(Term t, Functor f)
+{
+  t = Deref(t);
+  if (f)
+    t = Deref(ArgOfTerm(1, t));
+  return t;
+}
+
+static int
+sort_keys(CELL *pt, Int size, Functor f)
+{
+  int ints = TRUE, atoms = TRUE, floats = TRUE;
+  Int i;
+
+  for (i = 0; i < size; i++) {
+    Term t = Deref(pt[2*i]);
+
+    if (f) {
+      if (IsVarTerm(t) || !IsApplTerm(t) || FunctorOfTerm(t) != f)
+	return KEYS_ANY;
+      t = Deref(ArgOfTerm(1, t));
+    }
+    if (IsIntTerm(t)) {
+      atoms = floats = FALSE;
+    } else if (IsAtomTerm(t)) {
+      ints = floats = FALSE;
+    } else if (IsVarTerm(t)) {
+      ints = atoms = floats = FALSE;
+    } else if (IsApplTerm(t)) {
+      Functor fe = FunctorOfTerm(t);
+      if (fe == FunctorLongInt) {
+	atoms = floats = FALSE;
+      } else if (fe == FunctorDouble) {
+	Float d = FloatOfTerm(t);
+	/* NaN has no place in a radix order */
+	if (d != d)
+	  floats = FALSE;
+	ints = atoms = FALSE;
+      } else if (fe == FunctorString) {
+	ints = atoms = floats = FALSE;
+      } else {
+	return KEYS_ANY;
+      }
+    } else {
+      return KEYS_ANY;
+    }
+  }
+  if (ints)
+    return KEYS_INTS;
+  if (atoms)
+    return KEYS_ATOMS;
+  if (floats)
+    return KEYS_FLOATS;
+  return KEYS_ATOMIC;
+}
+
+static inline Int
+sort_compare(Term t0, Term t1, int keys, Functor f)
+{
+  t0 = sort_key(t0, f);
+  t1 = sort_key(t1, f);
+  switch (keys) {
+  case KEYS_INTS:
+    {
+      Int i0 = IntegerOfTerm(t0), i1 = IntegerOfTerm(t1);
+      return (i0 > i1) - (i0 < i1);
+    }
+  case KEYS_FLOATS:
+    {
+      Float d0 = FloatOfTerm(t0), d1 = FloatOfTerm(t1);
+      return (d0 > d1) - (d0 < d1);
+    }
+  case KEYS_ATOMS:
+    if (t0 == t1)
+      return 0;
+    return strcmp(RepAtom(AtomOfTerm(t0))->StrOfAE,
+		  RepAtom(AtomOfTerm(t1))->StrOfAE);
+  default:
+    return Yap_compare_terms(t0, t1);
+  }
+}
+
+/* stable merge of a and b into out */
+static void
+vector_merge(Term *a, Int na, Term *b, Int nb, Term *out, Int nout,
+	     int keys, Functor f)
+{
+  Term *end_a = a + na, *end_b = b + nb, *end_out = out + nout;
+
+  while (out < end_out && a < end_a && b < end_b) {
+    if (sort_compare(*a, *b, keys, f) <= 0)
+      *out++ = *a++;
+    else
+      *out++ = *b++;
+  }
+  while (out < end_out && a < end_a)
+    *out++ = *a++;
+  while (out < end_out && b < end_b)
+    *out++ = *b++;
+}
+
+/* how many of the first d merged elements come from a */
+static Int
+merge_split(Term *a, Int na, Term *b, Int nb, Int d, int keys, Functor f)
+{
+  Int lo = d > nb ? d - nb : 0, hi = d < na ? d : na;
+
+  while (lo < hi) {
+    Int mid = (lo + hi) / 2;
+    if (sort_compare(a[mid], b[d - mid - 1], keys, f) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* bottom up merge sort of a, using b as scratch */
+static void
+chunk_sort(Term *a, Term *b, Int n, int keys, Functor f)
+{
+  Term *src = a, *dst = b, *tmp;
+  Int i, j, w;
+
+  for (i = 0; i < n; i += SORT_RUN) {
+    Int end = i + SORT_RUN < n ? i + SORT_RUN : n;
+    for (j = i + 1; j < end; j++) {
+      Term t = a[j];
+      Int k = j;
+      while (k > i && sort_compare(a[k - 1], t, keys, f) > 0) {
+	a[k] = a[k - 1];
+	k--;
+      }
+      a[k] = t;
+    }
+  }
+  for (w = SORT_RUN; w < n; w *= 2) {
+    for (i = 0; i < n; i += 2*w) {
+      Int mid = i + w < n ? i + w : n, end = i + 2*w < n ? i + 2*w : n;
+      vector_merge(src + i, mid - i, src + mid, end - mid, dst + i, end - i,
+		   keys, f);
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  if (src != a)
+    memcpy(a, src, n * sizeof(Term));
+}
+
+/*
+ * LSD radix sort on a byte per pass, stable. Keys are mapped to unsigned
+ * 64 bit numbers in the same order, and passes where every key has the
+ * same byte are skipped, so small integers take one or two.
+ */
+static inline uint64_t
+radix_key(Term t, int keys, Functor f)
+{
+  t = sort_key(t, f);
+  if (keys == KEYS_FLOATS) {
+    union { Float d; uint64_t u; } x;
+
+    x.u = 0;
+    x.d = FloatOfTerm(t);
+    /* -0.0 and 0.0 are the same in the standard order */
+    if (x.d == 0.0)
+      x.d = 0.0;
+    return (x.u >> 63) ? ~x.u : x.u | ((uint64_t)1 << 63);
+  }
+  return (uint64_t)(int64_t)IntegerOfTerm(t) ^ ((uint64_t)1 << 63);
+}
+
+static void
+radix_sort(Term *a, Term *b, Int n, int keys, Functor f)
+{
+  Int count[8][256];
+  Term *src = a, *dst = b, *tmp;
+  uint64_t k0;
+  Int i;
+  int d, j;
+
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < n; i++) {
+    uint64_t k = radix_key(a[i], keys, f);
+    for (d = 0; d < 8; d++)
+      count[d][(k >> (8*d)) & 0xff]++;
+  }
+  k0 = radix_key(a[0], keys, f);
+  for (d = 0; d < 8; d++) {
+    Int sum = 0;
+
+    if (count[d][(k0 >> (8*d)) & 0xff] == n)
+      continue;
+    for (j = 0; j < 256; j++) {
+      Int c = count[d][j];
+      count[d][j] = sum;
+      sum += c;
+    }
+    for (i = 0; i < n; i++) {
+      Term t = src[i];
+      dst[count[d][(radix_key(t, keys, f) >> (8*d)) & 0xff]++] = t;
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  if (src != a)
+    memcpy(a, src, n * sizeof(Term));
+}
+
+/*
+ * Atoms are merge sorted on the first eight bytes of their names, read
+ * as a big endian number, so most comparisons do not go to the names.
+ * Returns FALSE if there is no memory for the prefixes.
+ */
+struct atom_key {
+  uint64_t prefix;
+  const char *name;
+  Term t;
+};
+
+static inline int
+atom_key_compare(struct atom_key *x, struct atom_key *y)
+{
+  if (x->prefix != y->prefix)
+    return x->prefix < y->prefix ? -1 : 1;
+  if (x->name == y->name)
+    return 0;
+  return strcmp(x->name, y->name);
+}
+
+static int
+atom_sort(Term *a, Int n, Functor f)
+{
+  struct atom_key *e, *src, *dst, *tmp;
+  Int i, w;
+
+  e = (struct atom_key *)malloc(2 * n * sizeof(struct atom_key));
+  if (!e)
+    return FALSE;
+  for (i = 0; i < n; i++) {
+    const unsigned char *s =
+      (const unsigned char *)RepAtom(AtomOfTerm(sort_key(a[i], f)))->StrOfAE;
+    uint64_t p = 0;
+    int j;
+
+    for (j = 0; j < 8 && s[j]; j++)
+      p |= (uint64_t)s[j] << (56 - 8*j);
+    e[i].prefix = p;
+    e[i].name = (const char *)s;
+    e[i].t = a[i];
+  }
+  src = e;
+  dst = e + n;
+  for (w = 1; w < n; w *= 2) {
+    for (i = 0; i < n; i += 2*w) {
+      struct atom_key *l = src + i, *r, *end_l, *end_r, *out = dst + i;
+
+      end_l = src + (i + w < n ? i + w : n);
+      r = end_l;
+      end_r = src + (i + 2*w < n ? i + 2*w : n);
+      while (l < end_l && r < end_r) {
+	if (atom_key_compare(l, r) <= 0)
+	  *out++ = *l++;
+	else
+	  *out++ = *r++;
+      }
+      while (l < end_l)
+	*out++ = *l++;
+      while (r < end_r)
+	*out++ = *r++;
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  for (i = 0; i < n; i++)
+    a[i] = src[i].t;
+  free(e);
+  return TRUE;
+}
+
+#if HAVE_PTHREAD_H
+
+struct sort_job {
+  Term *src, *dst;
+  Int *bounds;   /* runs in src, bounds[r] .. bounds[r+1] */
+  Int nruns;
+  int nthreads, keys;
+  Functor f;
+};
+
+struct sort_slot {
+  struct sort_job *job;
+  int slot;
+};
+
+/* sorts chunk slot of src */
+static void *
+sort_chunk_worker(void *arg)
+{
+  struct sort_slot *s = (struct sort_slot *)arg;
+  struct sort_job *j = s->job;
+  Int lo = j->bounds[s->slot], hi = j->bounds[s->slot + 1];
+
+  chunk_sort(j->src + lo, j->dst + lo, hi - lo, j->keys, j->f);
+  return NULL;
+}
+
+/*
+ * merges runs 2r and 2r+1 of src into dst; every thread takes the same
+ * share of the output of each pair, and finds where it starts in the
+ * two runs by binary search.
+ */
+static void *
+sort_merge_worker(void *arg)
+{
+  struct sort_slot *s = (struct sort_slot *)arg;
+  struct sort_job *j = s->job;
+  Int r;
+
+  for (r = 0; r < j->nruns; r += 2) {
+    Int lo = j->bounds[r];
+    /* an odd run out is just copied */
+    Int mid = j->bounds[r + 1];
+    Int hi = r + 1 < j->nruns ? j->bounds[r + 2] : mid;
+    Int n = hi - lo, na = mid - lo, nb = hi - mid;
+    Int d0 = n * s->slot / j->nthreads, d1 = n * (s->slot + 1) / j->nthreads;
+    Int i0 = merge_split(j->src + lo, na, j->src + mid, nb, d0, j->keys, j->f);
+    Int i1 = merge_split(j->src + lo, na, j->src + mid, nb, d1, j->keys, j->f);
+
+    vector_merge(j->src + lo + i0, i1 - i0, j->src + mid + (d0 - i0),
+		 (d1 - i1) - (d0 - i0), j->dst + lo + d0, d1 - d0, j->keys,
+		 j->f);
+  }
+  return NULL;
+}
+
+/* runs fn on every slot, slot 0 on the calling thread */
+static void
+sort_par_run(struct sort_job *j, void *(*fn)(void *))
+{
+  pthread_t tid[SORT_MAX_THREADS];
+  struct sort_slot slots[SORT_MAX_THREADS];
+  int started[SORT_MAX_THREADS];
+  int i;
+
+  for (i = 0; i < j->nthreads; i++) {
+    slots[i].job = j;
+    slots[i].slot = i;
+    started[i] = i > 0 && pthread_create(tid + i, NULL, fn, slots + i) == 0;
+  }
+  for (i = 0; i < j->nthreads; i++)
+    if (!started[i])
+      fn(slots + i);
+  for (i = 1; i < j->nthreads; i++)
+    if (started[i])
+      pthread_join(tid[i], NULL);
+}
+
+static void
+parallel_sort(Term *a, Term *b, Int n, int nthreads, int keys, Functor f)
+{
+  struct sort_job j;
+  Int bounds[SORT_MAX_THREADS + 1];
+  Term *tmp;
+  int i;
+
+  for (i = 0; i <= nthreads; i++)
+    bounds[i] = n * i / nthreads;
+  j.src = a;
+  j.dst = b;
+  j.bounds = bounds;
+  j.nruns = nthreads;
+  j.nthreads = nthreads;
+  j.keys = keys;
+  j.f = f;
+  sort_par_run(&j, sort_chunk_worker);
+  /* merge the runs pairwise, all threads working on each round */
+  while (j.nruns > 1) {
+    Int nruns = 0;
+
+    sort_par_run(&j, sort_merge_worker);
+    for (i = 0; i < j.nruns; i += 2)
+      bounds[nruns++] = bounds[i];
+    bounds[nruns] = n;
+    j.nruns = nruns;
+    tmp = j.src;
+    j.src = j.dst;
+    j.dst = tmp;
+  }
+  if (j.src != a)
+    memcpy(a, j.src, n * sizeof(Term));
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+static int
+sort_nthreads(Int size)
+{
+  long nthreads = size / SORT_PAR_MIN;
+#if HAVE_PTHREAD_H && defined(_SC_NPROCESSORS_ONLN)
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (ncpus < 1)
+    ncpus = 1;
+  if (nthreads > ncpus)
+    nthreads = ncpus;
+#else
+  nthreads = 1;
+#endif
+  if (nthreads > SORT_MAX_THREADS)
+    nthreads = SORT_MAX_THREADS;
+  if (nthreads < 1)
+    nthreads = 1;
+  return nthreads;
+}
+
+/*
+ * Sorts the size elements in the even cells of pt, as the mergesorts
+ * above do, by key if f is not NULL and removing duplicates if compact.
+ * Returns the new size, or -1 if some key is not atomic.
+ */
+static Int
+vector_sort(CELL *pt, Int size, Functor f, int compact)
+{
+  int keys = sort_keys(pt, size, f), nthreads;
+  Term *a = pt, *b = pt + size;
+  Int i, n;
+
+  if (keys == KEYS_ANY)
+    return -1;
+  /* pack the elements in the first half, the second is scratch */
+  for (i = 0; i < size; i++)
+    a[i] = pt[2*i];
+  nthreads = sort_nthreads(size);
+  if ((keys == KEYS_INTS || keys == KEYS_FLOATS) && size >= RADIX_MIN)
+    radix_sort(a, b, size, keys, f);
+#if HAVE_PTHREAD_H
+  else if (nthreads > 1)
+    parallel_sort(a, b, size, nthreads, keys, f);
+#endif
+  else if (keys != KEYS_ATOMS || size < RADIX_MIN || !atom_sort(a, size, f))
+    chunk_sort(a, b, size, keys, f);
+  n = size;
+  if (compact) {
+    for (i = 1, n = 1; i < size; i++)
+      if (sort_compare(a[n - 1], a[i], keys, f) != 0)
+	a[n++] = a[i];
+  }
+  for (i = n - 1; i >= 0; i--)
+    pt[2*i] = a[i];
+  return n;
+}
+
 
 
 static ssize_t prepare(Term t)
@@ -361,7 +848,8 @@ Term Yap_MergeSort(Term l USES_REGS)
   pt = HR-2*size;
   if (pt > ASP-1024)
     return 0;
-  simple_mergesort(pt, size, M_EVEN);
+  if (vector_sort(pt, size, NULL, FALSE) < 0)
+    simple_mergesort(pt, size, M_EVEN);
   adjust_vector(pt, size);
   /* reajust space */
   HR = pt+size*2;
@@ -371,6 +859,7 @@ Term Yap_MergeSort(Term l USES_REGS)
 Term Yap_SortList(Term l USES_REGS)
 {
   CELL *pt;
+  Int n;
   ssize_t size = prepare(l);
   if (size < 2) {
     return l;
@@ -379,11 +868,12 @@ Term Yap_SortList(Term l USES_REGS)
   pt = HR-2*size;
   if (pt > ASP-1024)
     return 0;
-size=
-  compact_mergesort(pt, size, M_EVEN);
-  adjust_vector(pt, size);
+  n = vector_sort(pt, size, NULL, TRUE);
+  if (n < 0)
+    n = compact_mergesort(pt, size, M_EVEN);
+  adjust_vector(pt, n);
   /* reajust space */
-  HR = pt+size*2;
+  HR = pt+n*2;
   return AbsPair(pt);
 }
 
@@ -399,8 +889,10 @@ p_sort( USES_REGS1 )
   CELL *pt = HR-2*size;
   /* use the heap to build a new list */
   Term out;
-  size = compact_mergesort(pt, size, M_EVEN);
-  adjust_vector(pt, size);
+  Int n = vector_sort(pt, size, NULL, TRUE);
+  if (n < 0)
+    n = compact_mergesort(pt, size, M_EVEN);
+  adjust_vector(pt, n);
   out = AbsPair(pt);
   return(Yap_unify(out, ARG2));
 }
@@ -417,7 +909,8 @@ p_msort( USES_REGS1 )
   CELL *pt = HR-2*size;
   /* use the heap to build a new list */
   Term out;
-  simple_mergesort(pt, size, M_EVEN);
+  if (vector_sort(pt, size, NULL, FALSE) < 0)
+    simple_mergesort(pt, size, M_EVEN);
   adjust_vector(pt, size);
   out = AbsPair(pt);
   return(Yap_unify(out, ARG2));
@@ -434,7 +927,8 @@ p_ksort( USES_REGS1 )
     return(Yap_unify(ARG1, ARG2));
   }
   CELL *pt = HR-2*size;
-   if (!key_mergesort(pt, size, M_EVEN, FunctorMinus))
+  if (vector_sort(pt, size, FunctorMinus, FALSE) < 0 &&
+      !key_mergesort(pt, size, M_EVEN, FunctorMinus))
     return(FALSE);
   adjust_vector(pt, size);
   out = AbsPair(pt);
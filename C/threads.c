@@ -124,6 +124,21 @@ allocate_new_tid(void)
 }
 
 
+/*
+ * Mailboxes
+ *
+ * Senders copy the message to the database and push it on the incoming
+ * stack with a compare and swap, so that sending never waits for
+ * receivers or for other senders. Receivers hold the mutex, move
+ * incoming to msgs, oldest first, and look for a message there; they
+ * build the message after releasing the mutex whenever they can.
+ *
+ * A receiver that finds nothing counts itself in nsleepers before the
+ * last look at incoming, and a sender looks at nsleepers after the
+ * push, so that one of them sees the other. Senders wake one sleeper
+ * per message, or all of them if some sleeper waits for a partial term
+ * that the message may not match.
+ */
 static bool
 mboxCreate( Term namet, mbox_t *mboxp USES_REGS )
 {
@@ -134,6 +149,7 @@ mboxCreate( Term namet, mbox_t *mboxp USES_REGS )
   memset(mboxp, 0, sizeof(mbox_t));
   condp = & mboxp->cond;
   pthread_cond_init(condp, NULL);
+  pthread_cond_init(& mboxp->room, NULL);
   mutexp = & mboxp->mutex;
   pthread_mutex_init(mutexp, NULL);
   msgsp = & mboxp->msgs;
@@ -146,43 +162,240 @@ mboxCreate( Term namet, mbox_t *mboxp USES_REGS )
   return true;
 }
 
+/* move what senders pushed to msgs, in the order it was sent; the
+   caller holds the mutex */
+static void
+mboxDrain( mbox_t *mboxp )
+{
+  QueueEntry *in = __sync_lock_test_and_set(&mboxp->incoming, NULL);
+  QueueEntry *first = NULL, *last = in;
+
+  if (!in)
+    return;
+  while (in) {
+    QueueEntry *next = in->next;
+    in->next = first;
+    first = in;
+    in = next;
+  }
+  Yap_append_tqueue(&mboxp->msgs, first, last);
+}
+
+/* release a closed mailbox nobody uses; the caller holds the mutex */
+static void
+mboxFree( mbox_t *mboxp USES_REGS )
+{
+  mboxDrain(mboxp);
+  Yap_destroy_tqueue(&mboxp->msgs PASS_REGS);
+  mboxp->nmsgs = 0;
+  pthread_mutex_unlock(&mboxp->mutex);
+  pthread_cond_destroy(&mboxp->cond);
+  pthread_cond_destroy(&mboxp->room);
+  pthread_mutex_destroy(&mboxp->mutex);
+}
+
+/* returns true if the mailbox was released, false if it will be
+   released by the last thread still in it */
 static bool
 mboxDestroy( mbox_t *mboxp USES_REGS )
 {
-  pthread_mutex_t *mutexp = &mboxp->mutex;
-  pthread_cond_t *condp = &mboxp->cond;
-  struct idb_queue *msgsp = &mboxp->msgs;
+  pthread_mutex_lock(&mboxp->mutex);
   mboxp->open = false;
-  if (mboxp->nclients == 0 ) {
-    pthread_cond_destroy(condp);
-    pthread_mutex_destroy(mutexp);
-    Yap_destroy_tqueue(msgsp PASS_REGS);
-    // at this point, there is nothing left to unlock!
+  if (__sync_or_and_fetch(&mboxp->sending, 1) == 1 &&
+      mboxp->nclients == 0) {
+    mboxFree(mboxp PASS_REGS);
     return true;
+  }
+  /* we have clients in the mailbox, wake them up */
+  pthread_cond_broadcast(&mboxp->cond);
+  pthread_cond_broadcast(&mboxp->room);
+  pthread_mutex_unlock(&mboxp->mutex);
+  return false;
+}
+
+/* a thread in the mailbox found it closed; the caller holds the
+   mutex */
+static void
+mboxLeave( mbox_t *mboxp USES_REGS )
+{
+  if (!mboxp->nclients && mboxp->sending == 1) {
+    mboxFree(mboxp PASS_REGS);
   } else {
-    /* we have clients in the mailbox, try to wake them up one by one */
-    pthread_cond_broadcast(condp);
-    pthread_mutex_unlock(mutexp);
-    return true;
+    pthread_mutex_unlock(&mboxp->mutex);
   }
 }
 
+/* a sender counts itself in sending before it touches the mailbox, so
+   that a closed mailbox is not released under a push; fails if the
+   mailbox was closed */
 static bool
-mboxSend( mbox_t *mboxp, Term t USES_REGS )
+mboxEnterSend( mbox_t *mboxp )
 {
-  pthread_mutex_t *mutexp = &mboxp->mutex;
-  pthread_cond_t *condp = &mboxp->cond;
-  struct idb_queue *msgsp = &mboxp->msgs;
+  int n;
+
+  do {
+    n = mboxp->sending;
+    if (n & 1)
+      return false;
+  } while (!__sync_bool_compare_and_swap(&mboxp->sending, n, n+2));
+  return true;
+}
+
+/* once the mailbox is closed senders leave under the mutex, so that
+   only the last thread out releases it */
+static void
+mboxLeaveSend( mbox_t *mboxp USES_REGS )
+{
+  int n;
+
+  do {
+    n = mboxp->sending;
+    if (n & 1) {
+      pthread_mutex_lock(&mboxp->mutex);
+      __sync_fetch_and_sub(&mboxp->sending, 2);
+      mboxLeave(mboxp PASS_REGS);
+      return;
+    }
+  } while (!__sync_bool_compare_and_swap(&mboxp->sending, n, n-2));
+}
+
+/* in a queue with a max_size, wait until there is room */
+static bool
+mboxWaitRoom( mbox_t *mboxp USES_REGS )
+{
+  bool rc;
+
+  if (!mboxp->max_size || mboxp->nmsgs < mboxp->max_size)
+    return mboxp->open;
+  pthread_mutex_lock(&mboxp->mutex);
+  mboxp->nsenders++;
+  while (mboxp->open && mboxp->nmsgs >= mboxp->max_size)
+    pthread_cond_wait(&mboxp->room, &mboxp->mutex);
+  mboxp->nsenders--;
+  rc = mboxp->open;
+  pthread_mutex_unlock(&mboxp->mutex);
+  return rc;
+}
 
+/* push the n messages first .. last, newest first, and wake up enough
+   receivers */
+static void
+mboxPush( mbox_t *mboxp, QueueEntry *first, QueueEntry *last, int n )
+{
+  QueueEntry *old;
+
+  __sync_fetch_and_add(&mboxp->nmsgs, n);
+  do {
+    old = mboxp->incoming;
+    last->next = old;
+  } while (!__sync_bool_compare_and_swap(&mboxp->incoming, old, first));
+  if (mboxp->nsleepers) {
+    pthread_mutex_lock(&mboxp->mutex);
+    if (mboxp->npatterns || n >= mboxp->nsleepers) {
+      pthread_cond_broadcast(&mboxp->cond);
+    } else {
+      while (n--)
+	pthread_cond_signal(&mboxp->cond);
+    }
+    pthread_mutex_unlock(&mboxp->mutex);
+  }
+}
+
+/* n messages left msgs; the caller holds the mutex */
+static void
+mboxTaken( mbox_t *mboxp, int n )
+{
+  __sync_fetch_and_sub(&mboxp->nmsgs, n);
+  if (mboxp->nsenders) {
+    if (n == 1)
+      pthread_cond_signal(&mboxp->room);
+    else
+      pthread_cond_broadcast(&mboxp->room);
+  }
+  /* a receiver woken for a message another one took */
+  if (mboxp->nsleepers && !mboxp->npatterns && mboxp->msgs.FirstInQueue)
+    pthread_cond_signal(&mboxp->cond);
+}
+
+/* wait until msgs may have something new for a receiver; returns false
+   if the mailbox was closed, after leaving it */
+static bool
+mboxSleep( mbox_t *mboxp, bool pattern USES_REGS )
+{
   if (!mboxp->open) {
+    mboxp->nclients--;
+    mboxLeave(mboxp PASS_REGS);
+    return false;
+  }
+  __sync_fetch_and_add(&mboxp->nsleepers, 1);
+  if (pattern)
+    mboxp->npatterns++;
+  if (!mboxp->incoming)
+    pthread_cond_wait(&mboxp->cond, &mboxp->mutex);
+  if (pattern)
+    mboxp->npatterns--;
+  __sync_fetch_and_sub(&mboxp->nsleepers, 1);
+  mboxDrain(mboxp);
+  return true;
+}
+
+static bool
+mboxSend( mbox_t *mboxp, Term t USES_REGS )
+{
+  QueueEntry *x;
+
+  if (!mboxEnterSend(mboxp))
+    return false;
+  if (!mboxWaitRoom(mboxp PASS_REGS) ||
+      !(x = Yap_new_tqueue_entry(t PASS_REGS))) {
     // oops, dead mailbox
+    mboxLeaveSend(mboxp PASS_REGS);
     return false;
   }
-  Yap_enqueue_tqueue(msgsp, t PASS_REGS);
-  // printf("+   (%d) %d/%d\n", worker_id,mboxp->nclients, mboxp->nmsgs);
-  mboxp->nmsgs++;
-  pthread_cond_broadcast(condp);
-  pthread_mutex_unlock(mutexp);
+  mboxPush(mboxp, x, x, 1);
+  mboxLeaveSend(mboxp PASS_REGS);
+  return true;
+}
+
+/* send all the messages in the list l with a single push */
+static bool
+mboxSendAll( mbox_t *mboxp, Term l USES_REGS )
+{
+  yhandle_t sl;
+  QueueEntry *first = NULL, *last = NULL;
+  int n = 0;
+
+  if (!mboxEnterSend(mboxp))
+    return false;
+  if (!mboxWaitRoom(mboxp PASS_REGS)) {
+    mboxLeaveSend(mboxp PASS_REGS);
+    return false;
+  }
+  sl = Yap_InitSlot(l);
+  while (IsPairTerm(l = Deref(Yap_GetFromSlot(sl)))) {
+    QueueEntry *x;
+
+    Yap_PutInSlot(sl, TailOfTerm(l));
+    if (!(x = Yap_new_tqueue_entry(HeadOfTerm(l) PASS_REGS))) {
+      while (first) {
+	x = first->next;
+	Yap_free_tqueue_entry(first PASS_REGS);
+	first = x;
+      }
+      Yap_RecoverSlots(1, sl);
+      mboxLeaveSend(mboxp PASS_REGS);
+      return false;
+    }
+    x->next = first;
+    first = x;
+    if (!last)
+      last = x;
+    n++;
+  }
+  Yap_RecoverSlots(1, sl);
+  if (n)
+    mboxPush(mboxp, first, last, n);
+  mboxLeaveSend(mboxp PASS_REGS);
   return true;
 }
 
@@ -190,41 +403,102 @@ static bool
 mboxReceive( mbox_t *mboxp, Term t USES_REGS )
 {
   pthread_mutex_t *mutexp = &mboxp->mutex;
-  pthread_cond_t *condp = &mboxp->cond;
   struct idb_queue *msgsp = &mboxp->msgs;
-  bool rc; 
+  bool pattern = !IsVarTerm(t);
+  /* the stacks may move while we build a message or wait for one */
+  yhandle_t sl;
 
+  pthread_mutex_lock(mutexp);
   if (!mboxp->open){
+    pthread_mutex_unlock(mutexp);
     return false; 	// don't try to read if someone else already closed down...
   }
   mboxp->nclients++;
+  mboxDrain(mboxp);
+  sl = Yap_InitSlot(t);
   do {
-    rc = mboxp->nmsgs && Yap_dequeue_tqueue(msgsp, t, false,  true PASS_REGS);
-    if (rc) {
+    if (!msgsp->FirstInQueue) {
+      continue;
+    } else if (!pattern) {
+      // take the first message, and build it outside the lock
+      QueueEntry *x = msgsp->FirstInQueue;
+      Term msg;
+
+      if (!(msgsp->FirstInQueue = x->next))
+	msgsp->LastInQueue = NULL;
       mboxp->nclients--;
-      mboxp->nmsgs--;
-      //printf("-   (%d) %d/%d\n", worker_id,mboxp->nclients, mboxp->nmsgs);
-      //	Yap_do_low_level_trace=1;
+      mboxTaken(mboxp, 1);
       pthread_mutex_unlock(mutexp);
-      return true;
-    } else if (!mboxp->open) {
-      //printf("o   (%d)\n", worker_id);
+      msg = Yap_pop_tqueue_entry(x PASS_REGS);
+      t = Yap_GetFromSlot(sl);
+      Yap_RecoverSlots(1, sl);
+      return msg && Yap_unify(t, msg);
+    } else if (Yap_dequeue_tqueue(msgsp, Yap_GetFromSlot(sl), false, true PASS_REGS)) {
       mboxp->nclients--;
-      if (!mboxp->nclients) {// release
-	pthread_cond_destroy(condp);
-	pthread_mutex_destroy(mutexp);
-	Yap_destroy_tqueue(msgsp PASS_REGS);
-	// at this point, there is nothing left to unlock!
-      } else {
-	pthread_cond_broadcast(condp);
-	pthread_mutex_unlock(mutexp);
+      mboxTaken(mboxp, 1);
+      pthread_mutex_unlock(mutexp);
+      Yap_RecoverSlots(1, sl);
+      return true;
+    }
+  } while (mboxSleep(mboxp, pattern PASS_REGS));
+  Yap_RecoverSlots(1, sl);
+  return false;
+}
+
+/* wait for messages and take up to max of them, or all if max is 0,
+   as a list */
+static bool
+mboxReceiveAll( mbox_t *mboxp, Term t, Int max USES_REGS )
+{
+  pthread_mutex_t *mutexp = &mboxp->mutex;
+  struct idb_queue *msgsp = &mboxp->msgs;
+  QueueEntry *x, *last;
+  yhandle_t tail;
+  Int n;
+
+  pthread_mutex_lock(mutexp);
+  if (!mboxp->open){
+    pthread_mutex_unlock(mutexp);
+    return false;
+  }
+  mboxp->nclients++;
+  mboxDrain(mboxp);
+  while (!msgsp->FirstInQueue) {
+    if (!mboxSleep(mboxp, false PASS_REGS))
+      return false;
+  }
+  x = last = msgsp->FirstInQueue;
+  for (n = 1; last->next && n != max; n++)
+    last = last->next;
+  if (!(msgsp->FirstInQueue = last->next))
+    msgsp->LastInQueue = NULL;
+  last->next = NULL;
+  mboxp->nclients--;
+  mboxTaken(mboxp, n);
+  pthread_mutex_unlock(mutexp);
+  // build the list outside the lock
+  tail = Yap_InitSlot(t);
+  while (x) {
+    QueueEntry *next = x->next;
+    Term msg, l;
+
+    if (!(msg = Yap_pop_tqueue_entry(x PASS_REGS))) {
+      while (next) {
+	x = next->next;
+	Yap_free_tqueue_entry(next PASS_REGS);
+	next = x;
       }
+      Yap_RecoverSlots(1, tail);
       return false;
-    } else {
-      pthread_cond_wait(condp, mutexp);
     }
-  } while (!rc);
-  return rc;
+    l = MkPairTerm(msg, MkVarTerm());
+    Yap_unify(Yap_GetFromSlot(tail), l);
+    Yap_PutInSlot(tail, TailOfTerm(l));
+    x = next;
+  }
+  Yap_unify(Yap_GetFromSlot(tail), TermNil);
+  Yap_RecoverSlots(1, tail);
+  return true;
 }
 
 static bool
@@ -232,7 +506,11 @@ mboxPeek( mbox_t *mboxp, Term t USES_REGS )
 {
   pthread_mutex_t *mutexp = &mboxp->mutex;
   struct idb_queue *msgsp = &mboxp->msgs;
-  bool rc = Yap_dequeue_tqueue(msgsp, t, false,  false PASS_REGS);
+  bool rc;
+
+  pthread_mutex_lock(mutexp);
+  mboxDrain(mboxp);
+  rc = Yap_dequeue_tqueue(msgsp, t, false,  false PASS_REGS);
   pthread_mutex_unlock(mutexp);
   return rc;
 }
@@ -1233,12 +1511,26 @@ typedef struct {
  {
    Term namet = Deref(ARG1);
    mbox_t* mboxp = GLOBAL_named_mboxes;
+   Term sizet = Deref(ARG2);
+   Int max_size = 0;
 
+   if (!IsVarTerm(sizet)) {
+     if (!IsIntegerTerm(sizet)) {
+       Yap_Error(TYPE_ERROR_INTEGER, sizet, "message_queue_create/2");
+       return FALSE;
+     }
+     max_size = IntegerOfTerm(sizet);
+   }
    if (IsVarTerm(namet)) {
        AtomEntry *ae;
        int new;
        mbox_t mbox;
 
+       // blobs are looked up by contents, make them different
+       memset(&mbox, 0, sizeof(mbox));
+       LOCK(GLOBAL_mboxq_lock);
+       mbox.name = MkIntegerTerm(GLOBAL_mbox_count++);
+       UNLOCK(GLOBAL_mboxq_lock);
        ae = Yap_lookupBlob(&mbox, sizeof(mbox), &PL_Message_Queue, &new);
        namet = MkAtomTerm(RepAtom(ae));
        mboxp = (mbox_t *)(ae->rep.blob[0].data);
@@ -1257,11 +1549,16 @@ typedef struct {
 	   UNLOCK(GLOBAL_mboxq_lock);
 	   return FALSE;
        }
+   } else {
+       return FALSE;
+   }
+   bool rc = mboxCreate( namet, mboxp PASS_REGS );
+   mboxp->max_size = max_size;
+   if (IsAtomTerm(namet) && !IsBlob(AtomOfTerm(namet))) {
        // global mbox, for now we'll just insert in list
        mboxp->next = GLOBAL_named_mboxes;
        GLOBAL_named_mboxes = mboxp;
    }
-   bool rc = mboxCreate( namet, mboxp PASS_REGS );
    UNLOCK(GLOBAL_mboxq_lock);
    return rc;
  }
@@ -1278,6 +1575,14 @@ p_mbox_destroy( USES_REGS1 )
   if (IsIntTerm(namet) ) {
     return FALSE;
   }
+  if (IsAtomTerm(namet) && IsBlob(AtomOfTerm(namet))) {
+    // anonymous queue, the blob keeps the mailbox
+    mboxp = (mbox_t *)(RepAtom(AtomOfTerm(namet))->rep.blob[0].data);
+    if (!mboxp->open)
+      return FALSE;
+    mboxDestroy(mboxp PASS_REGS);
+    return TRUE;
+  }
   LOCK(GLOBAL_mboxq_lock);
   prevp = NULL;
   while( mboxp && mboxp->name != namet) {
@@ -1294,8 +1599,9 @@ p_mbox_destroy( USES_REGS1 )
     prevp->next = mboxp->next;
   }
   UNLOCK(GLOBAL_mboxq_lock);
-  mboxDestroy(mboxp PASS_REGS);
-  Yap_FreeCodeSpace( (char *)mboxp );
+  // else the last thread waiting in the mailbox still uses it
+  if (mboxDestroy(mboxp PASS_REGS))
+    Yap_FreeCodeSpace( (char *)mboxp );
    return TRUE;
  }
 
@@ -1315,29 +1621,21 @@ p_mbox_destroy( USES_REGS1 )
 	   mboxp = mboxp->next;
        }
      }
-     if (!mboxp->open)
-       mboxp = NULL;
-     if (mboxp) {
-	 pthread_mutex_lock(& mboxp->mutex);
-     }
      UNLOCK(GLOBAL_mboxq_lock);
    } else if (IsIntTerm(t)) {
        int wid = IntOfTerm(t);
        if (REMOTE(wid) &&
 	   (REMOTE_ThreadHandle(wid).in_use || REMOTE_ThreadHandle(wid).zombie))
        {
-	 return &REMOTE_ThreadHandle(wid).mbox_handle;
+	 mboxp = &REMOTE_ThreadHandle(wid).mbox_handle;
        } else {
 	  return NULL;
        }
-       if (!mboxp->open)
-	 mboxp = NULL;
-       if (mboxp) {
-	   pthread_mutex_lock(& mboxp->mutex);
-       }
    } else {
        return NULL;
    }
+   if (mboxp && !mboxp->open)
+     mboxp = NULL;
    return mboxp;
  }
 
@@ -1353,6 +1651,17 @@ p_mbox_destroy( USES_REGS1 )
    return mboxSend(mboxp, Deref(ARG2) PASS_REGS);
  }
 
+ static Int
+ p_mbox_send_all( USES_REGS1 )
+ {
+   Term namet = Deref(ARG1);
+   mbox_t* mboxp = getMbox(namet) ;
+
+   if (!mboxp)
+     return FALSE;
+   return mboxSendAll(mboxp, Deref(ARG2) PASS_REGS);
+ }
+
  static Int
  p_mbox_size( USES_REGS1 )
  {
@@ -1364,6 +1673,17 @@ p_mbox_destroy( USES_REGS1 )
    return Yap_unify( ARG2, MkIntTerm(mboxp->nmsgs));
  }
 
+ static Int
+ p_mbox_max_size( USES_REGS1 )
+ {
+   Term namet = Deref(ARG1);
+   mbox_t* mboxp = getMbox(namet) ;
+
+   if (!mboxp || !mboxp->max_size)
+     return FALSE;
+   return Yap_unify( ARG2, MkIntTerm(mboxp->max_size));
+ }
+
 
  static Int
  p_mbox_receive( USES_REGS1 )
@@ -1376,6 +1696,17 @@ p_mbox_destroy( USES_REGS1 )
    return mboxReceive(mboxp, Deref(ARG2) PASS_REGS);
  }
 
+ static Int
+ p_mbox_receive_all( USES_REGS1 )
+ {
+   Term namet = Deref(ARG1);
+    mbox_t* mboxp = getMbox(namet) ;
+
+    if (!mboxp)
+       return FALSE;
+   return mboxReceiveAll(mboxp, Deref(ARG3), IntegerOfTerm(Deref(ARG2)) PASS_REGS);
+ }
+
 
  static Int
  p_mbox_peek( USES_REGS1 )
@@ -1388,6 +1719,308 @@ p_mbox_destroy( USES_REGS1 )
    return mboxPeek(mboxp, Deref(ARG2) PASS_REGS);
  }
 
+/*
+ * Task pools
+ *
+ * A pool has a deque of tasks per worker thread. A worker takes its
+ * own tasks at the bottom of its deque, newest first, and when it has
+ * none it steals the oldest task at the top of another deque. Tasks a
+ * worker submits go to its own deque, tasks from other threads go to
+ * the workers in turn. Idle workers sleep on work: they count
+ * themselves in nidle before the last look at pending, and submitters
+ * look at nidle after counting the task in pending, as mailboxes do.
+ */
+typedef struct task_deque {
+  pthread_mutex_t lock;
+  QueueEntry **ring;    // size is a power of two
+  UInt size;
+  UInt top, bottom;     // tasks are ring[top .. bottom-1]
+  int wid;              // the worker that owns the deque, or -1
+} task_deque_t;
+
+typedef struct task_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t work;  // idle workers wait here
+  volatile int pending; // tasks in the deques
+  volatile int nidle;
+  volatile UInt next;   // the next deque for a task from outside
+  volatile Int ids;     // the last task id
+  bool open;
+  int nworkers;
+  task_deque_t deques[1];
+} task_pool_t;
+
+#define TASK_DEQUE_SIZE 64
+
+static task_pool_t *
+getTaskPool(Term t)
+{
+  t = Deref(t);
+  if (IsVarTerm(t) || !IsIntegerTerm(t))
+    return NULL;
+  return (task_pool_t *)IntegerOfTerm(t);
+}
+
+static bool
+dequePush(task_deque_t *d, QueueEntry *x)
+{
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom - d->top == d->size) {
+    QueueEntry **ring;
+    UInt i;
+
+    ring = (QueueEntry **)Yap_AllocCodeSpace(2 * d->size * sizeof(QueueEntry *));
+    if (ring == NULL) {
+      pthread_mutex_unlock(&d->lock);
+      return false;
+    }
+    for (i = d->top; i != d->bottom; i++)
+      ring[i & (2 * d->size - 1)] = d->ring[i & (d->size - 1)];
+    Yap_FreeCodeSpace((char *)d->ring);
+    d->ring = ring;
+    d->size *= 2;
+  }
+  d->ring[d->bottom++ & (d->size - 1)] = x;
+  pthread_mutex_unlock(&d->lock);
+  return true;
+}
+
+/* the owner takes the newest task */
+static QueueEntry *
+dequePop(task_deque_t *d)
+{
+  QueueEntry *x = NULL;
+
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom != d->top)
+    x = d->ring[--d->bottom & (d->size - 1)];
+  pthread_mutex_unlock(&d->lock);
+  return x;
+}
+
+/* a thief takes the oldest task */
+static QueueEntry *
+dequeSteal(task_deque_t *d)
+{
+  QueueEntry *x = NULL;
+
+  if (d->bottom == d->top)
+    return NULL;
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom != d->top)
+    x = d->ring[d->top++ & (d->size - 1)];
+  pthread_mutex_unlock(&d->lock);
+  return x;
+}
+
+/* the deque of the current thread, or -1 if it is not a worker */
+static int
+taskPoolSelf(task_pool_t *pool USES_REGS)
+{
+  int i;
+
+  for (i = 0; i < pool->nworkers; i++)
+    if (pool->deques[i].wid == worker_id)
+      return i;
+  return -1;
+}
+
+static QueueEntry *
+taskPoolTake(task_pool_t *pool, int i)
+{
+  QueueEntry *x;
+  int k, n = pool->nworkers;
+
+  if ((x = dequePop(pool->deques+i)))
+    return x;
+  for (k = 1; k < n; k++) {
+    if ((x = dequeSteal(pool->deques+(i+k) % n)))
+      return x;
+  }
+  return NULL;
+}
+
+static void
+taskPoolFree(task_pool_t *pool USES_REGS)
+{
+  int i;
+
+  for (i = 0; i < pool->nworkers; i++) {
+    task_deque_t *d = pool->deques+i;
+
+    while (d->top != d->bottom)
+      Yap_free_tqueue_entry(d->ring[d->top++ & (d->size - 1)] PASS_REGS);
+    Yap_FreeCodeSpace((char *)d->ring);
+    pthread_mutex_destroy(&d->lock);
+  }
+  pthread_cond_destroy(&pool->work);
+  pthread_mutex_destroy(&pool->lock);
+  Yap_FreeCodeSpace((char *)pool);
+}
+
+/** '$task_pool_create'(+N, -Workers, -Pool): a pool for N workers, or
+    one per processor if N is 0 */
+static Int
+p_task_pool_create( USES_REGS1 )
+{
+  Int n = IntegerOfTerm(Deref(ARG1));
+  task_pool_t *pool;
+  int i;
+
+  if (n <= 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n <= 0)
+      n = 1;
+  }
+  pool = (task_pool_t *)Yap_AllocCodeSpace(sizeof(task_pool_t) +
+					   (n-1)*sizeof(task_deque_t));
+  if (pool == NULL) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "task_pool_create/2");
+    return FALSE;
+  }
+  memset(pool, 0, sizeof(task_pool_t) + (n-1)*sizeof(task_deque_t));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pool->nworkers = n;
+  for (i = 0; i < n; i++) {
+    task_deque_t *d = pool->deques+i;
+
+    pthread_mutex_init(&d->lock, NULL);
+    d->size = TASK_DEQUE_SIZE;
+    d->ring = (QueueEntry **)Yap_AllocCodeSpace(d->size * sizeof(QueueEntry *));
+    d->wid = -1;
+    if (d->ring == NULL) {
+      pool->nworkers = i+1;
+      taskPoolFree(pool PASS_REGS);
+      Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "task_pool_create/2");
+      return FALSE;
+    }
+  }
+  pool->open = true;
+  return Yap_unify(ARG2, MkIntegerTerm(n)) &&
+    Yap_unify(ARG3, MkIntegerTerm((Int)pool));
+}
+
+/** '$task_pool_worker'(+Pool, +I): the current thread owns deque I */
+static Int
+p_task_pool_worker( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+  Int i = IntegerOfTerm(Deref(ARG2));
+
+  if (!pool || i < 0 || i >= pool->nworkers)
+    return FALSE;
+  pool->deques[i].wid = worker_id;
+  return TRUE;
+}
+
+/** '$task_pool_self'(+Pool, -I): the current thread is worker I */
+static Int
+p_task_pool_self( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+  int i;
+
+  if (!pool || (i = taskPoolSelf(pool PASS_REGS)) < 0)
+    return FALSE;
+  return Yap_unify(ARG2, MkIntTerm(i));
+}
+
+/** '$task_pool_submit'(+Pool, -Id, +Task): bind Id to a new task id and
+    queue Task */
+static Int
+p_task_pool_submit( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+  QueueEntry *x;
+  int i;
+
+  if (!pool || !pool->open)
+    return FALSE;
+  if (!Yap_unify(ARG2, MkIntegerTerm(__sync_add_and_fetch(&pool->ids, 1))))
+    return FALSE;
+  if (!(x = Yap_new_tqueue_entry(Deref(ARG3) PASS_REGS)))
+    return FALSE;
+  if ((i = taskPoolSelf(pool PASS_REGS)) < 0)
+    i = __sync_fetch_and_add(&pool->next, 1) % pool->nworkers;
+  if (!dequePush(pool->deques+i, x)) {
+    Yap_free_tqueue_entry(x PASS_REGS);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "submit/3");
+    return FALSE;
+  }
+  __sync_fetch_and_add(&pool->pending, 1);
+  if (pool->nidle) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return TRUE;
+}
+
+/** '$task_pool_take'(+Pool, +I, -Task, +Block): worker I takes a task;
+    if Block is true it waits for one, and fails once the pool is closed
+    and empty */
+static Int
+p_task_pool_take( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+  Int i = IntegerOfTerm(Deref(ARG2));
+  bool block = Deref(ARG4) == TermTrue;
+  QueueEntry *x;
+  Term t;
+
+  if (!pool || i < 0 || i >= pool->nworkers)
+    return FALSE;
+  while (!(x = taskPoolTake(pool, i))) {
+    if (!block)
+      return FALSE;
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->open && pool->pending <= 0) {
+      pthread_mutex_unlock(&pool->lock);
+      return FALSE;
+    }
+    __sync_fetch_and_add(&pool->nidle, 1);
+    if (pool->open && pool->pending <= 0)
+      pthread_cond_wait(&pool->work, &pool->lock);
+    __sync_fetch_and_sub(&pool->nidle, 1);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  __sync_fetch_and_sub(&pool->pending, 1);
+  if (!(t = Yap_pop_tqueue_entry(x PASS_REGS)))
+    return FALSE;
+  return Yap_unify(ARG3, t);
+}
+
+/** '$task_pool_close'(+Pool): workers leave once the tasks are done */
+static Int
+p_task_pool_close( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+
+  if (!pool)
+    return FALSE;
+  pthread_mutex_lock(&pool->lock);
+  pool->open = false;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  return TRUE;
+}
+
+/** '$task_pool_destroy'(+Pool): release a closed pool, after joining
+    its workers */
+static Int
+p_task_pool_destroy( USES_REGS1 )
+{
+  task_pool_t *pool = getTaskPool(ARG1);
+
+  if (!pool || pool->open)
+    return FALSE;
+  taskPoolFree(pool PASS_REGS);
+  return TRUE;
+}
+
 static Int
 p_cond_create( USES_REGS1 )
 {
@@ -1662,12 +2295,22 @@ void Yap_InitThreadPreds(void)
   Yap_InitCPred("$cond_signal", 1, p_cond_signal, SafePredFlag);
   Yap_InitCPred("$cond_broadcast", 1, p_cond_broadcast, SafePredFlag);
   Yap_InitCPred("$cond_wait", 2, p_cond_wait, SafePredFlag);
-  Yap_InitCPred("$message_queue_create", 1, p_mbox_create, SafePredFlag);
+  Yap_InitCPred("$message_queue_create", 2, p_mbox_create, SafePredFlag);
   Yap_InitCPred("$message_queue_destroy", 1, p_mbox_destroy, SafePredFlag);
   Yap_InitCPred("$message_queue_send", 2, p_mbox_send, SafePredFlag);
+  Yap_InitCPred("$message_queue_send_all", 2, p_mbox_send_all, SafePredFlag);
   Yap_InitCPred("$message_queue_receive", 2, p_mbox_receive, SafePredFlag);
+  Yap_InitCPred("$message_queue_receive_all", 3, p_mbox_receive_all, SafePredFlag);
   Yap_InitCPred("$message_queue_size", 2, p_mbox_size, SafePredFlag);
+  Yap_InitCPred("$message_queue_max_size", 2, p_mbox_max_size, SafePredFlag);
   Yap_InitCPred("$message_queue_peek", 2, p_mbox_peek, SafePredFlag);
+  Yap_InitCPred("$task_pool_create", 3, p_task_pool_create, SafePredFlag);
+  Yap_InitCPred("$task_pool_worker", 2, p_task_pool_worker, SafePredFlag);
+  Yap_InitCPred("$task_pool_self", 2, p_task_pool_self, SafePredFlag);
+  Yap_InitCPred("$task_pool_submit", 3, p_task_pool_submit, SafePredFlag);
+  Yap_InitCPred("$task_pool_take", 4, p_task_pool_take, SafePredFlag);
+  Yap_InitCPred("$task_pool_close", 1, p_task_pool_close, SafePredFlag);
+  Yap_InitCPred("$task_pool_destroy", 1, p_task_pool_destroy, SafePredFlag);
   Yap_InitCPred("$thread_stacks", 4, p_thread_stacks, SafePredFlag);
   Yap_InitCPred("$signal_thread", 1, p_thread_signal, SafePredFlag);
   Yap_InitCPred("$nof_threads", 1, p_nof_threads, SafePredFlag);
@@ -224,7 +224,11 @@ Yap_udi_search(PredEntry *p)
 			return NULL;
 
 		parg = (UdiPArg) utarray_eltptr(info->args,0);
-		r = parg->control->search(parg->idxstr, parg->arg, si_callback, (void *) &c);
+		if (parg->control->search_batch)
+			r = parg->control->search_batch(parg->idxstr, parg->arg,
+			                                si_batch_callback, (void *) &c);
+		else
+			r = parg->control->search(parg->idxstr, parg->arg, si_callback, (void *) &c);
 		Yap_ClauseListClose(c.cl);
 
 		if (r == -1) {
@@ -73,7 +73,9 @@ handle_cp_overflow(int res, tr_fr_ptr TR0, UInt arity, Term t)
   XREGS[arity+1] = t;
   switch(res) {
   case -1:
-    if (!Yap_dogc(PASS_REGS1)) {
+    /* ask for twice the room we had, collecting alone may not free
+       enough for a large copy and we would loop forever */
+    if (!Yap_dogcl(2*(ASP-HR)*sizeof(CELL) PASS_REGS)) {
       Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
       return 0L;
     }
@@ -784,7 +786,8 @@ CELL *AtomAdjustSize(CELL *x, char *buf)
   return (CELL*)(buf+AdjustSizeAtom(offset));
 }
 
-/* export an atom from the symbol table to a buffer */
+/* export an atom from the symbol table to a buffer of len bytes,
+   leaves *hpp alone if it does not fit */
 static inline
 Atom export_atom(Atom at, char **hpp, char *buf, size_t len)
 {
@@ -795,10 +798,10 @@ Atom export_atom(Atom at, char **hpp, char *buf, size_t len)
   ptr = (char *)AtomAdjustSize((CELL*)ptr, buf);
 
   p0 = ptr;
-  *ptr++ = 0;
   sz = strlen(RepAtom(at)->StrOfAE);
-  if (sz + 1  >= len)
+  if (ptr + sz + 2 > buf + len)
     return (Atom)NULL;
+  *ptr++ = 0;
   strcpy(ptr, RepAtom(at)->StrOfAE);
   *hpp = ptr+(sz+1);
   return (Atom)(p0-buf);
@@ -810,12 +813,13 @@ Functor export_functor(Functor f, char **hpp, char *buf, size_t len)
 {
   CELL *hptr = AtomAdjustSize((CELL *)*hpp, buf);
   UInt arity = ArityOfFunctor(f);
-  if (2*sizeof(CELL) >= len)
+  char *hp = (char *)(hptr+1);
+  if (hp > buf + len)
     return NULL;
-  hptr[0] = arity;
-  *hpp = (char *)(hptr+1);
-  if (!export_atom(NameOfFunctor(f), hpp, buf, len))
+  if (!export_atom(NameOfFunctor(f), &hp, buf, len))
     return NULL;
+  hptr[0] = arity;
+  *hpp = hp;
   /* increment so that it cannot be mistaken with a functor on the stack,
      (increment is used as a tag ........01
   */
@@ -856,7 +860,6 @@ export_complex_term(Term tf, CELL *pt0, CELL *pt0_end, char * buf, size_t len0,
   tr_fr_ptr TR0 = TR;
   int ground = TRUE;
   char *bptr = buf+ 3*sizeof(CELL);
-  size_t len = len0;
 
   HB = HLow;
   tovisit0 = tovisit;
@@ -926,17 +929,8 @@ export_complex_term(Term tf, CELL *pt0, CELL *pt0_end, char * buf, size_t len0,
 	if (IsExtensionFunctor(f)) {
 	  UInt sz;
 
-	  /* make sure to export floats */
-	  if (f== FunctorDouble) {
-	    sz = sizeof(Float)/sizeof(CELL)+2;
-	  } else if (f== FunctorLongInt) {
-	    sz = 3;
-	  } else if (f== FunctorString) {
-	    sz = 3+ap2[1];
-	  } else {
-	    CELL *pt = ap2+1;
-	    sz = 2+sizeof(MP_INT)+(((MP_INT *)(pt+1))->_mp_alloc*sizeof(mp_limb_t));
-	  }
+	  /* make sure to export floats, bigints and strings, in cells */
+	  sz = SizeOfOpaqueTerm(ap2, (CELL)f);
 	  if (HR+sz > ASP - 2048) {
 	    goto overflow;
 	  }
@@ -979,16 +973,16 @@ export_complex_term(Term tf, CELL *pt0, CELL *pt0_end, char * buf, size_t len0,
 	if (HR > ASP - 2048) {
 	  goto overflow;
 	}
-	ptf[-1] = (CELL)export_functor(f, &bptr, buf, len);
-	len = len0 - (bptr-buf);
-	if (HR > ASP - 2048) {
-	  goto overflow;
+	if (!(ptf[-1] = (CELL)export_functor(f, &bptr, buf, len0))) {
+	  goto buffer_overflow;
 	}
       } else {
 	if (IsAtomTerm(d0)) {
-	  *ptf = MkAtomTerm(export_atom(AtomOfTerm(d0), &bptr, buf, len));
-	  ptf++;
-	  len = len0 - (bptr-buf);
+	  Atom at = export_atom(AtomOfTerm(d0), &bptr, buf, len0);
+	  if (!at) {
+	    goto buffer_overflow;
+	  }
+	  *ptf++ = MkAtomTerm(at);
 	} else {
 	  *ptf++ = d0;
 	}
@@ -1071,6 +1065,22 @@ export_complex_term(Term tf, CELL *pt0, CELL *pt0_end, char * buf, size_t len0,
   /* follow chain of multi-assigned variables */
   return -1;
 
+ buffer_overflow:
+  /* the caller tries again with a larger buffer */
+  HR = HLow;
+  HB = HB0;
+#ifdef RATIONAL_TREES
+  while (tovisit > tovisit0) {
+    tovisit --;
+    pt0 = tovisit->pt0;
+    pt0_end = tovisit->pt0_end;
+    ptf = tovisit->ptf;
+    *pt0 = tovisit->oldv;
+  }
+#endif
+  reset_trail(TR0);
+  return 0;
+
 trail_overflow:
   /* oops, we're in trouble */
   HR = HLow;
@@ -1128,8 +1138,10 @@ ExportTerm(Term inp, char * buf, size_t len, UInt arity, int newattvs USES_REGS)
     }
     if (IsAtomTerm(t)) {
       Atom at = AtomOfTerm(t);
-      char *b = buf+3*sizeof(CELL);
-      export_atom(at, &b, b, len-3*sizeof(CELL));
+      char *b = buf+3*sizeof(CELL), *b0 = b;
+      export_atom(at, &b, b0, len-3*sizeof(CELL));
+      if (b == b0)
+	return 0;
       return export_term_to_buffer(t, buf, b, &inp, &inp, len);
     }
     if ((Int)res < 0) {
@@ -1215,24 +1227,48 @@ import_arg(CELL *hp, char *abase, char *buf, CELL *amax)
 static CELL *
 import_compound(CELL *hp, char *abase, char *buf, CELL *amax)
 {
-  Functor f = (Functor)*hp;
-  UInt ar, i;
-
-  if (!((CELL)f & 1) && IsExtensionFunctor(f))
-    return amax;
-  ar = FetchFunctor(hp, buf);
-  for (i=1; i<=ar; i++) {
-    amax = import_arg(hp+i, abase, buf, amax);
+  /* follow the last argument in a loop, as for list tails */
+  for (;;) {
+    Functor f = (Functor)*hp;
+    UInt ar, i;
+    Term t;
+    CELL *newp;
+
+    if (!((CELL)f & 1) && IsExtensionFunctor(f))
+      return amax;
+    ar = FetchFunctor(hp, buf);
+    for (i=1; i<ar; i++) {
+      amax = import_arg(hp+i, abase, buf, amax);
+    }
+    t = hp[ar];
+    if (!IsApplTerm(t))
+      return import_arg(hp+ar, abase, buf, amax);
+    newp = ShiftPtr((CELL)RepAppl(t), abase);
+    hp[ar] = AbsAppl(newp);
+    if (newp <= amax)
+      return amax;
+    hp = amax = newp;
   }
-  return amax;
 }
 
 static CELL *
 import_pair(CELL *hp, char *abase, char *buf, CELL *amax)
 {
-  amax = import_arg(hp, abase, buf, amax);
-  amax = import_arg(hp+1, abase, buf, amax);
-  return amax;
+  /* follow the tail in a loop, long lists would exhaust the C stack */
+  for (;;) {
+    Term t;
+    CELL *newp;
+
+    amax = import_arg(hp, abase, buf, amax);
+    t = hp[1];
+    if (!IsPairTerm(t))
+      return import_arg(hp+1, abase, buf, amax);
+    newp = ShiftPtr((CELL)RepPair(t), abase);
+    hp[1] = AbsPair(newp);
+    if (newp <= amax)
+      return amax;
+    hp = amax = newp;
+  }
 }
 
 Term
@@ -1253,7 +1289,7 @@ Yap_ImportTerm(char * buf) {
   // call the gc/stack shifter mechanism
   // if not enough stack available
   while (HR + sz > ASP - 4096) {
-    if (!Yap_dogc(PASS_REGS1)) {
+    if (!Yap_dogcl((sz+4096)*sizeof(CELL) PASS_REGS)) {
       Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
       return 0L;
     }
@@ -1286,8 +1322,8 @@ p_export_term( USES_REGS1 )
     export_buf  = malloc(sz);
     if (!export_buf)
       return FALSE;
-    if (!(osz = Yap_ExportTerm(ARG1, export_buf, sz, 1))) {
-      sz += 4096;
+    if (!(osz = Yap_ExportTerm(ARG1, export_buf, sz, 3))) {
+      sz *= 2;
       free(export_buf);
     }
   } while (!osz);
@@ -2742,11 +2778,10 @@ MurmurHashNeutral2 ( const void * key, int len, unsigned int seed )
 }
 
 static CELL *
-addAtomToHash(CELL *st, Atom at)
+addCharsToHash(CELL *st, const char *c)
 {
   unsigned int len;
 
-    char *c = RepAtom(at)->StrOfAE;
     int ulen = strlen(c);
     /* fix hashing over empty atom */
     if (!ulen) {
@@ -2763,6 +2798,25 @@ addAtomToHash(CELL *st, Atom at)
   return st+len;
 }
 
+static CELL *
+addAtomToHash(CELL *st, Atom at)
+{
+  return addCharsToHash(st, RepAtom(at)->StrOfAE);
+}
+
+#ifdef USE_GMP
+/* hash a big integer by its sign and digits, not by where they are */
+static CELL *
+addBigIntToHash(CELL *st, MP_INT *b)
+{
+  size_t n = (b->_mp_size < 0 ? -b->_mp_size : b->_mp_size)*sizeof(mp_limb_t);
+
+  *st++ = b->_mp_size;
+  memcpy(st, b->_mp_d, n);
+  return st+(n+CellSize-1)/CellSize;
+}
+#endif
+
 typedef struct visited {
   CELL *start;
   CELL  *end;
@@ -2838,23 +2892,36 @@ hash_complex_term(register CELL *pt0,
 	    *st++ = LongIntOfTerm(d0);
 	    break;
 	  case (CELL)FunctorString:
-	    memcpy(st, RepAppl(d0), (3+RepAppl(d0)[1])*sizeof(CELL));
-	    st += 3+RepAppl(d0)[1];
+	    /* the text only: the cells after it are padding and the end
+	       marker holds the address of the string */
+	    if (st + (1024 + RepAppl(d0)[1]) >= ASP) {
+	      goto global_overflow;
+	    }
+	    *st++ = fc;
+	    st = addCharsToHash(st, StringOfTerm(d0));
 	    break;
 #ifdef USE_GMP
 	  case (CELL)FunctorBigInt:
 	    {
 	      CELL *pt = RepAppl(d0);
-	      Int sz =
-		sizeof(MP_INT)+1+
-		(((MP_INT *)(pt+2))->_mp_alloc*sizeof(mp_limb_t));
 
-	      if (st + (1024 + sz/CellSize) >= ASP) {
-		goto global_overflow;
+	      /* by value: the blob also keeps pointers to its digits. Other
+		 blobs are equal only to themselves, and they move, so they
+		 hash by their type. */
+	      *st++ = pt[1];
+	      if (pt[1] == BIG_INT || pt[1] == BIG_RATIONAL) {
+		if (st + (1024 + Yap_SizeOfBigInt(d0)) >= ASP) {
+		  goto global_overflow;
+		}
+		if (pt[1] == BIG_INT) {
+		  st = addBigIntToHash(st, Yap_BigIntOfTerm(d0));
+		} else {
+		  MP_RAT *r = Yap_BigRatOfTerm(d0);
+
+		  st = addBigIntToHash(st, mpq_numref(r));
+		  st = addBigIntToHash(st, mpq_denref(r));
+		}
 	      }
-	      /* then the actual number */
-	      memcpy((void *)(st+1), (void *)(pt+1), sz);
-	      st = st+sz/CellSize;
 	    }
 	    break;
 #endif
@@ -2932,29 +2999,33 @@ Yap_TermHash(Term t, Int size, Int depth, int variant)
 {
   CACHE_REGS
   unsigned int i1;
+  /* t need not be in ARG1: keep it where the garbage collector sees it */
+  yhandle_t yt = Yap_InitHandle(t);
   Term t1 = Deref(t);
 
   while (TRUE) {
     CELL *ar = hash_complex_term(&t1-1, &t1, depth, HR, FALSE PASS_REGS);
     if (ar == (CELL *)-1) {
       if (!Yap_ExpandPreAllocCodeSpace(0, NULL, TRUE)) {
-	Yap_ThrowError(RESOURCE_ERROR_AUXILIARY_STACK, ARG1, "overflow in term_hash");
+	Yap_ThrowError(RESOURCE_ERROR_AUXILIARY_STACK, t1, "overflow in term_hash");
 	return FALSE;
       }
-      t1 = Deref(ARG1);
+      t1 = Deref(Yap_GetFromHandle(yt));
     } else if(ar == (CELL *)-2) {
       if (!Yap_dogc(PASS_REGS1)) {
 	Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil, "in term_hash");
 	return FALSE;
       }
-      t1 = Deref(ARG1);
+      t1 = Deref(Yap_GetFromHandle(yt));
     } else if (ar == NULL) {
+      Yap_CloseHandles(yt);
       return FALSE;
     } else {
       i1 = MurmurHashNeutral2((const void *)HR, CellSize*(ar-HR),0x1a3be34a);
       break;
     }
   }
+  Yap_CloseHandles(yt);
   /* got the seed and hash from SWI-Prolog */
   return i1 % size;
 }
@@ -436,12 +436,13 @@ static void wrputref(void *ref, int Quote_illegal, struct write_globs *wglb) {
 static int wrputblob(AtomEntry *ref, int Quote_illegal,
                      struct write_globs *wglb) {
   wrf stream = wglb->stream;
-  int rc;
-  int Yap_write_blob(AtomEntry * ref, StreamDesc * stream);
+  char s[1024] = "";
+  char *Yap_blob_to_string(AtomEntry * ref, const char *s, size_t sz);
 
-  if ((rc = Yap_write_blob(ref, stream))) {
-    return rc;
-  }
+  /* blob writers print on a FILE *, so go through a buffer */
+  if (!Yap_blob_to_string(ref, s, sizeof(s)))
+    return 0;
+  wrputs(s, stream);
   lastw = alphanum;
   return 1;
 }
@@ -615,17 +615,34 @@ typedef struct idb_queue {
 void Yap_init_tqueue(db_queue *dbq);
 void Yap_destroy_tqueue(db_queue *dbq USES_REGS);
 bool Yap_enqueue_tqueue(db_queue *father_key, Term t USES_REGS);
+QueueEntry *Yap_new_tqueue_entry(Term t USES_REGS);
+void Yap_free_tqueue_entry(QueueEntry *x USES_REGS);
+Term Yap_pop_tqueue_entry(QueueEntry *x USES_REGS);
+void Yap_append_tqueue(db_queue *father_key, QueueEntry *first,
+                       QueueEntry *last);
 bool Yap_dequeue_tqueue(db_queue *father_key, Term t, bool first,
                         bool release USES_REGS);
 
 #ifdef THREADS
 
+/* Senders push messages on incoming without locking, receivers hold
+   the mutex, move incoming to msgs and scan msgs. A sender only takes
+   the mutex to wake up sleeping receivers, to wait for room in a
+   queue with a max_size, or to leave a closed mailbox. */
 typedef struct thread_mbox {
   Term name;
   pthread_mutex_t mutex;
-  pthread_cond_t cond;
+  pthread_cond_t cond;  // receivers wait here
+  pthread_cond_t room;  // senders to a full queue wait here
   struct idb_queue msgs;
-  int nmsgs, nclients; // if nclients < 0 mailbox has been closed.
+  QueueEntry *volatile incoming; // newest first
+  volatile int nmsgs;   // in msgs and incoming
+  int nclients;         // receivers in the mailbox
+  volatile int nsleepers; // receivers waiting on cond
+  int npatterns;        // sleepers that wait for a partial term
+  int nsenders;         // senders waiting on room
+  volatile int sending; // 2 per sender in the mailbox, +1 once closed
+  int max_size;         // 0 for unbounded
   bool open;
   struct thread_mbox *next;
 } mbox_t;
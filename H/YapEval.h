@@ -617,7 +617,8 @@ inline static Term add_int(Int i, Int j USES_REGS) {
     if (j > 0 && (Int)w < 0)
       goto overflow;
   } else {
-    if (j < 0 && (Int)w > 0)
+    /* Int_MIN + Int_MIN wraps to 0 */
+    if (j < 0 && (Int)w >= 0)
       goto overflow;
   }
   RINT((Int)w);
@@ -731,9 +731,16 @@ typedef struct DB_STRUCT {
   CELL Mask;                     /* parts that should be cleared         */
   CELL Key; /* A mask that can be used to check before
                you unify */
+  CELL HashKey;                  /* functor and first argument hash      */
+  struct DB_STRUCT *HashPrev, *HashNext; /* chain in the key's index    */
   DBTerm DBT;
 } DBStruct;
 
+/* a bucket in the index of a key, in the order of the entries */
+typedef struct db_hash_bucket {
+  struct DB_STRUCT *First, *Last;
+} DBHashBucket;
+
 #define DBStructFlagsToDBStruct(X)                                             \
   ((DBRef)((unsigned char *)(X) - (CELL) & (((DBRef)NULL)->Flags)))
 
@@ -795,6 +802,10 @@ typedef struct struct_dbentry {
   DBRef Last;      /* last DBase entry                     */
   Term ModuleOfDB; /* module for this definition           */
   DBRef F0, L0;    /* everyone                          */
+  UInt NOfEntries; /* live entries                          */
+  UInt NOfUnindexed; /* live entries the index cannot hold  */
+  DBHashBucket *Index; /* hash on functor and first argument    */
+  UInt IndexSize;  /* number of buckets, a power of two     */
 } DBEntry;
 typedef DBEntry *DBProp;
 #define DBProperty ((PropFlags)0x8000)
@@ -858,7 +869,8 @@ typedef enum {
   DBComplex = 0x8,
   DBCode = 0x10,
   DBNoCode = 0x20,
-  DBWithRefs = 0x40
+  DBWithRefs = 0x40,
+  DBNoIndex = 0x80
 } db_term_flags;
 
 typedef struct {
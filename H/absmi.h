@@ -1271,6 +1271,13 @@ goto notrailleft;				\
 goto notrailleft;				\
   }
 
+/* a C call keeps the Y variables of the calling clause below YREG */
+#define call_check_trail(x, sz)                                                \
+  if (__builtin_expect((Unsigned(CurrentTrailTop) < Unsigned(x)), 0)) {        \
+    SET_ASP(YREG, sz);                                                         \
+    goto notrailleft;                                                          \
+  }
+
 #endif /* YAP_DBG_PREDS */
 
 #define check_trail_in_indexing(x)                                             \
@@ -1329,6 +1336,19 @@ goto notrailleft;				\
 #endif /* YAPOR_SBA && YAPOR */
 #endif /* YAP_DBG_PREDS */
 
+/* deterministic code that binds older variables may never create a
+   choice point or deallocate an environment: calls must check the
+   trail too, the interrupt handler will grow it. */
+#ifdef OS_HANDLES_TR_OVERFLOW
+#define check_stack_and_trail(Label, GLOB) check_stack(Label, GLOB)
+#else
+#define check_stack_and_trail(Label, GLOB)                                     \
+  if (__builtin_expect((Unsigned(CurrentTrailTop) < Unsigned(TR)), 0)) {       \
+    goto Label;                                                                \
+  }                                                                            \
+  check_stack(Label, GLOB)
+#endif
+
 /***************************************************************
  * Macros for choice point manipulation                         *
  ***************************************************************/
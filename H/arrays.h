@@ -34,7 +34,10 @@ typedef union {
   Int *ints;
   char *chars;
   unsigned char *uchars;
+  int16_t *int16s;
+  int32_t *int32s;
   Float *floats;
+  float *floats32;
   AtomEntry **ptrs;
   Term *atoms;
   Term *dbrefs;
@@ -53,7 +56,10 @@ typedef enum static_array_type
   array_of_atoms,
   array_of_dbrefs,
   array_of_nb_terms,
-  array_of_terms
+  array_of_terms,
+  array_of_int16s,
+  array_of_int32s,
+  array_of_floats32
 } static_array_types;
 
 /* This should never be followed by GC */
@@ -68,7 +74,8 @@ typedef enum {
   STATIC_ARRAY = 1,
   DYNAMIC_ARRAY = 2,
   MMAP_ARRAY = 4,
-  FIXED_ARRAY = 8
+  FIXED_ARRAY = 8,
+  READ_ONLY_ARRAY = 16
 } array_type;
 
 
@@ -102,6 +102,7 @@ RepAttVar(Term *var_ptr) {
 }
 
 extern void AddToQueue(attvar_record *attv USES_REGS);
+extern void Yap_CloseWokenBatch(USES_REGS1);
 
 #define TermVoidAtt TermFoundVar
 
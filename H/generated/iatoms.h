@@ -47,6 +47,7 @@
   AtomAtt = Yap_FullLookupAtom("$att"); TermAtt = MkAtomTerm(AtomAtt);
   AtomAtt1 = Yap_LookupAtom("att"); TermAtt1 = MkAtomTerm(AtomAtt1);
   AtomAttDo = Yap_LookupAtom("unify_attributed_variable"); TermAttDo = MkAtomTerm(AtomAttDo);
+  AtomAttDoAll = Yap_LookupAtom("unify_attributed_variables"); TermAttDoAll = MkAtomTerm(AtomAttDoAll);
   AtomAttributes = Yap_LookupAtom("attributes"); TermAttributes = MkAtomTerm(AtomAttributes);
   AtomB = Yap_FullLookupAtom("$last_choice_pt"); TermB = MkAtomTerm(AtomB);
   AtomBatched = Yap_LookupAtom("batched"); TermBatched = MkAtomTerm(AtomBatched);
@@ -273,6 +274,9 @@
   AtomNan = Yap_LookupAtom("nan"); TermNan = MkAtomTerm(AtomNan);
   AtomNb = Yap_LookupAtom("nb"); TermNb = MkAtomTerm(AtomNb);
   AtomNbTerm = Yap_LookupAtom("nb_term"); TermNbTerm = MkAtomTerm(AtomNbTerm);
+  AtomNbHash = Yap_FullLookupAtom("$nb_hash"); TermNbHash = MkAtomTerm(AtomNbHash);
+  AtomNbHashSlots = Yap_FullLookupAtom("$nb_hash_slots"); TermNbHashSlots = MkAtomTerm(AtomNbHashSlots);
+  AtomNbSharedHash = Yap_FullLookupAtom("$nb_shared_hash"); TermNbSharedHash = MkAtomTerm(AtomNbSharedHash);
   AtomNew = Yap_LookupAtom("new"); TermNew = MkAtomTerm(AtomNew);
   AtomNewLine = Yap_LookupAtom("nl"); TermNewLine = MkAtomTerm(AtomNewLine);
   AtomNl = Yap_LookupAtom("nl"); TermNl = MkAtomTerm(AtomNl);
@@ -670,6 +674,7 @@
   FunctorAtSymbol = Yap_MkFunctor(AtomAtSymbol,2);
   FunctorAtt1 = Yap_MkFunctor(AtomAtt1,3);
   FunctorAttGoal = Yap_MkFunctor(AtomAttDo,2);
+  FunctorAttGoals = Yap_MkFunctor(AtomAttDoAll,1);
   FunctorAttVar = Yap_MkFunctor(AtomAttVar,4);
   FunctorBin = Yap_MkFunctor(AtomBin,1);
   FunctorBrackets = Yap_MkFunctor(AtomBrackets,1);
@@ -778,6 +783,8 @@
   FunctorMutex = Yap_MkFunctor(AtomMutex,2);
   FunctorNotImplemented = Yap_MkFunctor(AtomNotImplemented,2);
   FunctorNBQueue = Yap_MkFunctor(AtomQueue,4);
+  FunctorNBHash = Yap_MkFunctor(AtomNbHash,4);
+  FunctorNBSharedHash = Yap_MkFunctor(AtomNbSharedHash,1);
   FunctorNl = Yap_MkFunctor(AtomNl,1);
   FunctorNot = Yap_MkFunctor(AtomNot,1);
   FunctorNumberVars = Yap_MkFunctor(AtomNumberVars,1);
@@ -802,7 +809,7 @@
   FunctorRange1 = Yap_MkFunctor(AtomRange,1);
   FunctorRange2 = Yap_MkFunctor(AtomRange,2);
   FunctorRange3 = Yap_MkFunctor(AtomRange,3);
-  FunctorRecordedWithKey = Yap_MkFunctor(AtomRecordedWithKey,6);
+  FunctorRecordedWithKey = Yap_MkFunctor(AtomRecordedWithKey,3);
   FunctorRDiv = Yap_MkFunctor(AtomRDiv,2);
   FunctorRedoFreeze = Yap_MkFunctor(AtomRedoFreeze,3);
   FunctorRepresentationError = Yap_MkFunctor(AtomRepresentationError,1);
@@ -47,6 +47,7 @@
   AtomAtt = AtomAdjust(AtomAtt); TermAtt = MkAtomTerm(AtomAtt);
   AtomAtt1 = AtomAdjust(AtomAtt1); TermAtt1 = MkAtomTerm(AtomAtt1);
   AtomAttDo = AtomAdjust(AtomAttDo); TermAttDo = MkAtomTerm(AtomAttDo);
+  AtomAttDoAll = AtomAdjust(AtomAttDoAll); TermAttDoAll = MkAtomTerm(AtomAttDoAll);
   AtomAttributes = AtomAdjust(AtomAttributes); TermAttributes = MkAtomTerm(AtomAttributes);
   AtomB = AtomAdjust(AtomB); TermB = MkAtomTerm(AtomB);
   AtomBatched = AtomAdjust(AtomBatched); TermBatched = MkAtomTerm(AtomBatched);
@@ -273,6 +274,9 @@
   AtomNan = AtomAdjust(AtomNan); TermNan = MkAtomTerm(AtomNan);
   AtomNb = AtomAdjust(AtomNb); TermNb = MkAtomTerm(AtomNb);
   AtomNbTerm = AtomAdjust(AtomNbTerm); TermNbTerm = MkAtomTerm(AtomNbTerm);
+  AtomNbHash = AtomAdjust(AtomNbHash); TermNbHash = MkAtomTerm(AtomNbHash);
+  AtomNbHashSlots = AtomAdjust(AtomNbHashSlots); TermNbHashSlots = MkAtomTerm(AtomNbHashSlots);
+  AtomNbSharedHash = AtomAdjust(AtomNbSharedHash); TermNbSharedHash = MkAtomTerm(AtomNbSharedHash);
   AtomNew = AtomAdjust(AtomNew); TermNew = MkAtomTerm(AtomNew);
   AtomNewLine = AtomAdjust(AtomNewLine); TermNewLine = MkAtomTerm(AtomNewLine);
   AtomNl = AtomAdjust(AtomNl); TermNl = MkAtomTerm(AtomNl);
@@ -670,6 +674,7 @@
   FunctorAtSymbol = FuncAdjust(FunctorAtSymbol);
   FunctorAtt1 = FuncAdjust(FunctorAtt1);
   FunctorAttGoal = FuncAdjust(FunctorAttGoal);
+  FunctorAttGoals = FuncAdjust(FunctorAttGoals);
   FunctorAttVar = FuncAdjust(FunctorAttVar);
   FunctorBin = FuncAdjust(FunctorBin);
   FunctorBrackets = FuncAdjust(FunctorBrackets);
@@ -778,6 +783,8 @@
   FunctorMutex = FuncAdjust(FunctorMutex);
   FunctorNotImplemented = FuncAdjust(FunctorNotImplemented);
   FunctorNBQueue = FuncAdjust(FunctorNBQueue);
+  FunctorNBHash = FuncAdjust(FunctorNBHash);
+  FunctorNBSharedHash = FuncAdjust(FunctorNBSharedHash);
   FunctorNl = FuncAdjust(FunctorNl);
   FunctorNot = FuncAdjust(FunctorNot);
   FunctorNumberVars = FuncAdjust(FunctorNumberVars);
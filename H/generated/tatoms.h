@@ -47,6 +47,7 @@ X_API EXTERNAL Atom AtomAtSymbol; X_API EXTERNAL Term TermAtSymbol;
 X_API EXTERNAL Atom AtomAtt; X_API EXTERNAL Term TermAtt;
 X_API EXTERNAL Atom AtomAtt1; X_API EXTERNAL Term TermAtt1;
 X_API EXTERNAL Atom AtomAttDo; X_API EXTERNAL Term TermAttDo;
+X_API EXTERNAL Atom AtomAttDoAll; X_API EXTERNAL Term TermAttDoAll;
 X_API EXTERNAL Atom AtomAttributes; X_API EXTERNAL Term TermAttributes;
 X_API EXTERNAL Atom AtomB; X_API EXTERNAL Term TermB;
 X_API EXTERNAL Atom AtomBatched; X_API EXTERNAL Term TermBatched;
@@ -273,6 +274,9 @@ X_API EXTERNAL Atom AtomMyddasVersionName; X_API EXTERNAL Term TermMyddasVersion
 X_API EXTERNAL Atom AtomNan; X_API EXTERNAL Term TermNan;
 X_API EXTERNAL Atom AtomNb; X_API EXTERNAL Term TermNb;
 X_API EXTERNAL Atom AtomNbTerm; X_API EXTERNAL Term TermNbTerm;
+X_API EXTERNAL Atom AtomNbHash; X_API EXTERNAL Term TermNbHash;
+X_API EXTERNAL Atom AtomNbHashSlots; X_API EXTERNAL Term TermNbHashSlots;
+X_API EXTERNAL Atom AtomNbSharedHash; X_API EXTERNAL Term TermNbSharedHash;
 X_API EXTERNAL Atom AtomNew; X_API EXTERNAL Term TermNew;
 X_API EXTERNAL Atom AtomNewLine; X_API EXTERNAL Term TermNewLine;
 X_API EXTERNAL Atom AtomNl; X_API EXTERNAL Term TermNl;
@@ -688,6 +692,8 @@ X_API EXTERNAL  Functor FunctorAtt1;
 
 X_API EXTERNAL  Functor FunctorAttGoal;
 
+X_API EXTERNAL  Functor FunctorAttGoals;
+
 X_API EXTERNAL  Functor FunctorAttVar;
 
 X_API EXTERNAL  Functor FunctorBin;
@@ -904,6 +910,10 @@ X_API EXTERNAL  Functor FunctorNotImplemented;
 
 X_API EXTERNAL  Functor FunctorNBQueue;
 
+X_API EXTERNAL  Functor FunctorNBHash;
+
+X_API EXTERNAL  Functor FunctorNBSharedHash;
+
 X_API EXTERNAL  Functor FunctorNl;
 
 X_API EXTERNAL  Functor FunctorNot;
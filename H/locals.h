@@ -113,6 +113,8 @@ LOCAL_INIT(Int, StartLinePos, 0L);
 LOCAL_INITF(scratch_block, ScratchPad, InitScratchPad(wid));
 LOCAL_INIT_RESTORE(Term, WokenGoals, 0L, TermToGlobalAdjust);
 LOCAL_INIT(bool, DoNotWakeUp, false);
+LOCAL_INIT(UInt, WokenAttVars, 0);
+LOCAL_INIT(UInt, WakeUpBatches, 0);
 LOCAL_INIT_RESTORE(Term, AttsMutableList, 0L, TermToGlobalAdjust);
 
 // gc_stuff
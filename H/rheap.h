@@ -1029,6 +1029,9 @@ static void RestoreDB(DBEntry *pp USES_REGS) {
     pp->F0 = DBRefAdjust(pp->F0, TRUE);
   if (pp->L0 != NULL)
     pp->L0 = DBRefAdjust(pp->L0, TRUE);
+  /* the index is built again when it is next needed */
+  pp->Index = NULL;
+  pp->IndexSize = 0;
   /* immediate update semantics */
   dbr = pp->F0;
   /* While we have something in the data base, even if erased, restore it */
@@ -1109,6 +1112,9 @@ static void restore_static_array(StaticArrayEntry *ae USES_REGS) {
   case array_of_doubles:
   case array_of_chars:
   case array_of_uchars:
+  case array_of_int16s:
+  case array_of_int32s:
+  case array_of_floats32:
     return;
   case array_of_ptrs: {
     AtomEntry **base = (AtomEntry **)AddrAdjust((ADDR)(ae->ValueOfVE.ptrs));
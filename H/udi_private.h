@@ -30,9 +30,9 @@ typedef struct udi_info *UdiInfo;
 
 /* to ease code for a UdiInfo hash table*/
 #define HASH_FIND_UdiInfo(head,find,out)             \
-  HASH_FIND(hh,head,find,sizeof(PredEntry),out)
+  HASH_FIND(hh,head,&(find),sizeof(PredEntry *),out)
 #define HASH_ADD_UdiInfo(head,p,add)                 \
-  HASH_ADD_KEYPTR(hh,head,p,sizeof(PredEntry *),add)
+  HASH_ADD(hh,head,p,sizeof(PredEntry *),add)
 
 /* used during init */
 static YAP_Int p_new_udi( USES_REGS1 );
@@ -59,3 +59,15 @@ static inline int si_callback(void *key, void *data, void *arg)
   return Yap_ClauseListExtend(c->cl, *cl, c->pred);
 }
 
+static inline int si_batch_callback(void **data, size_t n, void *arg)
+{
+  si_callback_h_t c = (si_callback_h_t) arg;
+  yamop **cls = (yamop **) utarray_front(c->clauselist);
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (!Yap_ClauseListExtend(c->cl, cls[((YAP_Int) data[i]) - 1], c->pred))
+      return FALSE;
+  return TRUE;
+}
+
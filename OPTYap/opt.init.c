@@ -144,6 +144,7 @@ void Yap_init_global_optyap_data(int max_table_size, int n_workers,
     GLOBAL_parallel_mode = PARALLEL_MODE_OFF;
   else
     GLOBAL_parallel_mode = PARALLEL_MODE_ON;
+  GLOBAL_scheduler_mode = SCHEDULER_MODE_BITMAP;
 #endif /* YAPOR */
 
 #ifdef TABLING
@@ -214,6 +215,7 @@ void Yap_init_local_optyap_data(int wid) {
   REMOTE_top_or_fr(wid) = GLOBAL_root_or_fr;
   REMOTE_load(wid) = 0;
   REMOTE_share_request(wid) = MAX_WORKERS;
+  REMOTE_steal_seed(wid) = 2654435761u * (unsigned int)(wid + 1);
   REMOTE_reply_signal(wid) = worker_ready;
 #ifdef YAPOR_COPY
   INIT_LOCK(REMOTE_lock_signals(wid));
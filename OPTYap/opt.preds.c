@@ -31,6 +31,8 @@
 #ifdef TABLING
 #include "tab.macros.h"
 #endif /* TABLING */
+#include "clause.h"
+#include "heapgc.h"
 #include "iopreds.h"
 
 #ifdef TABLING
@@ -44,6 +46,7 @@ static Int p_abolish_table(USES_REGS1);
 static Int p_abolish_all_tables(USES_REGS1);
 static Int p_show_tabled_predicates(USES_REGS1);
 static Int p_show_table(USES_REGS1);
+static Int p_table_answers(USES_REGS1);
 static Int p_show_all_tables(USES_REGS1);
 static Int p_show_global_trie(USES_REGS1);
 static Int p_show_statistics_table(USES_REGS1);
@@ -54,6 +57,7 @@ static Int p_show_statistics_global_trie(USES_REGS1);
 static Int p_yapor_workers(USES_REGS1);
 #ifdef YAPOR
 static Int p_parallel_mode(USES_REGS1);
+static Int p_yapor_scheduler(USES_REGS1);
 static Int p_yapor_start(USES_REGS1);
 static Int p_worker(USES_REGS1);
 static Int p_parallel_new_answer(USES_REGS1);
@@ -248,6 +252,8 @@ void Yap_init_optyap_preds(void) {
   Yap_InitCPred("show_tabled_predicates", 1, p_show_tabled_predicates,
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("$c_show_table", 3, p_show_table, SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("$c_table_answers", 3, p_table_answers,
+                SafePredFlag | SyncPredFlag);
   Yap_InitCPred("show_all_tables", 1, p_show_all_tables,
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("show_global_trie", 1, p_show_global_trie,
@@ -262,6 +268,8 @@ void Yap_init_optyap_preds(void) {
 #ifdef YAPOR
   Yap_InitCPred("parallel_mode", 1, p_parallel_mode,
                 SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("yapor_scheduler", 1, p_yapor_scheduler,
+                SafePredFlag | SyncPredFlag);
   Yap_InitCPred("$c_yapor_start", 0, p_yapor_start,
                 SafePredFlag | SyncPredFlag);
   Yap_InitCPred("$c_worker", 0, p_worker, SafePredFlag | SyncPredFlag);
@@ -595,6 +603,46 @@ static Int p_show_table(USES_REGS1) {
   return (TRUE);
 }
 
+static Int p_table_answers(USES_REGS1) {
+  Term mod, t, list;
+  tab_ent_ptr tab_ent;
+  sg_fr_ptr sg_fr;
+  CELL subs_vars[MAX_TABLE_VARS];
+  int subs_arity, status;
+
+  do {
+    mod = Deref(ARG1);
+    t = Deref(ARG2);
+    if (IsAtomTerm(t))
+      tab_ent = RepPredProp(PredPropByAtom(AtomOfTerm(t), mod))->TableOfPred;
+    else if (IsApplTerm(t))
+      tab_ent = RepPredProp(PredPropByFunc(FunctorOfTerm(t), mod))->TableOfPred;
+    else
+      return (FALSE);
+    if (tab_ent == NULL)
+      return (FALSE);
+    sg_fr = subgoal_lookup(tab_ent, t, subs_vars, &subs_arity);
+    /* only completed subgoals have a stable answer trie */
+    if (sg_fr == NULL || SgFr_state(sg_fr) < complete)
+      return (FALSE);
+    list = load_answers_list(sg_fr, t, subs_vars, subs_arity, &status);
+    if (status == LOAD_ANSWERS_UNSUPPORTED)
+      return (FALSE);
+    if (status == LOAD_ANSWERS_OVERFLOW) {
+      /* ask for twice the room we had and try again */
+      gc_entry_info_t info;
+      CreepFlag = EventFlag = StackGap(PASS_REGS1) + 2 * (ASP - HR);
+      Yap_track_cpred(0, P, 0, &info);
+      if (!Yap_gc(&info)) {
+        Yap_ThrowError(RESOURCE_ERROR_STACK, TermNil,
+                       "stack overflow: gc failed");
+        return (FALSE);
+      }
+    }
+  } while (status != LOAD_ANSWERS_OK);
+  return Yap_unify(list, ARG3);
+}
+
 static Int p_show_all_tables(USES_REGS1) {
   tab_ent_ptr tab_ent;
   Term t = Deref(ARG1);
@@ -763,6 +811,33 @@ static Int p_parallel_mode(USES_REGS1) {
   return (FALSE);
 }
 
+static Int p_yapor_scheduler(USES_REGS1) {
+  Term t;
+  t = Deref(ARG1);
+  if (IsVarTerm(t)) {
+    Term ta;
+    if (GLOBAL_scheduler_mode == SCHEDULER_MODE_STEALING)
+      ta = MkAtomTerm(Yap_LookupAtom("stealing"));
+    else /* SCHEDULER_MODE_BITMAP */
+      ta = MkAtomTerm(Yap_LookupAtom("bitmap"));
+    YapBind((CELL *)t, ta);
+    return (TRUE);
+  }
+  if (IsAtomTerm(t) && GLOBAL_parallel_mode != PARALLEL_MODE_RUNNING) {
+    char *s;
+    s = RepAtom(AtomOfTerm(t))->StrOfAE;
+    if (strcmp(s, "bitmap") == 0) {
+      GLOBAL_scheduler_mode = SCHEDULER_MODE_BITMAP;
+      return (TRUE);
+    }
+    if (strcmp(s, "stealing") == 0) {
+      GLOBAL_scheduler_mode = SCHEDULER_MODE_STEALING;
+      return (TRUE);
+    }
+  }
+  return (FALSE);
+}
+
 static Int p_yapor_start(USES_REGS1) {
 #ifdef TIMESTAMP_CHECK
   GLOBAL_timestamp = 0;
@@ -45,6 +45,8 @@ ans_node_ptr answer_search(sg_fr_ptr, CELL *);
 ans_node_ptr mode_directed_answer_search(sg_fr_ptr, CELL *);
 #endif /* MODE_DIRECTED_TABLING */
 void load_answer(ans_node_ptr, CELL *);
+sg_fr_ptr subgoal_lookup(tab_ent_ptr, Term, CELL *, int *);
+Term load_answers_list(sg_fr_ptr, Term, CELL *, int, int *);
 CELL *exec_substitution(gt_node_ptr, CELL *);
 void update_answer_trie(sg_fr_ptr);
 void free_subgoal_trie(sg_node_ptr, int, int);
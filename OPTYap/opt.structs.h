@@ -316,6 +316,7 @@ struct global_optyap_data {
   struct global_optyap_locks locks;
   volatile unsigned int branch[MAX_WORKERS][MAX_BRANCH_DEPTH];
   volatile char parallel_mode;  /* PARALLEL_MODE_OFF / PARALLEL_MODE_ON / PARALLEL_MODE_RUNNING */
+  char scheduler_mode;          /* SCHEDULER_MODE_BITMAP / SCHEDULER_MODE_STEALING */
 #endif /* YAPOR */
 
 #ifdef TABLING
@@ -396,6 +397,7 @@ struct global_optyap_data {
 #define GLOBAL_locks_alloc_block                (GLOBAL_optyap_data.locks.alloc_block)
 #define GLOBAL_branch(worker, depth)            (GLOBAL_optyap_data.branch[worker][depth])
 #define GLOBAL_parallel_mode                    (GLOBAL_optyap_data.parallel_mode)
+#define GLOBAL_scheduler_mode                   (GLOBAL_optyap_data.scheduler_mode)
 #define GLOBAL_root_gt                          (GLOBAL_optyap_data.root_global_trie)
 #define GLOBAL_root_tab_ent                     (GLOBAL_optyap_data.root_table_entry)
 #define GLOBAL_max_pages                        (GLOBAL_optyap_data.max_pages)
@@ -437,6 +439,7 @@ struct local_optyap_data {
   choiceptr prune_request;
 #endif /* YAPOR_THREADS */
   volatile int share_request;
+  unsigned int steal_seed;
   struct local_optyap_signals share_signals;
   volatile struct {
     CELL start;
@@ -504,6 +507,7 @@ struct local_optyap_data {
 #define Set_LOCAL_prune_request(cpt)       (LOCAL_optyap_data.prune_request = cpt)
 #endif /* YAPOR_THREADS */
 #define LOCAL_share_request                (LOCAL_optyap_data.share_request)
+#define LOCAL_steal_seed                   (LOCAL_optyap_data.steal_seed)
 #define LOCAL_reply_signal                 (LOCAL_optyap_data.share_signals.reply_signal)
 #define LOCAL_p_fase_signal                (LOCAL_optyap_data.share_signals.P_fase)
 #define LOCAL_q_fase_signal                (LOCAL_optyap_data.share_signals.Q_fase)
@@ -563,6 +567,7 @@ struct local_optyap_data {
 #define Set_REMOTE_prune_request(wid,cp)       (REMOTE(wid)->optyap_data.prune_request = cp)
 #endif /* YAPOR_THREADS */
 #define REMOTE_share_request(wid)              (REMOTE(wid)->optyap_data.share_request)
+#define REMOTE_steal_seed(wid)                 (REMOTE(wid)->optyap_data.steal_seed)
 #define REMOTE_reply_signal(wid)               (REMOTE(wid)->optyap_data.share_signals.reply_signal)
 #define REMOTE_p_fase_signal(wid)              (REMOTE(wid)->optyap_data.share_signals.P_fase)
 #define REMOTE_q_fase_signal(wid)              (REMOTE(wid)->optyap_data.share_signals.Q_fase)
@@ -107,6 +107,15 @@ static inline qg_sol_fr_ptr CUT_prune_solution_frames(qg_sol_fr_ptr, int);
 
 
 
+/* ------------------------------- **
+**      Scheduler Mode Macros      **
+** ------------------------------- */
+
+#define SCHEDULER_MODE_BITMAP   0
+#define SCHEDULER_MODE_STEALING 1
+
+
+
 /* ----------------------- **
 **      Engine Macros      **
 ** ----------------------- */
@@ -33,7 +33,9 @@
 ** ------------------------------------- */
 
 static int move_up_one_node(or_fr_ptr nearest_livenode);
+static bitmap busy_workers_below(void);
 static int get_work_below(void);
+static int steal_work_below(void);
 static int get_work_above(void);
 static int find_a_better_position(void);
 static int search_for_hidden_shared_work(bitmap stable_busy);
@@ -221,7 +223,7 @@ int get_work(void) {
            must finish as there is no available computation. */
         return FALSE;
     }
-    if (get_work_below()) {
+    if (GLOBAL_scheduler_mode == SCHEDULER_MODE_STEALING ? steal_work_below() : get_work_below()) {
       PUT_BUSY(worker_id);
       return TRUE;
     }
@@ -508,13 +510,13 @@ int move_up_one_node(or_fr_ptr nearest_livenode) {
 
 
 static
-int get_work_below(void){
+bitmap busy_workers_below(void){
+  /* busy workers below the current node that are not already being
+  ** served by an idle worker sitting younger than us */
   CACHE_REGS
-  int i, worker_p, big_load;
+  int i;
   bitmap busy_below, idle_below;
 
-  worker_p = -1;
-  big_load = GLOBAL_delayed_release_load ;
   BITMAP_difference(busy_below, OrFr_members(LOCAL_top_or_fr), GLOBAL_bm_idle_workers);
   BITMAP_difference(idle_below, OrFr_members(LOCAL_top_or_fr), busy_below);
   BITMAP_delete(idle_below, worker_id);
@@ -522,6 +524,18 @@ int get_work_below(void){
     if (BITMAP_member(idle_below ,i) && YOUNGER_CP(REMOTE_top_cp(i), Get_LOCAL_top_cp()))
       BITMAP_minus(busy_below, OrFr_members(REMOTE_top_or_fr(i)));
   }
+  return busy_below;
+}
+
+
+static
+int get_work_below(void){
+  int i, worker_p, big_load;
+  bitmap busy_below;
+
+  worker_p = -1;
+  big_load = GLOBAL_delayed_release_load ;
+  busy_below = busy_workers_below();
   if (BITMAP_empty(busy_below))
     return FALSE;
   /* choose the worker with highest load */
@@ -537,6 +551,36 @@ int get_work_below(void){
 }
 
 
+static
+int steal_work_below(void){
+  /* like get_work_below(), but the victim is a random busy worker with
+  ** enough load instead of the most loaded one, so that idle workers
+  ** spread their requests rather than all queueing on the same worker;
+  ** the work itself is still shared node by node by q_share_work() */
+  CACHE_REGS
+  int i, n, start;
+  unsigned int seed;
+  bitmap busy_below;
+
+  busy_below = busy_workers_below();
+  if (BITMAP_empty(busy_below))
+    return FALSE;
+  /* xorshift32 */
+  seed = LOCAL_steal_seed;
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  LOCAL_steal_seed = seed;
+  start = seed % GLOBAL_number_workers;
+  for (n = 0; n < GLOBAL_number_workers; n++) {
+    i = (start + n) % GLOBAL_number_workers;
+    if (BITMAP_member(busy_below ,i) && REMOTE_load(i) > GLOBAL_delayed_release_load)
+      return (q_share_work(i));
+  }
+  return FALSE;
+}
+
+
 static
 int get_work_above(void){
   CACHE_REGS
@@ -127,6 +127,10 @@ typedef enum {
   TRAVERSE_MODE_LONGINT =      6,
   TRAVERSE_MODE_LONGINT_END =  7
 } traverse_mode_t;
+/* load_answers_list() status */
+#define LOAD_ANSWERS_OK            0
+#define LOAD_ANSWERS_OVERFLOW      1
+#define LOAD_ANSWERS_UNSUPPORTED   2
 /* do not change order !!! */
 #define TRAVERSE_TYPE_SUBGOAL      0
 #define TRAVERSE_TYPE_ANSWER       1
@@ -1419,6 +1419,357 @@ void load_answer(ans_node_ptr current_ans_node, CELL *subs_ptr) {
 #undef subs_arity
 }
 
+sg_fr_ptr subgoal_lookup(tab_ent_ptr tab_ent, Term goal, CELL *subs_vars,
+                         int *subs_arity_ptr) {
+  CACHE_REGS
+  sg_node_ptr current_node;
+  int i, j, pred_arity, subs_arity = 0;
+
+  /* only plain variant lookups: no mode-directed or global trie tables and
+  ** no compound arguments, as those would need the full subgoal_search_loop */
+#ifdef MODE_DIRECTED_TABLING
+  if (TabEnt_mode_directed(tab_ent))
+    return NULL;
+#endif /* MODE_DIRECTED_TABLING */
+  if (IsMode_GlobalTrie(TabEnt_mode(tab_ent)))
+    return NULL;
+  current_node = get_subgoal_trie(tab_ent);
+  if (current_node == NULL)
+    return NULL;
+  pred_arity = IsApplTerm(goal) ? ArityOfFunctor(FunctorOfTerm(goal)) : 0;
+  for (i = 1; i <= pred_arity; i++) {
+    sg_node_ptr child_node;
+    Term t = Deref(ArgOfTerm(i, goal));
+
+    if (IsVarTerm(t)) {
+      for (j = 0; j < subs_arity; j++)
+        if (subs_vars[j] == t)
+          break;
+      if (j == subs_arity) {
+        if (subs_arity == MAX_TABLE_VARS)
+          return NULL;
+        subs_vars[subs_arity++] = t;
+      }
+      t = MakeTableVarTerm(j);
+    } else if (!IsAtomOrIntTerm(t))
+      return NULL;
+    child_node = TrNode_child(current_node);
+    if (child_node == NULL)
+      return NULL;
+    if (IS_SUBGOAL_TRIE_HASH(child_node)) {
+      sg_hash_ptr hash = (sg_hash_ptr)child_node;
+      child_node = Hash_buckets(hash)[HASH_ENTRY(t, Hash_num_buckets(hash))];
+    }
+    while (child_node && TrNode_entry(child_node) != t)
+      child_node = TrNode_next(child_node);
+    if (child_node == NULL)
+      return NULL;
+    current_node = child_node;
+  }
+  if (!IS_SUBGOAL_LEAF_NODE(current_node))
+    return NULL;
+  *subs_arity_ptr = subs_arity;
+  return get_subgoal_frame(current_node);
+}
+
+/* parser frames used by load_answers_list() to rebuild the answer terms
+** top-down, in the same order the tokens were inserted by answer_search() */
+#define LOAD_FRAME_ARGS 0 /* count more terms go to consecutive slots */
+#define LOAD_FRAME_LIST 1 /* compact list elements go to fresh pairs */
+#define LOAD_FRAME_LAST 2 /* last element of a compact list */
+#define LOAD_FRAME_TAIL 3 /* tail of a compact list */
+#define LOAD_FRAME_BLOB 4 /* count raw cells of a number before its end mark */
+
+typedef struct load_frame {
+  int kind;
+  int count;
+  CELL *slot;
+  Functor f;
+  CELL raw[sizeof(Float) / sizeof(CELL) + 1];
+} load_frame;
+
+static inline CELL *load_frame_slot(load_frame *frames, int *top_ptr USES_REGS) {
+  load_frame *fr = frames + *top_ptr;
+  CELL *slot;
+
+  switch (fr->kind) {
+  case LOAD_FRAME_ARGS:
+    slot = fr->slot++;
+    if (--fr->count == 0)
+      (*top_ptr)--;
+    return slot;
+  case LOAD_FRAME_LIST:
+    slot = HR;
+    HR += 2;
+    *fr->slot = AbsPair(slot);
+    fr->slot = slot + 1;
+    return slot;
+  case LOAD_FRAME_LAST:
+    slot = HR;
+    HR += 2;
+    *fr->slot = AbsPair(slot);
+    slot[1] = TermNil;
+    (*top_ptr)--;
+    return slot;
+  default: /* LOAD_FRAME_TAIL */
+    (*top_ptr)--;
+    return fr->slot;
+  }
+}
+
+Term load_answers_list(sg_fr_ptr sg_fr, Term goal, CELL *subs_vars,
+                       int subs_arity, int *status_ptr) {
+  CACHE_REGS
+  ans_node_ptr ans_node, root_node = SgFr_answer_trie(sg_fr);
+  ans_node_ptr *path = NULL, *prev_path = NULL;
+  int path_size = 0, prev_depth = 0;
+  load_frame *frames = NULL;
+  int frames_size = 0;
+  Term subs_terms[MAX_TABLE_VARS], vars[MAX_TABLE_VARS];
+  int end_depth[MAX_TABLE_VARS];
+  char ground[MAX_TABLE_VARS];
+  int arg_subs[MAX_TABLE_VARS + 1];
+  int i, goal_arity = 0, vars_used = 0;
+  Functor goal_f = NULL;
+  Term list = TermNil, *tailp = &list;
+  CELL *hr0 = HR;
+
+  *status_ptr = LOAD_ANSWERS_OK;
+  ans_node = SgFr_first_answer(sg_fr);
+  if (ans_node == NULL)
+    return TermNil;
+  if (IsApplTerm(goal)) {
+    goal_f = FunctorOfTerm(goal);
+    goal_arity = ArityOfFunctor(goal_f);
+    for (i = 1; i <= goal_arity; i++) {
+      Term t = Deref(ArgOfTerm(i, goal));
+      arg_subs[i] = -1;
+      if (IsVarTerm(t)) {
+        int j;
+        for (j = 0; j < subs_arity; j++)
+          if (subs_vars[j] == t)
+            arg_subs[i] = j;
+      }
+    }
+  }
+  if (ans_node == root_node) {
+    /* yes answer */
+    if (HR + 2 > ASP - 1024) {
+      *status_ptr = LOAD_ANSWERS_OVERFLOW;
+      return 0;
+    }
+    HR[0] = goal;
+    HR[1] = TermNil;
+    HR += 2;
+    return AbsPair(HR - 2);
+  }
+  memset(ground, 0, sizeof(ground));
+  memset(vars, 0, sizeof(vars));
+  frames_size = 64;
+  frames = (load_frame *)malloc(sizeof(load_frame) * frames_size);
+
+  do {
+    ans_node_ptr node;
+    int depth = 0, lcp = 0, k = 0, d;
+
+    /* collect the root-to-leaf path of the answer */
+    for (node = ans_node; node != root_node;
+         node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(node)))
+      depth++;
+    if (depth > path_size) {
+      path_size = 2 * depth;
+      path = (ans_node_ptr *)realloc(path, sizeof(ans_node_ptr) * path_size);
+      prev_path =
+          (ans_node_ptr *)realloc(prev_path, sizeof(ans_node_ptr) * path_size);
+    }
+    for (node = ans_node, d = depth; node != root_node;
+         node = (ans_node_ptr)UNTAG_ANSWER_NODE(TrNode_parent(node)))
+      path[--d] = node;
+    /* reuse the ground substitution terms fully built for the previous
+    ** answer that are still on the common prefix of both trie paths */
+    while (lcp < depth && lcp < prev_depth && path[lcp] == prev_path[lcp])
+      lcp++;
+    while (k < subs_arity && ground[k] && end_depth[k] < lcp)
+      k++;
+    d = k ? end_depth[k - 1] + 1 : 0;
+
+    if (k < subs_arity) {
+      int top = 0;
+      /* an answer may have more variables than the subgoal has
+      ** substitution terms: clear every index the last answer used */
+      for (i = 0; i < vars_used; i++)
+        vars[i] = 0;
+      vars_used = 0;
+      frames[0].kind = LOAD_FRAME_ARGS;
+      frames[0].count = 1;
+      frames[0].slot = subs_terms + k;
+      ground[k] = TRUE;
+      for (; d < depth; d++) {
+        Term t = TrNode_entry(path[d]);
+        load_frame *fr;
+
+        if (top + 2 >= frames_size) {
+          frames_size *= 2;
+          frames =
+              (load_frame *)realloc(frames, sizeof(load_frame) * frames_size);
+        }
+        if (top < 0) {
+          /* more tokens than substitution terms */
+          *status_ptr = LOAD_ANSWERS_UNSUPPORTED;
+          goto done;
+        }
+        if (HR + 1024 > ASP) {
+          *status_ptr = LOAD_ANSWERS_OVERFLOW;
+          goto done;
+        }
+        fr = frames + top;
+        if (fr->kind == LOAD_FRAME_BLOB) {
+          if (fr->count) {
+            fr->raw[--fr->count] = t;
+          } else {
+            /* closing mark of a number */
+            if (fr->f == FunctorDouble) {
+              union {
+                Term t_dbl[sizeof(Float) / sizeof(Term)];
+                Float dbl;
+              } u;
+              u.t_dbl[0] = fr->raw[0];
+#if SIZEOF_DOUBLE == 2 * SIZEOF_INT_P
+              u.t_dbl[1] = fr->raw[1];
+#endif /* SIZEOF_DOUBLE x SIZEOF_INT_P */
+              *fr->slot = MkFloatTerm(u.dbl);
+            } else if (fr->f == FunctorLongInt) {
+              *fr->slot = MkLongIntTerm((Int)fr->raw[0]);
+            } else { /* FunctorBigInt || FunctorString */
+              *fr->slot = AbsAppl((CELL *)fr->raw[0]);
+            }
+            top--;
+          }
+        } else if (IsVarTerm(t)) {
+          int var_index;
+          CELL *slot;
+          if (t > VarIndexOfTableTerm(MAX_TABLE_VARS)) {
+            /* global trie references and rational terms */
+            *status_ptr = LOAD_ANSWERS_UNSUPPORTED;
+            goto done;
+          }
+          var_index = VarIndexOfTableTerm(t);
+          slot = load_frame_slot(frames, &top PASS_REGS);
+          if (var_index >= vars_used)
+            vars_used = var_index + 1;
+          if (vars[var_index] == 0)
+            vars[var_index] = MkVarTerm();
+          *slot = vars[var_index];
+          ground[k] = FALSE;
+        } else if (IsAtomOrIntTerm(t)) {
+          *load_frame_slot(frames, &top PASS_REGS) = t;
+        } else if (IsPairTerm(t)) {
+#ifdef TRIE_COMPACT_PAIRS
+          if (t == CompactPairInit) {
+            CELL *slot = load_frame_slot(frames, &top PASS_REGS);
+            fr = frames + ++top;
+            fr->kind = LOAD_FRAME_LIST;
+            fr->slot = slot;
+          } else if (fr->kind == LOAD_FRAME_LIST) {
+            fr->kind =
+                (t == CompactPairEndList ? LOAD_FRAME_LAST : LOAD_FRAME_TAIL);
+          } else {
+            *status_ptr = LOAD_ANSWERS_UNSUPPORTED;
+            goto done;
+          }
+#else
+          CELL *slot = load_frame_slot(frames, &top PASS_REGS);
+          *slot = AbsPair(HR);
+          fr = frames + ++top;
+          fr->kind = LOAD_FRAME_ARGS;
+          fr->count = 2;
+          fr->slot = HR;
+          HR += 2;
+#endif /* TRIE_COMPACT_PAIRS */
+        } else if (IsApplTerm(t)) {
+          Functor f = (Functor)RepAppl(t);
+          CELL *slot = load_frame_slot(frames, &top PASS_REGS);
+          fr = frames + ++top;
+          if (f == FunctorDouble || f == FunctorLongInt ||
+              f == FunctorBigInt || f == FunctorString) {
+            fr->kind = LOAD_FRAME_BLOB;
+            fr->f = f;
+            fr->slot = slot;
+            fr->count =
+                (f == FunctorDouble ? sizeof(Float) / sizeof(CELL) : 1);
+          } else {
+            int arity = ArityOfFunctor(f);
+            if (HR + arity + 1 > ASP - 1024) {
+              *status_ptr = LOAD_ANSWERS_OVERFLOW;
+              goto done;
+            }
+            *slot = AbsAppl(HR);
+            HR[0] = (CELL)f;
+            fr->kind = LOAD_FRAME_ARGS;
+            fr->count = arity;
+            fr->slot = HR + 1;
+            HR += arity + 1;
+          }
+        }
+        if (top < 0) {
+          /* substitution term k is complete */
+          end_depth[k++] = d;
+          if (k < subs_arity) {
+            top = 0;
+            frames[0].kind = LOAD_FRAME_ARGS;
+            frames[0].count = 1;
+            frames[0].slot = subs_terms + k;
+            ground[k] = TRUE;
+          }
+        }
+      }
+      if (k != subs_arity) {
+        *status_ptr = LOAD_ANSWERS_UNSUPPORTED;
+        goto done;
+      }
+    }
+
+    /* answer instance and list cell */
+    if (HR + goal_arity + 3 > ASP - 1024) {
+      *status_ptr = LOAD_ANSWERS_OVERFLOW;
+      goto done;
+    }
+    if (goal_f) {
+      HR[0] = (CELL)goal_f;
+      for (i = 1; i <= goal_arity; i++)
+        HR[i] = (arg_subs[i] < 0 ? Deref(ArgOfTerm(i, goal))
+                                 : subs_terms[arg_subs[i]]);
+      *tailp = AbsPair(HR + goal_arity + 1);
+      HR[goal_arity + 1] = AbsAppl(HR);
+      tailp = HR + goal_arity + 2;
+      HR += goal_arity + 3;
+    } else {
+      *tailp = AbsPair(HR);
+      HR[0] = goal;
+      tailp = HR + 1;
+      HR += 2;
+    }
+    {
+      ans_node_ptr *aux_path = prev_path;
+      prev_path = path;
+      path = aux_path;
+      prev_depth = depth;
+    }
+    ans_node = TrNode_child(ans_node);
+  } while (ans_node);
+  *tailp = TermNil;
+
+done:
+  free(frames);
+  free(path);
+  free(prev_path);
+  if (*status_ptr != LOAD_ANSWERS_OK) {
+    HR = hr0;
+    return 0;
+  }
+  return list;
+}
+
 CELL *exec_substitution(gt_node_ptr current_node, CELL *aux_stack) {
   CACHE_REGS
 #define subs_arity *subs_ptr
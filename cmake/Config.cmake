@@ -74,6 +74,7 @@ check_include_file(stropts.h HAVE_STROPTS_H)
 check_include_file(syslog.h HAVE_SYSLOG_H)
 check_include_file(sys/conf.h HAVE_SYS_CONF_H)
 check_include_file(sys/dir.h HAVE_SYS_DIR_H)
+check_include_file(sys/epoll.h HAVE_SYS_EPOLL_H)
 check_include_file(sys/file.h HAVE_SYS_FILE_H)
 check_include_file(sys/mman.h HAVE_SYS_MMAN_H)
 check_include_file(sys/ndir.h HAVE_SYS_NDIR_H)
@@ -299,6 +300,7 @@ check_function_exists(memmove HAVE_MEMCPY)
 check_function_exists(memmove HAVE_MEMMOVE)
 check_function_exists(mkstemp HAVE_MKSTEMP)
 check_function_exists(mktemp HAVE_MKTEMP)
+check_function_exists(mmap HAVE_MMAP)
 check_function_exists(nanosleep HAVE_NANOSLEEP)
 check_function_exists(mktime HAVE_MKTIME)
 check_function_exists(mtrace HAVE_MTRACE)
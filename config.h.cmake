@@ -1437,6 +1437,11 @@ signal. */
 #cmakedefine HAVE_SYS_DIR_H ${HAVE_SYS_DIR_H}
 #endif
 
+/* Define to 1 if you have the <sys/epoll.h> header file. */
+#ifndef HAVE_SYS_EPOLL_H
+#cmakedefine HAVE_SYS_EPOLL_H ${HAVE_SYS_EPOLL_H}
+#endif
+
 /* Define to 1 if you have the <sys/file.h> header file. */
 #ifndef HAVE_SYS_FILE_H
 #cmakedefine HAVE_SYS_FILE_H ${HAVE_SYS_FILE_H}
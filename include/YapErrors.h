@@ -128,6 +128,7 @@ E2(PERMISSION_ERROR_INPUT_PAST_END_OF_STREAM, PERMISSION_ERROR, "input",
    "past_end_of_stream")
 E2(PERMISSION_ERROR_INPUT_STREAM, PERMISSION_ERROR, "input", "stream")
 E2(PERMISSION_ERROR_INPUT_TEXT_STREAM, PERMISSION_ERROR, "input", "text_stream")
+E2(PERMISSION_ERROR_MODIFY_ARRAY, PERMISSION_ERROR, "modify", "array")
 E2(PERMISSION_ERROR_MODIFY_STATIC_PROCEDURE, PERMISSION_ERROR, "modify",
    "static_procedure")
 E2(PERMISSION_ERROR_MODULE_REDEFINED, PERMISSION_ERROR, "redefined", "module")
@@ -145,6 +146,7 @@ E(PERMISSION_ERROR_USER_DEFINED, PERMISSION_ERROR, "user_defined")
 E(
   REPRESENTATION_ERROR_CHARACTER, REPRESENTATION_ERROR, "character")
 E(REPRESENTATION_ERROR_CHARACTER_CODE, REPRESENTATION_ERROR, "character_code")
+E(REPRESENTATION_ERROR_FLOAT, REPRESENTATION_ERROR, "float")
 E(REPRESENTATION_ERROR_IN_CHARACTER_CODE, REPRESENTATION_ERROR,
   "in_character_code")
 E(REPRESENTATION_ERROR_INT, REPRESENTATION_ERROR, "int")
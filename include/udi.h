@@ -64,6 +64,26 @@ typedef int (* Yap_UdiSearch)
 		 Yap_UdiCallback f, /* callback on each found value */
 		 void *args);       /* auxiliary data to callback */
 
+/* Callback for n values found together in a search, e.g. a run of
+ * consecutive entries in an index page
+ * if it returns FALSE the search should be immediately aborted
+ */
+typedef int (* Yap_UdiBatchCallback)
+		(void **data,    /* data of each value */
+		 size_t n,       /* number of values */
+		 void *arg);     /* auxiliary data to callback */
+
+/* Optional, called upon search instead of Yap_UdiSearch
+ *
+ * Same return values as Yap_UdiSearch, but found values are passed in
+ * batches. An indexer that sets it may leave search NULL.
+ */
+typedef int (* Yap_UdiSearchBatch)
+		(void * control,         /* indexing structure opaque handle */
+		 int arg,                /* argument regarding this call */
+		 Yap_UdiBatchCallback f, /* callback on each batch found */
+		 void *args);            /* auxiliary data to callback */
+
 /* Called upon abolish of the term
  * to allow for a clean destroy of the indexing structures
  */
@@ -77,8 +97,9 @@ typedef struct udi_control_block {
   YAP_Atom       decl; //atom that triggers this indexing structure
   Yap_UdiInit    init;
   Yap_UdiInsert  insert;
-  Yap_UdiSearch  search;
+  Yap_UdiSearch  search; //may be NULL if search_batch is set
   Yap_UdiDestroy destroy;
+  Yap_UdiSearchBatch search_batch; //may be NULL
 } * UdiControlBlock;
 
 /* Register a new indexing structure */
@@ -216,4 +216,45 @@ string2term(char *const ptr,const size_t *size) {
   }
   return t;
 }                                                                                   
+/*********************************************************************************************
+ * Conversion: Prolog Term->binary buffer and back
+ *********************************************************************************************/
+/*
+ * Exports t into *bufp, growing the buffer until the term fits.
+ * Variables, sharing and atom names are kept, and the receiver only
+ * has to relocate the cells, so this is much cheaper than writing
+ * and parsing text.
+ */
+size_t
+term2buffer(const YAP_Term t, char **bufp, size_t *sizep) {
+  size_t len;
+  YAP_handle_t slot;
+
+  if (*bufp == NULL || *sizep < BLOCK_SIZE) {
+    char *nbuf = realloc(*bufp, BLOCK_SIZE);
+    if (nbuf == NULL)
+      return 0;
+    *bufp = nbuf;
+    *sizep = BLOCK_SIZE;
+  }
+  // exporting may garbage collect or shift the stacks, so every try
+  // reads the term back from a slot
+  slot = YAP_InitSlot(t);
+  while ((len = YAP_ExportTerm(YAP_GetFromSlot(slot), *bufp, *sizep)) == 0) {
+    char *nbuf = realloc(*bufp, 2 * *sizep);
+    if (nbuf == NULL)
+      break;
+    *bufp = nbuf;
+    *sizep *= 2;
+  }
+  YAP_RecoverSlots(1, slot);
+  return len;
+}
+/*
+ * Builds a term from a buffer filled by term2buffer, on any process.
+ */
+YAP_Term
+buffer2term(char *const buf) {
+  return YAP_ImportTerm(buf);
+}
 #endif /* HAVE_MPI_H */
@@ -48,6 +48,17 @@ char* term2string(const YAP_Term t);
  * representation of the term is copied to there.
  */
 YAP_Term string2term(char *const ptr,const size_t *size);
+/*
+ * Converts a term into the binary format of YAP_ExportTerm, written
+ * straight into *bufp, a malloc'ed buffer of *sizep bytes that is
+ * grown as needed (or allocated if *bufp is NULL).
+ * Returns the number of bytes used, or 0 if there is no memory.
+ */
+size_t term2buffer(const YAP_Term t, char **bufp, size_t *sizep);
+/*
+ * Builds the term exported to buf by term2buffer.
+ */
+YAP_Term buffer2term(char *const buf);
 /*
  * Read a prolog term from a stream
  * (the prolog term must have been writen by the write_term_to_stream)
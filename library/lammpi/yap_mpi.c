@@ -22,6 +22,7 @@ Comments: YAP interface to LAM/MPI
 */
 #include "YapConfig.h"
 #include <stdio.h>
+#include <limits.h>
 #if HAVE_STRING_H
 #include <string.h>
 #endif
@@ -77,6 +78,61 @@ extern int GLOBAL_argc;
 static hashtable requests=NULL;
 static hashtable broadcasts=NULL;
 
+/*
+ * Terms are sent in binary, as exported by term2buffer. Blocking
+ * operations export to and import from these buffers, which are kept
+ * between calls, so a message is written once, straight into the
+ * memory MPI sends from, and read straight from where MPI received it.
+ */
+struct term_buffer {
+  char *ptr;
+  size_t size;
+};
+static struct term_buffer send_buffers[1024], recv_buffers[1024];
+
+#if THREADS
+#define send_buffer (send_buffers[YAP_ThreadSelf()])
+#define recv_buffer (recv_buffers[YAP_ThreadSelf()])
+#else
+#define send_buffer (send_buffers[0])
+#define recv_buffer (recv_buffers[0])
+#endif
+
+// size of the buffers of non-blocking receives
+static size_t irecv_buffer_size=BLOCK_SIZE;
+
+/*
+ * Returns a receive buffer with room for at least size bytes
+ */
+static char*
+get_recv_buffer(size_t size) {
+  if (recv_buffer.size < size) {
+    char *nbuf=realloc(recv_buffer.ptr, size);
+    if (nbuf==NULL)
+      return NULL;
+    recv_buffer.ptr=nbuf;
+    recv_buffer.size=size;
+  }
+  return recv_buffer.ptr;
+}
+
+/*
+ * Returns the size of the term received by a non-blocking receive, or 0
+ * if the message did not fit in its buffer and was truncated
+ */
+static size_t
+irecv_size(char *buf, MPI_Status *status) {
+  int count;
+
+  if (MPI_Get_count(status, MPI_BYTE, &count)!=MPI_SUCCESS ||
+      count < 3*(int)sizeof(YAP_Term) ||
+      YAP_SizeOfExportedTerm(buf) > (size_t)count) {
+    YAP_Error(0,0,"mpi: message larger than the receive buffer, see mpi_default_buffer_size/2.\n");
+    return 0;
+  }
+  return count;
+}
+
 X_API void init_mpi(void);
 
 /********************************************************************
@@ -382,31 +438,38 @@ mpi_isend(void) {
     t4 = YAP_Deref(YAP_ARG4);
   char *str=NULL;
   int dest,tag;
-  size_t len=0;
+  size_t len=0,size=0;
   MPI_Request *handle=(MPI_Request*)malloc(sizeof(MPI_Request));
 
   CONT_TIMER();
   if ( handle==NULL ) return  false;
 
   if (YAP_IsVarTerm(t1) || !YAP_IsIntTerm(t2) || !YAP_IsIntTerm(t3) || !YAP_IsVarTerm(t4)) {
+    free(handle);
     PAUSE_TIMER();
     return false;
   }
   //
   dest = YAP_IntOfTerm(t2);
   tag  = YAP_IntOfTerm(t3);
-  // 
-  str=term2string(t2);
-  len=strlen(str)+1;
+  // the buffer is owned by the request until it completes
+  if ((len=term2buffer(t1,&str,&size))==0) {
+    free(str);
+    free(handle);
+    PAUSE_TIMER();
+    return false;
+  }
   MSG_SENT(len);
   // send the data 
-  if( MPI_CALL(MPI_Isend( str, len, MPI_CHAR, dest, tag, MPI_COMM_WORLD ,handle)) != MPI_SUCCESS ) {
+  if( MPI_CALL(MPI_Isend( str, len, MPI_BYTE, dest, tag, MPI_COMM_WORLD ,handle)) != MPI_SUCCESS ) {
+    free(str);
+    free(handle);
     PAUSE_TIMER();
     return false;
   }
 
 #ifdef MPI_DEBUG
-  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%s,%u, MPI_CHAR,%d,%d)\n",__FUNCTION__,str,len,dest,tag);
+  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%u, MPI_BYTE,%d,%d)\n",__FUNCTION__,len,dest,tag);
 #endif
   USED_BUFFER(); //  informs the prologterm2c module that the buffer is now used and should not be messed
   // We must associate the string to each handle
@@ -425,7 +488,6 @@ mpi_send(void) {
   YAP_Term t1 = YAP_Deref(YAP_ARG1), 
     t2 = YAP_Deref(YAP_ARG2), 
     t3 = YAP_Deref(YAP_ARG3);
-  char *str=NULL;
   int dest,tag;
   size_t len;
   int val;
@@ -437,14 +499,17 @@ mpi_send(void) {
   //
   dest = YAP_IntOfTerm(t2);
   tag  = YAP_IntOfTerm(t3);
-  // the data is packaged as a string
-  str=term2string(t1);
-  len=strlen(str)+1;
+  // the data is exported straight into the send buffer
+  if ((len=term2buffer(t1,&send_buffer.ptr,&send_buffer.size))==0) {
+    PAUSE_TIMER();
+    return false;
+  }
+  MSG_SENT(len);
 #if  defined(MPI_DEBUG)
-  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%s,%u, MPI_CHAR,%d,%d)\n",__FUNCTION__,str,len,dest,tag);
+  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%u, MPI_BYTE,%d,%d)\n",__FUNCTION__,len,dest,tag);
 #endif
   // send the data 
-  val=(MPI_CALL(MPI_Send( str, len, MPI_CHAR, dest, tag, MPI_COMM_WORLD))==MPI_SUCCESS?true:false);
+  val=(MPI_CALL(MPI_Send( send_buffer.ptr, len, MPI_BYTE, dest, tag, MPI_COMM_WORLD))==MPI_SUCCESS?true:false);
   
   PAUSE_TIMER();
   return(val);
@@ -461,7 +526,6 @@ mpi_recv(void) {
     t4;
   int tag, orig;
   MPI_Status status;
-  char *tmp;
   
   //The third argument (data) must be unbound
   if(!YAP_IsVarTerm(t3)) {
@@ -487,20 +551,16 @@ mpi_recv(void) {
     return false;
   }
   int count;
-  if( MPI_CALL(MPI_Get_count( &status, MPI_CHAR, &count )) != MPI_SUCCESS || 
+  if( MPI_CALL(MPI_Get_count( &status, MPI_BYTE, &count )) != MPI_SUCCESS || 
       status.MPI_TAG==MPI_UNDEFINED || 
       status.MPI_SOURCE==MPI_UNDEFINED) { 
     PAUSE_TIMER();
     return false;
   }
-  //realloc memory buffer
-  char *buf;
-  if (count>BLOCK_SIZE) {
-    buf = malloc(count);
-    tmp = buf;
-  } else {
-    buf = buffer.ptr;
-    tmp = NULL;
+  char *buf = get_recv_buffer(count);
+  if (buf == NULL) {
+    PAUSE_TIMER();
+    return false;
   }
   // Already know the source from MPI_Probe()
   if( orig == MPI_ANY_SOURCE ) {
@@ -518,26 +578,22 @@ mpi_recv(void) {
       return false; 
     }
   }
-  // Receive the message as a string
-  if( MPI_CALL(MPI_Recv( buf, count, MPI_CHAR,  orig, tag,
+  // Receive the exported term
+  if( MPI_CALL(MPI_Recv( buf, count, MPI_BYTE,  orig, tag,
 			 MPI_COMM_WORLD, &status )) != MPI_SUCCESS ) {
     /* Getting in here should never happen; it means that the first
        package (containing size) was sent properly, but there was a glitch with
        the actual content! */
     PAUSE_TIMER();
-    if (tmp)
-      free(tmp);
     return false;
   }
   
 #ifdef  MPI_DEBUG
-  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%s,%u, MPI_CHAR,%d,%d)\n",__FUNCTION__,buf, count, orig, tag);
+  write_msg(__FUNCTION__,__FILE__,__LINE__,"%s(%u, MPI_BYTE,%d,%d)\n",__FUNCTION__, count, orig, tag);
 #endif
   MSG_RECV(count);
-  t4=string2term(buf,NULL);
+  t4=buffer2term(buf);
   PAUSE_TIMER();
-  if (tmp)
-    free(tmp);
   return(YAP_Unify(YAP_ARG3,t4));
 }
 
@@ -551,7 +607,8 @@ mpi_irecv(void) {
     t2 = YAP_Deref(YAP_ARG2), 
     t3 = YAP_Deref(YAP_ARG3);
   int tag, orig;
- MPI_Request *mpi_req=(MPI_Request*)malloc(sizeof(MPI_Request));
+  MPI_Request *mpi_req;
+  char *buf;
 
    // The third argument (data) must be unbound
   if(!YAP_IsVarTerm(t3)) {
@@ -572,13 +629,23 @@ mpi_irecv(void) {
   else  tag  = YAP_IntOfTerm( t2 );
 
   CONT_TIMER();
-  if(  MPI_CALL(MPI_Irecv( BUFFER_PTR, BLOCK_SIZE, MPI_CHAR, orig, tag,
+  // each pending receive needs its own buffer, see mpi_default_buffer_size/2
+  mpi_req=(MPI_Request*)malloc(sizeof(MPI_Request));
+  buf=(char*)malloc(irecv_buffer_size);
+  if (mpi_req==NULL || buf==NULL) {
+    free(mpi_req);
+    free(buf);
+    PAUSE_TIMER();
+    return false;
+  }
+  if(  MPI_CALL(MPI_Irecv( buf, irecv_buffer_size, MPI_BYTE, orig, tag,
 			   MPI_COMM_WORLD, mpi_req )) != MPI_SUCCESS ) {
+    free(mpi_req);
+    free(buf);
     PAUSE_TIMER();
     return false;
   }
-  new_request(mpi_req,BUFFER_PTR);
-  DEL_BUFFER();
+  new_request(mpi_req,buf);
   PAUSE_TIMER();
   return YAP_Unify(t3,YAP_MkIntTerm(HANDLE2INT(mpi_req)));
 }
@@ -679,9 +746,13 @@ mpi_wait_recv(void) {
     PAUSE_TIMER();
     return false;
   }
-  len=YAP_SizeOfExportedTerm(s);
+  if ((len=irecv_size(s,&status))==0) {
+    free_request(handle);
+    PAUSE_TIMER();
+    return false;
+  }
   // make sure we only fetch ARG3 after constructing the term
-  out = string2term(s,(size_t*)&len);
+  out = buffer2term(s);
   MSG_RECV(len);
   free_request(handle);
   PAUSE_TIMER();
@@ -714,13 +785,18 @@ mpi_test_recv(void) {
 
   handle=INT2HANDLE(YAP_IntOfTerm(t1));
   //
-  if( MPI_CALL(MPI_Test( handle , &flag, &status ))!=MPI_SUCCESS) {
+  if( MPI_CALL(MPI_Test( handle , &flag, &status ))!=MPI_SUCCESS || !flag) {
     PAUSE_TIMER();
     return false;
   }
   s=(char*)get_request(handle);
-  len=strlen(s);
-  out = string2term(s,(size_t*)&len);
+  if ((len=irecv_size(s,&status))==0) {
+    free_request(handle);
+    PAUSE_TIMER();
+    return false;
+  }
+  out = buffer2term(s);
+  MSG_RECV(len);
   // make sure we only fetch ARG3 after constructing the term
   ret=YAP_Unify(YAP_ARG3,out);
   free_request(handle);
@@ -755,7 +831,7 @@ mpi_bcast(void) {
   YAP_Term t1 = YAP_Deref(YAP_ARG1), 
     t2 = YAP_Deref(YAP_ARG2);
   int root,val;
-  size_t len=0;
+  unsigned long len=0;
   char *str;
   int  rank;
   //The arguments should be bound
@@ -767,17 +843,26 @@ mpi_bcast(void) {
   CONT_TIMER();
   root = YAP_IntOfTerm(t1);
   if (root == rank) {
-    str=term2string(t2);
+    // a 0 length tells the others that the root failed
+    len=term2buffer(t2,&send_buffer.ptr,&send_buffer.size);
+    str=send_buffer.ptr;
 #ifdef MPI_DEBUG
-    write_msg(__FUNCTION__,__FILE__,__LINE__,"mpi_bcast(%s,%u, MPI_CHAR,%d)\n",str,len,root);
+    write_msg(__FUNCTION__,__FILE__,__LINE__,"mpi_bcast(%u, MPI_BYTE,%d)\n",len,root);
 #endif
-  } else {
-    RESET_BUFFER();
-    str = BUFFER_PTR;
-    len = BLOCK_SIZE;
+  }
+  // first the size, so that receivers know how much room they need
+  if (MPI_CALL(MPI_Bcast( &len, 1, MPI_UNSIGNED_LONG, root, MPI_COMM_WORLD))!=MPI_SUCCESS ||
+      len==0) {
+    PAUSE_TIMER();
+    return false;
+  }
+  if (root != rank && (str=get_recv_buffer(len))==NULL) {
+    PAUSE_TIMER();
+    YAP_Error(0,0,"mpi_bcast/2: out of memory.\n");
+    return false;
   }
   // send the data 
-  val=(MPI_CALL(MPI_Bcast( str, len, MPI_CHAR, root, MPI_COMM_WORLD))==MPI_SUCCESS?true:false);
+  val=(MPI_CALL(MPI_Bcast( str, len, MPI_BYTE, root, MPI_COMM_WORLD))==MPI_SUCCESS?true:false);
 
 
 #ifdef MPISTATS
@@ -790,9 +875,8 @@ mpi_bcast(void) {
   PAUSE_TIMER();
   if (root != rank) {
     YAP_Term out;
-    len=YAP_SizeOfExportedTerm(str);
     // make sure we only fetch ARG3 after constructing the term
-    out = string2term(str,(size_t*)&len);
+    out = buffer2term(str);
     MSG_RECV(len);
     if (!YAP_Unify(YAP_ARG2, out))
       return false;
@@ -826,18 +910,23 @@ my_bcast(YAP_Term t1,YAP_Term t2, YAP_Term t3) {
 
   root = YAP_IntOfTerm(t1);
   tag = YAP_IntOfTerm(t3);
-  str=term2string(t2);
+  // exported once, sent to everyone
+  if ((len=term2buffer(t2,&send_buffer.ptr,&send_buffer.size))==0) {
+    PAUSE_TIMER();
+    return false;
+  }
+  str=send_buffer.ptr;
   
   for(k=0;k<=worldsize-1;++k)
     if(k!=root) {
       // Use async send?
       MSG_SENT(len);
-      if(MPI_CALL(MPI_Send( str, len, MPI_CHAR, k, tag, MPI_COMM_WORLD))!=MPI_SUCCESS) {
+      if(MPI_CALL(MPI_Send( str, len, MPI_BYTE, k, tag, MPI_COMM_WORLD))!=MPI_SUCCESS) {
 	PAUSE_TIMER();
 	return false;
       }
 #ifdef MPI_DEBUG
-  write_msg(__FUNCTION__,__FILE__,__LINE__,"bcast2(%s,%u, MPI_CHAR,%d,%d)\n",str,len,k,tag);
+  write_msg(__FUNCTION__,__FILE__,__LINE__,"bcast2(%u, MPI_BYTE,%d,%d)\n",len,k,tag);
 #endif
     }
   PAUSE_TIMER();
@@ -871,8 +960,8 @@ static YAP_Bool
 my_ibcast(YAP_Term t1,YAP_Term t2, YAP_Term t3) {
   int root;
   int k,worldsize;
-  size_t len=0;
-  char *str;
+  size_t len=0,size=0;
+  char *str=NULL;
   int tag;
   BroadcastRequest *b;
 
@@ -889,9 +978,15 @@ my_ibcast(YAP_Term t1,YAP_Term t2, YAP_Term t3) {
 
   root = YAP_IntOfTerm(t1);
   tag = YAP_IntOfTerm(t3);
-  str = term2string(t2);
+  // the buffer is released once all the sends are done
+  if ((len=term2buffer(t2,&str,&size))==0) {
+    free(str);
+    PAUSE_TIMER();
+    return false;
+  }
   b=new_broadcast();
   if ( b==NULL ) {
+    free(str);
     PAUSE_TIMER();
     return false;
   }
@@ -901,7 +996,7 @@ my_ibcast(YAP_Term t1,YAP_Term t2, YAP_Term t3) {
       MPI_Request *handle=(MPI_Request*)malloc(sizeof(MPI_Request));
       MSG_SENT(len);
       // Use async send
-      if(MPI_CALL(MPI_Isend(str, len, MPI_CHAR, k, tag, MPI_COMM_WORLD,handle))!=MPI_SUCCESS) {
+      if(MPI_CALL(MPI_Isend(str, len, MPI_BYTE, k, tag, MPI_COMM_WORLD,handle))!=MPI_SUCCESS) {
 	free(handle);
 	PAUSE_TIMER();
 	return false;
@@ -911,8 +1006,10 @@ my_ibcast(YAP_Term t1,YAP_Term t2, YAP_Term t3) {
       USED_BUFFER();
     }
   }
-  if(!b->nreq)//release b if no messages were sent (worldsize==1)
+  if(!b->nreq) {//release b if no messages were sent (worldsize==1)
+    free(str);
     free(b);
+  }
 
 #if defined(MPI_DEBUG) && defined(MALLINFO)
   {
@@ -942,6 +1039,285 @@ static YAP_Bool
 mpi_ibcast2(void) {
   return my_ibcast(YAP_ARG1,YAP_ARG2,YAP_MkIntTerm(0));
 }
+/***********************************
+ * Collective operations
+ ***********************************/
+/*
+ * Builds the list of the n terms exported one after the other in buf,
+ * at the given offsets
+ */
+static YAP_Term
+import_terms(char *buf, const int *displs, int n) {
+  YAP_Term *ts=(YAP_Term*)malloc(n*sizeof(YAP_Term)), out;
+  size_t cells=2*n+1024;
+  int i;
+
+  if (ts==NULL)
+    return 0;
+  // the terms are not safe from the garbage collector until in the list
+  for (i=0;i<n;i++)
+    cells+=YAP_SizeOfExportedTerm(buf+displs[i])/sizeof(YAP_Term);
+  YAP_RequiresExtraStack(cells);
+  for (i=0;i<n;i++)
+    ts[i]=buffer2term(buf+displs[i]);
+  out=YAP_MkListFromTerms(ts,n);
+  free(ts);
+  return out;
+}
+/*
+ * Each process sends Data to Root, which gets the List of the terms
+ * sent, in rank order.
+ *
+ * mpi_gather(+Root,+Data,-List).
+ */
+static YAP_Bool 
+mpi_gather(void) {
+  YAP_Term t1 = YAP_Deref(YAP_ARG1), out;
+  int root,rank,size,i,len,*counts=NULL,*displs=NULL,ok;
+  char *buf=NULL;
+
+  if(!YAP_IsIntTerm(t1)) {
+    return false;
+  }
+  CONT_TIMER();
+  MPI_CALL(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+  MPI_CALL(MPI_Comm_size(MPI_COMM_WORLD, &size));
+  root = YAP_IntOfTerm(t1);
+  // a process that can not export sends nothing, and everyone fails
+  len=term2buffer(YAP_ARG2,&send_buffer.ptr,&send_buffer.size);
+  MSG_SENT(len);
+  if (rank==root) {
+    counts=(int*)malloc(2*size*sizeof(int));
+    if (counts==NULL) {
+      YAP_Error(0,0,"mpi_gather/3: out of memory.\n");
+      MPI_Abort(MPI_COMM_WORLD,1);
+    }
+    displs=counts+size;
+  }
+  if (MPI_CALL(MPI_Gather(&len,1,MPI_INT,counts,1,MPI_INT,root,MPI_COMM_WORLD))!=MPI_SUCCESS) {
+    free(counts);
+    PAUSE_TIMER();
+    return false;
+  }
+  if (rank==root) {
+    // terms are imported in place, so keep them aligned
+    size_t total=0;
+    for(i=0;i<size;i++) {
+      displs[i]=total;
+      total+=(counts[i]+sizeof(YAP_Term)-1) & ~(sizeof(YAP_Term)-1);
+    }
+    if (total > INT_MAX || (buf=get_recv_buffer(total))==NULL) {
+      YAP_Error(0,0,"mpi_gather/3: out of memory.\n");
+      MPI_Abort(MPI_COMM_WORLD,1);
+    }
+  }
+  ok=MPI_CALL(MPI_Gatherv(send_buffer.ptr,len,MPI_BYTE,buf,counts,displs,MPI_BYTE,root,MPI_COMM_WORLD))==MPI_SUCCESS;
+  PAUSE_TIMER();
+  if (rank!=root)
+    return ok && len>0;
+  for(i=0;i<size;i++) {
+    MSG_RECV(counts[i]);
+    if (counts[i]==0)
+      ok=false;
+  }
+  if (!ok || (out=import_terms(buf,displs,size))==0) {
+    free(counts);
+    return false;
+  }
+  free(counts);
+  return YAP_Unify(YAP_ARG3,out);
+}
+/*
+ * Root sends the i-th element of List to the process with rank i,
+ * each process gets its element in Data. List must have as many
+ * elements as there are processes.
+ *
+ * mpi_scatter(+Root,+List,-Data).
+ */
+static YAP_Bool 
+mpi_scatter(void) {
+  YAP_Term t1 = YAP_Deref(YAP_ARG1), out;
+  int root,rank,size,i,len=0,*counts=NULL,*displs=NULL,ok=true;
+  char *buf;
+
+  if(!YAP_IsIntTerm(t1)) {
+    return false;
+  }
+  CONT_TIMER();
+  MPI_CALL(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+  MPI_CALL(MPI_Comm_size(MPI_COMM_WORLD, &size));
+  root = YAP_IntOfTerm(t1);
+  if (rank==root) {
+    YAP_Term l = YAP_Deref(YAP_ARG2);
+    YAP_handle_t slot;
+    size_t total=0;
+
+    counts=(int*)malloc(2*size*sizeof(int));
+    if (counts==NULL) {
+      YAP_Error(0,0,"mpi_scatter/3: out of memory.\n");
+      MPI_Abort(MPI_COMM_WORLD,1);
+    }
+    displs=counts+size;
+    ok = (YAP_ListLength(l)==size);
+    // export the elements one after the other in the send buffer, the
+    // list is kept in a slot as exporting may move it
+    slot = YAP_InitSlot(l);
+    for(i=0;i<size;i++) {
+      size_t plen;
+
+      displs[i]=total;
+      counts[i]=0;
+      if (!ok)
+        continue;
+      while (send_buffer.size <= total ||
+             (plen=YAP_ExportTerm(YAP_HeadOfTerm(YAP_GetFromSlot(slot)),
+                                  send_buffer.ptr+total,
+                                  send_buffer.size-total))==0) {
+        char *nbuf=realloc(send_buffer.ptr,2*send_buffer.size+BLOCK_SIZE);
+        if (nbuf==NULL)
+          break;
+        send_buffer.ptr=nbuf;
+        send_buffer.size=2*send_buffer.size+BLOCK_SIZE;
+      }
+      if (send_buffer.size <= total || plen==0 ||
+          total+plen+sizeof(YAP_Term) > INT_MAX) {
+        ok=false;
+        continue;
+      }
+      counts[i]=plen;
+      MSG_SENT(plen);
+      total+=(plen+sizeof(YAP_Term)-1) & ~(sizeof(YAP_Term)-1);
+      YAP_PutInSlot(slot,YAP_TailOfTerm(YAP_GetFromSlot(slot)));
+    }
+    YAP_RecoverSlots(1,slot);
+    if (!ok)
+      for(i=0;i<size;i++)
+        counts[i]=0;
+  }
+  // an empty part tells a process that the root failed
+  if (MPI_CALL(MPI_Scatter(counts,1,MPI_INT,&len,1,MPI_INT,root,MPI_COMM_WORLD))!=MPI_SUCCESS ||
+      (buf=get_recv_buffer(len>0?len:1))==NULL) {
+    free(counts);
+    PAUSE_TIMER();
+    return false;
+  }
+  ok=(MPI_CALL(MPI_Scatterv(send_buffer.ptr,counts,displs,MPI_BYTE,buf,len,MPI_BYTE,root,MPI_COMM_WORLD))==MPI_SUCCESS) && len>0;
+  free(counts);
+  PAUSE_TIMER();
+  if (!ok)
+    return false;
+  MSG_RECV(len);
+  out=buffer2term(buf);
+  return YAP_Unify(YAP_ARG3,out);
+}
+/*
+ * Reads a number or a list of numbers into vals, returns how many or -1
+ */
+static long
+numeric_terms(YAP_Term t, double **dvals, long **lvals, int *is_float) {
+  long n=0,max=16;
+  YAP_Term l;
+
+  if (YAP_IsIntTerm(t) || YAP_IsFloatTerm(t)) {
+    max=1;
+  } else if ((max=YAP_ListLength(t))<0) {
+    return -1;
+  }
+  *dvals=(double*)malloc((max?max:1)*sizeof(double));
+  *lvals=(long*)malloc((max?max:1)*sizeof(long));
+  if (*dvals==NULL || *lvals==NULL)
+    return -1;
+  *is_float=false;
+  for (l=t; n<max; n++) {
+    YAP_Term h;
+
+    if (YAP_IsPairTerm(l)) {
+      h=YAP_HeadOfTerm(l);
+      l=YAP_TailOfTerm(l);
+    } else {
+      h=l;
+    }
+    if (YAP_IsIntTerm(h)) {
+      (*lvals)[n]=YAP_IntOfTerm(h);
+      (*dvals)[n]=(double)(*lvals)[n];
+    } else if (YAP_IsFloatTerm(h)) {
+      (*dvals)[n]=YAP_FloatOfTerm(h);
+      *is_float=true;
+    } else {
+      return -1;
+    }
+  }
+  return n;
+}
+/*
+ * Combines the numbers each process has in Data with Op, one of sum,
+ * prod, min or max, and gives every process the Result. Data is a
+ * number or a list of numbers, combined element by element; if any
+ * process has a float all are combined as floats.
+ *
+ * mpi_allreduce(+Data,+Op,-Result).
+ */
+static YAP_Bool 
+mpi_allreduce(void) {
+  YAP_Term t1 = YAP_Deref(YAP_ARG1), t2 = YAP_Deref(YAP_ARG2), out;
+  double *dvals=NULL,*dres=NULL;
+  long *lvals=NULL,*lres=NULL;
+  long n, shape[3], gshape[3];
+  int is_float, ok, i;
+  const char *opname;
+  MPI_Op op;
+
+  if (!YAP_IsAtomTerm(t2)) {
+    return false;
+  }
+  opname=YAP_AtomName(YAP_AtomOfTerm(t2));
+  if (!strcmp(opname,"sum")) op=MPI_SUM;
+  else if (!strcmp(opname,"prod")) op=MPI_PROD;
+  else if (!strcmp(opname,"min")) op=MPI_MIN;
+  else if (!strcmp(opname,"max")) op=MPI_MAX;
+  else return false;
+  CONT_TIMER();
+  n=numeric_terms(t1,&dvals,&lvals,&is_float);
+  // agree on the type and check everyone has the same number of values
+  shape[0]=is_float;
+  shape[1]=n;
+  shape[2]=-n;
+  ok=(MPI_CALL(MPI_Allreduce(shape,gshape,3,MPI_LONG,MPI_MAX,MPI_COMM_WORLD))==MPI_SUCCESS);
+  if (!ok || n<0 || gshape[1]!=n || -gshape[2]!=n) {
+    free(dvals);
+    free(lvals);
+    PAUSE_TIMER();
+    return false;
+  }
+  if (gshape[0]) {
+    dres=(double*)malloc((n?n:1)*sizeof(double));
+    ok=dres!=NULL &&
+      MPI_CALL(MPI_Allreduce(dvals,dres,n,MPI_DOUBLE,op,MPI_COMM_WORLD))==MPI_SUCCESS;
+  } else {
+    lres=(long*)malloc((n?n:1)*sizeof(long));
+    ok=lres!=NULL &&
+      MPI_CALL(MPI_Allreduce(lvals,lres,n,MPI_LONG,op,MPI_COMM_WORLD))==MPI_SUCCESS;
+  }
+  free(dvals);
+  free(lvals);
+  PAUSE_TIMER();
+  if (!ok) {
+    free(dres);
+    free(lres);
+    return false;
+  }
+  if (!YAP_IsPairTerm(t1) && t1!=YAP_TermNil()) {
+    out=(gshape[0]?YAP_MkFloatTerm(dres[0]):YAP_MkIntTerm(lres[0]));
+  } else {
+    YAP_RequiresExtraStack(4*n+1024);
+    out=YAP_TermNil();
+    for(i=n-1;i>=0;i--)
+      out=YAP_MkPairTerm(gshape[0]?YAP_MkFloatTerm(dres[i]):YAP_MkIntTerm(lres[i]),out);
+  }
+  free(dres);
+  free(lres);
+  return YAP_Unify(YAP_ARG3,out);
+}
 /*******************************************
  * Garbage collection
  *******************************************/
@@ -994,9 +1370,18 @@ mpi_gc(void) {
 static YAP_Bool
 mpi_default_buffer_size(void)
 {
-  if (!YAP_Unify(YAP_ARG1,YAP_MkIntTerm(BLOCK_SIZE))) {
+  YAP_Term t2;
+  if (!YAP_Unify(YAP_ARG1,YAP_MkIntTerm(irecv_buffer_size))) {
     return false;
-}
+  }
+  t2=YAP_Deref(YAP_ARG2);
+  if (YAP_IsVarTerm(t2)) {
+    return YAP_Unify(t2,YAP_MkIntTerm(irecv_buffer_size));
+  }
+  if (!YAP_IsIntTerm(t2) || YAP_IntOfTerm(t2)<=0) {
+    return false;
+  }
+  irecv_buffer_size=YAP_IntOfTerm(t2);
   return true;
 }
 
@@ -1051,6 +1436,9 @@ from the process with rank  _Root_ to all other processes.
  
 */
   YAP_UserCPredicate( "mpi_barrier", mpi_barrier,0);                       // mpi_barrier/0
+  YAP_UserCPredicate( "mpi_gather", mpi_gather,3);                         // mpi_gather(+Root,+Data,-List)
+  YAP_UserCPredicate( "mpi_scatter", mpi_scatter,3);                       // mpi_scatter(+Root,+List,-Data)
+  YAP_UserCPredicate( "mpi_allreduce", mpi_allreduce,3);                   // mpi_allreduce(+Data,+Op,-Result)
   YAP_UserCPredicate( "mpi_gc", mpi_gc,0);                                 // mpi_gc/0
   YAP_UserCPredicate( "mpi_default_buffer_size", mpi_default_buffer_size,2);        // buffer size
 /** @pred mpi_default_buffer_size(- _OldBufferSize_, ? _NewBufferSize_) 
@@ -1070,9 +1458,6 @@ process.
   YAP_UserCPredicate( "mpi_reset_stats", mpi_reset_stats,0);                // cleans the timers
   RESET_STATS();
 #endif
-  //  YAP_UserCPredicate( "mpi_gather", mpi_gather,0); //mpi_gather(+RootRank,?SendData,?RecvData)
-  // Each process (root process included) sends the contents of its send buffer to the root process. The root process receives the messages and stores them in rank order. The outcome is  as if each of the  n processes in the group (including the root process) had executed a call to MPI_Send and the root had executed n calls to MPI_Recv.  The receive buffer is ignored for all non-root processes.
-  // MPI_Scatter
 #ifdef MPI_DEBUG
   fprintf(stderr,"MPI  module succesfully loaded.");
   fflush(stderr);
@@ -27,6 +27,12 @@
 #if HAVE_STRING_H
 #include <string.h>
 #endif
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 /**
  * @addtogroup YapMatrix
@@ -184,26 +190,640 @@ static void matrix_next_index(intptr_t *dims, intptr_t ndims, intptr_t *indx) {
   }
 }
 
+/*
+  Bulk kernels.
+
+  The loops below are written so that the compiler can vectorise them:
+  reductions keep MATRIX_LANES independent accumulators, and on x86-64
+  GCC we ask for an AVX2 clone next to the generic one, picked at load
+  time by the dynamic linker. Large matrices are further split in
+  contiguous chunks, one per thread.
+*/
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) &&       \
+    defined(__linux__)
+#define MATRIX_SIMD __attribute__((target_clones("avx2", "default")))
+#else
+#define MATRIX_SIMD
+#endif
+
+#define MATRIX_LANES 8
+/* do not bother with threads for less than this many cells per thread */
+#define MATRIX_PAR_MIN (1 << 18)
+#define MATRIX_MAX_THREADS 16
+
+typedef void (*matrix_kernel)(void *env, intptr_t lo, intptr_t hi, int slot);
+
+static int matrix_nthreads(intptr_t sz) {
+  static int ncpus;
+  intptr_t n;
+
+  if (!ncpus) {
+#if HAVE_PTHREAD_H && defined(_SC_NPROCESSORS_ONLN)
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (ncpus < 1)
+      ncpus = 1;
+    if (ncpus > MATRIX_MAX_THREADS)
+      ncpus = MATRIX_MAX_THREADS;
+  }
+  n = sz / MATRIX_PAR_MIN;
+  if (n < 1)
+    return 1;
+  return n < ncpus ? n : ncpus;
+}
+
+#if HAVE_PTHREAD_H
+typedef struct matrix_chunk {
+  matrix_kernel fn;
+  void *env;
+  intptr_t lo, hi;
+  int slot;
+} matrix_chunk;
+
+static void *matrix_run_chunk(void *arg) {
+  matrix_chunk *c = arg;
+  c->fn(c->env, c->lo, c->hi, c->slot);
+  return NULL;
+}
+#endif
+
+/* run fn over [0,sz) in nthreads contiguous chunks; chunk i gets slot i */
+static void matrix_par_for(intptr_t sz, int nthreads, matrix_kernel fn,
+                           void *env) {
+#if HAVE_PTHREAD_H
+  matrix_chunk chunks[MATRIX_MAX_THREADS];
+  pthread_t tids[MATRIX_MAX_THREADS];
+  bool started[MATRIX_MAX_THREADS];
+  intptr_t step;
+  int i;
+
+  if (nthreads > 1) {
+    step = (sz + nthreads - 1) / nthreads;
+    for (i = 0; i < nthreads; i++) {
+      chunks[i].fn = fn;
+      chunks[i].env = env;
+      chunks[i].lo = i * step < sz ? i * step : sz;
+      chunks[i].hi = (i + 1) * step < sz ? (i + 1) * step : sz;
+      chunks[i].slot = i;
+      started[i] = i > 0 && pthread_create(tids + i, NULL, matrix_run_chunk,
+                                           chunks + i) == 0;
+    }
+    /* the caller takes the first chunk, and any the system refused */
+    for (i = 0; i < nthreads; i++) {
+      if (!started[i])
+        matrix_run_chunk(chunks + i);
+    }
+    for (i = 1; i < nthreads; i++) {
+      if (started[i])
+        pthread_join(tids[i], NULL);
+    }
+    return;
+  }
+#endif
+  fn(env, 0, sz, 0);
+}
+
+MATRIX_SIMD
+static void matrix_double_kahan_data(const double *data, intptr_t n,
+                                     double *psum, double *pc) {
+  double s[MATRIX_LANES], c[MATRIX_LANES], sum = *psum, comp = *pc;
+  intptr_t i, k;
+
+  for (k = 0; k < MATRIX_LANES; k++)
+    s[k] = c[k] = 0.0;
+  for (i = 0; i + MATRIX_LANES <= n; i += MATRIX_LANES) {
+    for (k = 0; k < MATRIX_LANES; k++) {
+      double y = data[i + k] - c[k];
+      double t = s[k] + y;
+      c[k] = (t - s[k]) - y;
+      s[k] = t;
+    }
+  }
+  for (k = 0; i + k < n; k++) {
+    double y = data[i + k] - c[k];
+    double t = s[k] + y;
+    c[k] = (t - s[k]) - y;
+    s[k] = t;
+  }
+  /* fold the lanes, compensating as we go */
+  for (k = 0; k < MATRIX_LANES; k++) {
+    double y = (s[k] - c[k]) - comp;
+    double t = sum + y;
+    comp = (t - sum) - y;
+    sum = t;
+  }
+  *psum = sum;
+  *pc = comp;
+}
+
+MATRIX_SIMD
+static YAP_Int matrix_long_sum_data(const YAP_Int *data, intptr_t n) {
+  YAP_Int sum = 0;
+  intptr_t i;
+
+  for (i = 0; i < n; i++)
+    sum += data[i];
+  return sum;
+}
+
+MATRIX_SIMD
+static double matrix_double_max_data(const double *data, intptr_t n) {
+  double m[MATRIX_LANES], max;
+  intptr_t i, k;
+
+  for (k = 0; k < MATRIX_LANES; k++)
+    m[k] = data[0];
+  for (i = 0; i + MATRIX_LANES <= n; i += MATRIX_LANES) {
+    for (k = 0; k < MATRIX_LANES; k++)
+      m[k] = data[i + k] > m[k] ? data[i + k] : m[k];
+  }
+  max = m[0];
+  for (k = 1; k < MATRIX_LANES; k++)
+    if (m[k] > max)
+      max = m[k];
+  for (; i < n; i++)
+    if (data[i] > max)
+      max = data[i];
+  return max;
+}
+
+MATRIX_SIMD
+static YAP_Int matrix_long_max_data(const YAP_Int *data, intptr_t n) {
+  YAP_Int m[MATRIX_LANES], max;
+  intptr_t i, k;
+
+  for (k = 0; k < MATRIX_LANES; k++)
+    m[k] = data[0];
+  for (i = 0; i + MATRIX_LANES <= n; i += MATRIX_LANES) {
+    for (k = 0; k < MATRIX_LANES; k++)
+      m[k] = data[i + k] > m[k] ? data[i + k] : m[k];
+  }
+  max = m[0];
+  for (k = 1; k < MATRIX_LANES; k++)
+    if (m[k] > max)
+      max = m[k];
+  for (; i < n; i++)
+    if (data[i] > max)
+      max = data[i];
+  return max;
+}
+
+typedef struct matrix_reduce_env {
+  const void *data;
+  double dsum[MATRIX_MAX_THREADS], dc[MATRIX_MAX_THREADS];
+  double dmax[MATRIX_MAX_THREADS];
+  YAP_Int lsum[MATRIX_MAX_THREADS], lmax[MATRIX_MAX_THREADS];
+} matrix_reduce_env;
+
+static void matrix_double_sum_chunk(void *env, intptr_t lo, intptr_t hi,
+                                    int slot) {
+  matrix_reduce_env *e = env;
+  e->dsum[slot] = e->dc[slot] = 0.0;
+  matrix_double_kahan_data((const double *)e->data + lo, hi - lo,
+                           e->dsum + slot, e->dc + slot);
+}
+
+static void matrix_long_sum_chunk(void *env, intptr_t lo, intptr_t hi,
+                                  int slot) {
+  matrix_reduce_env *e = env;
+  e->lsum[slot] = matrix_long_sum_data((const YAP_Int *)e->data + lo, hi - lo);
+}
+
+static void matrix_double_max_chunk(void *env, intptr_t lo, intptr_t hi,
+                                    int slot) {
+  matrix_reduce_env *e = env;
+  if (hi > lo)
+    e->dmax[slot] = matrix_double_max_data((const double *)e->data + lo,
+                                           hi - lo);
+}
+
+static void matrix_long_max_chunk(void *env, intptr_t lo, intptr_t hi,
+                                  int slot) {
+  matrix_reduce_env *e = env;
+  if (hi > lo)
+    e->lmax[slot] = matrix_long_max_data((const YAP_Int *)e->data + lo,
+                                         hi - lo);
+}
+
+static double matrix_double_sum(const double *data, intptr_t sz) {
+  matrix_reduce_env e;
+  int i, n = matrix_nthreads(sz);
+  double sum = 0.0, c = 0.0;
+
+  e.data = data;
+  matrix_par_for(sz, n, matrix_double_sum_chunk, &e);
+  for (i = 0; i < n; i++) {
+    double y = (e.dsum[i] - e.dc[i]) - c;
+    double t = sum + y;
+    c = (t - sum) - y;
+    sum = t;
+  }
+  return sum;
+}
+
+static YAP_Int matrix_long_sum(const YAP_Int *data, intptr_t sz) {
+  matrix_reduce_env e;
+  int i, n = matrix_nthreads(sz);
+  YAP_Int sum = 0;
+
+  e.data = data;
+  matrix_par_for(sz, n, matrix_long_sum_chunk, &e);
+  for (i = 0; i < n; i++)
+    sum += e.lsum[i];
+  return sum;
+}
+
+/* sz must be positive */
+static double matrix_double_max(const double *data, intptr_t sz) {
+  matrix_reduce_env e;
+  int i, n = matrix_nthreads(sz);
+  double max;
+
+  e.data = data;
+  matrix_par_for(sz, n, matrix_double_max_chunk, &e);
+  max = e.dmax[0];
+  for (i = 1; i < n; i++)
+    if (e.dmax[i] > max)
+      max = e.dmax[i];
+  return max;
+}
+
+static YAP_Int matrix_long_max(const YAP_Int *data, intptr_t sz) {
+  matrix_reduce_env e;
+  int i, n = matrix_nthreads(sz);
+  YAP_Int max;
+
+  e.data = data;
+  matrix_par_for(sz, n, matrix_long_max_chunk, &e);
+  max = e.lmax[0];
+  for (i = 1; i < n; i++)
+    if (e.lmax[i] > max)
+      max = e.lmax[i];
+  return max;
+}
+
+typedef struct matrix_map_env {
+  double *out;
+  const double *in;
+  const YAP_Int *lin;
+  double (*f)(double);
+  double shift;
+} matrix_map_env;
+
+/* out[i] = f(in[i]-shift), in may alias out */
+static void matrix_double_map_chunk(void *env, intptr_t lo, intptr_t hi,
+                                    int slot) {
+  matrix_map_env *e = env;
+  double (*f)(double) = e->f, shift = e->shift;
+  intptr_t i;
+
+  for (i = lo; i < hi; i++)
+    e->out[i] = f(e->in[i] - shift);
+}
+
+static void matrix_long_map_chunk(void *env, intptr_t lo, intptr_t hi,
+                                  int slot) {
+  matrix_map_env *e = env;
+  double (*f)(double) = e->f;
+  intptr_t i;
+
+  for (i = lo; i < hi; i++)
+    e->out[i] = f((double)e->lin[i]);
+}
+
+static void matrix_double_map(double *out, const double *in, intptr_t sz,
+                              double (*f)(double), double shift) {
+  matrix_map_env e;
+
+  e.out = out;
+  e.in = in;
+  e.f = f;
+  e.shift = shift;
+  matrix_par_for(sz, matrix_nthreads(sz), matrix_double_map_chunk, &e);
+}
+
+static void matrix_long_map(double *out, const YAP_Int *in, intptr_t sz,
+                            double (*f)(double)) {
+  matrix_map_env e;
+
+  e.out = out;
+  e.lin = in;
+  e.f = f;
+  matrix_par_for(sz, matrix_nthreads(sz), matrix_long_map_chunk, &e);
+}
+
+/*
+  summing out dimension d views the data as [outer][range][inner], where
+  inner is the product of the dimensions after d: every output cell
+  ndata[o*inner+j] adds range cells that are inner apart, and the
+  innermost loop walks both matrices contiguously.
+*/
+typedef struct matrix_sum_out_env {
+  const void *data;
+  void *ndata;
+  intptr_t range, inner;
+} matrix_sum_out_env;
+
+MATRIX_SIMD
+static void matrix_double_sum_out_chunk(void *env, intptr_t lo, intptr_t hi,
+                                        int slot) {
+  matrix_sum_out_env *e = env;
+  const double *data = e->data;
+  double *ndata = e->ndata;
+  intptr_t range = e->range, inner = e->inner, p = lo;
+
+  while (p < hi) {
+    intptr_t o = p / inner, j0 = p % inner;
+    intptr_t j1 = hi - o * inner < inner ? hi - o * inner : inner, r, j;
+    double *restrict dst = ndata + o * inner;
+
+    for (j = j0; j < j1; j++)
+      dst[j] = 0.0;
+    for (r = 0; r < range; r++) {
+      const double *restrict src = data + (o * range + r) * inner;
+      for (j = j0; j < j1; j++)
+        dst[j] += src[j];
+    }
+    p = o * inner + j1;
+  }
+}
+
+MATRIX_SIMD
+static void matrix_long_sum_out_chunk(void *env, intptr_t lo, intptr_t hi,
+                                      int slot) {
+  matrix_sum_out_env *e = env;
+  const YAP_Int *data = e->data;
+  YAP_Int *ndata = e->ndata;
+  intptr_t range = e->range, inner = e->inner, p = lo;
+
+  while (p < hi) {
+    intptr_t o = p / inner, j0 = p % inner;
+    intptr_t j1 = hi - o * inner < inner ? hi - o * inner : inner, r, j;
+    YAP_Int *restrict dst = ndata + o * inner;
+
+    for (j = j0; j < j1; j++)
+      dst[j] = 0;
+    for (r = 0; r < range; r++) {
+      const YAP_Int *restrict src = data + (o * range + r) * inner;
+      for (j = j0; j < j1; j++)
+        dst[j] += src[j];
+    }
+    p = o * inner + j1;
+  }
+}
+
+static void matrix_sum_out_data(bool floats, const void *data, void *ndata,
+                                intptr_t *dims, intptr_t ndims,
+                                intptr_t prdim) {
+  matrix_sum_out_env e;
+  intptr_t i, nsz = 1;
+
+  e.data = data;
+  e.ndata = ndata;
+  e.range = dims[prdim];
+  e.inner = 1;
+  for (i = prdim + 1; i < ndims; i++)
+    e.inner *= dims[i];
+  for (i = 0; i < ndims; i++)
+    if (i != prdim)
+      nsz *= dims[i];
+  if (nsz == 0)
+    return;
+  matrix_par_for(nsz, matrix_nthreads(nsz * e.range),
+                 floats ? matrix_double_sum_out_chunk
+                        : matrix_long_sum_out_chunk,
+                 &e);
+}
+
+MATRIX_SIMD
+static double matrix_double_dot_data(const double *a, const double *b,
+                                     intptr_t n) {
+  double s[MATRIX_LANES], sum = 0.0;
+  intptr_t i, k;
+
+  for (k = 0; k < MATRIX_LANES; k++)
+    s[k] = 0.0;
+  for (i = 0; i + MATRIX_LANES <= n; i += MATRIX_LANES) {
+    for (k = 0; k < MATRIX_LANES; k++)
+      s[k] += a[i + k] * b[i + k];
+  }
+  for (; i < n; i++)
+    sum += a[i] * b[i];
+  for (k = 0; k < MATRIX_LANES; k++)
+    sum += s[k];
+  return sum;
+}
+
+typedef struct matrix_dot_env {
+  const double *a, *b;
+  double part[MATRIX_MAX_THREADS];
+} matrix_dot_env;
+
+static void matrix_dot_chunk(void *env, intptr_t lo, intptr_t hi, int slot) {
+  matrix_dot_env *e = env;
+  e->part[slot] = matrix_double_dot_data(e->a + lo, e->b + lo, hi - lo);
+}
+
+static double matrix_double_dot(const double *a, const double *b,
+                                intptr_t sz) {
+  matrix_dot_env e;
+  int i, n = matrix_nthreads(sz);
+  double sum = 0.0;
+
+  e.a = a;
+  e.b = b;
+  matrix_par_for(sz, n, matrix_dot_chunk, &e);
+  for (i = 0; i < n; i++)
+    sum += e.part[i];
+  return sum;
+}
+
+/*
+  C[n,m] = A[n,k] B[k,m]: every thread owns a band of rows of C, and
+  walks B in MATRIX_BLOCK_K x MATRIX_BLOCK_J tiles that stay in cache
+  while the band is updated, one row of C at a time.
+*/
+#define MATRIX_BLOCK_K 64
+#define MATRIX_BLOCK_J 256
+
+typedef struct matrix_mult_env {
+  const double *a, *b;
+  double *c;
+  intptr_t k, m;
+} matrix_mult_env;
+
+MATRIX_SIMD
+static void matrix_mult_chunk(void *env, intptr_t lo, intptr_t hi, int slot) {
+  matrix_mult_env *e = env;
+  intptr_t k = e->k, m = e->m, i, p, j, p0, j0;
+
+  if (m == 1) {
+    /* matrix times vector */
+    for (i = lo; i < hi; i++)
+      e->c[i] = matrix_double_dot_data(e->a + i * k, e->b, k);
+    return;
+  }
+  for (i = lo * m; i < hi * m; i++)
+    e->c[i] = 0.0;
+  for (j0 = 0; j0 < m; j0 += MATRIX_BLOCK_J) {
+    intptr_t j1 = j0 + MATRIX_BLOCK_J < m ? j0 + MATRIX_BLOCK_J : m;
+    for (p0 = 0; p0 < k; p0 += MATRIX_BLOCK_K) {
+      intptr_t p1 = p0 + MATRIX_BLOCK_K < k ? p0 + MATRIX_BLOCK_K : k;
+      for (i = lo; i < hi; i++) {
+        const double *arow = e->a + i * k;
+        double *restrict crow = e->c + i * m;
+        for (p = p0; p < p1; p++) {
+          double aip = arow[p];
+          const double *restrict brow = e->b + p * m;
+          for (j = j0; j < j1; j++)
+            crow[j] += aip * brow[j];
+        }
+      }
+    }
+  }
+}
+
+static void matrix_double_mult(const double *a, const double *b, double *c,
+                               intptr_t n, intptr_t k, intptr_t m) {
+  matrix_mult_env e;
+  int nthreads = matrix_nthreads(n * k * m / 16);
+
+  if (nthreads > n)
+    nthreads = n;
+  e.a = a;
+  e.b = b;
+  e.c = c;
+  e.k = k;
+  e.m = m;
+  matrix_par_for(n, nthreads, matrix_mult_chunk, &e);
+}
+
+/* out-of-place transpose of a rows x cols matrix, in square tiles */
+#define MATRIX_TILE 32
+
+typedef struct matrix_transpose_env {
+  const void *data;
+  void *ndata;
+  intptr_t rows, cols;
+} matrix_transpose_env;
+
+/* [lo,hi) are rows of the result, ie columns of the source */
+static void matrix_double_transpose_chunk(void *env, intptr_t lo,
+                                          intptr_t hi, int slot) {
+  matrix_transpose_env *e = env;
+  const double *data = e->data;
+  double *ndata = e->ndata;
+  intptr_t rows = e->rows, cols = e->cols, i, j, i0, j0;
+
+  for (j0 = lo; j0 < hi; j0 += MATRIX_TILE) {
+    intptr_t j1 = j0 + MATRIX_TILE < hi ? j0 + MATRIX_TILE : hi;
+    for (i0 = 0; i0 < rows; i0 += MATRIX_TILE) {
+      intptr_t i1 = i0 + MATRIX_TILE < rows ? i0 + MATRIX_TILE : rows;
+      for (j = j0; j < j1; j++)
+        for (i = i0; i < i1; i++)
+          ndata[j * rows + i] = data[i * cols + j];
+    }
+  }
+}
+
+static void matrix_long_transpose_chunk(void *env, intptr_t lo, intptr_t hi,
+                                        int slot) {
+  matrix_transpose_env *e = env;
+  const YAP_Int *data = e->data;
+  YAP_Int *ndata = e->ndata;
+  intptr_t rows = e->rows, cols = e->cols, i, j, i0, j0;
+
+  for (j0 = lo; j0 < hi; j0 += MATRIX_TILE) {
+    intptr_t j1 = j0 + MATRIX_TILE < hi ? j0 + MATRIX_TILE : hi;
+    for (i0 = 0; i0 < rows; i0 += MATRIX_TILE) {
+      intptr_t i1 = i0 + MATRIX_TILE < rows ? i0 + MATRIX_TILE : rows;
+      for (j = j0; j < j1; j++)
+        for (i = i0; i < i1; i++)
+          ndata[j * rows + i] = data[i * cols + j];
+    }
+  }
+}
+
+static void matrix_transpose_data(bool floats, const void *data, void *ndata,
+                                  intptr_t rows, intptr_t cols) {
+  matrix_transpose_env e;
+
+  e.data = data;
+  e.ndata = ndata;
+  e.rows = rows;
+  e.cols = cols;
+  matrix_par_for(cols, matrix_nthreads(rows * cols),
+                 floats ? matrix_double_transpose_chunk
+                        : matrix_long_transpose_chunk,
+                 &e);
+}
+
+/* ndata[r] = sum of row r, for a matrix of nrows rows of ncols */
+typedef struct matrix_rows_env {
+  const void *data;
+  void *ndata;
+  intptr_t ncols;
+} matrix_rows_env;
+
+static void matrix_double_rows_chunk(void *env, intptr_t lo, intptr_t hi,
+                                     int slot) {
+  matrix_rows_env *e = env;
+  const double *data = e->data;
+  double *ndata = e->ndata;
+  intptr_t r;
+
+  for (r = lo; r < hi; r++) {
+    double sum = 0.0, c = 0.0;
+    matrix_double_kahan_data(data + r * e->ncols, e->ncols, &sum, &c);
+    ndata[r] = sum;
+  }
+}
+
+static void matrix_long_rows_chunk(void *env, intptr_t lo, intptr_t hi,
+                                   int slot) {
+  matrix_rows_env *e = env;
+  const YAP_Int *data = e->data;
+  YAP_Int *ndata = e->ndata;
+  intptr_t r;
+
+  for (r = lo; r < hi; r++)
+    ndata[r] = matrix_long_sum_data(data + r * e->ncols, e->ncols);
+}
+
+static void matrix_rows_sum_data(bool floats, const void *data, void *ndata,
+                                 intptr_t nrows, intptr_t ncols) {
+  matrix_rows_env e;
+  int nthreads = matrix_nthreads(nrows * ncols);
+
+  if (nthreads > nrows)
+    nthreads = nrows;
+  e.data = data;
+  e.ndata = ndata;
+  e.ncols = ncols;
+  matrix_par_for(nrows, nthreads,
+                 floats ? matrix_double_rows_chunk : matrix_long_rows_chunk,
+                 &e);
+}
+
 static int GET_MATRIX(YAP_Term inp, M *o) {
   intptr_t *mat;
   o->base = 0;
   // source: stack
   //
-  if (YAP_IsApplTerm(inp)) {
-    if ((mat = YAP_BlobOfTerm(inp))) {
-      o->type = mat[MAT_TYPE] == FLOAT_MATRIX ? 'f' : 'i';
-      o->c_ord = true;
-      o->sz = mat[MAT_SIZE];
-      o->ndims = mat[MAT_NDIMS];
-      o->data = (double *)(mat + (MAT_DIMS + o->ndims));
-      o->dims = mat + MAT_DIMS;
-      return true;
-    } else {
+  if ((mat = YAP_BlobOfTerm(inp))) {
+    o->type = mat[MAT_TYPE] == FLOAT_MATRIX ? 'f' : 'i';
+    o->c_ord = true;
+    o->sz = mat[MAT_SIZE];
+    o->ndims = mat[MAT_NDIMS];
+    o->data = (double *)(mat + (MAT_DIMS + o->ndims));
+    o->dims = mat + MAT_DIMS;
+    return true;
+  } else if (YAP_IsApplTerm(inp)) {
       YAP_Functor f = YAP_FunctorOfTerm(inp);
       // original, generic matrix
       if (f == MFunctorM)
 	{
-	  YAP_Term bases = YAP_IntOfTerm(YAP_ArgOfTerm(4,inp));
+	  YAP_Term bases = YAP_ArgOfTerm(4,inp);
 	  o->sz = YAP_IntOfTerm(YAP_ArgOfTerm(3,inp));
 	  if (YAP_IsIntTerm(bases))
 	    o->base = YAP_IntOfTerm(bases);
@@ -218,7 +838,8 @@ static int GET_MATRIX(YAP_Term inp, M *o) {
 	    *d++ = YAP_IntOfTerm(YAP_HeadOfTerm(l));
 	    l = YAP_TailOfTerm(l);
 	  }
-	  o->terms=YAP_ArgsOfTerm(YAP_ArgOfTerm(inp,5))+1;
+	  o->type = 't';
+	  o->terms=YAP_ArgsOfTerm(YAP_ArgOfTerm(5,inp));
 	}
       else if (f == MFunctorFloats) // used to pass floats to external code floats(Size,Data))
 	{	  
@@ -240,7 +861,7 @@ static int GET_MATRIX(YAP_Term inp, M *o) {
 	o->terms = YAP_ArgsOfTerm(inp);
 	  
 	}
-    }
+      return true;
   } else if (YAP_IsAtomTerm(inp)) {
     if ((o->data = YAP_FetchArray(inp, &o->sz, &o->type))) {
       // old-style arraysx
@@ -253,17 +874,16 @@ static int GET_MATRIX(YAP_Term inp, M *o) {
       }
     }
   }
-  return false;
+  return -1;
 }
 
 static bool IS_MATRIX(YAP_Term inp) {
   intptr_t *mat;
-  if (YAP_IsApplTerm(inp)) {
-    if ( (mat = YAP_BlobOfTerm(inp))) {
+  if ( (mat = YAP_BlobOfTerm(inp))) {
     return
       mat[MAT_TYPE] == FLOAT_MATRIX ||
       mat[MAT_TYPE] == INT_MATRIX;
-    }
+  } else if (YAP_IsApplTerm(inp)) {
       YAP_Functor f = YAP_FunctorOfTerm(inp);
       return
 	f == MFunctorM ||
@@ -299,9 +919,9 @@ static YAP_Term new_int_matrix(intptr_t ndims, intptr_t dims[],
     idims[i] = dims[i];
     nelems *= dims[i];
   }
-  sz = ((MAT_DIMS + 1) * sizeof(int) + ndims * sizeof(int) +
-        nelems * sizeof(YAP_Int)) /
-       sizeof(YAP_CELL);
+  /* the header and the dimensions take a cell each */
+  sz = MAT_DIMS + ndims +
+       (nelems * sizeof(YAP_Int) + (sizeof(YAP_CELL) - 1)) / sizeof(YAP_CELL);
 
   blob = YAP_MkBlobTerm(sz);
   if (blob == YAP_TermNil()) {
@@ -319,7 +939,7 @@ static YAP_Term new_int_matrix(intptr_t ndims, intptr_t dims[],
   if (data)
     memmove((void *)bdata, (void *)data, sizeof(double) * nelems);
   else
-    memset(bdata, 0, nelems);
+    memset(bdata, 0, sizeof(YAP_Int) * nelems);
   return blob;
 }
 
@@ -339,9 +959,9 @@ static YAP_Term new_float_matrix(intptr_t ndims, intptr_t dims[],
     idims[i] = dims[i];
     nelems *= dims[i];
   }
-  sz = ((MAT_DIMS + 1) * sizeof(int) + ndims * sizeof(int) +
-        (nelems + 1) * sizeof(double) + (sizeof(YAP_CELL) - 1)) /
-       sizeof(YAP_CELL);
+  /* the header and the dimensions take a cell each */
+  sz = MAT_DIMS + ndims +
+       (nelems * sizeof(double) + (sizeof(YAP_CELL) - 1)) / sizeof(YAP_CELL);
   blob = YAP_MkBlobTerm(sz);
   if (blob == YAP_TermNil())
     return blob;
@@ -997,27 +1617,15 @@ static YAP_Bool matrix_max(void) {
     /* Error */
     return false;
   }
+  if (mat.sz <= 0)
+    return false;
   switch (mat.type) {
-  case 'f': {
-      intptr_t i,  sz = mat.sz;
-      double max = mat.data[0];
-      for (i = 1; i < sz; i++) {
-          if (mat.data[i] > max) {
-              max = mat.data[i];
-          }
-      }
-      return YAP_Unify(YAP_MkFloatTerm(max), YAP_ARG2);
-  }
-  case 'i': {
-          intptr_t i, sz = mat.sz;
-          YAP_Int max = mat.ls[0];
-          for (i = 1; i < sz; i++) {
-              if (mat.ls[i] > max) {
-                  max = mat.ls[i];
-              }
-          }
-          return YAP_Unify(YAP_MkIntTerm(max), YAP_ARG2);
-      }
+  case 'f':
+      return YAP_Unify(YAP_MkFloatTerm(matrix_double_max(mat.data, mat.sz)),
+                       YAP_ARG2);
+  case 'i':
+      return YAP_Unify(YAP_MkIntTerm(matrix_long_max(mat.ls, mat.sz)),
+                       YAP_ARG2);
   case 'b':
   case 't':
   default:
@@ -1114,7 +1722,7 @@ switch (mat.type)
     int i=mat.sz;
     while (i) {
       i--;
-      t = YAP_MkPairTerm(YAP_MkFloatTerm(mat.ls[i]),t);
+      t = YAP_MkPairTerm(YAP_MkFloatTerm(mat.data[i]),t);
     }
     }
     break;
@@ -1255,11 +1863,8 @@ static YAP_Bool matrix_log_all(void) {
     return FALSE;
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    intptr_t i;
 
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      data[i] = log(data[i]);
-    }
+    matrix_double_map(data, data, mat[MAT_SIZE], log, 0.0);
   }
   return TRUE;
 }
@@ -1276,7 +1881,6 @@ static YAP_Bool matrix_log_all2(void) {
     YAP_Term out;
     YAP_Int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
     double *ndata;
-    intptr_t i;
     intptr_t *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1288,16 +1892,13 @@ static YAP_Bool matrix_log_all2(void) {
     }
     nmat = (intptr_t *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      ndata[i] = log((double)data[i]);
-    }
+    matrix_long_map(ndata, data, mat[MAT_SIZE], log);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
   } else {
     YAP_Term out;
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]), *ndata;
-    intptr_t i;
     intptr_t *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1309,9 +1910,7 @@ static YAP_Bool matrix_log_all2(void) {
     }
     nmat = (intptr_t *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      ndata[i] = log(data[i]);
-    }
+    matrix_double_map(ndata, data, mat[MAT_SIZE], log, 0.0);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
@@ -1331,11 +1930,8 @@ static YAP_Bool matrix_exp_all(void) {
     return FALSE;
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    intptr_t i;
 
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      data[i] = exp(data[i]);
-    }
+    matrix_double_map(data, data, mat[MAT_SIZE], exp, 0.0);
   }
   return TRUE;
 }
@@ -1352,16 +1948,10 @@ static YAP_Bool matrix_exp2_all(void) {
     return FALSE;
   } else {
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]);
-    intptr_t i;
-    double max = data[0];
 
-    for (i = 1; i < mat[MAT_SIZE]; i++) {
-      if (data[i] > max)
-        max = data[i];
-    }
-
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      data[i] = exp(data[i] - max);
+    if (mat[MAT_SIZE] > 0) {
+      double max = matrix_double_max(data, mat[MAT_SIZE]);
+      matrix_double_map(data, data, mat[MAT_SIZE], exp, max);
     }
   }
   return TRUE;
@@ -1379,7 +1969,6 @@ static YAP_Bool matrix_exp_all2(void) {
     YAP_Term out;
     YAP_Int *data = matrix_long_data(mat, mat[MAT_NDIMS]);
     double *ndata;
-    intptr_t i;
     intptr_t *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1391,16 +1980,13 @@ static YAP_Bool matrix_exp_all2(void) {
     }
     nmat = (intptr_t *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      ndata[i] = exp((double)data[i]);
-    }
+    matrix_long_map(ndata, data, mat[MAT_SIZE], exp);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
   } else {
     YAP_Term out;
     double *data = matrix_double_data(mat, mat[MAT_NDIMS]), *ndata;
-    intptr_t i;
     intptr_t *nmat;
 
     if (!YAP_IsVarTerm(YAP_ARG2)) {
@@ -1412,9 +1998,7 @@ static YAP_Bool matrix_exp_all2(void) {
     }
     nmat = (intptr_t *)YAP_BlobOfTerm(out);
     ndata = matrix_double_data(nmat, mat[MAT_NDIMS]);
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      ndata[i] = exp(data[i]);
-    }
+    matrix_double_map(ndata, data, mat[MAT_SIZE], exp, 0.0);
     if (YAP_IsVarTerm(YAP_ARG2)) {
       return YAP_Unify(YAP_ARG2, out);
     }
@@ -1433,63 +2017,36 @@ Unify  _Sum_ with the sum of all elements in matrix   _Matrix_.
 static YAP_Bool matrix_sum(void) {
     M mat;
     YAP_Term tf;
-    int i;
     if (GET_MATRIX(YAP_ARG1, &mat)>=0) {
         if (mat.type == 'i') {
-            YAP_Int sum = 0;
-
-            for (i = 0; i < mat.sz; i++) {
-                sum += mat.ls[i];
-            }
-            tf = YAP_MkIntTerm(sum);
+            tf = YAP_MkIntTerm(matrix_long_sum(mat.ls, mat.sz));
         } else {
-            double *data = mat.data;
-            intptr_t i;
-            double sum = 0.0;
-            // function KahanSum(input)
-            double c = 0.0; // A running compensation for lost low-order bits.
-            for (i = 0; i < mat.sz; i++) {
-                double y = data[i] - c; // So far, so good: c is zero.
-                double t =
-                        sum +
-                        y; // Alas, sum is big, y small, so low-order digits of y are lost.
-                c = (t - sum) - y; // (t - sum) cancels the high-order part of y;
-                // subtracting y recovers negative (low part of y)
-                sum = t; // Algebraically, c should always be zero. Beware
-                // overly-aggressive optimizing compilers!
-            }
-            tf = YAP_MkFloatTerm(sum);
+            // compensated (Kahan) summation, one running sum per lane
+            tf = YAP_MkFloatTerm(matrix_double_sum(mat.data, mat.sz));
         }
+    } else {
+        return false;
     }
   return YAP_Unify(YAP_ARG2, tf);
 }
 
+/* add all lines: sum out the first dimension */
 static void add_int_lines(int total, intptr_t nlines, YAP_Int *mat0,
                           YAP_Int *matf) {
-  intptr_t ncols = total / nlines, i;
-  for (i = 0; i < ncols; i++) {
-    YAP_Int sum = 0;
-    int j;
+  intptr_t dims[2];
 
-    for (j = i; j < total; j += ncols) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  dims[0] = nlines;
+  dims[1] = total / nlines;
+  matrix_sum_out_data(false, mat0, matf, dims, 2, 0);
 }
 
 static void add_double_lines(int total, intptr_t nlines, double *mat0,
                              double *matf) {
-  intptr_t ncols = total / nlines, i;
-  for (i = 0; i < ncols; i++) {
-    double sum = 0;
-    int j;
+  intptr_t dims[2];
 
-    for (j = i; j < total; j += ncols) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  dims[0] = nlines;
+  dims[1] = total / nlines;
+  matrix_sum_out_data(true, mat0, matf, dims, 2, 0);
 }
 
 static YAP_Bool matrix_agg_lines(void) {
@@ -1530,9 +2087,10 @@ static YAP_Bool matrix_agg_lines(void) {
     intptr_t *nmat;
 
     tf = new_float_matrix(dims - 1, mat + (MAT_DIMS + 1), NULL);
-    nmat = (intptr_t *)YAP_BlobOfTerm(tf);
     if (tf == YAP_TermNil())
       return FALSE;
+    mat = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1);
+    nmat = (intptr_t *)YAP_BlobOfTerm(tf);
     data = matrix_double_data(mat, dims);
     ndata = matrix_double_data(nmat, dims - 1);
     if (op == MAT_PLUS) {
@@ -1543,32 +2101,15 @@ static YAP_Bool matrix_agg_lines(void) {
   return YAP_Unify(YAP_ARG3, tf);
 }
 
+/* add all columns: one sum per line */
 static void add_int_cols(int total, intptr_t nlines, YAP_Int *mat0,
                          YAP_Int *matf) {
-  intptr_t ncols = total / nlines, i, j = 0;
-  for (i = 0; i < nlines; i++) {
-    YAP_Int sum = 0;
-    int max = (i + 1) * ncols;
-
-    for (; j < max; j++) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  matrix_rows_sum_data(false, mat0, matf, nlines, total / nlines);
 }
 
 static void add_double_cols(int total, intptr_t nlines, double *mat0,
                             double *matf) {
-  intptr_t ncols = total / nlines, i, j = 0;
-  for (i = 0; i < nlines; i++) {
-    double sum = 0;
-    int max = (i + 1) * ncols;
-
-    for (; j < max; j++) {
-      sum += mat0[j];
-    }
-    matf[i] = sum;
-  }
+  matrix_rows_sum_data(true, mat0, matf, nlines, total / nlines);
 }
 
 static YAP_Bool matrix_agg_cols(void) {
@@ -1611,6 +2152,7 @@ static YAP_Bool matrix_agg_cols(void) {
     tf = new_float_matrix(1, mat + MAT_DIMS, NULL);
     if (tf == YAP_TermNil())
       return FALSE;
+    mat = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1);
     nmat = (intptr_t *)YAP_BlobOfTerm(tf);
     data = matrix_double_data(mat, dims);
     ndata = matrix_double_data(nmat, 1);
@@ -1776,6 +2318,7 @@ static YAP_Bool matrix_copy(void) {
   return true;
 }
 
+MATRIX_SIMD
 static void matrix_long_add_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
                                  YAP_Int mat2[]) {
   intptr_t i;
@@ -1785,6 +2328,7 @@ static void matrix_long_add_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_add_data(double *nmat, int siz, YAP_Int mat1[],
                                         double mat2[]) {
   intptr_t i;
@@ -1794,6 +2338,7 @@ static void matrix_long_double_add_data(double *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_double_add_data(double *nmat, int siz, double mat1[],
                                    double mat2[]) {
   intptr_t i;
@@ -1803,6 +2348,7 @@ static void matrix_double_add_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_sub_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
                                  YAP_Int mat2[]) {
   intptr_t i;
@@ -1812,6 +2358,7 @@ static void matrix_long_sub_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_sub_data(double *nmat, int siz, YAP_Int mat1[],
                                         double mat2[]) {
   intptr_t i;
@@ -1821,6 +2368,7 @@ static void matrix_long_double_sub_data(double *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_rsub_data(double *nmat, int siz, double mat1[],
                                          YAP_Int mat2[]) {
   intptr_t i;
@@ -1830,6 +2378,7 @@ static void matrix_long_double_rsub_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_double_sub_data(double *nmat, int siz, double mat1[],
                                    double mat2[]) {
   intptr_t i;
@@ -1839,6 +2388,7 @@ static void matrix_double_sub_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_mult_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
                                   YAP_Int mat2[]) {
   intptr_t i;
@@ -1848,6 +2398,7 @@ static void matrix_long_mult_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_mult_data(double *nmat, int siz, YAP_Int mat1[],
                                          double mat2[]) {
   intptr_t i;
@@ -1857,6 +2408,7 @@ static void matrix_long_double_mult_data(double *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_double_mult_data(double *nmat, int siz, double mat1[],
                                     double mat2[]) {
   intptr_t i;
@@ -1866,6 +2418,7 @@ static void matrix_double_mult_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_div_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
                                  YAP_Int mat2[]) {
   intptr_t i;
@@ -1875,6 +2428,7 @@ static void matrix_long_div_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_div_data(double *nmat, int siz, YAP_Int mat1[],
                                         double mat2[]) {
   intptr_t i;
@@ -1884,6 +2438,7 @@ static void matrix_long_double_div_data(double *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_div2_data(double *nmat, int siz, double mat1[],
                                          YAP_Int mat2[]) {
   intptr_t i;
@@ -1893,6 +2448,7 @@ static void matrix_long_double_div2_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_double_div_data(double *nmat, int siz, double mat1[],
                                    double mat2[]) {
   intptr_t i;
@@ -1902,6 +2458,7 @@ static void matrix_double_div_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_zdiv_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
                                   YAP_Int mat2[]) {
   intptr_t i;
@@ -1914,6 +2471,7 @@ static void matrix_long_zdiv_data(YAP_Int *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_zdiv_data(double *nmat, int siz, YAP_Int mat1[],
                                          double mat2[]) {
   intptr_t i;
@@ -1926,6 +2484,7 @@ static void matrix_long_double_zdiv_data(double *nmat, int siz, YAP_Int mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_long_double_zdiv2_data(double *nmat, int siz, double mat1[],
                                           YAP_Int mat2[]) {
   intptr_t i;
@@ -1938,6 +2497,7 @@ static void matrix_long_double_zdiv2_data(double *nmat, int siz, double mat1[],
   }
 }
 
+MATRIX_SIMD
 static void matrix_double_zdiv_data(double *nmat, int siz, double mat1[],
                                     double mat2[]) {
   intptr_t i;
@@ -1951,132 +2511,162 @@ static void matrix_double_zdiv_data(double *nmat, int siz, double mat1[],
   }
 }
 
-static YAP_Bool matrix_op(void) {
-  M mat1, mat2, nmat;
-  YAP_Term top = YAP_ARG3;
+typedef struct matrix_op_env {
   op_type op;
-  YAP_Term tf = YAP_ARG4;
-  int create = true;
-   if (!YAP_IsIntTerm(top)) {
-    return FALSE;
-  }
-  op = YAP_IntOfTerm(top);
-  if (GET_MATRIX(YAP_ARG1, &mat1)<0 ||
-  GET_MATRIX(YAP_ARG2, &mat2)<0) {
-  return false;
-  }
-   if (tf == YAP_ARG1 || tf == YAP_ARG2) {
-    create = false;
-  }
-   int mem= 0;
-   if (create && (mem = YAP_RequiresExtraStack(mat1.sz*2+4096)) > 0) {
-     GET_MATRIX(YAP_ARG1, &mat1);
-     GET_MATRIX(YAP_ARG2, &mat2);
-     } else if (mem<0) {
-       return false;
-     }
-      if (create) {
-	if (mat1.type == 'i' && mat2.type == 'i') {	    
-	  tf = new_int_matrix(mat1.ndims, mat1.dims, NULL);
-	  } else {
-	    tf = new_float_matrix(mat1.ndims, mat1.dims, NULL); 
-	}
-	  if (tf == YAP_TermNil()) {
-	    return FALSE;
-	  }
-     }else {
-       tf=YAP_ARG1;
-      }
-	GET_MATRIX(tf, &nmat);
-   if (mat1.type == 'i') {
+  M *mat1, *mat2, *nmat;
+} matrix_op_env;
+
+static void matrix_op_chunk(void *env, intptr_t lo, intptr_t hi, int slot) {
+  matrix_op_env *e = env;
+  M *mat1 = e->mat1, *mat2 = e->mat2, *nmat = e->nmat;
+  op_type op = e->op;
+  int n = hi - lo;
 
-    if (mat2.type == 'i') {
+  if (mat1->type == 'i') {
+    if (mat2->type == 'i') {
       switch (op) {
       case MAT_PLUS:
-        matrix_long_add_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
+        matrix_long_add_data(nmat->ls + lo, n, mat1->ls + lo, mat2->ls + lo);
         break;
       case MAT_SUB:
-        matrix_long_sub_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
+        matrix_long_sub_data(nmat->ls + lo, n, mat1->ls + lo, mat2->ls + lo);
         break;
       case MAT_TIMES:
-        matrix_long_mult_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
+        matrix_long_mult_data(nmat->ls + lo, n, mat1->ls + lo, mat2->ls + lo);
         break;
       case MAT_DIV:
-        matrix_long_div_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
+        matrix_long_div_data(nmat->ls + lo, n, mat1->ls + lo, mat2->ls + lo);
         break;
       case MAT_ZDIV:
-        matrix_long_zdiv_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
+        matrix_long_zdiv_data(nmat->ls + lo, n, mat1->ls + lo, mat2->ls + lo);
         break;
       default:
-        return FALSE;
+        break;
       }
-    } else if (mat2.type == 'f') {
+    } else if (mat2->type == 'f') {
       switch (op) {
       case MAT_PLUS:
-        matrix_long_double_add_data(nmat.data, nmat.sz, mat1.ls, mat2.data);
+        matrix_long_double_add_data(nmat->data + lo, n, mat1->ls + lo, mat2->data + lo);
         break;
       case MAT_SUB:
-      matrix_long_double_sub_data(nmat.data, nmat.sz, mat1.ls, mat2.data);
+        matrix_long_double_sub_data(nmat->data + lo, n, mat1->ls + lo, mat2->data + lo);
         break;
       case MAT_TIMES:
-      matrix_long_double_mult_data(nmat.data, nmat.sz, mat1.ls, mat2.data);
+        matrix_long_double_mult_data(nmat->data + lo, n, mat1->ls + lo, mat2->data + lo);
         break;
       case MAT_DIV:
-      matrix_long_double_div_data(nmat.data, nmat.sz, mat1.ls, mat2.data);
+        matrix_long_double_div_data(nmat->data + lo, n, mat1->ls + lo, mat2->data + lo);
         break;
       case MAT_ZDIV:
-        matrix_long_zdiv_data(nmat.ls, mat1.sz, mat1.ls, mat2.ls);
-	break;
+        matrix_long_double_zdiv_data(nmat->data + lo, n, mat1->ls + lo, mat2->data + lo);
+        break;
       default:
-        return FALSE;
+        break;
       }
-    } else {
-      return FALSE;
     }
   } else {
-    if (mat2.type == 'i') {
+    if (mat2->type == 'i') {
       switch (op) {
       case MAT_PLUS:
-        matrix_long_double_add_data(nmat.data, nmat.sz, mat2.ls, mat1.data);
+        matrix_long_double_add_data(nmat->data + lo, n, mat2->ls + lo, mat1->data + lo);
         break;
       case MAT_SUB:
-        matrix_long_double_rsub_data(nmat.data, nmat.sz, mat1.data, mat2.ls);
+        matrix_long_double_rsub_data(nmat->data + lo, n, mat1->data + lo, mat2->ls + lo);
         break;
       case MAT_TIMES:
-        matrix_long_double_mult_data(nmat.data, nmat.sz, mat2.ls, mat1.data  );
+        matrix_long_double_mult_data(nmat->data + lo, n, mat2->ls + lo, mat1->data + lo);
         break;
       case MAT_DIV:
-        matrix_long_double_div2_data(nmat.data, nmat.sz, mat1.data, mat2.ls);
+        matrix_long_double_div2_data(nmat->data + lo, n, mat1->data + lo, mat2->ls + lo);
         break;
       case MAT_ZDIV:
-        matrix_long_double_zdiv_data(nmat.data, nmat.sz, mat2.ls, mat1.data);
+        matrix_long_double_zdiv2_data(nmat->data + lo, n, mat1->data + lo, mat2->ls + lo);
         break;
       default:
-        return FALSE;
+        break;
       }
-    } else if (mat2.type == 'f') {
+    } else if (mat2->type == 'f') {
       switch (op) {
       case MAT_PLUS:
-        matrix_double_add_data(nmat.data, nmat.sz, mat1.data, mat2.data);
+        matrix_double_add_data(nmat->data + lo, n, mat1->data + lo, mat2->data + lo);
         break;
       case MAT_SUB:
-        matrix_double_sub_data(nmat.data, nmat.sz, mat1.data, mat2.data);
+        matrix_double_sub_data(nmat->data + lo, n, mat1->data + lo, mat2->data + lo);
         break;
       case MAT_TIMES:
-        matrix_double_mult_data(nmat.data, nmat.sz, mat1.data, mat2.data);
+        matrix_double_mult_data(nmat->data + lo, n, mat1->data + lo, mat2->data + lo);
         break;
       case MAT_DIV:
-        matrix_double_div_data(nmat.data, nmat.sz, mat1.data, mat2.data);
+        matrix_double_div_data(nmat->data + lo, n, mat1->data + lo, mat2->data + lo);
         break;
       case MAT_ZDIV:
-        matrix_double_zdiv_data(nmat.data, nmat.sz, mat1.data, mat2.data);
+        matrix_double_zdiv_data(nmat->data + lo, n, mat1->data + lo, mat2->data + lo);
         break;
       default:
-        return FALSE;
+        break;
       }
-    } else {
-      return FALSE;
     }
+  }
+}
+
+static YAP_Bool matrix_op(void) {
+  M mat1, mat2, nmat;
+  YAP_Term top = YAP_ARG3;
+  op_type op;
+  YAP_Term tf = YAP_ARG4;
+  int create = true;
+   if (!YAP_IsIntTerm(top)) {
+    return FALSE;
+  }
+  op = YAP_IntOfTerm(top);
+  if (GET_MATRIX(YAP_ARG1, &mat1)<0 ||
+  GET_MATRIX(YAP_ARG2, &mat2)<0) {
+  return false;
+  }
+   if (tf == YAP_ARG1 || tf == YAP_ARG2) {
+    create = false;
+  }
+   int mem= 0;
+   if (create && (mem = YAP_RequiresExtraStack(mat1.sz*2+4096)) > 0) {
+     GET_MATRIX(YAP_ARG1, &mat1);
+     GET_MATRIX(YAP_ARG2, &mat2);
+     } else if (mem<0) {
+       return false;
+     }
+      if (create) {
+	if (mat1.type == 'i' && mat2.type == 'i') {	    
+	  tf = new_int_matrix(mat1.ndims, mat1.dims, NULL);
+	  } else {
+	    tf = new_float_matrix(mat1.ndims, mat1.dims, NULL); 
+	}
+	  if (tf == YAP_TermNil()) {
+	    return FALSE;
+	  }
+     }else {
+       tf=YAP_ARG1;
+      }
+	GET_MATRIX(tf, &nmat);
+   if ((mat1.type != 'i' && mat1.type != 'f') ||
+       (mat2.type != 'i' && mat2.type != 'f')) {
+     return FALSE;
+   }
+   switch (op) {
+   case MAT_PLUS:
+   case MAT_SUB:
+   case MAT_TIMES:
+   case MAT_DIV:
+   case MAT_ZDIV:
+     break;
+   default:
+     return FALSE;
+   }
+   {
+     matrix_op_env e;
+     e.op = op;
+     e.mat1 = &mat1;
+     e.mat2 = &mat2;
+     e.nmat = &nmat;
+     matrix_par_for(nmat.sz, matrix_nthreads(nmat.sz), matrix_op_chunk, &e);
    }
 
   return YAP_Unify(YAP_ARG4, tf);
@@ -2400,7 +2990,16 @@ static YAP_Bool matrix_transpose(void) {
     we now got all the dimensions set up, so what we need to do
     next is to copy the elements to the new matrix.
   */
-  if (mat[MAT_TYPE] == INT_MATRIX) {
+  if (ndims == 2 && conv[0] == 1 && conv[1] == 0) {
+    /* plain transpose */
+    if (mat[MAT_TYPE] == INT_MATRIX)
+      matrix_transpose_data(false, matrix_long_data(mat, ndims),
+                            matrix_long_data(nmat, ndims), dims[0], dims[1]);
+    else
+      matrix_transpose_data(true, matrix_double_data(mat, ndims),
+                            matrix_double_data(nmat, ndims), dims[0],
+                            dims[1]);
+  } else if (mat[MAT_TYPE] == INT_MATRIX) {
     YAP_Int *data = matrix_long_data(mat, ndims);
     /* create a new matrix with the same size */
     for (i = 0; i < mat[MAT_SIZE]; i++) {
@@ -2432,6 +3031,61 @@ static YAP_Bool matrix_transpose(void) {
   return YAP_Unify(YAP_ARG3, tf);
 }
 
+/** @pred matrix_mult(+ _A_,+ _B_,- _C_)
+
+Unify  _C_ with the product of the float matrices  _A_ and  _B_.  _A_
+must have two dimensions `[N,K]`; if  _B_ is `[K,M]` then  _C_ is
+`[N,M]`, and if  _B_ is a vector of size `K` then  _C_ is a vector of
+size `N`.
+*/
+static YAP_Bool matrix_mult(void) {
+  intptr_t *a = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1);
+  intptr_t *b = (intptr_t *)YAP_BlobOfTerm(YAP_ARG2), *c;
+  intptr_t n, k, m, ndims[2];
+  YAP_Term tf;
+
+  if (!a || !b || a[MAT_TYPE] != FLOAT_MATRIX ||
+      b[MAT_TYPE] != FLOAT_MATRIX || a[MAT_NDIMS] != 2 ||
+      b[MAT_NDIMS] > 2)
+    return FALSE;
+  n = a[MAT_DIMS];
+  k = a[MAT_DIMS + 1];
+  if (b[MAT_DIMS] != k)
+    return FALSE;
+  m = b[MAT_NDIMS] == 2 ? b[MAT_DIMS + 1] : 1;
+  ndims[0] = n;
+  ndims[1] = m;
+  tf = new_float_matrix(b[MAT_NDIMS], ndims, NULL);
+  if (tf == YAP_TermNil())
+    return FALSE;
+  /* in case the matrices moved */
+  a = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1);
+  b = (intptr_t *)YAP_BlobOfTerm(YAP_ARG2);
+  c = (intptr_t *)YAP_BlobOfTerm(tf);
+  matrix_double_mult(matrix_double_data(a, 2),
+                     matrix_double_data(b, b[MAT_NDIMS]),
+                     matrix_double_data(c, c[MAT_NDIMS]), n, k, m);
+  return YAP_Unify(YAP_ARG3, tf);
+}
+
+/** @pred matrix_dot(+ _A_,+ _B_,- _Dot_)
+
+Unify  _Dot_ with the sum of the products of the elements of the float
+matrices  _A_ and  _B_, that must have the same size.
+*/
+static YAP_Bool matrix_dot(void) {
+  intptr_t *a = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1);
+  intptr_t *b = (intptr_t *)YAP_BlobOfTerm(YAP_ARG2);
+  double dot;
+
+  if (!a || !b || a[MAT_TYPE] != FLOAT_MATRIX ||
+      b[MAT_TYPE] != FLOAT_MATRIX || a[MAT_SIZE] != b[MAT_SIZE])
+    return FALSE;
+  dot = matrix_double_dot(matrix_double_data(a, a[MAT_NDIMS]),
+                          matrix_double_data(b, b[MAT_NDIMS]), a[MAT_SIZE]);
+  return YAP_Unify(YAP_ARG3, YAP_MkFloatTerm(dot));
+}
+
 /* given a matrix M and a set of dims, fold one of the dimensions of the
    matrix on one of the elements
 */
@@ -2603,7 +3257,7 @@ static YAP_Bool matrix_column(void) {
  */
 static YAP_Bool matrix_sum_out(void) {
   intptr_t ndims, i, j, newdims, prdim;
-  intptr_t indx[MAX_DIMS], nindx[MAX_DIMS];
+  intptr_t nindx[MAX_DIMS];
   YAP_Term tpdim, tf;
   intptr_t *mat = (intptr_t *)YAP_BlobOfTerm(YAP_ARG1), *nmat;
   if (!mat) {
@@ -2617,6 +3271,9 @@ static YAP_Bool matrix_sum_out(void) {
     return FALSE;
   }
   prdim = YAP_IntOfTerm(tpdim);
+  if (prdim < 0 || prdim >= ndims) {
+    return FALSE;
+  }
   newdims = ndims - 1;
   for (i = 0, j = 0; i < ndims; i++) {
     if (i != prdim) {
@@ -2636,23 +3293,7 @@ static YAP_Bool matrix_sum_out(void) {
     nmat = (intptr_t *)YAP_BlobOfTerm(tf);
     data = matrix_long_data(mat, ndims);
     ndata = matrix_long_data(nmat, newdims);
-    /* create a new matrix with smaller size */
-    for (i = 0; i < nmat[MAT_SIZE]; i++)
-      ndata[i] = 0;
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      int j, k;
-      /*
-        not very efficient, we could try to take advantage of the fact
-        that we usually only change an index at a time
-      */
-      matrix_get_index(mat, i, indx);
-      for (j = 0, k = 0; j < ndims; j++) {
-        if (j != prdim) {
-          nindx[k++] = indx[j];
-        }
-      }
-      ndata[matrix_get_offset(nmat, nindx)] += data[i];
-    }
+    matrix_sum_out_data(false, data, ndata, mat + MAT_DIMS, ndims, prdim);
   } else {
     double *data, *ndata;
 
@@ -2665,23 +3306,7 @@ static YAP_Bool matrix_sum_out(void) {
     nmat = (intptr_t *)YAP_BlobOfTerm(tf);
     data = matrix_double_data(mat, ndims);
     ndata = matrix_double_data(nmat, newdims);
-    /* create a new matrix with smaller size */
-    for (i = 0; i < nmat[MAT_SIZE]; i++)
-      ndata[i] = 0.0;
-    for (i = 0; i < mat[MAT_SIZE]; i++) {
-      int j, k;
-      /*
-        not very efficient, we could try to take advantage of the fact
-        that we usually only change an index at a time
-      */
-      matrix_get_index(mat, i, indx);
-      for (j = 0, k = 0; j < ndims; j++) {
-        if (j != prdim) {
-          nindx[k++] = indx[j];
-        }
-      }
-      ndata[matrix_get_offset(nmat, nindx)] += data[i];
-    }
+    matrix_sum_out_data(true, data, ndata, mat + MAT_DIMS, ndims, prdim);
   }
   return YAP_Unify(YAP_ARG3, tf);
 }
@@ -3225,6 +3850,8 @@ X_API void init_matrix(void) {
   YAP_UserCPredicate("matrix_offset_to_arg", matrix_offset_to_arg, 3);
   YAP_UserCPredicate("matrix_sum", matrix_sum, 2);
   YAP_UserCPredicate("matrix_shuffle", matrix_transpose, 3);
+  YAP_UserCPredicate("matrix_mult", matrix_mult, 3);
+  YAP_UserCPredicate("matrix_dot", matrix_dot, 3);
   YAP_UserCPredicate("matrix_expand", matrix_expand, 3);
   YAP_UserCPredicate("matrix_select", matrix_select, 4);
   YAP_UserCPredicate("matrix_column", matrix_column, 3);
@@ -0,0 +1,758 @@
+/*************************************************************************
+ *									 *
+ *	 YAP Prolog 							 *
+ *									 *
+ *	Yap Prolog was developed at NCCUP - Universidade do Porto	 *
+ *									 *
+ * Copyright L.Damas, V.S.Costa and Universidade do Porto 1985-1997	 *
+ *									 *
+ **************************************************************************
+ *									 *
+ * File:		regdfa.c						 *
+ * comments:	lazy DFA for match/no match regular expression tests	 *
+ *									 *
+ *************************************************************************/
+
+/**
+ * @file regdfa.c
+ *
+ * The expression is parsed into a tree, the tree into a Thompson NFA, and
+ * DFA states, sets of NFA states, are made on demand while strings are
+ * scanned and kept for the next strings. Matching is unanchored, so every
+ * step also enters the start state, and a string matches as soon as a
+ * state holds the final NFA state.
+ *
+ * Only the 7 bit characters are handled here: the meaning of the others
+ * depends on the locale, and the regexec engine takes care of them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "regdfa.h"
+
+/* parse tree */
+#define T_SET 0
+#define T_CAT 1
+#define T_ALT 2
+#define T_STAR 3
+#define T_PLUS 4
+#define T_QUEST 5
+#define T_REP 6
+#define T_BOL 7
+#define T_EOL 8
+#define T_EMPTY 9
+
+/* NFA states */
+#define N_SET 0
+#define N_SPLIT 1
+#define N_BOL 2
+#define N_EOL 3
+#define N_MATCH 4
+
+#define DFA_MAX_NFA 4096   /* NFA states, bigger expressions use regexec */
+#define DFA_MAX_STATES 2048 /* cached DFA states before a flush */
+#define DFA_MAX_DEPTH 256  /* parenthesis nesting */
+#define DFA_DUP_MAX 255    /* RE_DUP_MAX */
+
+typedef unsigned char charset[16]; /* bytes 0..127 */
+
+struct tree {
+  int op;
+  int l, r;     /* subtrees */
+  int min, max; /* T_REP bounds, max < 0 for no upper bound */
+  int set;      /* T_SET */
+};
+
+struct nfa {
+  int op;
+  int out, out1;
+  int set;
+};
+
+struct dstate {
+  int *set; /* sorted NFA states */
+  int n;
+  char accept;     /* holds the final state */
+  char eol_accept; /* would hold it at the end of the string */
+  int next[1];     /* actually [nclasses], -1 if not made yet */
+};
+
+struct regdfa {
+  struct nfa *nfa;
+  int nnfa;
+  charset *sets;
+  int nsets;
+  int start;
+
+  unsigned char classmap[256]; /* class 0 is for bytes we do not handle */
+  unsigned char classrep[256];
+  int nclasses;
+
+  struct dstate **states; /* states[0] is the start state */
+  int nstates;
+  int *table; /* open addressing hash of states[1..] */
+  int tsize;
+
+  /* closure scratch */
+  int *mark;
+  int gen;
+  int *stack;
+  int *work;
+  int nwork;
+};
+
+struct parse {
+  const unsigned char *p;
+  int icase;
+  int ok;
+  int lead; /* nothing can have been matched before this point */
+  int nbol; /* ^ seen so far */
+  int depth;
+  struct tree *trees;
+  int ntrees, maxtrees;
+  charset *sets;
+  int nsets, maxsets;
+};
+
+static int parse_alt(struct parse *ps);
+
+static int new_tree(struct parse *ps, int op, int l, int r) {
+  struct tree *t;
+
+  if (ps->ntrees == ps->maxtrees) {
+    int n = ps->maxtrees ? 2 * ps->maxtrees : 64;
+    struct tree *nt = realloc(ps->trees, n * sizeof(struct tree));
+    if (!nt) {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->trees = nt;
+    ps->maxtrees = n;
+  }
+  t = ps->trees + ps->ntrees;
+  t->op = op;
+  t->l = l;
+  t->r = r;
+  t->min = t->max = 0;
+  t->set = -1;
+  return ps->ntrees++;
+}
+
+static int new_set(struct parse *ps) {
+  if (ps->nsets == ps->maxsets) {
+    int n = ps->maxsets ? 2 * ps->maxsets : 16;
+    charset *ns = realloc(ps->sets, n * sizeof(charset));
+    if (!ns) {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->sets = ns;
+    ps->maxsets = n;
+  }
+  memset(ps->sets[ps->nsets], 0, sizeof(charset));
+  return ps->nsets++;
+}
+
+#define SET_IN(s, c) ((s)[(c) >> 3] & (1 << ((c)&7)))
+#define SET_ADD(s, c) ((s)[(c) >> 3] |= (1 << ((c)&7)))
+
+static void set_add(struct parse *ps, int set, int c) {
+  SET_ADD(ps->sets[set], c);
+  if (ps->icase && isalpha(c)) {
+    SET_ADD(ps->sets[set], tolower(c));
+    SET_ADD(ps->sets[set], toupper(c));
+  }
+}
+
+static int char_class(const char *name, size_t len, int c) {
+#define CLASS(N, F)                                                            \
+  if (len == sizeof(N) - 1 && !strncmp(name, N, len))                          \
+    return F(c) != 0;
+  CLASS("alpha", isalpha)
+  CLASS("digit", isdigit)
+  CLASS("alnum", isalnum)
+  CLASS("upper", isupper)
+  CLASS("lower", islower)
+  CLASS("space", isspace)
+  CLASS("blank", isblank)
+  CLASS("punct", ispunct)
+  CLASS("print", isprint)
+  CLASS("graph", isgraph)
+  CLASS("cntrl", iscntrl)
+  CLASS("xdigit", isxdigit)
+#undef CLASS
+  return -1;
+}
+
+/* [...], p is past the [ */
+static int parse_bracket(struct parse *ps) {
+  int set = new_set(ps), neg = 0, first = 1, c, t;
+
+  if (!ps->ok)
+    return 0;
+  if (*ps->p == '^') {
+    neg = 1;
+    ps->p++;
+  }
+  for (;; first = 0) {
+    c = *ps->p;
+    if (c == 0 || c > 127) {
+      ps->ok = 0;
+      return 0;
+    }
+    if (c == ']' && !first) {
+      ps->p++;
+      break;
+    }
+    if (c == '[' && (ps->p[1] == '=' || ps->p[1] == '.')) {
+      /* collating elements and equivalence classes */
+      ps->ok = 0;
+      return 0;
+    }
+    if (c == '[' && ps->p[1] == ':') {
+      const char *name = (const char *)ps->p + 2;
+      const char *end = strstr(name, ":]");
+      int b;
+
+      if (!end || char_class(name, end - name, 'a') < 0) {
+        ps->ok = 0;
+        return 0;
+      }
+      for (b = 1; b < 128; b++)
+        if (char_class(name, end - name, b))
+          set_add(ps, set, b);
+      ps->p = (const unsigned char *)end + 2;
+      continue;
+    }
+    if (ps->p[1] == '-' && ps->p[2] != ']' && ps->p[2] != 0) {
+      int hi = ps->p[2], b;
+
+      if (hi == '[' || hi > 127 || hi < c) {
+        ps->ok = 0;
+        return 0;
+      }
+      for (b = c; b <= hi; b++)
+        set_add(ps, set, b);
+      ps->p += 3;
+      continue;
+    }
+    set_add(ps, set, c);
+    ps->p++;
+  }
+  if (neg) {
+    int b;
+    for (b = 0; b < (int)sizeof(charset); b++)
+      ps->sets[set][b] = ~ps->sets[set][b];
+    ps->sets[set][0] &= ~1; /* NUL never matches */
+  }
+  t = new_tree(ps, T_SET, -1, -1);
+  if (ps->ok)
+    ps->trees[t].set = set;
+  return t;
+}
+
+static int parse_atom(struct parse *ps) {
+  int c = *ps->p, t, set;
+
+  switch (c) {
+  case '(':
+    ps->p++;
+    if (*ps->p == ')' || ++ps->depth > DFA_MAX_DEPTH) {
+      ps->ok = 0;
+      return 0;
+    }
+    t = parse_alt(ps);
+    ps->depth--;
+    if (*ps->p != ')') {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->p++;
+    return t;
+  case '^':
+    /* glibc does not always take a ^ after something else as an anchor */
+    if (!ps->lead) {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->p++;
+    ps->nbol++;
+    return new_tree(ps, T_BOL, -1, -1);
+  case '$':
+    /* nor a $ before something else, so only the last ones are ours */
+    for (t = 1; ps->p[t] == ')'; t++)
+      ;
+    if (ps->p[t] != 0 && (ps->p[t] != '|' || ps->depth != t - 1)) {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->p++;
+    return new_tree(ps, T_EOL, -1, -1);
+  case '[':
+    ps->p++;
+    return parse_bracket(ps);
+  case '.':
+    ps->p++;
+    set = new_set(ps);
+    if (!ps->ok)
+      return 0;
+    for (c = 1; c < 128; c++)
+      SET_ADD(ps->sets[set], c);
+    break;
+  case '\\':
+    c = ps->p[1];
+    /* back references and the GNU escapes are left to regexec */
+    if (c == 0 || c > 127 || isalnum(c) || c == '<' || c == '>' ||
+        c == '`' || c == '\'') {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->p += 2;
+    set = new_set(ps);
+    if (!ps->ok)
+      return 0;
+    set_add(ps, set, c);
+    break;
+  case '*':
+  case '+':
+  case '?':
+  case '{':
+  case 0:
+    ps->ok = 0;
+    return 0;
+  default:
+    if (c > 127) {
+      ps->ok = 0;
+      return 0;
+    }
+    ps->p++;
+    set = new_set(ps);
+    if (!ps->ok)
+      return 0;
+    set_add(ps, set, c);
+  }
+  t = new_tree(ps, T_SET, -1, -1);
+  if (ps->ok)
+    ps->trees[t].set = set;
+  return t;
+}
+
+static int parse_bound(struct parse *ps) {
+  int n = 0;
+
+  if (!isdigit(*ps->p)) {
+    ps->ok = 0;
+    return 0;
+  }
+  while (isdigit(*ps->p)) {
+    n = 10 * n + (*ps->p++ - '0');
+    if (n > DFA_DUP_MAX) {
+      ps->ok = 0;
+      return 0;
+    }
+  }
+  return n;
+}
+
+static int parse_rep(struct parse *ps) {
+  int nbol = ps->nbol, t = parse_atom(ps), min, max;
+
+  if (ps->ok && (ps->nbol != nbol || ps->trees[t].op == T_EOL) &&
+      (*ps->p == '*' || *ps->p == '+' || *ps->p == '?' || *ps->p == '{')) {
+    /* a repeated ^ is not at the start any more, and regexec may take
+       the operator after an anchor as a literal */
+    ps->ok = 0;
+    return 0;
+  }
+  while (ps->ok) {
+    switch (*ps->p) {
+    case '*':
+      t = new_tree(ps, T_STAR, t, -1);
+      break;
+    case '+':
+      t = new_tree(ps, T_PLUS, t, -1);
+      break;
+    case '?':
+      t = new_tree(ps, T_QUEST, t, -1);
+      break;
+    case '{':
+      ps->p++;
+      min = max = parse_bound(ps);
+      if (*ps->p == ',') {
+        ps->p++;
+        max = (*ps->p == '}') ? -1 : parse_bound(ps);
+      }
+      if (!ps->ok || *ps->p != '}' || (max >= 0 && max < min)) {
+        ps->ok = 0;
+        return 0;
+      }
+      t = new_tree(ps, T_REP, t, -1);
+      if (ps->ok) {
+        ps->trees[t].min = min;
+        ps->trees[t].max = max;
+      }
+      break;
+    default:
+      return t;
+    }
+    ps->p++;
+  }
+  return 0;
+}
+
+static int parse_cat(struct parse *ps) {
+  int t = -1, a, lead = ps->lead;
+
+  while (ps->ok && *ps->p && *ps->p != '|' && *ps->p != ')') {
+    a = parse_rep(ps);
+    t = (t < 0) ? a : new_tree(ps, T_CAT, t, a);
+    ps->lead = 0;
+  }
+  ps->lead = lead;
+  if (t < 0)
+    t = new_tree(ps, T_EMPTY, -1, -1);
+  return t;
+}
+
+static int parse_alt(struct parse *ps) {
+  int t = parse_cat(ps);
+
+  while (ps->ok && *ps->p == '|') {
+    ps->p++;
+    t = new_tree(ps, T_ALT, t, parse_cat(ps));
+  }
+  return t;
+}
+
+/* NFA construction, right to left: next is the continuation */
+
+static int new_nfa(regdfa_t *d, int op, int out, int out1, int set) {
+  if (d->nnfa == DFA_MAX_NFA)
+    return -1;
+  d->nfa[d->nnfa].op = op;
+  d->nfa[d->nnfa].out = out;
+  d->nfa[d->nnfa].out1 = out1;
+  d->nfa[d->nnfa].set = set;
+  return d->nnfa++;
+}
+
+static int compile(regdfa_t *d, struct tree *trees, int t, int next) {
+  struct tree *tr = trees + t;
+  int s, b, i;
+
+  if (next < 0)
+    return -1;
+  switch (tr->op) {
+  case T_SET:
+    return new_nfa(d, N_SET, next, -1, tr->set);
+  case T_CAT:
+    return compile(d, trees, tr->l, compile(d, trees, tr->r, next));
+  case T_ALT:
+    s = compile(d, trees, tr->l, next);
+    b = compile(d, trees, tr->r, next);
+    if (s < 0 || b < 0)
+      return -1;
+    return new_nfa(d, N_SPLIT, s, b, -1);
+  case T_STAR:
+  case T_PLUS:
+    if ((s = new_nfa(d, N_SPLIT, -1, next, -1)) < 0 ||
+        (b = compile(d, trees, tr->l, s)) < 0)
+      return -1;
+    d->nfa[s].out = b;
+    return tr->op == T_STAR ? s : b;
+  case T_QUEST:
+    if ((b = compile(d, trees, tr->l, next)) < 0)
+      return -1;
+    return new_nfa(d, N_SPLIT, b, next, -1);
+  case T_REP:
+    /* x{m,n} is m copies of x then n-m nested optional ones */
+    if (tr->max < 0) {
+      if ((s = new_nfa(d, N_SPLIT, -1, next, -1)) < 0 ||
+          (b = compile(d, trees, tr->l, s)) < 0)
+        return -1;
+      d->nfa[s].out = b;
+      next = s;
+    } else {
+      int tail = next;
+      for (i = tr->min; i < tr->max; i++) {
+        if ((b = compile(d, trees, tr->l, tail)) < 0 ||
+            (tail = new_nfa(d, N_SPLIT, b, next, -1)) < 0)
+          return -1;
+      }
+      next = tail;
+    }
+    for (i = 0; i < tr->min; i++)
+      if ((next = compile(d, trees, tr->l, next)) < 0)
+        return -1;
+    return next;
+  case T_BOL:
+    return new_nfa(d, N_BOL, next, -1, -1);
+  case T_EOL:
+    return new_nfa(d, N_EOL, next, -1, -1);
+  default: /* T_EMPTY */
+    return next;
+  }
+}
+
+/* bytes that no set tells apart share a class, and a row entry */
+static void make_classes(regdfa_t *d) {
+  unsigned char cls[256];
+  int map[512], s, b, n = 2;
+
+  for (b = 0; b < 256; b++)
+    cls[b] = (b > 0 && b < 128);
+  for (s = 0; s < d->nsets; s++) {
+    for (b = 0; b < 2 * n; b++)
+      map[b] = -1;
+    n = 0;
+    for (b = 0; b < 256; b++) {
+      int k = 2 * cls[b] + (b < 128 && SET_IN(d->sets[s], b) != 0);
+      if (map[k] < 0)
+        map[k] = n++;
+      cls[b] = map[k];
+    }
+  }
+  for (b = 255; b >= 0; b--) {
+    d->classmap[b] = cls[b];
+    d->classrep[cls[b]] = b;
+  }
+  d->nclasses = n;
+}
+
+/* follows the empty moves from s, adding the states that matter */
+static void closure(regdfa_t *d, int s, int bol) {
+  int sp = 0;
+
+  d->stack[sp++] = s;
+  while (sp) {
+    s = d->stack[--sp];
+    if (d->mark[s] == d->gen)
+      continue;
+    d->mark[s] = d->gen;
+    switch (d->nfa[s].op) {
+    case N_SPLIT:
+      d->stack[sp++] = d->nfa[s].out1;
+      d->stack[sp++] = d->nfa[s].out;
+      break;
+    case N_BOL:
+      if (bol)
+        d->stack[sp++] = d->nfa[s].out;
+      break;
+    default: /* N_SET, N_EOL, N_MATCH */
+      d->work[d->nwork++] = s;
+    }
+  }
+}
+
+/* does the end of the string take some N_EOL in set to the final state? */
+static int eol_accepts(regdfa_t *d, const int *set, int n, int bol) {
+  int i, sp = 0, s;
+
+  d->gen++;
+  for (i = 0; i < n; i++)
+    if (d->nfa[set[i]].op == N_EOL)
+      d->stack[sp++] = set[i];
+  while (sp) {
+    s = d->stack[--sp];
+    if (d->mark[s] == d->gen)
+      continue;
+    d->mark[s] = d->gen;
+    switch (d->nfa[s].op) {
+    case N_MATCH:
+      return 1;
+    case N_SPLIT:
+      d->stack[sp++] = d->nfa[s].out1;
+      d->stack[sp++] = d->nfa[s].out;
+      break;
+    case N_BOL:
+      if (bol)
+        d->stack[sp++] = d->nfa[s].out;
+      break;
+    case N_EOL:
+      d->stack[sp++] = d->nfa[s].out;
+      break;
+    default:
+      break;
+    }
+  }
+  return 0;
+}
+
+static int int_compare(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+static unsigned int set_hash(const int *set, int n) {
+  unsigned int h = 2166136261u;
+  int i;
+
+  for (i = 0; i < n; i++)
+    h = (h ^ (unsigned int)set[i]) * 16777619u;
+  return h;
+}
+
+static struct dstate *new_dstate(regdfa_t *d, int bol) {
+  struct dstate *ds;
+  int i;
+
+  ds = malloc(sizeof(struct dstate) + (d->nclasses - 1) * sizeof(int));
+  if (!ds)
+    return NULL;
+  if (!(ds->set = malloc((d->nwork ? d->nwork : 1) * sizeof(int)))) {
+    free(ds);
+    return NULL;
+  }
+  memcpy(ds->set, d->work, d->nwork * sizeof(int));
+  ds->n = d->nwork;
+  ds->accept = 0;
+  for (i = 0; i < ds->n; i++)
+    if (d->nfa[ds->set[i]].op == N_MATCH)
+      ds->accept = 1;
+  ds->eol_accept = ds->accept || eol_accepts(d, ds->set, ds->n, bol);
+  for (i = 0; i < d->nclasses; i++)
+    ds->next[i] = -1;
+  return ds;
+}
+
+static void free_dstate(struct dstate *ds) {
+  free(ds->set);
+  free(ds);
+}
+
+/* forgets every state but the start one */
+static void flush(regdfa_t *d) {
+  int i;
+
+  for (i = 1; i < d->nstates; i++)
+    free_dstate(d->states[i]);
+  d->nstates = 1;
+  for (i = 0; i < d->nclasses; i++)
+    d->states[0]->next[i] = -1;
+  for (i = 0; i < d->tsize; i++)
+    d->table[i] = 0;
+}
+
+/* the state after class k in state from, -1 if the cache is full */
+static int step(regdfa_t *d, int from, int k) {
+  struct dstate *ds = d->states[from], *nds;
+  int c = d->classrep[k], i, h;
+
+  d->gen++;
+  d->nwork = 0;
+  for (i = 0; i < ds->n; i++) {
+    struct nfa *n = d->nfa + ds->set[i];
+    if (n->op == N_SET && SET_IN(d->sets[n->set], c))
+      closure(d, n->out, 0);
+  }
+  closure(d, d->start, 0);
+  qsort(d->work, d->nwork, sizeof(int), int_compare);
+  h = set_hash(d->work, d->nwork) & (d->tsize - 1);
+  while ((i = d->table[h])) {
+    nds = d->states[i];
+    if (nds->n == d->nwork &&
+        !memcmp(nds->set, d->work, d->nwork * sizeof(int))) {
+      ds->next[k] = i;
+      return i;
+    }
+    h = (h + 1) & (d->tsize - 1);
+  }
+  if (d->nstates == DFA_MAX_STATES || !(nds = new_dstate(d, 0)))
+    return -1;
+  d->table[h] = d->nstates;
+  d->states[d->nstates] = nds;
+  ds->next[k] = d->nstates;
+  return d->nstates++;
+}
+
+regdfa_t *yap_regdfa_new(const char *pattern, int icase) {
+  struct parse ps;
+  regdfa_t *d;
+  int t;
+
+  memset(&ps, 0, sizeof(ps));
+  ps.p = (const unsigned char *)pattern;
+  ps.icase = icase;
+  ps.ok = 1;
+  ps.lead = 1;
+  t = parse_alt(&ps);
+  if (ps.ok && *ps.p)
+    ps.ok = 0; /* a ) without ( */
+  if (!ps.ok || !(d = calloc(1, sizeof(regdfa_t)))) {
+    free(ps.trees);
+    free(ps.sets);
+    return NULL;
+  }
+  d->sets = ps.sets;
+  d->nsets = ps.nsets;
+  if ((d->nfa = malloc(DFA_MAX_NFA * sizeof(struct nfa))))
+    d->start = compile(d, ps.trees, t, new_nfa(d, N_MATCH, -1, -1, -1));
+  free(ps.trees);
+  if (!d->nfa || d->start < 0) {
+    yap_regdfa_free(d);
+    return NULL;
+  }
+  make_classes(d);
+  d->tsize = 2 * DFA_MAX_STATES;
+  d->mark = calloc(d->nnfa, sizeof(int));
+  /* states push their successors once, and eol_accepts starts from a set */
+  d->stack = malloc((3 * d->nnfa + 1) * sizeof(int));
+  d->work = malloc(d->nnfa * sizeof(int));
+  d->table = calloc(d->tsize, sizeof(int));
+  d->states = malloc(DFA_MAX_STATES * sizeof(struct dstate *));
+  if (!d->mark || !d->stack || !d->work || !d->table || !d->states) {
+    yap_regdfa_free(d);
+    return NULL;
+  }
+  d->gen = 1;
+  d->nwork = 0;
+  closure(d, d->start, 1);
+  qsort(d->work, d->nwork, sizeof(int), int_compare);
+  if (!(d->states[0] = new_dstate(d, 1))) {
+    yap_regdfa_free(d);
+    return NULL;
+  }
+  d->nstates = 1;
+  return d;
+}
+
+int yap_regdfa_exec(regdfa_t *d, const char *string) {
+  const unsigned char *p = (const unsigned char *)string;
+  int s = 0, k, n;
+
+  if (d->states[0]->accept)
+    return REGDFA_MATCH;
+  while (*p) {
+    if ((k = d->classmap[*p++]) == 0)
+      return REGDFA_UNKNOWN;
+    if ((n = d->states[s]->next[k]) < 0 && (n = step(d, s, k)) < 0) {
+      /* too many states: start afresh with the next string */
+      flush(d);
+      return REGDFA_UNKNOWN;
+    }
+    s = n;
+    if (d->states[s]->accept)
+      return REGDFA_MATCH;
+  }
+  return d->states[s]->eol_accept ? REGDFA_MATCH : REGDFA_NOMATCH;
+}
+
+void yap_regdfa_free(regdfa_t *d) {
+  int i;
+
+  if (!d)
+    return;
+  if (d->states) {
+    for (i = 0; i < d->nstates; i++)
+      free_dstate(d->states[i]);
+    free(d->states);
+  }
+  free(d->table);
+  free(d->work);
+  free(d->stack);
+  free(d->mark);
+  free(d->nfa);
+  free(d->sets);
+  free(d);
+}
@@ -0,0 +1,38 @@
+/*************************************************************************
+ *									 *
+ *	 YAP Prolog 							 *
+ *									 *
+ *	Yap Prolog was developed at NCCUP - Universidade do Porto	 *
+ *									 *
+ * Copyright L.Damas, V.S.Costa and Universidade do Porto 1985-1997	 *
+ *									 *
+ **************************************************************************
+ *									 *
+ * File:		regdfa.h						 *
+ * comments:	lazy DFA for match/no match regular expression tests	 *
+ *									 *
+ *************************************************************************/
+
+#ifndef _REGDFA_H_
+#define _REGDFA_H_
+
+/*
+ * A lazy DFA answers whether a POSIX extended regular expression matches
+ * somewhere in a string, building its states the first time the string
+ * needs them. It covers expressions without back references: anything it
+ * does not understand makes yap_regdfa_new return NULL, and strings it
+ * can not decide (non-ASCII bytes, a full state cache) return
+ * REGDFA_UNKNOWN, so that callers use the regexec engine instead.
+ */
+
+#define REGDFA_NOMATCH 0
+#define REGDFA_MATCH 1
+#define REGDFA_UNKNOWN (-1)
+
+typedef struct regdfa regdfa_t;
+
+extern regdfa_t *yap_regdfa_new(const char *pattern, int icase);
+extern int yap_regdfa_exec(regdfa_t *dfa, const char *string);
+extern void yap_regdfa_free(regdfa_t *dfa);
+
+#endif /* _REGDFA_H_ */
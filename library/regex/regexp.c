@@ -37,103 +37,290 @@
 #endif
 /* for the sake of NULL */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include "YapBlobs.h"
+#include "regdfa.h"
 
 void init_regexp(void);
 
-static YAP_Bool check_regexp(void) {
-  unsigned int buflen = (unsigned int)YAP_IntOfTerm(YAP_ARG2) + 1;
-  unsigned int sbuflen = (unsigned int)YAP_IntOfTerm(YAP_ARG4) + 1;
-  char *buf, *sbuf;
+/*
+ * Compiled expressions are cached by text and flags, so that a program
+ * matching the same expression against many strings compiles it once.
+ * The cache keeps the most recently used REGEX_CACHE_SIZE expressions;
+ * those that have been given a handle by compile_regexp/3 stay forever,
+ * as handles are atoms and nothing tells us when the last one goes away.
+ */
+#define REGEX_CACHE_SIZE 64
+#define REGEX_HASH_SIZE 256
+
+typedef struct regex_entry {
+  char *pattern;
+  int flags; /* regcomp flags */
+  unsigned int hash;
   regex_t reg;
-  int out;
-  int yap_flags = YAP_IntOfTerm(YAP_ARG5);
-  int regcomp_flags = REG_NOSUB | REG_EXTENDED;
+  regdfa_t *dfa; /* lazy DFA for match tests, NULL if regexec must do */
+  int dfa_tried;
+  int pinned;                        /* has a handle, never evicted */
+  struct regex_entry *chain;         /* hash bucket */
+  struct regex_entry *newer, *older; /* LRU list of the unpinned ones */
+} regex_entry;
 
-  if ((buf = (char *)YAP_AllocSpaceFromYap(buflen)) == NULL) {
-    /* early exit */
-    return (FALSE);
+static regex_entry *regex_table[REGEX_HASH_SIZE];
+static regex_entry *regex_newest, *regex_oldest;
+static int regex_cached;
+
+#if HAVE_PTHREAD_H
+static pthread_mutex_t regex_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_REGEX() pthread_mutex_lock(&regex_lock)
+#define UNLOCK_REGEX() pthread_mutex_unlock(&regex_lock)
+#else
+#define LOCK_REGEX()
+#define UNLOCK_REGEX()
+#endif
+
+static int regex_blob_write(void *s, YAP_Atom a, int flags) {
+  regex_entry *e = *(regex_entry **)YAP_blob_data(a, NULL, NULL);
+
+  return fprintf((FILE *)s, "<regexp>(%s)", e->pattern);
+}
+
+static blob_type_t regex_blob = {
+    PL_BLOB_MAGIC, PL_BLOB_UNIQUE | PL_BLOB_NOCOPY, "regexp",
+    0,                // release
+    0,                // compare
+    regex_blob_write, // write
+    0                 // acquire
+};
+
+static void lru_unlink(regex_entry *e) {
+  if (e->newer)
+    e->newer->older = e->older;
+  else
+    regex_newest = e->older;
+  if (e->older)
+    e->older->newer = e->newer;
+  else
+    regex_oldest = e->newer;
+  e->newer = e->older = NULL;
+}
+
+static void lru_push(regex_entry *e) {
+  e->older = regex_newest;
+  e->newer = NULL;
+  if (regex_newest)
+    regex_newest->newer = e;
+  else
+    regex_oldest = e;
+  regex_newest = e;
+}
+
+static void regex_evict(void) {
+  regex_entry *e = regex_oldest, **ep;
+
+  lru_unlink(e);
+  for (ep = &regex_table[e->hash % REGEX_HASH_SIZE]; *ep != e;
+       ep = &(*ep)->chain)
+    ;
+  *ep = e->chain;
+  regex_cached--;
+  yap_regfree(&e->reg);
+  yap_regdfa_free(e->dfa);
+  free(e->pattern);
+  free(e);
+}
+
+static unsigned int regex_hash(const char *s, int flags) {
+  unsigned int h = 2166136261u ^ (unsigned int)flags;
+
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+/* the compiled form of pattern, NULL if it does not compile */
+static regex_entry *regex_lookup(const char *pattern, int flags) {
+  unsigned int h = regex_hash(pattern, flags);
+  regex_entry *e;
+
+  for (e = regex_table[h % REGEX_HASH_SIZE]; e; e = e->chain)
+    if (e->hash == h && e->flags == flags && !strcmp(e->pattern, pattern)) {
+      if (!e->pinned && e != regex_newest) {
+        lru_unlink(e);
+        lru_push(e);
+      }
+      return e;
+    }
+  if ((e = calloc(1, sizeof(regex_entry))) == NULL)
+    return NULL;
+  if ((e->pattern = strdup(pattern)) == NULL ||
+      yap_regcomp(&e->reg, pattern, flags) != 0) {
+    free(e->pattern);
+    free(e);
+    return NULL;
   }
-  if (YAP_StringToBuffer(YAP_ARG1, buf, buflen) == FALSE) {
-    /* something went wrong, possibly a type checking error */
-    YAP_FreeSpaceFromYap(buf);
-    return (FALSE);
+  e->flags = flags;
+  e->hash = h;
+  e->chain = regex_table[h % REGEX_HASH_SIZE];
+  regex_table[h % REGEX_HASH_SIZE] = e;
+  lru_push(e);
+  if (++regex_cached > REGEX_CACHE_SIZE)
+    regex_evict();
+  return e;
+}
+
+/*
+ * The text of a code or char list, atom or string, in UTF-8. Lists are
+ * copied to a buffer that grows as needed and that the caller frees.
+ */
+static const char *regex_text(YAP_Term t, char **buf, size_t *size) {
+  YAP_Int len;
+  char *p;
+
+  if (t == YAP_TermNil())
+    return "";
+  if (YAP_IsAtomTerm(t))
+    return YAP_AtomName(YAP_AtomOfTerm(t));
+  if (YAP_IsStringTerm(t))
+    return YAP_StringOfTerm(t);
+  if ((len = YAP_ListLength(t)) < 0)
+    return NULL;
+  /* up to 4 bytes a character */
+  if (*size < 4 * (size_t)len + 1) {
+    char *nbuf = realloc(*buf, 4 * len + 1);
+    if (nbuf == NULL)
+      return NULL;
+    *buf = nbuf;
+    *size = 4 * len + 1;
   }
-  if (yap_flags & 1)
-    regcomp_flags |= REG_ICASE;
-  /* cool, now I have my string in the buffer, let's have some fun */
-  if (yap_regcomp(&reg, buf, regcomp_flags) != 0)
-    return (FALSE);
-  if ((sbuf = (char *)YAP_AllocSpaceFromYap(sbuflen)) == NULL) {
-    /* early exit */
-    yap_regfree(&reg);
-    YAP_FreeSpaceFromYap(buf);
-    return (FALSE);
+  for (p = *buf; YAP_IsPairTerm(t); t = YAP_TailOfTerm(t)) {
+    YAP_Term h = YAP_HeadOfTerm(t);
+    YAP_Int c;
+
+    if (YAP_IsIntTerm(h)) {
+      c = YAP_IntOfTerm(h);
+    } else if (YAP_IsAtomTerm(h)) {
+      const unsigned char *a =
+          (const unsigned char *)YAP_AtomName(YAP_AtomOfTerm(h));
+      size_t n = strlen((const char *)a);
+      if (n == 0 || n > 4)
+        return NULL;
+      memcpy(p, a, n);
+      p += n;
+      continue;
+    } else {
+      return NULL;
+    }
+    if (c <= 0 || c > 0x10FFFF) {
+      return NULL;
+    } else if (c < 0x80) {
+      *p++ = c;
+    } else if (c < 0x800) {
+      *p++ = 0xC0 | (c >> 6);
+      *p++ = 0x80 | (c & 0x3F);
+    } else if (c < 0x10000) {
+      *p++ = 0xE0 | (c >> 12);
+      *p++ = 0x80 | ((c >> 6) & 0x3F);
+      *p++ = 0x80 | (c & 0x3F);
+    } else {
+      *p++ = 0xF0 | (c >> 18);
+      *p++ = 0x80 | ((c >> 12) & 0x3F);
+      *p++ = 0x80 | ((c >> 6) & 0x3F);
+      *p++ = 0x80 | (c & 0x3F);
+    }
   }
-  if (YAP_StringToBuffer(YAP_ARG3, sbuf, sbuflen) == FALSE) {
-    /* something went wrong, possibly a type checking error */
-    yap_regfree(&reg);
-    YAP_FreeSpaceFromYap(buf);
-    YAP_FreeSpaceFromYap(sbuf);
-    return (FALSE);
+  *p = '\0';
+  return *buf;
+}
+
+/*
+ * The compiled expression for a handle, or for the text of t. Must be
+ * called with the cache locked, and used before unlocking it.
+ */
+static regex_entry *regex_of_term(YAP_Term t, int yap_flags) {
+  char *buf = NULL;
+  size_t size = 0;
+  const char *s;
+  regex_entry *e;
+
+  if (YAP_IsAtomTerm(t) && t != YAP_TermNil()) {
+    blob_type_t *type;
+    void *data = YAP_blob_data(YAP_AtomOfTerm(t), NULL, &type);
+    if (type == &regex_blob)
+      return *(regex_entry **)data;
   }
-  out = yap_regexec(&reg, sbuf, 0, NULL, 0);
-  yap_regfree(&reg);
-  YAP_FreeSpaceFromYap(buf);
-  YAP_FreeSpaceFromYap(sbuf);
-  if (out != 0 && out != REG_NOMATCH) {
-    return (FALSE);
+  if ((s = regex_text(t, &buf, &size)) == NULL)
+    return NULL;
+  e = regex_lookup(s, REG_EXTENDED | ((yap_flags & 1) ? REG_ICASE : 0));
+  free(buf);
+  return e;
+}
+
+/* 0 on a match, like regexec */
+static int regex_match(regex_entry *e, const char *s) {
+  if (!e->dfa_tried) {
+    e->dfa = yap_regdfa_new(e->pattern, (e->flags & REG_ICASE) != 0);
+    e->dfa_tried = TRUE;
   }
+  if (e->dfa) {
+    switch (yap_regdfa_exec(e->dfa, s)) {
+    case REGDFA_MATCH:
+      return 0;
+    case REGDFA_NOMATCH:
+      return REG_NOMATCH;
+    default:
+      break;
+    }
+  }
+  return yap_regexec(&e->reg, s, 0, NULL, 0);
+}
+
+static YAP_Bool check_regexp(void) {
+  int yap_flags = YAP_IntOfTerm(YAP_ARG3);
+  char *buf = NULL;
+  size_t size = 0;
+  const char *s;
+  regex_entry *e;
+  int out = REG_NOMATCH;
+
+  LOCK_REGEX();
+  if ((e = regex_of_term(YAP_ARG1, yap_flags)) != NULL &&
+      (s = regex_text(YAP_ARG2, &buf, &size)) != NULL)
+    out = regex_match(e, s);
+  UNLOCK_REGEX();
+  free(buf);
   return (out == 0);
 }
 
 static YAP_Bool regexp(void) {
-  unsigned int buflen = (unsigned int)YAP_IntOfTerm(YAP_ARG2) + 1;
-  unsigned int sbuflen = (unsigned int)YAP_IntOfTerm(YAP_ARG4) + 1;
-  char *buf, *sbuf;
-  regex_t reg;
+  int yap_flags = YAP_IntOfTerm(YAP_ARG3);
+  char *buf = NULL;
+  size_t size = 0;
+  const char *sbuf;
+  regex_entry *e;
   int out;
   size_t nmatch;
   regmatch_t *pmatch;
   long int tout;
-  int yap_flags = YAP_IntOfTerm(YAP_ARG5);
-  int regcomp_flags = REG_EXTENDED;
 
-  if ((buf = (char *)YAP_AllocSpaceFromYap(buflen)) == NULL) {
-    /* early exit */
-    return (FALSE);
-  }
-  if (YAP_StringToBuffer(YAP_ARG1, buf, buflen) == FALSE) {
-    /* something went wrong, possibly a type checking error */
-    YAP_FreeSpaceFromYap(buf);
+  LOCK_REGEX();
+  if ((e = regex_of_term(YAP_ARG1, yap_flags)) == NULL ||
+      (sbuf = regex_text(YAP_ARG2, &buf, &size)) == NULL) {
+    UNLOCK_REGEX();
+    free(buf);
     return (FALSE);
   }
-  if (yap_flags & 1)
-    regcomp_flags |= REG_ICASE;
-  /* cool, now I have my string in the buffer, let's have some fun */
-  if (yap_regcomp(&reg, buf, regcomp_flags) != 0) {
-    YAP_FreeSpaceFromYap(buf);
-    return (FALSE);
-  }
-  if (YAP_IsVarTerm(YAP_ARG7)) {
-    nmatch = reg.re_nsub;
+  if (YAP_IsVarTerm(YAP_ARG5)) {
+    nmatch = e->reg.re_nsub;
   } else {
-    nmatch = YAP_IntOfTerm(YAP_ARG7);
-  }
-  if ((sbuf = (char *)YAP_AllocSpaceFromYap(sbuflen)) == NULL) {
-    /* early exit */
-    yap_regfree(&reg);
-    YAP_FreeSpaceFromYap(buf);
-    return (FALSE);
-  }
-  if (YAP_StringToBuffer(YAP_ARG3, sbuf, sbuflen) == FALSE) {
-    /* something went wrong, possibly a type checking error */
-    yap_regfree(&reg);
-    YAP_FreeSpaceFromYap(buf);
-    YAP_FreeSpaceFromYap(sbuf);
-    return (FALSE);
+    nmatch = YAP_IntOfTerm(YAP_ARG5);
   }
   pmatch = YAP_AllocSpaceFromYap(sizeof(regmatch_t) * (nmatch));
-  out = yap_regexec(&reg, sbuf, nmatch, pmatch, 0);
+  out = yap_regexec(&e->reg, sbuf, nmatch, pmatch, 0);
+  UNLOCK_REGEX();
   if (out == 0) {
     /* match succeed, let's fill the match in */
     long int i;
@@ -159,20 +346,84 @@ static YAP_Bool regexp(void) {
         tout = YAP_MkPairTerm(t, tout);
       }
     }
-    out = !YAP_Unify(tout, YAP_ARG6);
+    out = !YAP_Unify(tout, YAP_ARG4);
   } else if (out != REG_NOMATCH) {
     out = 0;
   }
-  yap_regfree(&reg);
-  YAP_FreeSpaceFromYap(buf);
-  YAP_FreeSpaceFromYap(sbuf);
+  free(buf);
   YAP_FreeSpaceFromYap(pmatch);
   return (out == 0);
 }
 
+/* a handle for a compiled expression, kept for as long as YAP runs */
+static YAP_Bool compile_regexp(void) {
+  regex_entry *e;
+  YAP_Term t;
+
+  LOCK_REGEX();
+  if ((e = regex_of_term(YAP_ARG1, YAP_IntOfTerm(YAP_ARG2))) == NULL) {
+    UNLOCK_REGEX();
+    return FALSE;
+  }
+  if (!e->pinned) {
+    lru_unlink(e);
+    regex_cached--;
+    e->pinned = TRUE;
+  }
+  UNLOCK_REGEX();
+  if (!YAP_unify_blob(&t, &e, sizeof(e), &regex_blob))
+    return FALSE;
+  return YAP_Unify(YAP_ARG3, t);
+}
+
+/*
+ * The strings of a list that match, in order. Space for the answer is
+ * made first, as a garbage collection would move the elements we keep.
+ */
+static YAP_Bool filter_regexp(void) {
+  YAP_Int n = YAP_ListLength(YAP_ARG3);
+  YAP_Term l, *keep;
+  char *buf = NULL;
+  size_t size = 0, nkeep = 0;
+  const char *s;
+  regex_entry *e;
+
+  if (n < 0)
+    return FALSE;
+  if (YAP_RequiresExtraStack(2 * n + 1024) < 0)
+    return FALSE;
+  if ((keep = malloc((n ? n : 1) * sizeof(YAP_Term))) == NULL)
+    return FALSE;
+  LOCK_REGEX();
+  if ((e = regex_of_term(YAP_ARG1, YAP_IntOfTerm(YAP_ARG2))) == NULL) {
+    UNLOCK_REGEX();
+    free(keep);
+    return FALSE;
+  }
+  for (l = YAP_ARG3; YAP_IsPairTerm(l); l = YAP_TailOfTerm(l)) {
+    YAP_Term h = YAP_HeadOfTerm(l);
+    if ((s = regex_text(h, &buf, &size)) == NULL) {
+      UNLOCK_REGEX();
+      free(buf);
+      free(keep);
+      return FALSE;
+    }
+    if (regex_match(e, s) == 0)
+      keep[nkeep++] = h;
+  }
+  UNLOCK_REGEX();
+  free(buf);
+  l = YAP_MkListFromTerms(keep, nkeep);
+  free(keep);
+  return YAP_Unify(YAP_ARG4, l);
+}
+
 void init_regexp(void) {
-  YAP_UserCPredicate("check_regexp", check_regexp, 5);
-  YAP_UserCPredicate("check_regexp", regexp, 7);
+  YAP_register_blob_type(&regex_blob);
+  YAP_UserCPredicate("check_regexp", check_regexp, 3);
+  YAP_UserCPredicate("check_regexp", regexp, 5);
+  YAP_UserCPredicate("compile_regexp", compile_regexp, 3);
+  YAP_UserCPredicate("filter_regexp", filter_regexp, 4);
 }
 
 #if __WINDOWS__
@@ -282,8 +282,15 @@ Yap_InitSocketStream(int fd, socket_info flags, socket_domain domain) {
 int
 Yap_CheckSocketStream(Term stream, const char * error)
 {
-  int sno = Yap_CheckStream(stream, Socket_Stream_f, error);
+  /* session sockets are also input and output streams */
+  int sno = Yap_CheckStream(stream, Input_Stream_f|Output_Stream_f|Socket_Stream_f, error);
+  if (sno < 0)
+    return sno;
   UNLOCK(GLOBAL_Stream[sno].streamlock);
+  if (!(GLOBAL_Stream[sno].status & Socket_Stream_f)) {
+    Yap_Error(DOMAIN_ERROR_STREAM, stream, error);
+    return -1;
+  }
   return sno;
 }
 
@@ -402,6 +402,7 @@ static Int write_term3(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   return Yap_WriteTerm(output_stream, ARG2, ARG3 PASS_REGS);
 }
 
@@ -421,6 +422,7 @@ static Int write2(USES_REGS1) {
   int output_stream = Yap_CheckTextStream(ARG1, Output_Stream_f, "write/2");
   if (output_stream < 0)
     return false;
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   Term opts  = MkPairTerm(Yap_MkApplTerm(FunctorSingletons,1,&t), TermNil);
   return Yap_WriteTerm(output_stream, ARG2, opts PASS_REGS);
 }
@@ -482,6 +484,7 @@ static Int write_canonical(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   Term nv = getAtomicLocalPrologFlag(NUMBERVARS_FUNCTOR_FLAG);
   setAtomicLocalPrologFlag(NUMBERVARS_FUNCTOR_FLAG,TermDollarUVar);
   Term opts  = MkPairTerm(Yap_MkApplTerm(FunctorSingletons,1,&t),
@@ -519,6 +522,7 @@ static Int writeq(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   Term opts  = MkPairTerm(Yap_MkApplTerm(FunctorQuoted,1,&t),
 			  MkPairTerm(Yap_MkApplTerm(FunctorNumberVars,1,&t),
 							TermNil));
@@ -549,6 +553,7 @@ static Int print(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   Term opts  = MkPairTerm(Yap_MkApplTerm(FunctorPortray,1,&t),
 			  MkPairTerm(Yap_MkApplTerm(FunctorNumberVars,1,&t),
 							TermNil));
@@ -584,6 +589,7 @@ static Int display(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
   Term opts  =  MkPairTerm(Yap_MkApplTerm(FunctorIgnoreOps,1,&t),TermNil);
   return Yap_WriteTerm(output_stream, ARG2, opts PASS_REGS);
 }
@@ -607,6 +613,7 @@ static Int writeln(USES_REGS1) {
   if (output_stream < 0) {
     return false;
   }
+  UNLOCK(GLOBAL_Stream[output_stream].streamlock);
    Term opts  = MkPairTerm(Yap_MkApplTerm(FunctorNl,1,&t),
 
 			   MkPairTerm(Yap_MkApplTerm(FunctorNumberVars,1,&t),
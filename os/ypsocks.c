@@ -67,6 +67,10 @@
 #if HAVE_SYS_PARAM_H
 #include <sys/param.h>
 #endif
+#if HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#include <poll.h>
+#endif
 #endif
 #ifdef _WIN32
 //#include <ws2tcpip.h>
@@ -662,6 +666,7 @@ static Int p_socket_bind(USES_REGS1) {
       socklen_t namelen;
 #endif
       Term t;
+      namelen = sizeof(saddr);
       if (getsockname(fd, (struct sockaddr *)&saddr, &namelen) < 0) {
 #if HAVE_STRERROR
         Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
@@ -1244,6 +1249,653 @@ static Int p_hostname_address(USES_REGS1) {
     return (Yap_unify(out, ARG2));
   }
 }
+
+#if HAVE_SYS_EPOLL_H
+/*
+ * Event loop support: an epoll set watches the server socket and any
+ * number of connections, and connections are plain non-blocking file
+ * descriptors, '$connection'(Fd), instead of streams, so a server is
+ * not bound by the size of the stream table. Registered descriptors
+ * remember the term they were added with, and socket_poll_wait/3
+ * returns it with the events that are ready.
+ */
+
+#define MAX_POLL_EVENTS 1024
+#define SOCKET_RECV_CHUNK 65536
+#define SOCKET_RECV_MAX (4 * SOCKET_RECV_CHUNK)
+
+static Functor FunctorSocketPoll, FunctorConnection;
+
+static int poll_fd(Term t, const char *pred) {
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, pred);
+    return -1;
+  }
+  if (!IsApplTerm(t) || FunctorOfTerm(t) != FunctorSocketPoll ||
+      !IsIntTerm(ArgOfTerm(1, t))) {
+    Yap_Error(DOMAIN_ERROR_STREAM, t, pred);
+    return -1;
+  }
+  return IntOfTerm(ArgOfTerm(1, t));
+}
+
+static int connection_fd(Term t, const char *pred) {
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, pred);
+    return -1;
+  }
+  if (!IsApplTerm(t) || FunctorOfTerm(t) != FunctorConnection ||
+      !IsIntTerm(ArgOfTerm(1, t))) {
+    Yap_Error(DOMAIN_ERROR_STREAM, t, pred);
+    return -1;
+  }
+  return IntOfTerm(ArgOfTerm(1, t));
+}
+
+/* connections are tagged with 0 in the epoll data, socket streams with 1 */
+static int poll_target(Term t, uint64_t *data, const char *pred) {
+  int fd, sno;
+
+  if (!IsVarTerm(t) && IsApplTerm(t) && FunctorOfTerm(t) == FunctorConnection) {
+    if ((fd = connection_fd(t, pred)) < 0)
+      return -1;
+    *data = (uint64_t)fd << 1;
+    return fd;
+  }
+  if ((sno = Yap_CheckSocketStream(t, pred)) < 0)
+    return -1;
+  *data = ((uint64_t)sno << 1) | 1;
+  return Yap_GetStreamFd(sno);
+}
+
+static bool poll_events(Term t, uint32_t *events, const char *pred) {
+  *events = 0;
+  while (!IsVarTerm(t) && IsPairTerm(t)) {
+    Term h = HeadOfTerm(t);
+    char *s;
+
+    if (IsVarTerm(h)) {
+      Yap_Error(INSTANTIATION_ERROR, h, pred);
+      return false;
+    }
+    if (!IsAtomTerm(h)) {
+      Yap_Error(TYPE_ERROR_ATOM, h, pred);
+      return false;
+    }
+    s = RepAtom(AtomOfTerm(h))->StrOfAE;
+    if (!strcmp(s, "read"))
+      *events |= EPOLLIN | EPOLLRDHUP;
+    else if (!strcmp(s, "write"))
+      *events |= EPOLLOUT;
+    else if (!strcmp(s, "edge"))
+      *events |= EPOLLET;
+    else if (!strcmp(s, "oneshot"))
+      *events |= EPOLLONESHOT;
+    else {
+      Yap_Error(DOMAIN_ERROR_IO_MODE, h, pred);
+      return false;
+    }
+    t = TailOfTerm(t);
+  }
+  if (IsVarTerm(t)) {
+    Yap_Error(INSTANTIATION_ERROR, t, pred);
+    return false;
+  }
+  if (t != TermNil) {
+    Yap_Error(TYPE_ERROR_LIST, t, pred);
+    return false;
+  }
+  return true;
+}
+
+static bool set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
+}
+
+/* free cells on the global stack, collecting garbage if there are
+ * less than n */
+static size_t global_room(size_t n USES_REGS) {
+  if (HR + n + 1024 > ASP && !Yap_dogc(PASS_REGS1))
+    return 0;
+  return (ASP - HR > 1024 ? ASP - HR - 1024 : 0);
+}
+
+/* make sure the next n cells of the global stack are available */
+static bool reserve_global(size_t n USES_REGS) {
+  if (global_room(n PASS_REGS) < n) {
+    Yap_Error(RESOURCE_ERROR_STACK, TermNil, LOCAL_ErrorMessage);
+    return false;
+  }
+  return true;
+}
+
+/** @pred socket_poll_create(-Poll)
+
+Create an empty set of sockets to wait on.
+*/
+static Int p_socket_poll_create(USES_REGS1) {
+  Term t;
+  int fd;
+
+  if ((fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+#if HAVE_STRERROR
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "socket_poll_create/1 (epoll_create: %s)",
+              strerror(socket_errno));
+#else
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "socket_poll_create/1 (epoll_create)");
+#endif
+    return (FALSE);
+  }
+  t = MkIntTerm(fd);
+  return (Yap_unify(ARG1, Yap_MkApplTerm(FunctorSocketPoll, 1, &t)));
+}
+
+static Int p_socket_poll_close(USES_REGS1) {
+  int fd;
+
+  if ((fd = poll_fd(Deref(ARG1), "socket_poll_close/1")) < 0)
+    return (FALSE);
+  close(fd);
+  return (TRUE);
+}
+
+static Int poll_ctl(int op, const char *pred USES_REGS) {
+  struct epoll_event ev;
+  uint64_t data;
+  uint32_t events = 0;
+  int pfd, fd;
+
+  if ((pfd = poll_fd(Deref(ARG1), pred)) < 0)
+    return (FALSE);
+  if ((fd = poll_target(Deref(ARG2), &data, pred)) < 0)
+    return (FALSE);
+  if (op != EPOLL_CTL_DEL) {
+    if (!poll_events(Deref(ARG3), &events, pred))
+      return (FALSE);
+    /* readiness only means something if we never block */
+    if (op == EPOLL_CTL_ADD && !set_nonblocking(fd)) {
+#if HAVE_STRERROR
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (fcntl: %s)", pred,
+                strerror(socket_errno));
+#else
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (fcntl)", pred);
+#endif
+      return (FALSE);
+    }
+  }
+  /* epoll_event is packed on some targets */
+  ev.events = events;
+  ev.data.u64 = data;
+  if (epoll_ctl(pfd, op, fd, &ev) < 0) {
+#if HAVE_STRERROR
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (epoll_ctl: %s)", pred,
+              strerror(socket_errno));
+#else
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (epoll_ctl)", pred);
+#endif
+    return (FALSE);
+  }
+  return (TRUE);
+}
+
+/** @pred socket_poll_add(+Poll, +Socket, +Events)
+
+Watch _Socket_, a socket stream or a connection, for the _Events_ in
+the list: `read`, `write`, and the modes `edge` (edge triggered) and
+`oneshot` (disarm after the first event, see socket_poll_modify/3).
+_Socket_ is made non-blocking.
+*/
+static Int p_socket_poll_add(USES_REGS1) {
+  return poll_ctl(EPOLL_CTL_ADD, "socket_poll_add/3" PASS_REGS);
+}
+
+/** @pred socket_poll_modify(+Poll, +Socket, +Events)
+
+Change the events watched for _Socket_, or rearm a `oneshot` socket.
+*/
+static Int p_socket_poll_modify(USES_REGS1) {
+  return poll_ctl(EPOLL_CTL_MOD, "socket_poll_modify/3" PASS_REGS);
+}
+
+static Int p_socket_poll_remove(USES_REGS1) {
+  return poll_ctl(EPOLL_CTL_DEL, "socket_poll_remove/2" PASS_REGS);
+}
+
+static Term ready_events(uint32_t ev) {
+  CACHE_REGS
+  Term t = TermNil;
+
+  if (ev & EPOLLERR)
+    t = MkPairTerm(MkAtomTerm(Yap_LookupAtom("error")), t);
+  if (ev & (EPOLLHUP | EPOLLRDHUP))
+    t = MkPairTerm(MkAtomTerm(Yap_LookupAtom("hangup")), t);
+  if (ev & EPOLLOUT)
+    t = MkPairTerm(MkAtomTerm(AtomWrite), t);
+  if (ev & EPOLLIN)
+    t = MkPairTerm(MkAtomTerm(AtomRead), t);
+  return t;
+}
+
+/** @pred socket_poll_wait(+Poll, +Timeout, -Ready)
+
+Wait up to _Timeout_ milliseconds, or forever if _Timeout_ is
+`infinite` or negative, until some of the sockets in _Poll_ are ready.
+_Ready_ is a list of `Socket-Events`, where _Events_ is a list of
+`read`, `write`, `hangup` and `error`; it is empty on a time out or if
+the wait was interrupted by a signal.
+*/
+static Int p_socket_poll_wait(USES_REGS1) {
+  struct epoll_event evs[MAX_POLL_EVENTS];
+  Term t2 = Deref(ARG2), out = TermNil;
+  int pfd, timeout, n, i;
+
+  if ((pfd = poll_fd(Deref(ARG1), "socket_poll_wait/3")) < 0)
+    return (FALSE);
+  if (IsVarTerm(t2)) {
+    Yap_Error(INSTANTIATION_ERROR, t2, "socket_poll_wait/3");
+    return (FALSE);
+  }
+  if (IsAtomTerm(t2) && !strcmp(RepAtom(AtomOfTerm(t2))->StrOfAE, "infinite")) {
+    timeout = -1;
+  } else if (IsIntegerTerm(t2)) {
+    Int ms = IntegerOfTerm(t2);
+    timeout = (ms < 0 ? -1 : ms > INT_MAX ? INT_MAX : (int)ms);
+  } else {
+    Yap_Error(TYPE_ERROR_INTEGER, t2, "socket_poll_wait/3");
+    return (FALSE);
+  }
+  if ((n = epoll_wait(pfd, evs, MAX_POLL_EVENTS, timeout)) < 0) {
+    if (socket_errno == EINTR)
+      return (Yap_unify(ARG3, TermNil));
+#if HAVE_STRERROR
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "socket_poll_wait/3 (epoll_wait: %s)", strerror(socket_errno));
+#else
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "socket_poll_wait/3 (epoll_wait)");
+#endif
+    return (FALSE);
+  }
+  /* Socket-[E1,...,E4] */
+  if (!reserve_global(n * 16 PASS_REGS))
+    return (FALSE);
+  for (i = n - 1; i >= 0; i--) {
+    uint64_t data = evs[i].data.u64;
+    Term pair[2], tf;
+
+    if (data & 1) {
+      pair[0] = Yap_MkStream((int)(data >> 1));
+    } else {
+      tf = MkIntTerm((Int)(data >> 1));
+      pair[0] = Yap_MkApplTerm(FunctorConnection, 1, &tf);
+    }
+    pair[1] = ready_events(evs[i].events);
+    out = MkPairTerm(Yap_MkApplTerm(FunctorMinus, 2, pair), out);
+  }
+  return (Yap_unify(ARG3, out));
+}
+
+/** @pred socket_accept_ready(+Socket, -Clients)
+
+Accept all the connections pending on the server socket _Socket_
+without blocking. _Clients_ is a list of `Peer-Connection`, where
+_Peer_ is the address of the client and _Connection_ a non-blocking
+connection for socket_recv/2 and socket_send/3.
+*/
+static Int p_socket_accept_ready(USES_REGS1) {
+  Term t1 = Deref(ARG1), out = TermNil;
+  int sno, ofd, fd;
+  size_t n = 0, max = 64;
+  struct sockaddr_in *peers;
+  int *fds;
+
+  if ((sno = Yap_CheckSocketStream(t1, "socket_accept_ready/2")) < 0) {
+    return (FALSE);
+  }
+  if (Yap_GetSocketStatus(sno) != server_socket) {
+    /* ok, this should be an error, as you are trying to bind  */
+    return (FALSE);
+  }
+  ofd = Yap_GetStreamFd(sno);
+  if (!set_nonblocking(ofd))
+    return (FALSE);
+  fds = malloc(max * sizeof(int));
+  peers = malloc(max * sizeof(struct sockaddr_in));
+  if (fds == NULL || peers == NULL) {
+    free(fds);
+    free(peers);
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "socket_accept_ready/2");
+    return (FALSE);
+  }
+  /* accept first, the terms are built once we know how many */
+  for (;;) {
+    socklen_t len = sizeof(struct sockaddr_in);
+
+    if (n == max) {
+      int *nfds = realloc(fds, 2 * max * sizeof(int));
+      struct sockaddr_in *npeers;
+
+      if (nfds == NULL)
+        break;
+      fds = nfds;
+      if ((npeers = realloc(peers, 2 * max * sizeof(struct sockaddr_in))) ==
+          NULL)
+        break;
+      peers = npeers;
+      max *= 2;
+    }
+    memset((void *)(peers + n), (int)0, sizeof(struct sockaddr_in));
+    if ((fd = accept(ofd, (struct sockaddr *)(peers + n), &len)) < 0) {
+      if (socket_errno == EINTR || socket_errno == ECONNABORTED)
+        continue;
+      if (socket_errno == EAGAIN || socket_errno == EWOULDBLOCK)
+        break;
+      /* out of descriptors: keep what we got, the rest stay queued */
+      if (n > 0 && (socket_errno == EMFILE || socket_errno == ENFILE))
+        break;
+      free(fds);
+      free(peers);
+#if HAVE_STRERROR
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+                "socket_accept_ready/2 (accept: %s)", strerror(socket_errno));
+#else
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+                "socket_accept_ready/2 (accept)");
+#endif
+      return (FALSE);
+    }
+    set_nonblocking(fd);
+    fds[n++] = fd;
+  }
+  /* Peer-'$connection'(Fd) */
+  if (!reserve_global(8 * n PASS_REGS)) {
+    while (n > 0)
+      close(fds[--n]);
+    free(fds);
+    free(peers);
+    return (FALSE);
+  }
+  while (n > 0) {
+    Term tfd, pair[2];
+
+    n--;
+    if (peers[n].sin_family == AF_INET) {
+      pair[0] = MkAtomTerm(Yap_LookupAtom(inet_ntoa(peers[n].sin_addr)));
+    } else {
+      pair[0] = TermNil;
+    }
+    tfd = MkIntTerm(fds[n]);
+    pair[1] = Yap_MkApplTerm(FunctorConnection, 1, &tfd);
+    out = MkPairTerm(Yap_MkApplTerm(FunctorMinus, 2, pair), out);
+  }
+  free(fds);
+  free(peers);
+  return (Yap_unify(ARG2, out));
+}
+
+/** @pred socket_recv(+Connection, -Data)
+
+Read what is available on _Connection_ without blocking, up to 256
+KBytes or what fits on the global stack. _Data_ is a list of byte
+codes, empty if nothing was waiting, or `end_of_file` if the peer
+closed the connection. Edge triggered connections should be read until
+_Data_ is empty.
+*/
+static Int p_socket_recv(USES_REGS1) {
+  unsigned char *buf;
+  size_t n = 0, max = SOCKET_RECV_CHUNK, room;
+  bool eof = false;
+  Term out = TermNil;
+  int fd;
+
+  if ((fd = connection_fd(Deref(ARG1), "socket_recv/2")) < 0)
+    return (FALSE);
+  /* never read more than fits in a list, the rest waits in the socket */
+  if ((room = global_room(2 * SOCKET_RECV_CHUNK PASS_REGS) / 2) == 0) {
+    Yap_Error(RESOURCE_ERROR_STACK, TermNil, "socket_recv/2");
+    return (FALSE);
+  }
+  if (room > SOCKET_RECV_MAX)
+    room = SOCKET_RECV_MAX;
+  if ((buf = malloc(max)) == NULL) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, "socket_recv/2");
+    return (FALSE);
+  }
+  while (n < room) {
+    ssize_t r;
+
+    if (n == max) {
+      unsigned char *nbuf = realloc(buf, max * 2);
+      if (nbuf == NULL)
+        break;
+      buf = nbuf;
+      max *= 2;
+    }
+    r = recv(fd, buf + n, (max < room ? max : room) - n, 0);
+    if (r > 0) {
+      n += r;
+    } else if (r == 0) {
+      eof = true;
+      break;
+    } else if (socket_errno == EINTR) {
+      continue;
+    } else if (socket_errno == EAGAIN || socket_errno == EWOULDBLOCK) {
+      break;
+    } else if (socket_errno == ECONNRESET) {
+      eof = true;
+      break;
+    } else {
+      free(buf);
+#if HAVE_STRERROR
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "socket_recv/2 (recv: %s)",
+                strerror(socket_errno));
+#else
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "socket_recv/2 (recv)");
+#endif
+      return (FALSE);
+    }
+  }
+  if (n == 0 && eof) {
+    free(buf);
+    return (Yap_unify(ARG2, MkAtomTerm(AtomEof)));
+  }
+  while (n > 0) {
+    out = MkPairTerm(MkIntTerm(buf[--n]), out);
+  }
+  free(buf);
+  return (Yap_unify(ARG2, out));
+}
+
+/* copy the bytes of a code list, returns how many or -1 */
+static ssize_t send_bytes(Term t, unsigned char **bufp, const char *pred) {
+  size_t n = 0, max = 4096;
+  unsigned char *buf = malloc(max);
+
+  if (buf == NULL) {
+    Yap_Error(RESOURCE_ERROR_HEAP, TermNil, pred);
+    return -1;
+  }
+  while (!IsVarTerm(t) && IsPairTerm(t)) {
+    Term h = HeadOfTerm(t);
+    Int c;
+
+    if (IsVarTerm(h)) {
+      free(buf);
+      Yap_Error(INSTANTIATION_ERROR, h, pred);
+      return -1;
+    }
+    if (!IsIntTerm(h) || (c = IntOfTerm(h)) < 0 || c > 255) {
+      free(buf);
+      Yap_Error(TYPE_ERROR_BYTE, h, pred);
+      return -1;
+    }
+    if (n == max) {
+      unsigned char *nbuf = realloc(buf, max * 2);
+      if (nbuf == NULL) {
+        free(buf);
+        Yap_Error(RESOURCE_ERROR_HEAP, TermNil, pred);
+        return -1;
+      }
+      buf = nbuf;
+      max *= 2;
+    }
+    buf[n++] = c;
+    t = TailOfTerm(t);
+  }
+  if (IsVarTerm(t)) {
+    free(buf);
+    Yap_Error(INSTANTIATION_ERROR, t, pred);
+    return -1;
+  }
+  if (t != TermNil) {
+    free(buf);
+    Yap_Error(TYPE_ERROR_LIST, t, pred);
+    return -1;
+  }
+  *bufp = buf;
+  return n;
+}
+
+static Int socket_send(bool block, const char *pred USES_REGS) {
+  unsigned char *buf;
+  Term rest;
+  ssize_t n, sent = 0;
+  int fd;
+
+  if ((fd = connection_fd(Deref(ARG1), pred)) < 0)
+    return (FALSE);
+  if ((n = send_bytes(Deref(ARG2), &buf, pred)) < 0)
+    return (FALSE);
+  while (sent < n) {
+    ssize_t r = send(fd, buf + sent, n - sent, MSG_NOSIGNAL);
+
+    if (r >= 0) {
+      sent += r;
+    } else if (socket_errno == EINTR) {
+      continue;
+    } else if (socket_errno == EAGAIN || socket_errno == EWOULDBLOCK) {
+      struct pollfd p;
+
+      if (!block)
+        break;
+      p.fd = fd;
+      p.events = POLLOUT;
+      poll(&p, 1, -1);
+    } else {
+      free(buf);
+#if HAVE_STRERROR
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (send: %s)", pred,
+                strerror(socket_errno));
+#else
+      Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "%s (send)", pred);
+#endif
+      return (FALSE);
+    }
+  }
+  free(buf);
+  if (block)
+    return (TRUE);
+  /* the unsent suffix is a tail of the original list */
+  rest = Deref(ARG2);
+  while (sent-- > 0)
+    rest = TailOfTerm(rest);
+  return (Yap_unify(ARG3, rest));
+}
+
+/** @pred socket_send(+Connection, +Data, -Rest)
+
+Write the byte codes _Data_ on _Connection_ as far as that is possible
+without blocking, _Rest_ is what could not be sent yet.
+*/
+static Int p_socket_send3(USES_REGS1) {
+  return socket_send(false, "socket_send/3" PASS_REGS);
+}
+
+/** @pred socket_send(+Connection, +Data)
+
+Write all of the byte codes _Data_ on _Connection_, waiting for the
+socket to drain if need be.
+*/
+static Int p_socket_send2(USES_REGS1) {
+  return socket_send(true, "socket_send/2" PASS_REGS);
+}
+
+static Int p_socket_connection_close(USES_REGS1) {
+  int fd;
+
+  if ((fd = connection_fd(Deref(ARG1), "socket_connection_close/1")) < 0)
+    return (FALSE);
+  /* closing also takes the descriptor out of any epoll set */
+  close(fd);
+  return (TRUE);
+}
+
+/** @pred socket_client(+Address, -Connection)
+
+Connect to `'AF_INET'(Host, Port)` and return a non-blocking
+_Connection_, to be used like the ones socket_accept_ready/2 returns.
+*/
+static Int p_socket_client(USES_REGS1) {
+  Term t1 = Deref(ARG1), thost, tport, tfd;
+  struct sockaddr_in saddr;
+  struct hostent *he;
+  int fd;
+
+  if (IsVarTerm(t1)) {
+    Yap_Error(INSTANTIATION_ERROR, t1, "socket_client/2");
+    return (FALSE);
+  }
+  if (!IsApplTerm(t1) || FunctorOfTerm(t1) != FunctorAfInet) {
+    Yap_Error(DOMAIN_ERROR_STREAM, t1, "socket_client/2");
+    return (FALSE);
+  }
+  thost = Deref(ArgOfTerm(1, t1));
+  tport = Deref(ArgOfTerm(2, t1));
+  if (IsVarTerm(thost)) {
+    Yap_Error(INSTANTIATION_ERROR, thost, "socket_client/2");
+    return (FALSE);
+  }
+  if (!IsAtomTerm(thost)) {
+    Yap_Error(TYPE_ERROR_ATOM, thost, "socket_client/2");
+    return (FALSE);
+  }
+  if (IsVarTerm(tport)) {
+    Yap_Error(INSTANTIATION_ERROR, tport, "socket_client/2");
+    return (FALSE);
+  }
+  if (!IsIntegerTerm(tport)) {
+    Yap_Error(TYPE_ERROR_INTEGER, tport, "socket_client/2");
+    return (FALSE);
+  }
+  if ((he = gethostbyname(RepAtom(AtomOfTerm(thost))->StrOfAE)) == NULL) {
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil,
+              "socket_client/2 (gethostbyname)");
+    return (FALSE);
+  }
+  memset((void *)&saddr, (int)0, sizeof(saddr));
+  memmove((void *)&saddr.sin_addr, (void *)he->h_addr_list[0], he->h_length);
+  saddr.sin_port = htons((unsigned short int)IntegerOfTerm(tport));
+  saddr.sin_family = AF_INET;
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      connect(fd, (struct sockaddr *)&saddr, sizeof(saddr)) < 0) {
+    if (fd >= 0)
+      close(fd);
+#if HAVE_STRERROR
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "socket_client/2 (connect: %s)",
+              strerror(socket_errno));
+#else
+    Yap_Error(SYSTEM_ERROR_INTERNAL, TermNil, "socket_client/2 (connect)");
+#endif
+    return (FALSE);
+  }
+  set_nonblocking(fd);
+  tfd = MkIntTerm(fd);
+  return (Yap_unify(ARG2, Yap_MkApplTerm(FunctorConnection, 1, &tfd)));
+}
+#endif
 #endif
 
 void Yap_InitSocketLayer(void) {
@@ -1263,6 +1915,31 @@ void Yap_InitSocketLayer(void) {
                 SafePredFlag | SyncPredFlag | HiddenPredFlag);
   Yap_InitCPred("current_host", 1, p_current_host, SafePredFlag);
   Yap_InitCPred("hostname_address", 2, p_hostname_address, SafePredFlag);
+#if HAVE_SYS_EPOLL_H
+  FunctorSocketPoll = Yap_MkFunctor(Yap_LookupAtom("$socket_poll"), 1);
+  FunctorConnection = Yap_MkFunctor(Yap_LookupAtom("$connection"), 1);
+  Yap_InitCPred("socket_poll_create", 1, p_socket_poll_create,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_poll_close", 1, p_socket_poll_close,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_poll_add", 3, p_socket_poll_add,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_poll_modify", 3, p_socket_poll_modify,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_poll_remove", 2, p_socket_poll_remove,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_poll_wait", 3, p_socket_poll_wait,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_accept_ready", 2, p_socket_accept_ready,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_recv", 2, p_socket_recv, SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_send", 3, p_socket_send3, SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_send", 2, p_socket_send2, SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_connection_close", 1, p_socket_connection_close,
+                SafePredFlag | SyncPredFlag);
+  Yap_InitCPred("socket_client", 2, p_socket_client,
+                SafePredFlag | SyncPredFlag);
+#endif
 #if _MSC_VER || defined(__MINGW32__)
   {
     WSADATA info;
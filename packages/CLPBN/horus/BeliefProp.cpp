@@ -4,6 +4,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <thread>
 
 #include "BeliefProp.h"
 #include "Indexer.h"
@@ -14,6 +15,7 @@ namespace Horus {
 
 double    BeliefProp::accuracy_ = 0.0001;
 unsigned  BeliefProp::maxIter_  = 1000;
+unsigned  BeliefProp::nrThreads_ = 1;
 
 BeliefProp::MsgSchedule BeliefProp::schedule_ =
     MsgSchedule::seqFixedSch;
@@ -63,6 +65,7 @@ BeliefProp::printSolverFlags() const
   }
   ss << ",bp_max_iter=" << Util::toString (maxIter_);
   ss << ",bp_accuracy=" << Util::toString (accuracy_);
+  ss << ",bp_threads="  << Util::toString (nrThreads_);
   ss << ",log_domain="  << Util::toString (Globals::logDomain);
   ss << "]" ;
   std::cout << ss.str() << std::endl;
@@ -267,12 +270,7 @@ BeliefProp::runSolver()
         }
         break;
       case MsgSchedule::parallelSch:
-        for (size_t i = 0; i < links_.size(); i++) {
-          calculateMessage (links_[i]);
-        }
-        for (size_t i = 0; i < links_.size(); i++) {
-          updateMessage(links_[i]);
-        }
+        parallelSchedule();
         break;
       case MsgSchedule::maxResidualSch:
         maxResidualSchedule();
@@ -295,6 +293,49 @@ BeliefProp::runSolver()
 
 
 
+void
+BeliefProp::parallelSchedule()
+{
+  // every message of the iteration only depends on the messages
+  // of the previous one, so the links can be split into disjoint
+  // ranges and computed concurrently; the results (and thus the
+  // residuals seen by converged()) do not depend on the split
+  size_t nrThreads = nrThreads_;
+  if (Globals::verbosity > 2 || Constants::showBpCalcs) {
+    nrThreads = 1; // keep the traces readable
+  }
+  nrThreads = std::min (nrThreads, links_.size() / 64 + 1);
+  if (nrThreads <= 1) {
+    for (size_t i = 0; i < links_.size(); i++) {
+      calculateMessage (links_[i]);
+    }
+    for (size_t i = 0; i < links_.size(); i++) {
+      updateMessage (links_[i]);
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve (nrThreads);
+  size_t chunk = (links_.size() + nrThreads - 1) / nrThreads;
+  for (size_t t = 0; t < nrThreads; t++) {
+    size_t first = t * chunk;
+    size_t last  = std::min (first + chunk, links_.size());
+    workers.push_back (std::thread ([this, first, last] {
+      for (size_t i = first; i < last; i++) {
+        calculateMessage (links_[i]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < nrThreads; t++) {
+    workers[t].join();
+  }
+  for (size_t i = 0; i < links_.size(); i++) {
+    updateMessage (links_[i]);
+  }
+}
+
+
+
 void
 BeliefProp::createLinks()
 {
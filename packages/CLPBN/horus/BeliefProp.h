@@ -49,6 +49,10 @@ class BeliefProp : public GroundSolver {
 
     static void setMsgSchedule (MsgSchedule sch) { schedule_ = sch; }
 
+    static unsigned nrThreads() { return nrThreads_; }
+
+    static void setNrThreads (unsigned nt) { nrThreads_ = nt ? nt : 1; }
+
   protected:
     class BpLink {
       public:
@@ -108,6 +112,8 @@ class BeliefProp : public GroundSolver {
 
     void runSolver();
 
+    void parallelSchedule();
+
     virtual void createLinks();
 
     virtual void maxResidualSchedule();
@@ -138,6 +144,7 @@ class BeliefProp : public GroundSolver {
 
     static unsigned           maxIter_;
     static MsgSchedule        schedule_;
+    static unsigned           nrThreads_;
 
     DISALLOW_COPY_AND_ASSIGN (BeliefProp);
 };
@@ -101,6 +101,7 @@ CountingBp::printSolverFlags() const
   }
   ss << ",bp_max_iter=" << WeightedBp::maxIterations();
   ss << ",bp_accuracy=" << WeightedBp::accuracy();
+  ss << ",bp_threads=" << WeightedBp::nrThreads();
   ss << ",log_domain=" << Util::toString (Globals::logDomain);
   ss << ",fif=" << Util::toString (CountingBp::fif_);
   ss << "]" ;
@@ -1,4 +1,7 @@
 #include <cassert>
+#include <cmath>
+
+#include <algorithm>
 
 #include "GenericFactor.h"
 #include "ProbFormula.h"
@@ -7,6 +10,134 @@
 
 namespace Horus {
 
+namespace {
+
+// Walks the row-major index space described by `ranges', where moving
+// one step along dimension i advances the source position by
+// `strides[i]'. Trailing dimensions whose source strides are themselves
+// row-major are collapsed into a single block, so `op' is called once
+// per block with a constant source stride and its innermost loop runs
+// without any index arithmetic (and can be vectorized when the stride
+// is one).
+template <typename Op> void
+stridedApply (
+    const Ranges& ranges,
+    const std::vector<size_t>& strides,
+    Op op)
+{
+  assert (ranges.size() == strides.size());
+  if (ranges.empty()) {
+    op (0, 0, 1, 0);
+    return;
+  }
+  size_t nOuter  = ranges.size() - 1;
+  size_t block   = ranges[nOuter];
+  size_t bStride = strides[nOuter];
+  while (nOuter > 0 && strides[nOuter - 1] == bStride * block) {
+    nOuter --;
+    block *= ranges[nOuter];
+  }
+  std::vector<unsigned> indices (nOuter, 0);
+  size_t dst = 0;
+  size_t src = 0;
+  while (true) {
+    op (dst, src, block, bStride);
+    dst += block;
+    size_t i = nOuter;
+    while (i-- > 0) {
+      indices[i] ++;
+      src += strides[i];
+      if (indices[i] != ranges[i]) {
+        break;
+      }
+      indices[i] = 0;
+      src -= strides[i] * ranges[i];
+    }
+    if (i == size_t (-1)) {
+      return;
+    }
+  }
+}
+
+
+
+// Source strides of each `allArgs' dimension into a factor over
+// `wantedArgs'; zero for arguments the latter does not have.
+template <typename T> std::vector<size_t>
+mapStrides (
+    const std::vector<T>& allArgs,
+    const std::vector<T>& wantedArgs,
+    const Ranges& wantedRanges)
+{
+  std::vector<size_t> offsets (wantedRanges.size());
+  size_t prod = 1;
+  for (size_t i = wantedRanges.size(); i-- > 0; ) {
+    offsets[i] = prod;
+    prod *= wantedRanges[i];
+  }
+  std::vector<size_t> strides;
+  strides.reserve (allArgs.size());
+  for (size_t i = 0; i < allArgs.size(); i++) {
+    size_t idx = Util::indexOf (wantedArgs, allArgs[i]);
+    strides.push_back (idx != wantedArgs.size() ? offsets[idx] : 0);
+  }
+  return strides;
+}
+
+
+
+struct MultiplyBlock {
+  MultiplyBlock (double* d, const double* s) : dst (d), src (s) { }
+  void operator() (size_t di, size_t si, size_t n, size_t stride) const
+  {
+    double* d = dst + di;
+    const double* s = src + si;
+    if (stride == 1) {
+      if (Globals::logDomain) {
+        for (size_t k = 0; k < n; k++) d[k] += s[k];
+      } else {
+        for (size_t k = 0; k < n; k++) d[k] *= s[k];
+      }
+    } else if (stride == 0) {
+      const double v = *s;
+      if (Globals::logDomain) {
+        for (size_t k = 0; k < n; k++) d[k] += v;
+      } else {
+        for (size_t k = 0; k < n; k++) d[k] *= v;
+      }
+    } else {
+      if (Globals::logDomain) {
+        for (size_t k = 0; k < n; k++) d[k] += s[k * stride];
+      } else {
+        for (size_t k = 0; k < n; k++) d[k] *= s[k * stride];
+      }
+    }
+  }
+  double*        dst;
+  const double*  src;
+};
+
+
+
+struct GatherBlock {
+  GatherBlock (double* d, const double* s) : dst (d), src (s) { }
+  void operator() (size_t di, size_t si, size_t n, size_t stride) const
+  {
+    double* d = dst + di;
+    const double* s = src + si;
+    if (stride == 1) {
+      std::copy (s, s + n, d);
+    } else {
+      for (size_t k = 0; k < n; k++) d[k] = s[k * stride];
+    }
+  }
+  double*        dst;
+  const double*  src;
+};
+
+}  // namespace
+
+
 template <typename T> const T&
 GenericFactor<T>::argument (size_t idx) const
 {
@@ -112,17 +243,8 @@ GenericFactor<T>::multiply (const GenericFactor<T>& g)
     cartesianProduct (g_params.begin(), g_params.end());
   } else {
     extend (range_prod);
-    Params::iterator it = params_.begin();
-    MapIndexer indexer (args_, ranges_, g_args, g_ranges);
-    if (Globals::logDomain) {
-      for (; indexer.valid(); ++it, ++indexer) {
-        *it += g_params[indexer];
-      }
-    } else {
-      for (; indexer.valid(); ++it, ++indexer) {
-        *it *= g_params[indexer];
-      }
-    }
+    stridedApply (ranges_, mapStrides (args_, g_args, g_ranges),
+        MultiplyBlock (params_.data(), g_params.data()));
   }
   return *this;
 }
@@ -134,21 +256,58 @@ GenericFactor<T>::sumOutIndex (size_t idx)
 {
   assert (idx < args_.size());
   assert (args_.size() > 1);
-  size_t new_size = params_.size() / ranges_[idx];
-  Params newps (new_size, LogAware::addIdenty());
-  Params::const_iterator first = params_.begin();
-  Params::const_iterator last  = params_.end();
-  MapIndexer indexer (ranges_, idx);
+  // view the parameters as a [outer][range][inner] array and
+  // reduce the middle dimension, one contiguous row at a time
+  const size_t range = ranges_[idx];
+  size_t inner = 1;
+  for (size_t i = idx + 1; i < ranges_.size(); i++) {
+    inner *= ranges_[i];
+  }
+  const size_t outer = params_.size() / (range * inner);
+  Params newps (outer * inner);
+  const double* src = params_.data();
+  double* dst = newps.data();
   if (Globals::logDomain) {
-    for (; first != last; ++indexer) {
-      newps[indexer] = Util::logSum (newps[indexer], *first++);
+    // log-sum-exp against the row maximum: one exp per
+    // element instead of a pairwise Util::logSum chain
+    Params sums (inner);
+    for (size_t o = 0; o < outer; o++, dst += inner) {
+      const double* row = src + o * range * inner;
+      std::copy (row, row + inner, dst);
+      for (size_t r = 1; r < range; r++) {
+        const double* p = row + r * inner;
+        for (size_t j = 0; j < inner; j++) {
+          dst[j] = std::max (dst[j], p[j]);
+        }
+      }
+      std::fill (sums.begin(), sums.end(), 0.0);
+      for (size_t r = 0; r < range; r++) {
+        const double* p = row + r * inner;
+        for (size_t j = 0; j < inner; j++) {
+          if (p[j] != NEG_INF) {
+            sums[j] += std::exp (p[j] - dst[j]);
+          }
+        }
+      }
+      for (size_t j = 0; j < inner; j++) {
+        if (dst[j] != NEG_INF) {
+          dst[j] += std::log (sums[j]);
+        }
+      }
     }
   } else {
-    for (; first != last; ++indexer) {
-      newps[indexer] += *first++;
+    for (size_t o = 0; o < outer; o++, dst += inner) {
+      const double* row = src + o * range * inner;
+      std::copy (row, row + inner, dst);
+      for (size_t r = 1; r < range; r++) {
+        const double* p = row + r * inner;
+        for (size_t j = 0; j < inner; j++) {
+          dst[j] += p[j];
+        }
+      }
     }
   }
-  params_ = newps;
+  params_.swap (newps);
   args_.erase (args_.begin() + idx);
   ranges_.erase (ranges_.begin() + idx);
 }
@@ -191,13 +350,10 @@ GenericFactor<T>::reorderArguments (const std::vector<T>& new_args)
     assert (idx != args_.size());
     new_ranges.push_back (ranges_[idx]);
   }
-  Params newps;
-  newps.reserve (params_.size());
-  MapIndexer indexer (new_args, new_ranges, args_, ranges_);
-  for (; indexer.valid(); ++indexer) {
-    newps.push_back (params_[indexer]);
-  }
-  params_ = newps;
+  Params newps (params_.size());
+  stridedApply (new_ranges, mapStrides (new_args, args_, ranges_),
+      GatherBlock (newps.data(), params_.data()));
+  params_.swap (newps);
   args_   = new_args;
   ranges_ = new_ranges;
 }
@@ -207,16 +363,14 @@ GenericFactor<T>::reorderArguments (const std::vector<T>& new_args)
 template <typename T> void
 GenericFactor<T>::extend (unsigned range_prod)
 {
-  Params backup = params_;
-  params_.clear();
-  params_.reserve (backup.size() * range_prod);
-  Params::const_iterator first = backup.begin();
-  Params::const_iterator last  = backup.end();
-  for (; first != last; ++first) {
-    for (unsigned reps = 0; reps < range_prod; ++reps) {
-      params_.push_back (*first);
-    }
+  Params newps (params_.size() * range_prod);
+  double* dst = newps.data();
+  Params::const_iterator first = params_.begin();
+  Params::const_iterator last  = params_.end();
+  for (; first != last; ++first, dst += range_prod) {
+    std::fill (dst, dst + range_prod, *first);
   }
+  params_.swap (newps);
 }
 
 
@@ -228,7 +382,7 @@ GenericFactor<T>::cartesianProduct (
 {
   Params backup = params_;
   params_.clear();
-  params_.reserve (params_.size() * (last2 - first2));
+  params_.reserve (backup.size() * (last2 - first2));
   Params::const_iterator first1 = backup.begin();
   Params::const_iterator last1  = backup.end();
   Params::const_iterator tmp;
@@ -78,6 +78,7 @@ LiftedBp::printSolverFlags() const
   }
   ss << ",bp_max_iter=" << WeightedBp::maxIterations();
   ss << ",bp_accuracy=" << WeightedBp::accuracy();
+  ss << ",bp_threads=" << WeightedBp::nrThreads();
   ss << ",log_domain=" << Util::toString (Globals::logDomain);
   ss << "]" ;
   std::cout << ss.str() << std::endl;
@@ -274,6 +274,13 @@ setHorusFlag (std::string option, std::string value)
     ss >> mi;
     BeliefProp::setMaxIterations (mi);
 
+  } else if (option == "bp_threads") {
+    std::stringstream ss;
+    unsigned nt;
+    ss << value;
+    ss >> nt;
+    BeliefProp::setNrThreads (nt);
+
   } else if (option == "export_libdai") {
     if      (value == "true")  FactorGraph::enableExportToLibDai();
     else if (value == "false") FactorGraph::disableExportToLibDai();
@@ -0,0 +1,238 @@
+#include <ctime>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "../Factor.h"
+#include "../Indexer.h"
+#include "Common.h"
+
+
+namespace Horus {
+
+namespace UnitTests {
+
+class FactorBenchmark : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE (FactorBenchmark);
+    CPPUNIT_TEST (benchProduct);
+    CPPUNIT_TEST (benchSummingOut);
+    CPPUNIT_TEST (benchReordering);
+    CPPUNIT_TEST_SUITE_END();
+  public:
+    void setUp();
+    void tearDown();
+    void benchProduct();
+    void benchSummingOut();
+    void benchReordering();
+
+  private:
+    bool logDomain_;
+};
+
+
+
+namespace {
+
+const unsigned nrRepetitions = 20;
+
+// reference kernels: the element at a time MapIndexer walks
+// that the factor operations are checked against
+
+Params
+referenceProduct (const Factor& f, const Factor& g)
+{
+  VarIds args   = f.arguments();
+  Ranges ranges = f.ranges();
+  for (size_t i = 0; i < g.nrArguments(); i++) {
+    if (Util::contains (args, g.argument (i)) == false) {
+      args.push_back (g.argument (i));
+      ranges.push_back (g.range (i));
+    }
+  }
+  Params params;
+  MapIndexer fi (args, ranges, f.arguments(), f.ranges());
+  MapIndexer gi (args, ranges, g.arguments(), g.ranges());
+  for (; fi.valid(); ++fi, ++gi) {
+    params.push_back (Globals::logDomain
+        ? f[fi] + g[gi]
+        : f[fi] * g[gi]);
+  }
+  return params;
+}
+
+
+
+Params
+referenceSumOut (const Factor& f, size_t idx)
+{
+  Params params (f.size() / f.range (idx), LogAware::addIdenty());
+  MapIndexer indexer (f.ranges(), idx);
+  for (size_t i = 0; i < f.size(); ++i, ++indexer) {
+    params[indexer] = Globals::logDomain
+        ? Util::logSum (params[indexer], f[i])
+        : params[indexer] + f[i];
+  }
+  return params;
+}
+
+
+
+Params
+referenceReorder (const Factor& f, const VarIds& newArgs)
+{
+  Ranges newRanges;
+  for (size_t i = 0; i < newArgs.size(); i++) {
+    newRanges.push_back (f.range (f.indexOf (newArgs[i])));
+  }
+  Params params;
+  MapIndexer indexer (newArgs, newRanges, f.arguments(), f.ranges());
+  for (; indexer.valid(); ++indexer) {
+    params.push_back (f[indexer]);
+  }
+  return params;
+}
+
+
+
+Factor
+randomFactor (const VarIds& vids, const Ranges& ranges)
+{
+  bool logDomain = Globals::logDomain;
+  Globals::logDomain = false;
+  Params params = generateRandomParams (ranges);
+  Globals::logDomain = logDomain;
+  if (Globals::logDomain) {
+    Util::log (params);
+  }
+  return Factor (vids, ranges, params);
+}
+
+
+
+void
+report (const std::string& name, clock_t ref, clock_t opt)
+{
+  std::cout << std::endl << "  " << std::setw (28) << std::left << name;
+  std::cout << std::setw (10) << std::right;
+  std::cout << double (ref) / CLOCKS_PER_SEC * 1000 << " ms (ref)" ;
+  std::cout << std::setw (10);
+  std::cout << double (opt) / CLOCKS_PER_SEC * 1000 << " ms" ;
+}
+
+}  // namespace
+
+
+
+void
+FactorBenchmark::setUp()
+{
+  logDomain_ = Globals::logDomain;
+}
+
+
+
+void
+FactorBenchmark::tearDown()
+{
+  Globals::logDomain = logDomain_;
+}
+
+
+
+void
+FactorBenchmark::benchProduct()
+{
+  VarIds vids1   = {0, 1, 2, 3, 4};
+  Ranges ranges1 = {4, 3, 5, 4, 6};
+  VarIds vids2   = {5, 3, 1, 6};
+  Ranges ranges2 = {3, 4, 3, 4};
+  for (int ld = 0; ld < 2; ld++) {
+    Globals::logDomain = ld;
+    Factor f = randomFactor (vids1, ranges1);
+    Factor g = randomFactor (vids2, ranges2);
+    Params expected;
+    clock_t start = clock();
+    for (unsigned i = 0; i < nrRepetitions; i++) {
+      expected = referenceProduct (f, g);
+    }
+    clock_t ref = clock() - start;
+    Factor r;
+    start = clock();
+    for (unsigned i = 0; i < nrRepetitions; i++) {
+      r = f;
+      r.multiply (g);
+    }
+    report (ld ? "product (log)" : "product", ref, clock() - start);
+    CPPUNIT_ASSERT (similiar (r.params(), expected));
+  }
+}
+
+
+
+void
+FactorBenchmark::benchSummingOut()
+{
+  VarIds vids   = {0, 1, 2, 3, 4, 5};
+  Ranges ranges = {4, 3, 5, 4, 6, 3};
+  for (int ld = 0; ld < 2; ld++) {
+    Globals::logDomain = ld;
+    Factor f = randomFactor (vids, ranges);
+    for (size_t idx = 0; idx < vids.size(); idx++) {
+      Params expected;
+      clock_t start = clock();
+      for (unsigned i = 0; i < nrRepetitions; i++) {
+        expected = referenceSumOut (f, idx);
+      }
+      clock_t ref = clock() - start;
+      Factor r;
+      start = clock();
+      for (unsigned i = 0; i < nrRepetitions; i++) {
+        r = f;
+        r.sumOutIndex (idx);
+      }
+      std::string name = ld ? "sum out (log) #" : "sum out #";
+      report (name + std::to_string (idx), ref, clock() - start);
+      CPPUNIT_ASSERT (similiar (r.params(), expected));
+    }
+  }
+}
+
+
+
+void
+FactorBenchmark::benchReordering()
+{
+  VarIds vids    = {0, 1, 2, 3, 4, 5};
+  Ranges ranges  = {4, 3, 5, 4, 6, 3};
+  VarIds order1  = {5, 4, 3, 2, 1, 0};
+  VarIds order2  = {1, 0, 2, 3, 4, 5};
+  Factor f = randomFactor (vids, ranges);
+  const VarIds* orders[] = { &order1, &order2 };
+  for (size_t k = 0; k < 2; k++) {
+    Params expected;
+    clock_t start = clock();
+    for (unsigned i = 0; i < nrRepetitions; i++) {
+      expected = referenceReorder (f, *orders[k]);
+    }
+    clock_t ref = clock() - start;
+    Factor r;
+    start = clock();
+    for (unsigned i = 0; i < nrRepetitions; i++) {
+      r = f;
+      r.reorderArguments (*orders[k]);
+    }
+    report (k == 0 ? "reorder (reverse)" : "reorder (swap head)",
+        ref, clock() - start);
+    CPPUNIT_ASSERT (similiar (r.params(), expected));
+  }
+}
+
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION (FactorBenchmark);
+
+}  // namespace UnitTests
+
+}  // namespace Horus
+
@@ -86,22 +86,9 @@ lookup_ht(HT,Key,Values) :-
 	).
 */
 
-% :- load_foreign_library(chr_support).
-
-/*
-lookup_ht1(HT,Hash,Key,Values) :-
-	( lookup_ht1_(HT,Hash,Key,Values) ->
-		true
-	;
-		( lookup_ht1__(HT,Hash,Key,Values) ->
-			writeln(lookup_ht1(HT,Hash,Key,Values)),
-			throw(error)
-		;
-			fail
-		)
-	).
-*/
-
+% lookup_ht1/4 and next_bucket/5 are in chr_support.c when it is available.
+:- if(catch(load_foreign_files([chr_support],[],install_chr_support),_,fail)).
+:- else.
 lookup_ht1(HT,Hash,Key,Values) :-
 	HT = ht(Capacity,_,Table),
 	Index is (Hash mod Capacity) + 1,
@@ -114,18 +101,17 @@ lookup_ht1(HT,Hash,Key,Values) :-
 	    lookup(Bucket,Key,Values)
 	).
 
-lookup_ht2(HT,Key,Values,Index) :-
-	term_hash(Key,Hash),
-	HT = ht(Capacity,_,Table),
-	Index is (Hash mod Capacity) + 1,
-	arg(Index,Table,Bucket),
-	nonvar(Bucket),
-	( Bucket = K-Vs ->
-	    K == Key,
-	    Values = Vs
+next_bucket(Table,I,N,J,Bucket) :-
+	I =< N,
+	arg(I,Table,B),
+	( nonvar(B), B \== [] ->
+		J = I,
+		Bucket = B
 	;
-	    lookup(Bucket,Key,Values)
+		I1 is I + 1,
+		next_bucket(Table,I1,N,J,Bucket)
 	).
+:- endif.
 
 lookup_pair_eq([P | KVs],Key,Pair) :-
 	P = K-_,
@@ -135,6 +121,26 @@ lookup_pair_eq([P | KVs],Key,Pair) :-
 		lookup_pair_eq(KVs,Key,Pair)
 	).
 
+/*
+lookup_ht1(HT,Hash,Key,Values) :-
+	( lookup_ht1_(HT,Hash,Key,Values) ->
+		true
+	;
+		( lookup_ht1__(HT,Hash,Key,Values) ->
+			writeln(lookup_ht1(HT,Hash,Key,Values)),
+			throw(error)
+		;
+			fail
+		)
+	).
+*/
+
+lookup_ht2(HT,Key,Values,Index) :-
+	term_hash(Key,Hash),
+	HT = ht(Capacity,_,_),
+	Index is (Hash mod Capacity) + 1,
+	lookup_ht1(HT,Hash,Key,Values).
+
 insert_ht(HT,Key,Value) :-
 	term_hash(Key,Hash),
 	HT = ht(Capacity0,Load,Table0),
@@ -351,10 +357,8 @@ value_ht(HT,Value) :-
 	value_ht(1,Capacity,Table,Value).
 
 value_ht(I,N,Table,Value) :-
-	I =< N,
-	arg(I,Table,Bucket),
+	next_bucket(Table,I,N,J,Bucket),
 	(
-		nonvar(Bucket),
 		( Bucket = _-Vs ->
 			true
 		;
@@ -362,8 +366,8 @@ value_ht(I,N,Table,Value) :-
 		),
 		member(Value,Vs)
 	;
-		J is I + 1,
-		value_ht(J,N,Table,Value)
+		K is J + 1,
+		value_ht(K,N,Table,Value)
 	).
 
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -78,7 +78,7 @@ insert_iht(HT,Int,Value) :-
 		setarg(Index,Table,[Value|Bucket])
 	    )
 	;	% index > capacity
-		Capacity is 1<<ceil(log(Index)/log(2)),
+		Capacity is 1<<ceiling(log(Index)/log(2)),
 		expand_iht(HT,Capacity),
 		insert_iht(HT,Int,Value)
 	).
@@ -100,20 +100,33 @@ delete_first_fail([X | Xs], Y, Xs) :-
 delete_first_fail([X | Xs], Y, [X | Zs]) :-
 	delete_first_fail(Xs, Y, Zs).
 
+% next_bucket/5 is in chr_support.c when it is available.
+:- if(catch(load_foreign_files([chr_support],[],install_chr_support),_,fail)).
+:- else.
+next_bucket(Table,I,N,J,Bucket) :-
+	I =< N,
+	arg(I,Table,B),
+	( nonvar(B), B \== [] ->
+		J = I,
+		Bucket = B
+	;
+		I1 is I + 1,
+		next_bucket(Table,I1,N,J,Bucket)
+	).
+:- endif.
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 value_iht(HT,Value) :-
 	HT = ht(Capacity,Table),
 	value_iht(1,Capacity,Table,Value).
 
 value_iht(I,N,Table,Value) :-
-	I =< N,
-	arg(I,Table,Bucket),
+	next_bucket(Table,I,N,J,Bucket),
 	(
-		nonvar(Bucket),
 		member(Value,Bucket)
 	;
-		J is I + 1,
-		value_iht(J,N,Table,Value)
+		K is J + 1,
+		value_iht(K,N,Table,Value)
 	).
 		 	
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
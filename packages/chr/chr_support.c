@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+/* YAP's PL_get_list() also splits [], into a fresh head and [] */
+#define GET_LIST(l,h,t) (!PL_get_nil(l) && PL_get_list(l,h,t))
+
 
 /*
 	lookup_ht(HT,Key,Values) :-
@@ -27,9 +30,9 @@
 static foreign_t
 pl_lookup_ht1(term_t ht, term_t pl_hash, term_t key, term_t values)
 {
-  int capacity;
-  int hash;
-  int index;
+  long capacity;
+  long hash;
+  long index;
 
   term_t pl_capacity = PL_new_term_ref();
   term_t table       = PL_new_term_ref();
@@ -37,11 +40,11 @@ pl_lookup_ht1(term_t ht, term_t pl_hash, term_t key, term_t values)
 
   /* HT = ht(Capacity,_,Table) */
   PL_get_arg(1, ht, pl_capacity);
-  PL_get_integer(pl_capacity, &capacity);
+  PL_get_long(pl_capacity, &capacity);
   PL_get_arg(3, ht, table);
 
   /* Index is (Hash mod Capacity) + 1 */
-  PL_get_integer(pl_hash, &hash);
+  PL_get_long(pl_hash, &hash);
   index = (hash % capacity) + 1;  
 
   /* arg(Index,Table,Bucket) */
@@ -54,7 +57,7 @@ pl_lookup_ht1(term_t ht, term_t pl_hash, term_t key, term_t values)
   	term_t pair	     = PL_new_term_ref();
   	term_t k	     = PL_new_term_ref();
 	term_t vs	     = PL_new_term_ref();
-	while (PL_get_list(bucket, pair,bucket)) {
+	while (GET_LIST(bucket, pair,bucket)) {
   		PL_get_arg(1, pair, k);
 		if ( PL_compare(k,key) == 0 ) {
       			/* Values = Vs */
@@ -85,7 +88,7 @@ pl_memberchk_eq(term_t element, term_t maybe_list)
   term_t head = PL_new_term_ref();      	/* variable for the elements */
   term_t list = PL_copy_term_ref(maybe_list);   /* copy as we need to write */
 
-  while( PL_get_list(list, head, list) )
+  while( GET_LIST(list, head, list) )
   { if ( PL_compare(element,head) == 0 )
      PL_succeed ;
   }
@@ -94,12 +97,53 @@ pl_memberchk_eq(term_t element, term_t maybe_list)
 
 }
 
+/*
+	next_bucket(Table,I,N,J,Bucket) :-
+		I =< N,
+		arg(I,Table,B),
+		( nonvar(B), B \== [] ->
+			J = I,
+			Bucket = B
+		;
+			I1 is I + 1,
+			next_bucket(Table,I1,N,J,Bucket)
+		).
+
+   Finds the next bucket in use for value_ht/2 and value_iht/2, which
+   spend most of their time stepping over empty buckets.
+*/
+static foreign_t
+pl_next_bucket(term_t table, term_t pl_i, term_t pl_n, term_t pl_j,
+	       term_t bucket)
+{
+  long i, n;
+  term_t b = PL_new_term_ref();
+
+  if ( !PL_get_long(pl_i, &i) || !PL_get_long(pl_n, &n) )
+    PL_fail;
+
+  for ( ; i <= n; i++ )
+  { if ( !PL_get_arg(i, table, b) )
+      PL_fail;
+    if ( !PL_is_variable(b) && !PL_get_nil(b) )
+      return PL_unify_integer(pl_j,i) && PL_unify(bucket,b);
+  }
+
+  PL_fail;
+}
+
 	/* INSTALL */
 
 install_t
 install_chr_support()
 {
   PL_register_foreign("memberchk_eq",2, pl_memberchk_eq, 0);
-  PL_register_foreign("lookup_ht1",4, pl_lookup_ht1, 0);
+  /* the stores ask for the library, whichever is loaded first */
+  PL_register_foreign_in_module("chr_hashtable_store",
+				"lookup_ht1",4, pl_lookup_ht1, 0);
+  PL_register_foreign_in_module("chr_hashtable_store",
+				"next_bucket",5, pl_next_bucket, 0);
+  PL_register_foreign_in_module("chr_integertable_store",
+				"next_bucket",5, pl_next_bucket, 0);
 }
 
@@ -43,6 +43,13 @@ int32_t Cuda_Erase(predicate *pred);
 
 void init_cuda( void );
 
+// evaluate on the CPU instead of the GPU, see cuda_backend/1
+#ifdef CUDA_CPU_ONLY
+static int use_cpu = TRUE;
+#else
+static int use_cpu = FALSE;
+#endif
+
 //#define DEBUG_INTERFACE 1
 
 #ifdef ROCKIT
@@ -429,6 +436,16 @@ void setQuery(YAP_Term t1, int32_t **res)
 	*res = query;
 }
 
+static int32_t
+datalog_eval(predicate **inpfacts, int ninpf, predicate **inprules, int ninpr, int32_t *inpquery, int32_t **result, char *names, int32_t finalDR)
+{
+#ifndef CUDA_CPU_ONLY
+  if (!use_cpu)
+    return Cuda_Eval(inpfacts, ninpf, inprules, ninpr, inpquery, result, names, finalDR);
+#endif
+  return Cpu_Eval(inpfacts, ninpf, inprules, ninpr, inpquery, result, names, finalDR);
+}
+
 static int
 cuda_eval( void )
 {
@@ -440,7 +457,7 @@ cuda_eval( void )
 #endif
 
 	int32_t finalDR = YAP_IntOfTerm(YAP_ARG3);
-  int32_t n = Cuda_Eval(facts, cf, rules, cr, query, & mat, names, finalDR);
+  int32_t n = datalog_eval(facts, cf, rules, cr, query, & mat, names, finalDR);
 
 #ifdef TUFFY
 	cf = 0;
@@ -465,6 +482,8 @@ cuda_eval( void )
 
   if (n < 0)
     return FALSE;
+  // the list is built from C locals, that the collector cannot move
+  YAP_RequiresExtraStack((size_t)n*(ncols+3)+1024);
   for (i=0; i<n; i++) {
     int32_t ni = ((n-1)-i)*ncols, j;
 
@@ -503,7 +522,7 @@ cuda_coverage( void )
 	setQuery(YAP_ARG1, &query);
 #endif
 
-  int32_t n = Cuda_Eval(facts, cf, rules, cr, query, & mat, 0, 0);
+  int32_t n = datalog_eval(facts, cf, rules, cr, query, & mat, 0, 0);
   int32_t post = YAP_AtomToInt(YAP_AtomOfTerm(YAP_ARG2));
   int32_t i = n/2, min = 0, max = n-1;
   int32_t t0, t1;
@@ -554,7 +573,7 @@ static int cuda_count( void )
 	setQuery(YAP_ARG1, &query);
 #endif
 
-  int32_t n = Cuda_Eval(facts, cf, rules, cr, query, & mat, 0, 0);
+  int32_t n = datalog_eval(facts, cf, rules, cr, query, & mat, 0, 0);
 
   if (n < 0)
     return FALSE;
@@ -564,10 +583,36 @@ static int cuda_count( void )
 
 static int cuda_statistics( void )
 {
-  Cuda_Statistics();
+#ifndef CUDA_CPU_ONLY
+  if (!use_cpu) {
+    Cuda_Statistics();
+    return TRUE;
+  }
+#endif
+  Cpu_Statistics();
   return TRUE;
 }
 
+static int cuda_backend( void )
+{
+  YAP_Term t = YAP_ARG1;
+  if (YAP_IsVarTerm(t))
+    return YAP_Unify(t, YAP_MkAtomTerm(YAP_LookupAtom(use_cpu ? "cpu" : "gpu")));
+  if (!YAP_IsAtomTerm(t))
+    return FALSE;
+  if (!strcmp(YAP_AtomName(YAP_AtomOfTerm(t)), "cpu")) {
+    use_cpu = TRUE;
+    return TRUE;
+  }
+#ifndef CUDA_CPU_ONLY
+  if (!strcmp(YAP_AtomName(YAP_AtomOfTerm(t)), "gpu")) {
+    use_cpu = FALSE;
+    return TRUE;
+  }
+#endif
+  return FALSE;
+}
+
 static int first_time = TRUE;
 
 void
@@ -592,6 +637,7 @@ init_cuda(void)
   YAP_UserCPredicate("cuda_coverage", cuda_coverage, 4);
   YAP_UserCPredicate("cuda_count", cuda_count, 2);
   YAP_UserCPredicate("cuda_statistics", cuda_statistics, 0);
+  YAP_UserCPredicate("cuda_backend", cuda_backend, 1);
 
 #ifdef ROCKIT
   YAP_UserCPredicate("cuda_init_query", cuda_init_query, 1);
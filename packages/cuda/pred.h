@@ -44,4 +44,8 @@ extern statinfo cuda_stats;
 
 int Cuda_Eval(predicate**, int, predicate**, int, int*, int**, char*, int);
 void  Cuda_Statistics( void );
+
+/* semi-naive evaluation on the CPU, see seminaive.cpp */
+int Cpu_Eval(predicate**, int, predicate**, int, int*, int**, char*, int);
+void  Cpu_Statistics( void );
 #endif
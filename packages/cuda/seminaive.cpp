@@ -0,0 +1,621 @@
+/*
+ * Semi-naive bottom-up evaluation of the Datalog programs built by
+ * cuda.c, for machines without a GPU.
+ *
+ * Facts and rules use the same encoding as Cuda_Eval: facts are
+ * row-major int tables, a rule is the head goal followed by the body
+ * goals, each one a predicate name (or one of the SBG_ comparison
+ * codes) followed by its arguments and a 0 terminator. Positive
+ * arguments are variables, negative ones constants.
+ *
+ * Relations are kept as duplicate free tuple arrays in the order the
+ * tuples were derived, so the tuples added by the last iteration (the
+ * delta) are a suffix of the relation. Every iteration joins the delta
+ * against the full relations with hash joins and appends the new
+ * tuples; the hash indices only ever index the rows they have not
+ * seen yet. Probing is split over a number of threads.
+ */
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+extern "C" {
+#include "pred.h"
+}
+
+using namespace std;
+
+namespace {
+
+/* tuples per thread below which probing stays sequential */
+const size_t MIN_CHUNK = 4096;
+
+struct cpu_stats_t {
+  size_t calls, iterations, joins, tuples;
+  double total_time;
+} cpu_stats;
+
+struct HashIndex {
+  vector<int> cols;
+  vector<int> heads;
+  vector<int> next;
+  size_t mask;
+  size_t count;         /* rows indexed so far */
+  HashIndex() : mask(0), count(0) {}
+};
+
+struct Relation {
+  int arity;
+  size_t nrows;
+  vector<int> rows;     /* duplicate free, in derivation order */
+  size_t dstart;        /* rows from dstart on are the delta */
+  HashIndex all;        /* on every column, to drop duplicates */
+  map<vector<int>, HashIndex> indices;  /* over rows */
+  Relation() : arity(-1), nrows(0), dstart(0) {}
+  size_t ndelta() const { return nrows - dstart; }
+  const int *delta() const { return rows.data() + dstart * arity; }
+};
+
+struct Goal {
+  int code;             /* predicate name or SBG_ code */
+  bool negated;
+  vector<int> args;
+};
+
+struct Rule {
+  int head;
+  vector<int> hargs;
+  vector<Goal> body;    /* in execution order */
+  int nvars;
+};
+
+inline uint32_t
+mix(uint32_t h, int v)
+{
+  h ^= (uint32_t)v + 0x9e3779b9u + (h << 6) + (h >> 2);
+  return h;
+}
+
+inline bool
+row_less(const int *a, const int *b, int n)
+{
+  for (int i = 0; i < n; i++) {
+    if (a[i] != b[i])
+      return a[i] < b[i];
+  }
+  return false;
+}
+
+inline uint32_t
+row_hash(const int *t, const vector<int> &cols)
+{
+  uint32_t h = 0;
+  for (size_t c = 0; c < cols.size(); c++)
+    h = mix(h, t[cols[c]]);
+  return h;
+}
+
+/*
+ * Adds rows [ix.count, n) to the index. The table is only rebuilt when
+ * it gets half full, and then to twice the size needed, so a relation
+ * that grows by its deltas is indexed in amortised constant time per row.
+ */
+void
+extend_index(HashIndex &ix, const int *rows, size_t n, int arity)
+{
+  if (ix.heads.empty() || 2 * n > ix.mask + 1) {
+    size_t size = 16;
+    while (size < 4 * n)
+      size <<= 1;
+    ix.mask = size - 1;
+    ix.heads.assign(size, -1);
+    ix.count = 0;
+  }
+  ix.next.resize(n);
+  for (size_t i = ix.count; i < n; i++) {
+    uint32_t h = row_hash(rows + i * arity, ix.cols) & ix.mask;
+    ix.next[i] = ix.heads[h];
+    ix.heads[h] = (int)i;
+  }
+  ix.count = n;
+}
+
+void
+build_index(HashIndex &ix, const vector<int> &cols, const int *rows, size_t n, int arity)
+{
+  ix.cols = cols;
+  ix.heads.clear();
+  extend_index(ix, rows, n, arity);
+}
+
+/* sort and remove duplicates from n tuples of the given arity */
+size_t
+sort_unique(vector<int> &tuples, size_t n, int arity)
+{
+  if (n < 2 || arity == 0)
+    return n < 1 ? n : 1;
+  vector<size_t> perm(n);
+  for (size_t i = 0; i < n; i++)
+    perm[i] = i;
+  const int *base = tuples.data();
+  sort(perm.begin(), perm.end(), [base, arity](size_t a, size_t b) {
+    return row_less(base + a * arity, base + b * arity, arity);
+  });
+  vector<int> out;
+  out.reserve(n * arity);
+  const int *prev = NULL;
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    const int *t = base + perm[i] * arity;
+    if (prev && !row_less(prev, t, arity))
+      continue;
+    out.insert(out.end(), t, t + arity);
+    prev = t;
+    m++;
+  }
+  tuples.swap(out);
+  return m;
+}
+
+/* appends the tuples of cand not yet in r to r, where they become its delta */
+void
+merge_new(Relation &r, const vector<int> &cand, size_t ncand)
+{
+  int a = r.arity;
+  r.dstart = r.nrows;
+  if (a == 0) {
+    /* a proposition: true once derived */
+    if (r.nrows == 0 && ncand > 0)
+      r.nrows = 1;
+    cpu_stats.tuples += r.ndelta();
+    return;
+  }
+  if (r.all.cols.empty())
+    for (int c = 0; c < a; c++)
+      r.all.cols.push_back(c);
+  for (size_t j = 0; j < ncand; j++) {
+    const int *y = &cand[j * a];
+    int t = r.all.heads.empty() ? -1 : r.all.heads[row_hash(y, r.all.cols) & r.all.mask];
+    for (; t >= 0; t = r.all.next[t])
+      if (!memcmp(&r.rows[(size_t)t * a], y, a * sizeof(int)))
+        break;
+    if (t >= 0)
+      continue;
+    r.rows.insert(r.rows.end(), y, y + a);
+    r.nrows++;
+    extend_index(r.all, r.rows.data(), r.nrows, a);
+  }
+  cpu_stats.tuples += r.ndelta();
+}
+
+const HashIndex &
+full_index(Relation &r, const vector<int> &cols)
+{
+  HashIndex &ix = r.indices[cols];
+  if (ix.cols.empty())
+    ix.cols = cols;
+  if (ix.count != r.nrows || ix.heads.empty())
+    extend_index(ix, r.rows.data(), r.nrows, r.arity);
+  return ix;
+}
+
+unsigned
+nr_threads(void)
+{
+  unsigned n = thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+/*
+ * Runs f(first, last, out) over [0, n) in contiguous chunks, one per
+ * thread, and concatenates the outputs in chunk order so the result
+ * does not depend on the number of threads.
+ */
+template <typename F> void
+parallel_chunks(size_t n, vector<int> &out, F f)
+{
+  size_t nt = min((size_t)nr_threads(), n / MIN_CHUNK + 1);
+  if (nt <= 1) {
+    f(0, n, out);
+    return;
+  }
+  vector<vector<int> > outs(nt);
+  vector<thread> workers;
+  size_t chunk = (n + nt - 1) / nt;
+  for (size_t t = 0; t < nt; t++) {
+    size_t first = min(t * chunk, n), last = min(first + chunk, n);
+    workers.push_back(thread([&f, &outs, t, first, last] {
+      f(first, last, outs[t]);
+    }));
+  }
+  for (size_t t = 0; t < nt; t++)
+    workers[t].join();
+  for (size_t t = 0; t < nt; t++)
+    out.insert(out.end(), outs[t].begin(), outs[t].end());
+}
+
+inline int
+arg_value(int a, const int *b)
+{
+  return a > 0 ? b[a - 1] : -a;
+}
+
+bool
+compare(int code, int x, int y)
+{
+  switch (code) {
+  case SBG_EQ: return x == y;
+  case SBG_GT: return x > y;
+  case SBG_LT: return x < y;
+  case SBG_GE: return x >= y;
+  case SBG_LE: return x <= y;
+  case SBG_DF: return x != y;
+  }
+  return false;
+}
+
+/*
+ * Evaluates one rule; goal `deltaGoal' (if any) reads the delta of
+ * its relation instead of the full one. Derived head tuples are
+ * appended to out.
+ */
+size_t
+eval_rule(const Rule &r, int deltaGoal, map<int, Relation> &rels, vector<int> &out)
+{
+  /* one row of variable values per partial solution */
+  int w = r.nvars ? r.nvars : 1;
+  vector<char> bound(w + 1, 0);
+  vector<int> bind(w, 0);
+  size_t nb = 1;
+
+  for (size_t g = 0; g < r.body.size() && nb > 0; g++) {
+    const Goal &goal = r.body[g];
+    vector<int> nbind;
+
+    if (goal.code < 0) {
+      /* comparison; an equality with one unbound variable binds it */
+      int a0 = goal.args[0], a1 = goal.args[1], setv = 0, from = 0;
+      if (goal.code == SBG_EQ && a0 > 0 && !bound[a0])
+        setv = a0, from = a1;
+      else if (goal.code == SBG_EQ && a1 > 0 && !bound[a1])
+        setv = a1, from = a0;
+      parallel_chunks(nb, nbind, [&](size_t first, size_t last, vector<int> &o) {
+        for (size_t i = first; i < last; i++) {
+          const int *b = &bind[i * w];
+          if (setv) {
+            o.insert(o.end(), b, b + w);
+            o[o.size() - w + setv - 1] = arg_value(from, b);
+          } else if (compare(goal.code, arg_value(a0, b), arg_value(a1, b))) {
+            o.insert(o.end(), b, b + w);
+          }
+        }
+      });
+      if (setv)
+        bound[setv] = 1;
+    } else {
+      Relation &rel = rels[goal.code];
+      bool useDelta = (int)g == deltaGoal;
+      const int *rows = useDelta ? rel.delta() : rel.rows.data();
+      size_t nrows = useDelta ? rel.ndelta() : rel.nrows;
+      int a = rel.arity;
+      /* columns whose value is known before the lookup */
+      vector<int> keyCols, keyArgs, newVars, newCols, eqCols, eqArgs;
+      vector<char> seen(w + 1, 0);
+      for (int c = 0; c < a; c++) {
+        int v = goal.args[c];
+        if (v <= 0 || bound[v]) {
+          keyCols.push_back(c);
+          keyArgs.push_back(v);
+        } else if (seen[v]) {
+          eqCols.push_back(c);
+          eqArgs.push_back(v);
+        } else {
+          seen[v] = 1;
+          newVars.push_back(v);
+          newCols.push_back(c);
+        }
+      }
+      HashIndex local;
+      const HashIndex *ix = NULL;
+      if (!keyCols.empty()) {
+        if (useDelta) {
+          build_index(local, keyCols, rows, nrows, a);
+          ix = &local;
+        } else {
+          ix = &full_index(rel, keyCols);
+        }
+      }
+      cpu_stats.joins++;
+      parallel_chunks(nb, nbind, [&](size_t first, size_t last, vector<int> &o) {
+        vector<int> key(keyCols.size());
+        for (size_t i = first; i < last; i++) {
+          const int *b = &bind[i * w];
+          uint32_t h = 0;
+          for (size_t k = 0; k < keyCols.size(); k++) {
+            key[k] = arg_value(keyArgs[k], b);
+            h = mix(h, key[k]);
+          }
+          int t = ix ? ix->heads[h & ix->mask] : (nrows ? 0 : -1);
+          bool found = false;
+          for (; t >= 0; t = ix ? ix->next[t] : ((size_t)t + 1 < nrows ? t + 1 : -1)) {
+            const int *tp = rows + (size_t)t * a;
+            size_t k;
+            for (k = 0; k < keyCols.size(); k++) {
+              if (tp[keyCols[k]] != key[k])
+                break;
+            }
+            if (k < keyCols.size())
+              continue;
+            for (k = 0; k < eqCols.size(); k++) {
+              int c0 = newCols[find(newVars.begin(), newVars.end(), eqArgs[k]) - newVars.begin()];
+              if (tp[eqCols[k]] != tp[c0])
+                break;
+            }
+            if (k < eqCols.size())
+              continue;
+            found = true;
+            if (goal.negated)
+              break;
+            o.insert(o.end(), b, b + w);
+            int *nbp = &o[o.size() - w];
+            for (k = 0; k < newVars.size(); k++)
+              nbp[newVars[k] - 1] = tp[newCols[k]];
+          }
+          if (goal.negated && !found)
+            o.insert(o.end(), b, b + w);
+        }
+      });
+      for (size_t k = 0; k < newVars.size(); k++)
+        bound[newVars[k]] = 1;
+    }
+    bind.swap(nbind);
+    nb = bind.size() / w;
+  }
+  size_t ha = r.hargs.size();
+  for (size_t i = 0; i < nb; i++) {
+    const int *b = &bind[i * w];
+    for (size_t k = 0; k < ha; k++)
+      out.push_back(arg_value(r.hargs[k], b));
+  }
+  return nb;
+}
+
+const int *
+parse_goal(const int *ptr, Goal &g)
+{
+  g.code = *ptr++;
+  g.negated = false;
+  g.args.clear();
+  while (*ptr != 0)
+    g.args.push_back(*ptr++);
+  return ptr + 1;
+}
+
+/*
+ * Reorders the body so that comparisons and negated goals run as soon
+ * as their variables are bound. Fails for unsafe rules.
+ */
+bool
+schedule_body(Rule &r)
+{
+  vector<Goal> pending, body;
+  vector<char> bound(r.nvars + 1, 0);
+  vector<Goal> in = r.body;
+  size_t i = 0;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (size_t p = 0; p < pending.size(); ) {
+      Goal &g = pending[p];
+      size_t unb = 0;
+      for (size_t k = 0; k < g.args.size(); k++)
+        if (g.args[k] > 0 && !bound[g.args[k]])
+          unb++;
+      if (unb == 0 || (g.code == SBG_EQ && unb == 1)) {
+        for (size_t k = 0; k < g.args.size(); k++)
+          if (g.args[k] > 0)
+            bound[g.args[k]] = 1;
+        body.push_back(g);
+        pending.erase(pending.begin() + p);
+        progress = true;
+      } else {
+        p++;
+      }
+    }
+    if (progress)
+      continue;
+    if (i < in.size()) {
+      Goal &g = in[i++];
+      if (g.code < 0 || g.negated) {
+        pending.push_back(g);
+      } else {
+        for (size_t k = 0; k < g.args.size(); k++)
+          if (g.args[k] > 0)
+            bound[g.args[k]] = 1;
+        body.push_back(g);
+      }
+      progress = true;
+    }
+  }
+  if (!pending.empty())
+    return false;
+  for (size_t k = 0; k < r.hargs.size(); k++)
+    if (r.hargs[k] > 0 && !bound[r.hargs[k]])
+      return false;
+  r.body.swap(body);
+  return true;
+}
+
+bool
+set_arity(Relation &r, int arity)
+{
+  if (r.arity < 0)
+    r.arity = arity;
+  return r.arity == arity;
+}
+
+}  // namespace
+
+extern "C"
+void Cpu_Statistics(void)
+{
+  cerr << "CPU Datalog statistics:" << endl;
+  cerr << "    Calls: " << cpu_stats.calls << "." << endl;
+  cerr << "    Iterations: " << cpu_stats.iterations << "." << endl;
+  cerr << "    Joins: " << cpu_stats.joins << "." << endl;
+  cerr << "    Tuples derived: " << cpu_stats.tuples << "." << endl;
+  cerr << "    Total time: " << cpu_stats.total_time << " ms." << endl << endl;
+}
+
+extern "C"
+int Cpu_Eval(predicate **inpfacts, int ninpf, predicate **inprules, int ninpr, int *inpquery, int **result, char *names, int finalDR)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  map<int, Relation> rels;
+  vector<Rule> rules;
+  int x;
+
+  (void)names;
+  (void)finalDR;
+  cpu_stats.calls++;
+  *result = NULL;
+
+  /* load the facts */
+  for (x = 0; x < ninpf; x++) {
+    predicate *p = inpfacts[x];
+    Relation &r = rels[p->name];
+    if (!set_arity(r, p->num_columns))
+      return -1;
+    vector<int> cand(p->address_host_table, p->address_host_table + (size_t)p->num_rows * p->num_columns);
+    merge_new(r, cand, p->num_rows);
+    r.dstart = 0;
+  }
+
+  /* decode the rules */
+  for (x = 0; x < ninpr; x++) {
+    predicate *p = inprules[x];
+    const int *ptr = p->address_host_table;
+    Rule r;
+    Goal g;
+    int y, npreds = 1;
+    ptr = parse_goal(ptr, g);
+    r.head = g.code;
+    r.hargs = g.args;
+    r.nvars = 0;
+    for (y = 1; y < p->num_rows; y++) {
+      ptr = parse_goal(ptr, g);
+      if (g.code >= 0) {
+        g.negated = p->negatives && p->negatives[npreds];
+        npreds++;
+        if (!set_arity(rels[g.code], g.args.size()))
+          return -1;
+      } else if (g.code < BPOFFSET || g.args.size() != 2) {
+        return -1;
+      }
+      r.body.push_back(g);
+    }
+    if (!set_arity(rels[r.head], r.hargs.size()))
+      return -1;
+    for (size_t k = 0; k < r.hargs.size(); k++)
+      r.nvars = max(r.nvars, r.hargs[k]);
+    for (size_t b = 0; b < r.body.size(); b++)
+      for (size_t k = 0; k < r.body[b].args.size(); k++)
+        r.nvars = max(r.nvars, r.body[b].args[k]);
+    if (!schedule_body(r))
+      return -1;
+    rules.push_back(r);
+  }
+
+  /* stratify: a predicate sits above everything it negates */
+  map<int, int> stratum;
+  for (size_t i = 0; i < rules.size(); i++)
+    stratum[rules[i].head] = 0;
+  bool changed = true;
+  int nstrata = 0;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < rules.size(); i++) {
+      int &s = stratum[rules[i].head];
+      for (size_t b = 0; b < rules[i].body.size(); b++) {
+        const Goal &g = rules[i].body[b];
+        map<int, int>::iterator it;
+        if (g.code < 0 || (it = stratum.find(g.code)) == stratum.end())
+          continue;
+        int need = it->second + (g.negated ? 1 : 0);
+        if (need > s) {
+          s = need;
+          changed = true;
+        }
+      }
+      if (s > (int)rules.size())
+        return -1;   /* recursion through negation */
+      nstrata = max(nstrata, s + 1);
+    }
+  }
+
+  /* semi-naive evaluation, one stratum at a time */
+  for (int s = 0; s < nstrata; s++) {
+    vector<size_t> srules;
+    for (size_t i = 0; i < rules.size(); i++)
+      if (stratum[rules[i].head] == s)
+        srules.push_back(i);
+    map<int, pair<vector<int>, size_t> > cand;
+    for (size_t i = 0; i < srules.size(); i++) {
+      const Rule &r = rules[srules[i]];
+      pair<vector<int>, size_t> &c = cand[r.head];
+      c.second += eval_rule(r, -1, rels, c.first);
+    }
+    while (true) {
+      bool any = false;
+      cpu_stats.iterations++;
+      for (map<int, pair<vector<int>, size_t> >::iterator it = cand.begin(); it != cand.end(); ++it) {
+        Relation &r = rels[it->first];
+        merge_new(r, it->second.first, it->second.second);
+        it->second.first.clear();
+        it->second.second = 0;
+        if (r.ndelta())
+          any = true;
+      }
+      if (!any)
+        break;
+      for (size_t i = 0; i < srules.size(); i++) {
+        const Rule &r = rules[srules[i]];
+        pair<vector<int>, size_t> &c = cand[r.head];
+        for (size_t b = 0; b < r.body.size(); b++) {
+          const Goal &g = r.body[b];
+          if (g.code < 0 || g.negated)
+            continue;
+          map<int, int>::iterator st = stratum.find(g.code);
+          if (st == stratum.end() || st->second != s || rels[g.code].ndelta() == 0)
+            continue;
+          c.second += eval_rule(r, b, rels, c.first);
+        }
+      }
+    }
+    for (size_t i = 0; i < srules.size(); i++) {
+      Relation &r = rels[rules[srules[i]].head];
+      r.dstart = r.nrows;
+    }
+  }
+
+  cpu_stats.total_time += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  map<int, Relation>::iterator q = rels.find(inpquery[0]);
+  if (q == rels.end() || q->second.nrows == 0)
+    return 0;
+  /* answers come out sorted, as from the GPU */
+  Relation &r = q->second;
+  vector<int> sorted(r.rows);
+  size_t n = sort_unique(sorted, r.nrows, r.arity);
+  size_t bytes = n * r.arity * sizeof(int);
+  *result = (int *)malloc(bytes ? bytes : sizeof(int));
+  if (*result == NULL)
+    return -1;
+  memcpy(*result, sorted.data(), bytes);
+  return (int)n;
+}
@@ -2,353 +2,382 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "b+tree_private.h"
 
 btree_t BTreeNew (void)
 {
   btree_t t;
-  t = BTreeNewNode();
-  t->level = 0; /*leaf*/
+
+  t = (btree_t) calloc (1, sizeof(struct BTree));
+  assert(t);
+  t->kind = BTREE_EMPTY;
   return t;
 }
 
 void BTreeDestroy (btree_t t)
 {
-  if (t)
-    BTreeDestroyNode (t);
+  if (!t)
+    return;
+  if (t->root)
+    BTreeDestroyNode (t->root);
+  free(t->pending);
+  free(t);
 }
 
 static void BTreeDestroyNode (node_t n)
 {
   int i;
 
-  if (n->level == 0)
-    {
-      for (i = 0; i < n->count; i++)
-        ;/* allow user free data*/
-    }
-  else
-    {
-      for (i = 0; i < n->count; i++)
-        BTreeDestroyNode (n->branch[i].child);
-    }
+  if (n->level > 0)
+    for (i = 0; i <= n->count; i++)
+      BTreeDestroyNode (n->child[i]);
+  /* leaf data belongs to the user */
+  free(n);
 }
 
-static node_t BTreeNewNode (void)
+static node_t BTreeNewNode (int level)
 {
   node_t n;
 
-  n = (node_t) malloc (SIZEOF_NODE);
+#ifdef _WIN32
+  n = (node_t) malloc (sizeof(struct Node));
+#else
+  if (posix_memalign((void **) &n, CACHE_LINE, sizeof(struct Node)))
+    n = NULL;
+#endif
   assert(n);
-  BTreeNodeInit(n);
+  n->next = NULL;
+  n->count = 0;
+  n->level = level;
   return n;
 }
 
-static void BTreeNodeInit (node_t n)
+static int BTreeCompare (int kind, btree_key_t a, btree_key_t b)
 {
-  memset((void *) n,0, SIZEOF_NODE);
-  n->level = -1;
+  if (kind == BTREE_FLOAT)
+    return (a.f > b.f) - (a.f < b.f);
+  return (a.i > b.i) - (a.i < b.i);
 }
 
-void *BTreeMin (node_t n, node_t *f, int *i)
+/* ties keep insertion order, data is the clause number */
+static int EntryCompareInt (const void *a, const void *b)
 {
+  const entry_t *x = a, *y = b;
 
-  if (n->level > 0)
-    return BTreeMin((node_t) n->branch[0].child, f, i);
-  else
-    {
-      if(f)
-        *f = n;
-      if(i)
-        *i = 0;
-      return n->branch[0].child;
-    }
+  if (x->key.i != y->key.i)
+    return x->key.i < y->key.i ? -1 : 1;
+  return ((uintptr_t) x->data > (uintptr_t) y->data) -
+    ((uintptr_t) x->data < (uintptr_t) y->data);
 }
 
-void *BTreeMax (node_t n, node_t *f, int *i)
+static int EntryCompareFloat (const void *a, const void *b)
 {
+  const entry_t *x = a, *y = b;
 
-  if (n->level > 0)
-    return BTreeMax((node_t) n->branch[n->count].child, f, i);
-  else
-    {
-      if(n->count > 0)
-	{
-	  if(f)
-	    *f = n;
-	  if(i)
-	    *i = n->count - 1;
-	  return n->branch[n->count - 1].child;
-	}
-    }
+  if (x->key.f != y->key.f)
+    return x->key.f < y->key.f ? -1 : 1;
+  return ((uintptr_t) x->data > (uintptr_t) y->data) -
+    ((uintptr_t) x->data < (uintptr_t) y->data);
+}
 
-  if (f)
-    *f = NULL;
-  if (i)
-    *i = -1;
-  return NULL;
+static int BTreeJoinKind (int a, int b)
+{
+  if (a == BTREE_EMPTY || a == b)
+    return b;
+  if (b == BTREE_EMPTY)
+    return a;
+  if ((a == BTREE_INT && b == BTREE_FLOAT) ||
+      (a == BTREE_FLOAT && b == BTREE_INT))
+    return BTREE_FLOAT;
+  return BTREE_MIXED;
 }
 
-void * BTreeSearch (node_t n, double k, int s, node_t *f, int *i)
+void BTreeInsert (btree_t t, int kind, btree_key_t k, void *ptr)
 {
-  int j;
+  assert(t);
 
-  assert(s == EQ || s == GE || s == GT);
+  if (t->kind == BTREE_MIXED)
+    return;
+  if (t->npending == t->maxpending)
+    {
+      t->maxpending = t->maxpending ? 2 * t->maxpending : 1024;
+      t->pending = (entry_t *) realloc (t->pending,
+                                        t->maxpending * sizeof(entry_t));
+      assert(t->pending);
+    }
+  t->pending[t->npending].key = k;
+  t->pending[t->npending].data = ptr;
+  t->pending[t->npending].kind = kind;
+  t->npending ++;
+}
 
-  if (n->level > 0)
+/*
+ * Sorts the buffered entries and merges them with the ones already in
+ * the tree, that is then rebuilt bottom up. UDI predicates are static,
+ * so this usually happens once, at the first search after consult.
+ */
+static void BTreeFlush (btree_t t)
+{
+  entry_t *p = t->pending, *all;
+  size_t n = t->npending, i, j, k;
+  int kind = t->kind;
+  node_t leaf;
+  int (*cmp)(const void *, const void *);
+
+  if (n == 0)
+    return;
+  for (i = 0; i < n; i++)
+    kind = BTreeJoinKind(kind, p[i].kind);
+  if (kind == BTREE_MIXED)
     {
-      for (j = 0; j < n->count; j++)
-        if (n->branch[j].key >= k)
-          return BTreeSearch((node_t) n->branch[j].child,k,s,f,i);
-      return BTreeSearch((node_t) n->branch[j].child,k,s,f,i);
+      if (t->root)
+        BTreeDestroyNode(t->root);
+      t->root = t->first = t->last = NULL;
+      t->size = 0;
+      t->kind = BTREE_MIXED;
+      free(t->pending);
+      t->pending = NULL;
+      t->npending = t->maxpending = 0;
+      return;
     }
+  if (kind == BTREE_FLOAT)
+    for (i = 0; i < n; i++)
+      if (p[i].kind == BTREE_INT)
+        p[i].key.f = (double) p[i].key.i;
+  cmp = kind == BTREE_FLOAT ? EntryCompareFloat : EntryCompareInt;
+  qsort(p, n, sizeof(entry_t), cmp);
+
+  if (t->size == 0)
+    all = p;
   else
     {
-      if (s == EQ || s == GE) /*== or >=*/
-        for (j = 0; j < n->count; j++)
-          if (n->branch[j].key == k)
+      all = (entry_t *) malloc ((t->size + n) * sizeof(entry_t));
+      assert(all);
+      leaf = t->first;
+      i = j = k = 0;
+      while (leaf || j < n)
+        {
+          entry_t e;
+
+          if (leaf)
             {
-              if (f)
-                *f = n;
-              if (i)
-                *i = j;
-              return n->branch[j].child;
+              e.key = leaf->key[i];
+              if (t->kind == BTREE_INT && kind == BTREE_FLOAT)
+                e.key.f = (double) e.key.i;
+              e.data = leaf->child[i];
             }
-      if (s == GE || s == GT) /* >= or > */
-        {
-          if (f)
-            *f = n;
-          for (j = 0; j < n->count; j++)
-            if (n->branch[j].key > k)
-              {
-                if (i)
-                  *i = j;
-                return n->branch[j].child;
-              }
+          if (leaf && (j == n || cmp(&e, p + j) <= 0))
+            {
+              all[k++] = e;
+              if (++i == (size_t) leaf->count)
+                {
+                  leaf = leaf->next;
+                  i = 0;
+                }
+            }
+          else
+            all[k++] = p[j++];
         }
+      n = k;
+      BTreeDestroyNode(t->root);
     }
-  if (f)
-    *f = NULL;
-  if (i)
-    *i = -1;
-  return NULL;
+  t->kind = kind;
+  BTreePack(t, all, n);
+  if (all != p)
+    free(all);
+  free(t->pending);
+  t->pending = NULL;
+  t->npending = t->maxpending = 0;
 }
 
-void *BTreeSearchNext (double max, int s, node_t *n, int *i)
+/*
+ * Builds the tree from n sorted entries: full leaves chained left to
+ * right, then each level of inner nodes over the one below, where the
+ * separator before child i is the least key under it.
+ */
+static void BTreePack (btree_t t, entry_t *e, size_t n)
 {
-  assert(n && i);
-  assert(s == LT || s == LE);
-
-  if (*i == (*n)->count - 1)
+  node_t *level, prev = NULL;
+  btree_key_t *mins;
+  size_t nnodes, i, j;
+  int lvl, c;
+
+  t->size = n;
+  t->root = t->first = t->last = NULL;
+  if (n == 0)
+    return;
+  nnodes = (n + MAXCARD - 1) / MAXCARD;
+  level = (node_t *) malloc (nnodes * sizeof(node_t));
+  mins = (btree_key_t *) malloc (nnodes * sizeof(btree_key_t));
+  assert(level && mins);
+
+  for (i = 0; i < nnodes; i++)
     {
-      if (!(*n)->branch[MAXCARD - 1].child) /*terminou*/
-        return NULL;
-      *n = (node_t) (*n)->branch[MAXCARD - 1].child;
-      *i = 0;
-    }
-  else
-    (*i) ++;
-
-  if ((*n)->branch[*i].key > max ||
-      ((*n)->branch[*i].key == max && s == LT))
-    return NULL;
+      node_t leaf = BTreeNewNode(0);
 
-  return (*n)->branch[*i].child;
-}
+      for (c = 0, j = i * MAXCARD; c < MAXCARD && j < n; c++, j++)
+        {
+          leaf->key[c] = e[j].key;
+          leaf->child[c] = e[j].data;
+        }
+      leaf->count = c;
+      if (prev)
+        prev->next = leaf;
+      prev = leaf;
+      level[i] = leaf;
+      mins[i] = leaf->key[0];
+    }
+  t->first = level[0];
+  t->last = prev;
 
-void BTreeInsert (btree_t *t, double k, void *ptr)
-{
-  node_t new_root;
+  for (lvl = 1; nnodes > 1; lvl++)
+    {
+      size_t nparents = (nnodes + MAXCARD) / (MAXCARD + 1);
 
-  assert(t && *t);
+      for (i = 0; i < nparents; i++)
+        {
+          node_t node = BTreeNewNode(lvl);
+          btree_key_t min = mins[i * (MAXCARD + 1)];
 
-  if (BTreeInsertNode(*t,&k,&ptr))
-    /* deal with root split */
-    {
-      new_root = BTreeNewNode();
-      new_root->level = (*t)->level + 1;
-      new_root->count = 1;
-      new_root->branch[0].key = k;
-      new_root->branch[0].child = (void *) (*t);
-      new_root->branch[1].child = ptr;
-      *t = new_root;
+          for (c = 0, j = i * (MAXCARD + 1);
+               c <= MAXCARD && j < nnodes; c++, j++)
+            {
+              node->child[c] = level[j];
+              if (c > 0)
+                node->key[c - 1] = mins[j];
+            }
+          node->count = c - 1;
+          level[i] = node;
+          mins[i] = min;
+        }
+      nnodes = nparents;
     }
+  t->root = level[0];
+  free(level);
+  free(mins);
 }
 
-static int BTreeInsertNode(node_t n, double *k, void **ptr)
-/*ptr holds data and can return node_t*/
+/* number of keys in n below k (strict == 0) or not above k (strict) */
+static int BTreeRank (node_t n, int kind, btree_key_t k, int strict)
 {
-  int i;
-
-  assert(n);
+  int lo = 0, hi = n->count;
 
-  if (n->level > 0)
+  while (lo < hi)
     {
-      i = BTreePickBranch(n,*k);
-      if (!BTreeInsertNode((node_t) n->branch[i].child, k, ptr))
-        /*not split */
-        {
-          return FALSE;
-        }
+      int mid = (lo + hi) / 2;
+      int c = BTreeCompare(kind, n->key[mid], k);
+
+      if (c < 0 || (strict && c == 0))
+        lo = mid + 1;
       else
-        /* node split */
-        {
-          return BTreeAddBranch(n, i, k, ptr); /*propagate split*/
-        }
-    }
-  else
-    {
-      return BTreeAddLeaf(n,k,ptr);
+        hi = mid;
     }
+  return lo;
 }
 
-static int BTreeAddBranch(node_t n, int idx, double *k,
-                          void **ptr)
+/* leaf and position of the first key >= k (> k if strict) */
+static node_t BTreeLeaf (btree_t t, btree_key_t k, int strict, int *idx)
 {
-  int i,j;
-  double key[MAXCARD];
-  void *branch[MAXCARD+1];
-  int level;
-  node_t t;
+  node_t n = t->root;
 
-  if (n->count < MAXCARD - 1)
+  while (n->level > 0)
+    n = (node_t) n->child[BTreeRank(n, t->kind, k, strict)];
+  *idx = BTreeRank(n, t->kind, k, strict);
+  if (*idx == n->count)
     {
-      i = n->count;
-      if (i > 0)
-        for(; n->branch[i-1].key > *k ; i--)
-          {
-            n->branch[i].key = n->branch[i-1].key;
-            n->branch[i+1].child = n->branch[i].child;
-          }
-      n->branch[i].key = *k;
-      n->branch[i+1].child = *ptr;
-      n->branch[i].child = n->branch[idx].child;
-      n->count ++;
-      return FALSE;
+      n = n->next;
+      *idx = 0;
     }
-  else
-    {
-      for(i = n->count, j = MAXCARD; 
-	  n->branch[i - 1].key  > *k; 
-	  i--, j--)
-        {
-          key[j - 1] = n->branch[i - 1].key;
-          branch[j] = n->branch[i].child;
-        }
-      key[j - 1] = *k;
-      branch[j - 1] = n->branch[idx].child;
-      branch[j] = *ptr;
-      j--;
-      for(; i > 0;i--,j--)
-        {
-          key[j-1] = n->branch[i-1].key;
-          branch[j-1] = n->branch[i-1].child;
-        }
-
-      level = n->level;
-      BTreeNodeInit(n);
-      n->level = level;
-      t = BTreeNewNode();
-      t->level = level;
-
-      for (i = 0; i < MAXCARD / 2; i ++)
-        {
-          n->branch[i].key = key[i];
-          n->branch[i].child = branch[i];
-          n->count ++;
-        }
-      n->branch[i].child = branch[i];
-
-      *k = key[i];
-      *ptr = t;
-
-      for (j = 0,i++; i < MAXCARD; j ++, i ++)
-        {
-          t->branch[j].key = key[i];
-          t->branch[j].child = branch[i];
-          t->count ++;
-        }
-      t->branch[j].child = branch[i];
+  return n;
+}
 
-      return TRUE;
-    }
+int BTreeKind (btree_t t)
+{
+  BTreeFlush(t);
+  return t->kind;
 }
 
-static int BTreePickBranch(node_t n, double k)
+void *BTreeMin (btree_t t)
 {
-  int i;
+  BTreeFlush(t);
+  if (!t->first)
+    return NULL;
+  return t->first->child[0];
+}
 
-  for (i = 0; i < n->count; i++)
-    if (n->branch[i].key > k)
-      return i;
-  return i;
+void *BTreeMax (btree_t t)
+{
+  BTreeFlush(t);
+  if (!t->last)
+    return NULL;
+  return t->last->child[t->last->count - 1];
 }
 
-static int BTreeAddLeaf(node_t n, double *k, void **ptr)
+size_t BTreeSearch (btree_t t,
+                    int minc, btree_key_t min,
+                    int maxc, btree_key_t max,
+                    BTreeBatchCallback callback, void *arg)
 {
-  int i,j;
-  node_t t;
-  double key[MAXCARD];
-  void *branch[MAXCARD];
+  node_t n;
+  int i, end, done = FALSE;
+  size_t count = 0;
 
-  assert(n);
+  assert(minc == ANY || minc == GE || minc == GT);
+  assert(maxc == ANY || maxc == LE || maxc == LT);
+
+  BTreeFlush(t);
+  if (!t->root || t->kind == BTREE_MIXED)
+    return 0;
 
-  if (n->count < MAXCARD - 1) /*split not necessary*/
+  if (minc == ANY)
     {
-      i = n->count;
-      if (i > 0)
-        for (; n->branch[i - 1].key > *k; i--)
-          {
-            n->branch[i].key = n->branch[i-1].key;
-            n->branch[i].child = n->branch[i-1].child;
-          }
-      n->branch[i].key = *k;
-      n->branch[i].child = *ptr;
-      n->count ++;
-      return FALSE;
+      n = t->first;
+      i = 0;
     }
-  else /*needs to split*/
+  else
+    n = BTreeLeaf(t, min, minc == GT, &i);
+
+  for (; n && !done; n = n->next, i = 0)
     {
-      for(i = n->count - 1, j = MAXCARD - 1; 
-	  n->branch[i].key  > *k;
-	  i--, j--)
+      end = n->count;
+      if (maxc != ANY &&
+          BTreeCompare(t->kind, n->key[end - 1], max) >= (maxc == LE))
         {
-          key[j] = n->branch[i].key;
-          branch[j] = n->branch[i].child;
+          /* the run ends in this leaf */
+          end = BTreeRank(n, t->kind, max, maxc == LE);
+          done = TRUE;
         }
-      key[j] = *k;
-      branch[j] = *ptr;
-      j--;
-      for(; i >= 0;i--,j--)
+      if (end > i)
         {
-          key[j] = n->branch[i].key;
-          branch[j] = n->branch[i].child;
+          count += end - i;
+          if (!callback(n->child + i, end - i, arg))
+            break;
         }
+    }
+  return count;
+}
 
-      n->count = 0;
-      t = BTreeNewNode();
-      t->level = n->level;
-
-      for (i = 0; i <= MAXCARD / 2; i ++)
-        {
-          n->branch[i].key = key[i];
-          n->branch[i].child = branch[i];
-          n->count ++;
-        }
-      *k = key[i-1];
-      *ptr = t;
-      for (j = 0; i < MAXCARD; j ++, i ++)
-        {
-          t->branch[j].key = key[i];
-          t->branch[j].child = branch[i];
-          t->count ++;
-        }
+static void BTreePrintNode (node_t n, int kind, int depth)
+{
+  int i;
 
-      /*linked list*/
-      t->branch[MAXCARD -1].child = n->branch[MAXCARD - 1].child;
-      n->branch[MAXCARD -1].child = t;
+  printf("%*s%s %d:", 2 * depth, "", n->level ? "node" : "leaf", n->count);
+  for (i = 0; i < n->count; i++)
+    if (kind == BTREE_FLOAT)
+      printf(" %g", n->key[i].f);
+    else
+      printf(" %" PRId64, n->key[i].i);
+  printf("\n");
+  if (n->level > 0)
+    for (i = 0; i <= n->count; i++)
+      BTreePrintNode((node_t) n->child[i], kind, depth + 1);
+}
 
-    return TRUE;
-    }
+void BTreePrint (btree_t t)
+{
+  BTreeFlush(t);
+  if (t->root)
+    BTreePrintNode(t->root, t->kind, 0);
 }
@@ -1,80 +1,80 @@
 #ifndef __BTREE_H__
 #define __BTREE_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifndef __BTREE_PRIVATE_H__
 typedef void * btree_t;
 typedef void * node_t;
 #endif
 
+/* Key domains, a tree holds keys of a single domain */
+#define BTREE_EMPTY 0
+#define BTREE_INT   1
+#define BTREE_FLOAT 2
+#define BTREE_ATOM  3 /* only equality, keys are the atom addresses */
+#define BTREE_MIXED 4 /* some keys can not be ordered, searches fail */
+
+typedef union
+{
+  double f;
+  int64_t i;
+} btree_key_t;
+
+/*
+ * Callback for a run of n consecutive values found in a search
+ * if it returns FALSE the search is immediately aborted
+ */
+typedef int (*BTreeBatchCallback) (void **data, size_t n, void *arg);
+
 /*
  * Alocates and initializes a new b+tree structure
  */
 extern btree_t BTreeNew (void);
 
 /*
- * Inserts in the b+tree the object with key key
+ * Adds the object data with key key, of domain kind, to the b+tree
+ *
+ * Insertions are buffered and the tree is built bottom up, with full
+ * leaves, the next time it is searched, so loading n keys costs a
+ * sort instead of n descents and splits.
  */
-extern void BTreeInsert (btree_t *btree, double key, void *data);
+extern void BTreeInsert (btree_t btree, int kind, btree_key_t key,
+                         void *data);
 
 /*
- * Searchs the b+tree for the min key object returning it
- *
- * If nidx(node index) and bidx(branch index) is not NULL
- * ...
+ * Returns the key domain of the b+tree
  */
-extern void * BTreeMin(btree_t btree, node_t *nidx, int *bidx);
+extern int BTreeKind (btree_t btree);
 
 /*
- * Searchs the b+tree for the max key object returning it
- *
- * If nidx(node index) and bidx(branch index) is not NULL
- * ...
+ * Returns the min (max) key object, NULL if the b+tree is empty
  */
-extern void * BTreeMax(btree_t btree, node_t *nidx, int *bidx);
+extern void * BTreeMin (btree_t btree);
+extern void * BTreeMax (btree_t btree);
 
 /* Seach Kinds */
-#define EQ 1 /* BTreeSearch(btree, key, EQ, NULL, NULL); */
+#define EQ 1
 #define LE 2
 #define LT 3
-/* First call: BTreeMin(btree, nidx, bidx);
-   Next Calls(until NULL is returned):
-        BTreeSearchNext(key_max, LT || LE, btree, nidx, bidx);*/
 #define GE 4
 #define GT 5
-/* First call: BTreeSearch(btree, key_min, GE || GT, nidx, bidx);
-   Next Calls(until NULL is returned):
-        BTreeSearchNext(key_min, LT || LE, btree, nidx, bidx);*/
-
-/* Range Searches
- * First call: BTreeSearch(btree, key_min, GE || GT, nidx, bidx);
- * Next Calls(until NULL is returned):
- *       BTreeSearchNext(key_max, LT || LE, btree, nidx, bidx);
- */
-
-/*
- * Searchs the b+tree for:
- * if kind == EQ finds the key object returning it
- * if kind == GE || GT finds the first valid key returning it
- *
- * Returns NULL on fail to find
- *
- * Other parameter to kind will fail
- *
- * If nidx(node index) and bidx(branch index) is not NULL it those values
- */
-extern void * BTreeSearch(btree_t btree, double key, int kind,
-                          node_t *nidx, int *bidx);
+#define ANY 0 /* no bound */
 
 /*
- * Searches next valid answers given nidx, bidx where set in previous call to
- * BTreeMin or BTreeSearch
+ * Range search: calls callback on the objects with min (GE || GT)
+ * key and (LE || LT) max, in key order. Either bound may be ANY.
  *
- * It will return the valid key objects with kind LE or LT, NULL otherwise
+ * The callback receives the hits stored consecutively in a leaf, so
+ * the scan does not allocate and is called once per leaf.
  *
- * nidx(node index) and bidx(branch index) will also be set
+ * Returns the number of objects found
  */
-extern void * BTreeSearchNext (double key, int kind,
-                               node_t *nidx, int *bidx);
+extern size_t BTreeSearch (btree_t btree,
+                           int minc, btree_key_t min,
+                           int maxc, btree_key_t max,
+                           BTreeBatchCallback callback, void *arg);
 
 /*
  * Destroys b+tree, freeing all the memory allocated to it
@@ -3,55 +3,57 @@
 
 #include "udi_common.h"
 
-// Do not kown where it is defined but I need it
-extern int Yap_page_size;
-#define MAXCARD (int)((Yap_page_size-(2*sizeof(int)))/ (2 * sizeof(void*)))
-#define MINCARD (MAXCARD / 2)
+typedef struct Node * node_t;
+typedef struct BTree * btree_t;
 
-struct Branch
-{
-  double key;
-  void * child;
-  /*This B+Tree will allways hold index_t both in branches and leaves*/
-};
-typedef struct Branch branch_t;
+#include "b+tree.h"
+
+/*
+ * Nodes are cache line aligned and keep their keys contiguous, so that
+ * a search touches the key lines and a single child line per level.
+ * 64 keys of 8 bytes fill 8 lines.
+ */
+#define CACHE_LINE 64
+#define MAXCARD 64
 
 struct Node
 {
+  btree_key_t key[MAXCARD];
+  /* inner nodes have count + 1 children, child i holding the keys
+   * below key[i]; leaves have count data pointers, one per key */
+  void * child[MAXCARD + 1];
+  struct Node * next; /* leaves only, next leaf for in order runs */
   int count;
   int level;
-
-//  double key[MAXCARD - 1];
-//  void * branch[MAXCARD];
-
-  /* we do not use one key with this representation */
-  branch_t branch[FLEXIBLE_SIZE];
-  /* in leaf nodes last child is ptr to next node
-   * for fast in order run
-   */
 };
-typedef struct Node * node_t;
-#define SIZEOF_NODE SIZEOF_FLEXIBLE(struct Node, branch, MAXCARD)
 
-struct Range
+/* buffered insertion */
+struct Entry
 {
-  double min;
-  int le;
-  double max;
-  int ge;
+  btree_key_t key;
+  void * data;
+  int kind;
 };
-typedef struct Range range_t;
-
-typedef node_t btree_t;
+typedef struct Entry entry_t;
 
-static node_t BTreeNewNode (void);
-static void BTreeNodeInit (node_t);
-static int BTreeInsertNode(node_t, double *, void **);
-static int BTreePickBranch(node_t, double);
-static int BTreeAddBranch(node_t, int, double *, void **);
-static int BTreeAddLeaf(node_t, double *, void **);
-static void BTreeDestroyNode (node_t n);
+struct BTree
+{
+  node_t root;
+  node_t first; /* leftmost leaf */
+  node_t last;  /* rightmost leaf */
+  size_t size;
+  int kind;
+
+  entry_t * pending;
+  size_t npending;
+  size_t maxpending;
+};
 
-#include "b+tree.h"
+static node_t BTreeNewNode (int);
+static void BTreeDestroyNode (node_t);
+static void BTreeFlush (btree_t);
+static void BTreePack (btree_t, entry_t *, size_t);
+static int BTreeCompare (int, btree_key_t, btree_key_t);
+static node_t BTreeLeaf (btree_t, btree_key_t, int, int *);
 
 #endif /* __BTREE_PRIVATE_H__ */
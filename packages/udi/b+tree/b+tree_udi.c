@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
 
 #include "b+tree_udi.h"
 
@@ -18,6 +19,7 @@ void udi_btree_init(void) {
 	cb->init=BtreeUdiInit;
 	cb->insert=BtreeUdiInsert;
 	cb->search=BtreeUdiSearch;
+	cb->search_batch=BtreeUdiSearchBatch;
 	cb->destroy=BtreeUdiDestroy;
 
 	Yap_UdiRegister(cb);
@@ -31,18 +33,38 @@ void *BtreeUdiInsert (void *control,
 		YAP_Term term, int arg, void *data)
 {
   btree_t btree = (btree_t) control;
+  YAP_Term t = YAP_ArgOfTerm(arg,term);
+  btree_key_t k;
+  int kind;
+
   assert(control);
 
-  BTreeInsert(&btree,
-              YAP_FloatOfTerm(YAP_ArgOfTerm(arg,term)),
-              data);
+  k.i = 0;
+  if (YAP_IsIntTerm(t))
+    {
+      kind = BTREE_INT;
+      k.i = YAP_IntOfTerm(t);
+    }
+  else if (YAP_IsFloatTerm(t))
+    {
+      kind = BTREE_FLOAT;
+      k.f = YAP_FloatOfTerm(t);
+    }
+  else if (YAP_IsAtomTerm(t))
+    {
+      kind = BTREE_ATOM;
+      k.i = (intptr_t) YAP_AtomOfTerm(t);
+    }
+  else /* this clause can not be indexed, nor can the predicate */
+    kind = BTREE_MIXED;
+  BTreeInsert(btree, kind, k, data);
 
   return (void *) btree;
 }
 
 /*ARGS ARE AVAILABLE*/
-int BtreeUdiSearch (void *control,
-		int arg, Yap_UdiCallback callback, void *args)
+int BtreeUdiSearchBatch (void *control,
+		int arg, Yap_UdiBatchCallback callback, void *args)
 {
   int j;
   size_t n;
@@ -50,12 +72,12 @@ int BtreeUdiSearch (void *control,
   const char * att;
 
   YAP_Term t = YAP_A(arg);
-  if (YAP_IsAttVar(t))
+  if (YAP_IsAttVar(t) && BTreeKind(control) != BTREE_MIXED)
       {
         Constraints = YAP_AttsOfVar(t);
         /* Yap_DebugPlWrite(Constraints); */
         att = YAP_AtomName(YAP_NameOfFunctor(YAP_FunctorOfTerm(Constraints)));
- 
+
         n = sizeof (att_func) / sizeof (struct Att);
         for (j = 0; j < n; j ++)
           if (strcmp(att_func[j].att,att) == 0) /*TODO: Improve this do not need strcmp*/
@@ -64,146 +86,186 @@ int BtreeUdiSearch (void *control,
   return -1; /*YAP FALLBACK*/
 }
 
-/*Needs to test if tree is not null*/
-int BTreeMinAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+struct SingleHits
 {
-  void *d;
-  d = BTreeMin(tree,NULL,NULL);
-  callback(d,d,args);
-  /*TODO: test empty tree*/
-  return 1;
-}
+  Yap_UdiCallback callback;
+  void *args;
+};
 
-int BTreeMaxAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+static int SingleHitsCallback (void **data, size_t n, void *arg)
 {
-	void *d;
-	d = BTreeMax(tree,NULL,NULL);
-	callback(d,d,args);
-	/*TODO: test empty tree*/
-	return 1;
+  struct SingleHits *h = (struct SingleHits *) arg;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (!h->callback(data[i], data[i], h->args))
+      return FALSE;
+  return TRUE;
 }
 
-int BTreeEqAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+int BtreeUdiSearch (void *control,
+		int arg, Yap_UdiCallback callback, void *args)
 {
-  node_t n;
-  int i;
-  double r;
-  void * d;
+  struct SingleHits h;
 
-  r = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
-
-  d = BTreeSearch(tree,r,EQ,&n,&i);
-  if (d) {
-	callback(d,d,args);
-	return 1;
-  }
-  return 0;
+  h.callback = callback;
+  h.args = args;
+  return BtreeUdiSearchBatch(control, arg, SingleHitsCallback, &h);
 }
 
-int BTreeLtAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+/*
+ * Turns a bound from the constraint into the key domain of the tree.
+ * Integer trees take float bounds rounded inwards, so kind may change
+ * from strict to non strict. Returns FALSE if the tree can not use it.
+ */
+static int BTreeBound (btree_t tree, YAP_Term t, int *kind, btree_key_t *k)
 {
-  node_t n;
-  int i;
-  double max;
-  void * d;
-  int count = 0;
-
-  max = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
-
-  d = BTreeMin(tree,&n,&i);
-  if (d)
-	  do {
-		  callback(d,d,args);
-		  count ++;
-	  } while ((d = BTreeSearchNext(max,LT,&n,&i)));
-
-  return count;
+  double d;
+
+  switch (BTreeKind(tree))
+    {
+    case BTREE_FLOAT:
+      if (YAP_IsIntTerm(t))
+        k->f = (double) YAP_IntOfTerm(t);
+      else if (YAP_IsFloatTerm(t))
+        k->f = YAP_FloatOfTerm(t);
+      else
+        return FALSE;
+      return TRUE;
+    case BTREE_INT:
+      if (YAP_IsIntTerm(t))
+        {
+          k->i = YAP_IntOfTerm(t);
+          return TRUE;
+        }
+      if (!YAP_IsFloatTerm(t))
+        return FALSE;
+      d = YAP_FloatOfTerm(t);
+      if (d != d)
+        return FALSE;
+      if (d >= 9.2e18) d = 9.2e18;
+      if (d <= -9.2e18) d = -9.2e18;
+      switch (*kind)
+        {
+        case GE: case GT:
+          if (ceil(d) != d) *kind = GE;
+          k->i = (int64_t) ceil(d);
+          break;
+        case LE: case LT:
+          if (floor(d) != d) *kind = LE;
+          k->i = (int64_t) floor(d);
+          break;
+        default: /* EQ */
+          if (floor(d) != d)
+            return FALSE;
+          k->i = (int64_t) d;
+        }
+      return TRUE;
+    case BTREE_ATOM:
+      if (*kind != EQ || !YAP_IsAtomTerm(t))
+        return FALSE;
+      k->i = (intptr_t) YAP_AtomOfTerm(t);
+      return TRUE;
+    default:
+      return FALSE;
+    }
 }
 
-int BTreeLeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+static int BTreeRangeSearch (btree_t tree, YAP_Term min, int minc,
+                             YAP_Term max, int maxc,
+                             Yap_UdiBatchCallback callback, void *args)
 {
-  node_t n;
-  int i;
-  double max;
-  void * d;
-  int count = 0;
-
-  max = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
+  btree_key_t kmin, kmax;
+
+  kmin.i = kmax.i = 0;
+  if (minc != ANY && !BTreeBound(tree, min, &minc, &kmin))
+    return -1;
+  if (maxc != ANY && !BTreeBound(tree, max, &maxc, &kmax))
+    return -1;
+  return (int) BTreeSearch(tree, minc, kmin, maxc, kmax,
+                           (BTreeBatchCallback) callback, args);
+}
 
-  d = BTreeMin(tree,&n,&i);
-  if (d)
-	  do {
-		  callback(d,d,args);
-		  count ++;
-	  } while ((d = BTreeSearchNext(max,LE,&n,&i)));
+/*Needs to test if tree is not null*/
+int BTreeMinAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
+{
+  void *d;
 
-  return count;
+  if (BTreeKind(tree) == BTREE_ATOM)
+    return -1;
+  d = BTreeMin(tree);
+  if (!d)
+    return 0;
+  callback(&d,1,args);
+  return 1;
 }
 
-int BTreeGtAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+int BTreeMaxAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
 {
-  node_t n;
-  int i;
-  double min;
-  void * d;
-  int count = 0;
-
-  min = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
+  void *d;
 
-  d = BTreeSearch(tree,min,GT,&n,&i);
-  if (d)
-	  do {
-		  callback(d,d,args);
-		  count ++;
-	  }  while ((d = BTreeSearchNext(DBL_MAX,LT,&n,&i)));
+  if (BTreeKind(tree) == BTREE_ATOM)
+    return -1;
+  d = BTreeMax(tree);
+  if (!d)
+    return 0;
+  callback(&d,1,args);
+  return 1;
+}
 
-  return count;
+int BTreeEqAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
+{
+  YAP_Term k = YAP_ArgOfTerm(2,constraint);
+  btree_key_t key;
+  int kind = EQ;
+
+  if (!BTreeBound(tree, k, &kind, &key))
+    {
+      /* an integral tree never holds a fractional key */
+      if (BTreeKind(tree) == BTREE_INT && YAP_IsFloatTerm(k))
+        return 0;
+      return -1;
+    }
+  return (int) BTreeSearch(tree, GE, key, LE, key,
+                           (BTreeBatchCallback) callback, args);
 }
 
-int BTreeGeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+int BTreeLtAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
 {
-  node_t n;
-  int i;
-  double min;
-  void * d;
-  int count = 0;
+  return BTreeRangeSearch(tree, 0, ANY, YAP_ArgOfTerm(2,constraint), LT,
+                          callback, args);
+}
 
-  min = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
+int BTreeLeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
+{
+  return BTreeRangeSearch(tree, 0, ANY, YAP_ArgOfTerm(2,constraint), LE,
+                          callback, args);
+}
 
-  d = BTreeSearch(tree,min,GE,&n,&i);
-  if (d)
-	  do {
-	  		  callback(d,d,args);
-	  		  count ++;
-	  	  }  while ((d = BTreeSearchNext(DBL_MAX,LT,&n,&i)));
+int BTreeGtAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
+{
+  return BTreeRangeSearch(tree, YAP_ArgOfTerm(2,constraint), GT, 0, ANY,
+                          callback, args);
+}
 
-  return count;
+int BTreeGeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
+{
+  return BTreeRangeSearch(tree, YAP_ArgOfTerm(2,constraint), GE, 0, ANY,
+                          callback, args);
 }
 
-int BTreeRangeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args)
+int BTreeRangeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args)
 {
-  node_t n;
-  int i;
-  double min,max;
   int minc,maxc;
-  void * d;
-  int count = 0;
 
-  min = YAP_FloatOfTerm(YAP_ArgOfTerm(2,constraint));
   minc = strcmp(YAP_AtomName(YAP_AtomOfTerm(YAP_ArgOfTerm(3,constraint))),
                 "true") == 0 ? GE: GT;
-  max = YAP_FloatOfTerm(YAP_ArgOfTerm(4,constraint));
   maxc = strcmp(YAP_AtomName(YAP_AtomOfTerm(YAP_ArgOfTerm(5,constraint))),
                 "true") == 0 ? LE: LT;
 
-  d = BTreeSearch(tree,min,minc,&n,&i);
-  if (d)
-	  do {
-		  callback(d,d,args);
-		  count ++;
-	  } while ((d = BTreeSearchNext(max,maxc,&n,&i)));
-
-  return count;
+  return BTreeRangeSearch(tree, YAP_ArgOfTerm(2,constraint), minc,
+                          YAP_ArgOfTerm(4,constraint), maxc,
+                          callback, args);
 }
 
 int BtreeUdiDestroy(void *control)
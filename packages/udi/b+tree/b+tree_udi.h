@@ -17,9 +17,12 @@ extern void *BtreeUdiInsert
 extern int BtreeUdiSearch
 	(void *control, int arg, Yap_UdiCallback callback, void *args);
 
+extern int BtreeUdiSearchBatch
+	(void *control, int arg, Yap_UdiBatchCallback callback, void *args);
+
 extern int BtreeUdiDestroy(void *control);
 
-typedef int (*BTreeSearchAtt) (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
+typedef int (*BTreeSearchAtt) (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
 
 struct Att
 {
@@ -27,16 +30,16 @@ struct Att
   BTreeSearchAtt proc_att;
 };
 
-int BTreeMinAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeMaxAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeEqAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeLtAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeLeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeGtAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeGeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
-int BTreeRangeAtt (btree_t tree, YAP_Term constraint, Yap_UdiCallback callback, void *args);
+int BTreeMinAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeMaxAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeEqAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeLtAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeLeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeGtAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeGeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
+int BTreeRangeAtt (btree_t tree, YAP_Term constraint, Yap_UdiBatchCallback callback, void *args);
 
-static struct Att att_func[] = 
+static struct Att att_func[] =
   {
     {"min",BTreeMinAtt},
     {"max",BTreeMaxAtt},
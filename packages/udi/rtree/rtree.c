@@ -3,421 +3,603 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <stdint.h>
+#ifdef RTREE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include "rtree_private.h"
 
 rtree_t RTreeNew (void)
 {
   rtree_t t;
-  t = RTreeNewNode();
-  t->level = 0; /*leaf*/
+
+  t = (rtree_t) calloc (1, sizeof(struct RTree));
+  assert(t);
   return t;
 }
 
 void RTreeDestroy (rtree_t t)
 {
-  if (t)
-    RTreeDestroyNode (t);
+  if (!t)
+    return;
+  /* leaf data belongs to the user */
+  free(t->nodes);
+  free(t->data);
+  free(t->pending);
+  free(t);
 }
 
-static node_t RTreeNewNode (void)
+static node_t RTreeNewNodes (size_t n)
 {
-  node_t n;
+  node_t nodes;
+
+#ifdef _WIN32
+  nodes = (node_t) malloc (n * sizeof(struct Node));
+#else
+  if (posix_memalign((void **) &nodes, CACHE_LINE, n * sizeof(struct Node)))
+    nodes = NULL;
+#endif
+  assert(nodes);
+  memset((void *) nodes, 0, n * sizeof(struct Node));
+  return nodes;
+}
 
-  n = (node_t) malloc (SIZEOF_NODE);
-  assert(n);
-  RTreeNodeInit(n);
-  return n;
+size_t RTreeSize (rtree_t t)
+{
+  return t->size + t->npending;
 }
 
-static void RTreeDestroyNode (node_t node)
+void RTreeInsert (rtree_t t, rect_t r, void *data)
 {
-  int i;
-  
-  if (node->level == 0) /* leaf level*/
+  assert(t);
+
+  if (t->npending == t->maxpending)
     {
-      for (i = 0; i < MAXCARD; i++)
-        if (node->branch[i].child)
-          continue;/* allow user free data*/
-        else
-          break;
+      t->maxpending = t->maxpending ? 2 * t->maxpending : 1024;
+      t->pending = (entry_t *) realloc (t->pending,
+                                        t->maxpending * sizeof(entry_t));
+      assert(t->pending);
     }
+  t->pending[t->npending].mbr = r;
+  t->pending[t->npending].data = data;
+  t->npending ++;
+}
+
+/*
+ * Packs the buffered entries together with the ones already in the
+ * tree. UDI predicates are static, so this usually happens once, at the
+ * first search after consult.
+ */
+static void RTreeFlush (rtree_t t)
+{
+  entry_t *all;
+  size_t n, i, k;
+  int c;
+
+  if (t->npending == 0)
+    return;
+  if (t->size == 0)
+    all = t->pending;
   else
     {
-      for (i = 0; i < MAXCARD; i++)
-        if (node->branch[i].child)
-          RTreeDestroyNode (node->branch[i].child);
-        else
-          break;
+      n = t->size + t->npending;
+      all = (entry_t *) malloc (n * sizeof(entry_t));
+      assert(all);
+      for (i = 0, k = 0; i < t->nnodes; i++)
+        {
+          node_t leaf = t->nodes + i;
+
+          if (leaf->level > 0)
+            continue;
+          for (c = 0; c < leaf->count; c++, k++)
+            {
+              all[k].mbr.coords[0] = leaf->lo[0][c];
+              all[k].mbr.coords[1] = leaf->lo[1][c];
+              all[k].mbr.coords[2] = leaf->hi[0][c];
+              all[k].mbr.coords[3] = leaf->hi[1][c];
+              all[k].data = t->data[leaf->first + c];
+            }
+        }
+      memcpy(all + k, t->pending, t->npending * sizeof(entry_t));
+      free(t->nodes);
+      free(t->data);
     }
-  free (node);
+  RTreePack(t, all, t->size + t->npending);
+  if (all != t->pending)
+    free(all);
+  free(t->pending);
+  t->pending = NULL;
+  t->npending = t->maxpending = 0;
 }
 
-static void RTreeNodeInit (node_t n)
+static int EntryCompare (const entry_t *x, const entry_t *y, int dim)
 {
-  memset((void *) n,0, SIZEOF_NODE);
-  n->level = -1;
+  double a = x->mbr.coords[dim] + x->mbr.coords[dim + NUMDIMS];
+  double b = y->mbr.coords[dim] + y->mbr.coords[dim + NUMDIMS];
+
+  if (a != b)
+    return a < b ? -1 : 1;
+  return ((uintptr_t) x->data > (uintptr_t) y->data) -
+    ((uintptr_t) x->data < (uintptr_t) y->data);
 }
 
-int RTreeSearch (rtree_t t, rect_t s, SearchHitCallback f, void *arg)
+static int EntryCompareX (const void *a, const void *b)
 {
-  assert(t);
-  return RTreeSearchNode(t,s,f,arg);
+  return EntryCompare((const entry_t *) a, (const entry_t *) b, 0);
 }
 
-static int RTreeSearchNode (node_t n, rect_t s, SearchHitCallback f, void *arg)
+static int EntryCompareY (const void *a, const void *b)
 {
-  int i;
-  int c = 0;
+  return EntryCompare((const entry_t *) a, (const entry_t *) b, 1);
+}
 
-  if (n->level > 0)
-    {
-      for (i = 0; i < MAXCARD; i++)
-        if (n->branch[i].child &&
-            RectOverlap (s,n->branch[i].mbr))
-          c += RTreeSearchNode ((node_t) n->branch[i].child, s, f, arg);
-    }
-  else
-    {
-      for (i = 0; i < MAXCARD; i++)
-        if (n->branch[i].child &&
-            RectOverlap (s,n->branch[i].mbr))
-          {
-            c ++;
-            if (f)
-              if ( !f(&(n->branch[i].mbr),n->branch[i].child,arg))
-                return c;
-          }
-    }
-  return c;
+/*
+ * Sort-Tile-Recursive order: sorted by x center and cut into about
+ * sqrt(n / MAXCARD) vertical slices, each slice sorted by y center, so
+ * that every MAXCARD consecutive entries make a compact tile.
+ */
+static void RTreeTile (entry_t *e, size_t n)
+{
+  size_t pages = (n + MAXCARD - 1) / MAXCARD;
+  size_t slices, per, i;
+
+  for (slices = 1; slices * slices < pages; slices++)
+    ;
+  per = slices * MAXCARD;
+  qsort(e, n, sizeof(entry_t), EntryCompareX);
+  for (i = 0; i < n; i += per)
+    qsort(e + i, MIN(per, n - i), sizeof(entry_t), EntryCompareY);
 }
 
-void RTreeInsert (rtree_t *t, rect_t r, void *data)
+static void RTreeNodeAdd (node_t n, rect_t r)
 {
-  node_t n2;
-  node_t new_root;
-  branch_t b;
-  assert(t && *t);
+  int c = n->count++;
 
-  if (RTreeInsertNode(*t, 0, r, data, &n2))
-    /* deal with root split */
-    {
-      new_root = RTreeNewNode();
-      new_root->level = (*t)->level + 1;
-      b.mbr = RTreeNodeCover(*t);
-      b.child = (void *) *t;
-      RTreeAddBranch(new_root, b, NULL);
-      b.mbr = RTreeNodeCover(n2);
-      b.child = (void *) n2;
-      RTreeAddBranch(new_root, b, NULL);
-      *t = new_root;
-    }
+  n->lo[0][c] = r.coords[0];
+  n->lo[1][c] = r.coords[1];
+  n->hi[0][c] = r.coords[2];
+  n->hi[1][c] = r.coords[3];
 }
 
-static int RTreeInsertNode (node_t n, int level,
-                            rect_t r, void *data,
-                            node_t *new_node)
+/*
+ * Builds the tree bottom up, tiling the entries into full leaves and then
+ * the covers of each level into the nodes of the level above. A level is
+ * reordered when its parents are tiled, so that siblings are adjacent.
+ */
+static void RTreePack (rtree_t t, entry_t *e, size_t n)
 {
-  int i;
-  node_t n2;
-  branch_t b;
+  node_t level[64];
+  size_t count[64];
+  size_t i, off;
+  int nlevels, l;
+
+  t->size = n;
+  t->nodes = NULL;
+  t->data = NULL;
+  t->nnodes = 0;
+  if (n == 0)
+    return;
+
+  RTreeTile(e, n);
+  t->data = (void **) malloc (n * sizeof(void *));
+  assert(t->data);
+  count[0] = (n + MAXCARD - 1) / MAXCARD;
+  level[0] = RTreeNewNodes(count[0]);
+  for (i = 0; i < n; i++)
+    {
+      node_t leaf = level[0] + i / MAXCARD;
 
-  assert(n && new_node);
-  assert(level >= 0 && level <= n->level);
-  
-  if (n->level > level)
+      if (leaf->count == 0)
+        leaf->first = i;
+      RTreeNodeAdd(leaf, e[i].mbr);
+      t->data[i] = e[i].data;
+    }
+
+  for (nlevels = 1; count[nlevels - 1] > 1; nlevels++)
     {
-      i = RTreePickBranch(r,n);
-      if (!RTreeInsertNode((node_t) n->branch[i].child, level,
-                           r, data,&n2)) /* not split */
+      size_t nchildren = count[nlevels - 1];
+      node_t children = level[nlevels - 1], sorted;
+      entry_t *items;
+
+      items = (entry_t *) malloc (nchildren * sizeof(entry_t));
+      assert(items);
+      for (i = 0; i < nchildren; i++)
         {
-          n->branch[i].mbr = RectCombine(r,n->branch[i].mbr);
-          return FALSE;
+          items[i].mbr = RTreeNodeCover(children + i);
+          items[i].data = children + i;
         }
-      else /* node split */
+      RTreeTile(items, nchildren);
+
+      count[nlevels] = (nchildren + MAXCARD - 1) / MAXCARD;
+      level[nlevels] = RTreeNewNodes(count[nlevels]);
+      sorted = RTreeNewNodes(nchildren);
+      for (i = 0; i < nchildren; i++)
         {
-           n->branch[i].mbr = RTreeNodeCover(n->branch[i].child);
-           b.child = n2;
-           b.mbr = RTreeNodeCover(n2);
-           return RTreeAddBranch(n, b, new_node);
+          node_t parent = level[nlevels] + i / MAXCARD;
+
+          if (parent->count == 0)
+            parent->first = i;
+          parent->level = nlevels;
+          RTreeNodeAdd(parent, items[i].mbr);
+          sorted[i] = *(node_t) items[i].data;
         }
+      free(children);
+      free(items);
+      level[nlevels - 1] = sorted;
     }
-  else /*insert level*/
+
+  for (l = 0; l < nlevels; l++)
+    t->nnodes += count[l];
+  t->nodes = RTreeNewNodes(t->nnodes);
+  for (l = nlevels - 1, off = 0; l >= 0; l--)
     {
-      b.mbr = r;
-      b.child = data;
-      return RTreeAddBranch(n, b, new_node);
+      size_t below = off + count[l];
+
+      memcpy(t->nodes + off, level[l], count[l] * sizeof(struct Node));
+      if (l > 0)
+        for (i = off; i < below; i++)
+          t->nodes[i].first += below;
+      free(level[l]);
+      off = below;
     }
 }
 
-static int RTreeAddBranch(node_t n, branch_t b, node_t *new_node)
+static rect_t RTreeNodeCover (node_t n)
 {
   int i;
+  rect_t r = RectInit(), s;
 
-  assert(n);
-
-  if (n->count < MAXCARD) /*split not necessary*/
-    {
-      for (i = 0; i < MAXCARD; i++)
-        if (n->branch[i].child == NULL)
-          {
-            n->branch[i] = b;
-            n->count ++;
-            break;
-          }
-      return FALSE;
-    }
-  else /*needs to split*/
+  for (i = 0; i < n->count; i++)
     {
-      assert(new_node);
-      RTreeSplitNode (n, b, new_node);
-      return TRUE;
+      s.coords[0] = n->lo[0][i];
+      s.coords[1] = n->lo[1][i];
+      s.coords[2] = n->hi[0][i];
+      s.coords[3] = n->hi[1][i];
+      r = RectCombine(r, s);
     }
+  return r;
 }
 
-static int RTreePickBranch (rect_t r, node_t n)
+size_t RTreeSearch (rtree_t t, rect_t s, RTreeBatchCallback f, void *arg)
 {
-  int i;
-  double area;
-  double inc_area;
-  rect_t tmp;
-  int best_i;
-  double best_inc;
-  double best_i_area;
-
-  best_i = 0;
-  best_inc = DBL_MAX; /* double Max value */
-  best_i_area = DBL_MAX;
-
-  for (i = 0; i < MAXCARD; i++)
-    if (n->branch[i].child)
-      {
-        area = RectArea (n->branch[i].mbr);
-        tmp = RectCombine (r, n->branch[i].mbr);
-        inc_area = RectArea (tmp) - area; 
-
-        if (inc_area < best_inc)
-          {
-            best_inc = inc_area;
-            best_i = i;
-            best_i_area = area;
-          }
-        else if (inc_area == best_inc && best_i_area > area)
-          {
-            best_inc = inc_area;
-            best_i = i;
-            best_i_area = area;
-          }
-      }
-    else
-      break;
-  return best_i;
-}
-
-static void RTreeSplitNode (node_t n, branch_t b, node_t *new_node)
-{
-  partition_t p;
-  int level;
-  int i;
-
-  assert(n);
-  assert(new_node);
+  int stop = FALSE;
 
-  p = PartitionNew();
+  assert(t);
+  RTreeFlush(t);
+  if (!t->nodes)
+    return 0;
+  return RTreeSearchNode(t, t->nodes, s, f, arg, &stop);
+}
 
-  for (i = 0; i < MAXCARD; i ++)
-    PartitionPush(p,n->branch[i]);
-  PartitionPush(p,b);
+static size_t RTreeSearchNode (rtree_t t, node_t n, rect_t s,
+                               RTreeBatchCallback f, void *arg, int *stop)
+{
+  int hit[MAXCARD];
+  void *found[MAXCARD];
+  size_t c = 0;
+  int i, nfound = 0;
 
-  level = n->level;
-  RTreeNodeInit(n);
-  n->level = level;
-  *new_node = RTreeNewNode();
-  (*new_node)->level = level;
+  /* touching rects overlap */
+  for (i = 0; i < n->count; i++)
+    hit[i] = (n->lo[0][i] <= s.coords[2]) & (n->hi[0][i] >= s.coords[0]) &
+      (n->lo[1][i] <= s.coords[3]) & (n->hi[1][i] >= s.coords[1]);
 
-  RTreePickSeeds(p, n, *new_node);
+  if (n->level > 0)
+    {
+      for (i = 0; i < n->count && !*stop; i++)
+        if (hit[i])
+          c += RTreeSearchNode(t, t->nodes + n->first + i, s, f, arg, stop);
+      return c;
+    }
 
-  while (p->n)
-    if (n->count + p->n <= MINCARD)
-      /* first group (n) needs all entries */
-      RTreeNodeAddBranch(&(p->cover[0]), n, PartitionPop(p));
-    else if ((*new_node)->count + p->n <= MINCARD)
-      /* second group (new_node) needs all entries */
-      RTreeNodeAddBranch(&(p->cover[1]), *new_node, PartitionPop(p));
-    else
-      RTreePickNext(p, n, *new_node);
+  for (i = 0; i < n->count; i++)
+    if (hit[i])
+      found[nfound++] = t->data[n->first + i];
+  if (nfound && f && !f(found, nfound, arg))
+    *stop = TRUE;
+  return nfound;
 }
 
-static void RTreePickNext(partition_t p, node_t n1, node_t n2)
-/* linear version */
+/*
+ * k nearest neighbours
+ */
+
+static double RectMinDist (double x, double y,
+                           double x0, double y0, double x1, double y1)
 {
-  branch_t b;
-  double area[2], inc_area[2];
-  rect_t tmp;
+  double dx = MAX(MAX(x0 - x, x - x1), 0);
+  double dy = MAX(MAX(y0 - y, y - y1), 0);
 
-  b = PartitionPop(p);
+  return dx * dx + dy * dy;
+}
 
-  area[0] = RectArea (p->cover[0]);
-  tmp = RectCombine (p->cover[0], b.mbr);
-  inc_area[0] = RectArea (tmp) - area[0];
+/* objects come out before nodes at the same distance */
+static int NearLess (near_t a, near_t b)
+{
+  return a.dist < b.dist || (a.dist == b.dist && a.object > b.object);
+}
 
-  area[1] = RectArea (p->cover[1]);
-  tmp = RectCombine (p->cover[1], b.mbr);
-  inc_area[1] = RectArea (tmp) - area[1]; 
+static void NearPush (near_t **heap, size_t *n, size_t *max, near_t e)
+{
+  size_t i, parent;
 
-  if (inc_area[0] < inc_area[1] ||
-      (inc_area[0] == inc_area[1] && area[0] < area[1]))
-    RTreeNodeAddBranch(&(p->cover[0]),n1,b);
-  else
-    RTreeNodeAddBranch(&(p->cover[1]),n2,b);
+  if (*n == *max)
+    {
+      *max = *max ? 2 * *max : 256;
+      *heap = (near_t *) realloc (*heap, *max * sizeof(near_t));
+      assert(*heap);
+    }
+  for (i = (*n)++; i > 0; i = parent)
+    {
+      parent = (i - 1) / 2;
+      if (!NearLess(e, (*heap)[parent]))
+        break;
+      (*heap)[i] = (*heap)[parent];
+    }
+  (*heap)[i] = e;
 }
 
-static void RTreePickSeeds(partition_t p, node_t n1, node_t n2)
-/* puts in index 0 of each node the resulting entry, forming the two
-   groups
-   This is the linear version
-*/
+static near_t NearPop (near_t *heap, size_t *n)
 {
-  int dim,high, i;
-  int highestLow[NUMDIMS], lowestHigh[NUMDIMS];
-  double width[NUMDIMS];
-  int seed0, seed1;
-  double sep, best_sep;
-
-  assert(p->n == MAXCARD + 1);
+  near_t top = heap[0], last = heap[--*n];
+  size_t i = 0, child;
 
-  for (dim = 0; dim < NUMDIMS; dim++)
+  while ((child = 2 * i + 1) < *n)
     {
-      high = dim + NUMDIMS;
-      highestLow[dim] = lowestHigh[dim] = 0;
-      for (i = 1; i < MAXCARD +1; i++)
-        {
-          if (p->buffer[i].mbr.coords[dim] >
-              p->buffer[highestLow[dim]].mbr.coords[dim])
-            highestLow[dim] = i;
-          if (p->buffer[i].mbr.coords[high] < 
-              p->buffer[lowestHigh[dim]].mbr.coords[high])
-            lowestHigh[dim] = i;
-        }
-      width[dim] = p->cover_all.coords[high] - p->cover_all.coords[dim];
-      assert(width[dim] >= 0);
+      if (child + 1 < *n && NearLess(heap[child + 1], heap[child]))
+        child++;
+      if (!NearLess(heap[child], last))
+        break;
+      heap[i] = heap[child];
+      i = child;
     }
+  heap[i] = last;
+  return top;
+}
+
+/*
+ * Best first search: a node leaves the queue only when nothing left in
+ * it can be closer, so objects come out in distance order and just the
+ * nodes near the point are opened.
+ */
+static size_t RTreeNearestInto (rtree_t t, double x, double y, size_t k,
+                                void **out)
+{
+  near_t *heap = NULL, e;
+  size_t nheap = 0, maxheap = 0, found = 0;
+  int i;
 
-  seed0 = lowestHigh[0];
-  seed1 = highestLow[0];
-  best_sep = 0;
-  for (dim = 0; dim < NUMDIMS; dim ++)
+  if (!t->nodes || k == 0)
+    return 0;
+  e.dist = 0;
+  e.id = 0;
+  e.object = FALSE;
+  NearPush(&heap, &nheap, &maxheap, e);
+  while (nheap && found < k)
     {
-      high = dim + NUMDIMS;
-      
-      sep = (p->buffer[highestLow[dim]].mbr.coords[dim] -
-             p->buffer[lowestHigh[dim]].mbr.coords[high]) / width[dim];
-      if (sep > best_sep)
+      node_t n;
+
+      e = NearPop(heap, &nheap);
+      if (e.object)
         {
-          seed0 = lowestHigh[dim];
-          seed1 = highestLow[dim];
-          best_sep = sep;
+          out[found++] = t->data[e.id];
+          continue;
+        }
+      n = t->nodes + e.id;
+      for (i = 0; i < n->count; i++)
+        {
+          near_t c;
+
+          c.dist = RectMinDist(x, y, n->lo[0][i], n->lo[1][i],
+                               n->hi[0][i], n->hi[1][i]);
+          c.id = n->first + i;
+          c.object = n->level == 0;
+          NearPush(&heap, &nheap, &maxheap, c);
         }
     }
-/*   assert (seed0 != seed1); */
-  if (seed0 > seed1)
-    {
-      RTreeNodeAddBranch(&(p->cover[0]),n1,PartitionGet(p,seed0));
-      RTreeNodeAddBranch(&(p->cover[1]),n2,PartitionGet(p,seed1));
-    }
-  else if (seed0 < seed1)
-    {
-      RTreeNodeAddBranch(&(p->cover[0]),n1,PartitionGet(p,seed1));
-      RTreeNodeAddBranch(&(p->cover[1]),n2,PartitionGet(p,seed0));
-    }
+  free(heap);
+  return found;
 }
 
-static void RTreeNodeAddBranch(rect_t *r, node_t n, branch_t b)
+size_t RTreeNearest (rtree_t t, double x, double y, size_t k,
+                     RTreeBatchCallback f, void *arg)
 {
-  int i;
-
-  assert(n);
-  assert(n->count < MAXCARD);
+  void **out;
+  size_t found;
 
-  for (i = 0; i < MAXCARD; i++)
-    if (n->branch[i].child == NULL)
-      {
-        n->branch[i] = b;
-        n->count ++;
-        break;
-      }
-  *r = RectCombine(*r,b.mbr);
+  assert(t);
+  RTreeFlush(t);
+  k = MIN(k, t->size);
+  if (k == 0)
+    return 0;
+  out = (void **) malloc (k * sizeof(void *));
+  assert(out);
+  found = RTreeNearestInto(t, x, y, k, out);
+  if (found && f)
+    f(out, found, arg);
+  free(out);
+  return found;
 }
 
+/*
+ * Query batches. The tree is packed before the batch starts, after that
+ * searches only read it and the queries can run on separate threads.
+ */
+
+#define RTREE_PAR_MIN 64 /* queries per thread */
+#define RTREE_MAX_THREADS 16
 
-void RTreePrint(node_t t)
+struct Batch
 {
-  int i;
+  rtree_t t;
+  const rect_t *q;   /* window queries, or */
+  const double *xy;  /* nearest queries */
+  size_t k;
+  rtree_hits_t *hits;
+  size_t lo, hi;
+};
+
+static int HitsAppend (void **data, size_t n, void *arg)
+{
+  rtree_hits_t *h = (rtree_hits_t *) arg;
+  size_t cap;
 
-  /*  printf("rtree([_,_,_,_,_]).\n"); */
-  printf("rtree(%p,%d,[",t,t->level);
-  for (i = 0; i < MAXCARD; i++)
+  /* capacity is the power of two above the size */
+  for (cap = 16; cap < h->n; cap *= 2)
+    ;
+  if (!h->data || h->n + n > cap)
     {
-      if (t->branch[i].child != NULL)
+      while (cap < h->n + n)
+        cap *= 2;
+      h->data = (void **) realloc (h->data, cap * sizeof(void *));
+      assert(h->data);
+    }
+  memcpy(h->data + h->n, data, n * sizeof(void *));
+  h->n += n;
+  return TRUE;
+}
+
+static void * RTreeBatchRun (void *arg)
+{
+  struct Batch *b = (struct Batch *) arg;
+  rtree_t t = b->t;
+  size_t i;
+  int stop;
+
+  for (i = b->lo; i < b->hi; i++)
+    {
+      rtree_hits_t *h = b->hits + i;
+
+      h->data = NULL;
+      h->n = 0;
+      if (!t->nodes)
+        continue;
+      if (b->q)
         {
-          printf("(%p,",t->branch[i].child);
-                   RectPrint(t->branch[i].mbr);
-          printf(")");
+          stop = FALSE;
+          RTreeSearchNode(t, t->nodes, b->q[i], HitsAppend, h, &stop);
         }
-      else
+      else if (b->k > 0)
         {
-          printf("nil");
+          h->data = (void **) malloc (MIN(b->k, t->size) * sizeof(void *));
+          assert(h->data);
+          h->n = RTreeNearestInto(t, b->xy[2 * i], b->xy[2 * i + 1],
+                                  b->k, h->data);
         }
-      if (i < MAXCARD-1)
-        printf(",");
     }
-  printf("]).\n");
+  return NULL;
+}
 
-  if (t->level != 0)
-    for (i = 0; i < MAXCARD; i++)
-      if (t->branch[i].child != NULL)
-        RTreePrint((node_t) t->branch[i].child);
-      else
-        break;
+static void RTreeBatch (struct Batch *b, size_t n)
+{
+#ifdef RTREE_THREADS
+  struct Batch part[RTREE_MAX_THREADS];
+  pthread_t tid[RTREE_MAX_THREADS];
+  int started[RTREE_MAX_THREADS];
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t nthreads = n / RTREE_PAR_MIN, chunk, i;
+
+  if (ncpu > 0 && nthreads > (size_t) ncpu)
+    nthreads = ncpu;
+  if (nthreads > RTREE_MAX_THREADS)
+    nthreads = RTREE_MAX_THREADS;
+  if (nthreads > 1)
+    {
+      chunk = (n + nthreads - 1) / nthreads;
+      for (i = 0; i < nthreads; i++)
+        {
+          part[i] = *b;
+          part[i].lo = MIN(i * chunk, n);
+          part[i].hi = MIN((i + 1) * chunk, n);
+          started[i] = i > 0 &&
+            pthread_create(tid + i, NULL, RTreeBatchRun, part + i) == 0;
+        }
+      /* the caller takes the first chunk, and any that failed to start */
+      for (i = 0; i < nthreads; i++)
+        if (!started[i])
+          RTreeBatchRun(part + i);
+      for (i = 1; i < nthreads; i++)
+        if (started[i])
+          pthread_join(tid[i], NULL);
+      return;
+    }
+#endif
+  b->lo = 0;
+  b->hi = n;
+  RTreeBatchRun(b);
 }
 
-/*
- * Partition related
- */
+void RTreeSearchMany (rtree_t t, const rect_t *q, size_t n,
+                      rtree_hits_t *hits)
+{
+  struct Batch b;
+
+  assert(t);
+  RTreeFlush(t);
+  memset((void *) &b, 0, sizeof(b));
+  b.t = t;
+  b.q = q;
+  b.hits = hits;
+  RTreeBatch(&b, n);
+}
 
-static partition_t PartitionNew (void)
+void RTreeNearestMany (rtree_t t, const double *xy, size_t n, size_t k,
+                       rtree_hits_t *hits)
 {
-  partition_t p;
+  struct Batch b;
 
-  p = (partition_t) malloc(SIZEOF_PARTITION);
-  /*TODO: check return value*/
-  memset((void *) p,0, SIZEOF_PARTITION);
-  p->cover[0] = p->cover[1] = p->cover_all = RectInit();
-  return p;
+  assert(t);
+  RTreeFlush(t);
+  memset((void *) &b, 0, sizeof(b));
+  b.t = t;
+  b.xy = xy;
+  b.k = k;
+  b.hits = hits;
+  RTreeBatch(&b, n);
 }
 
-static void PartitionPush (partition_t p, branch_t b)
+void RTreeHitsFree (rtree_hits_t *hits, size_t n)
 {
-  assert(p->n < MAXCARD + 1);
-  p->buffer[p->n] = b;
-  p->n ++;
-  p->cover_all = RectCombine(p->cover_all,b.mbr);
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      free(hits[i].data);
+      hits[i].data = NULL;
+      hits[i].n = 0;
+    }
 }
 
-static branch_t PartitionPop (partition_t p)
+static void RTreePrintNode (rtree_t t, node_t n, int depth)
 {
-  assert(p->n > 0);
-  p->n --;
-  return p->buffer[p->n];
+  int i;
+  rect_t r;
+
+  printf("%*s%s %d:", 2 * depth, "", n->level ? "node" : "leaf", n->count);
+  for (i = 0; i < n->count; i++)
+    {
+      r.coords[0] = n->lo[0][i];
+      r.coords[1] = n->lo[1][i];
+      r.coords[2] = n->hi[0][i];
+      r.coords[3] = n->hi[1][i];
+      printf(" ");
+      RectPrint(r);
+      if (n->level == 0)
+        printf("=%p", t->data[n->first + i]);
+    }
+  printf("\n");
+  if (n->level > 0)
+    for (i = 0; i < n->count; i++)
+      RTreePrintNode(t, t->nodes + n->first + i, depth + 1);
 }
 
-static branch_t PartitionGet (partition_t p, int n)
+void RTreePrint(rtree_t t)
 {
-  branch_t b;
-  assert (p->n > n);
-  b = p->buffer[n];
-  p->buffer[n] = PartitionPop(p);
-  return b;
+  RTreeFlush(t);
+  if (t->nodes)
+    RTreePrintNode(t, t->nodes, 0);
 }
 
 /*
@@ -426,7 +608,8 @@ static branch_t PartitionGet (partition_t p, int n)
 
 rect_t RectInit (void)
 {
-  rect_t r = {{DBL_MAX, DBL_MAX, DBL_MIN, DBL_MIN}};
+  /* empty, it overlaps nothing and is absorbed by RectCombine */
+  rect_t r = {{DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX}};
   return (r);
 }
 
@@ -440,20 +623,6 @@ rect_t RectInitCoords (double c[4])
   return (r);
 }
 
-static double RectArea (rect_t r)
-{
-  int i;
-  double area;
-
-  for (i = 0,area = 1; i < NUMDIMS; i++)
-    area *= r.coords[i+NUMDIMS] - r.coords[i];
-
-/*   area = (r.coords[1] - r.coords[0]) *  */
-/*     (r.coords[3] - r.coords[2]); */
-
-  return area;
-}
-
 static rect_t RectCombine (rect_t r, rect_t s)
 {
   int i;
@@ -464,35 +633,8 @@ static rect_t RectCombine (rect_t r, rect_t s)
       new_rect.coords[i] = MIN(r.coords[i],s.coords[i]);
       new_rect.coords[i+NUMDIMS] = MAX(r.coords[i+NUMDIMS],s.coords[i+NUMDIMS]);
     }
-  
-  return new_rect;
-}
-
-static int RectOverlap (rect_t r, rect_t s)
-{
-  int i;
-  
-  for (i = 0; i < NUMDIMS; i++)
-    if (r.coords[i] > s.coords[i + NUMDIMS] ||
-        s.coords[i] > r.coords[i + NUMDIMS])
-      return FALSE;
-  return TRUE;
-}
 
-static rect_t RTreeNodeCover(node_t n)
-{
-  int i;
-  rect_t r = RectInit();
-
-  for (i = 0; i < MAXCARD; i++)
-    if (n->branch[i].child)
-      {
-        r = RectCombine (r, n->branch[i].mbr);
-      }
-    else
-      break;
-
-  return r;
+  return new_rect;
 }
 
 void RectPrint (rect_t r)
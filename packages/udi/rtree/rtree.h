@@ -1,6 +1,8 @@
 #ifndef _RTREE_
 #define _RTREE_ 1
 
+#include <stddef.h>
+
 #ifndef __RTREE_PRIVATE_H__
 	typedef void * rtree_t;
 	typedef void * node_t;
@@ -12,13 +14,55 @@
 	typedef struct Rect rect_t;
 #endif
 
-typedef int (*SearchHitCallback)(void *, void *data, void *arg);
+/*
+ * Callback for n objects found in a search, all the hits of a leaf are
+ * delivered together. If it returns FALSE the search is aborted.
+ */
+typedef int (*RTreeBatchCallback)(void **data, size_t n, void *arg);
+
+/* results of one query of a batch, data is malloc'ed */
+struct RTreeHits
+{
+  void **data;
+  size_t n;
+};
+typedef struct RTreeHits rtree_hits_t;
 
 extern rtree_t RTreeNew (void);
-extern void RTreeInsert (rtree_t *, rect_t, void *);
-extern int RTreeSearch (rtree_t, rect_t, SearchHitCallback, void *);
+
+/*
+ * Insertions are buffered, and the tree is packed with Sort-Tile-Recursive
+ * the next time it is searched: leaves are full and tile the plane, so
+ * queries visit fewer nodes than on a tree grown by splits.
+ */
+extern void RTreeInsert (rtree_t, rect_t, void *);
+
+/*
+ * Calls f on the objects whose rect overlaps s, returns how many
+ */
+extern size_t RTreeSearch (rtree_t, rect_t s, RTreeBatchCallback f, void *);
+
+/*
+ * Calls f once on the k objects nearest to point (x,y), closest first,
+ * the distance to an object being the distance to its rect.
+ * Returns how many were found, less than k if the tree is smaller.
+ */
+extern size_t RTreeNearest (rtree_t, double x, double y, size_t k,
+                            RTreeBatchCallback f, void *);
+
+/*
+ * Query batches, split among threads when there are enough of them.
+ * hits[i] gets the answers to query i, free them with RTreeHitsFree.
+ */
+extern void RTreeSearchMany (rtree_t, const rect_t *q, size_t n,
+                             rtree_hits_t *hits);
+extern void RTreeNearestMany (rtree_t, const double *xy, size_t n, size_t k,
+                              rtree_hits_t *hits);
+extern void RTreeHitsFree (rtree_hits_t *hits, size_t n);
+
+extern size_t RTreeSize (rtree_t);
 extern void RTreeDestroy (rtree_t);
-extern void RTreePrint(node_t);
+extern void RTreePrint(rtree_t);
 extern rect_t RectInit (void);
 extern void RectPrint (rect_t);
 extern rect_t RectInitCoords (double *);
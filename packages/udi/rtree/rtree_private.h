@@ -6,76 +6,78 @@
 #define NUMDIMS 2 /* we will work in 2d changing this will
                      break some functions */
 
-// Do not kown where it is defined but I need it
-extern int Yap_page_size;
-#define MAXCARD (int)((Yap_page_size-(2*sizeof(int)))/ sizeof(struct Branch))
-#define MINCARD (MAXCARD / 2)
-
 struct Rect
 {
   double coords[2*NUMDIMS]; /* x1min, y1min, ... , x1max, y1max, ...*/
 };
 typedef struct Rect rect_t;
 
-typedef size_t index_t;
+typedef struct Node * node_t;
+typedef struct RTree * rtree_t;
 
-struct Branch
-{
-  rect_t mbr;
-  void * child; /*void * so user can store whatever he needs, in case
-   of non-leaf ndes it stores the child-pointer*/
-};
-typedef struct Branch branch_t;
+#include "rtree.h"
+
+/*
+ * Packed trees never change, so nodes live in one array, root first and
+ * a level after the other, and the children of a node are consecutive:
+ * a node only keeps the index of the first one. Bounds are kept per
+ * coordinate so that testing all the children of a node is a tight loop
+ * over contiguous doubles.
+ */
+#define CACHE_LINE 64
+#define MAXCARD 16
 
 struct Node
 {
+  double lo[NUMDIMS][MAXCARD];
+  double hi[NUMDIMS][MAXCARD];
+  /* children first .. first + count - 1, in nodes for inner nodes and
+   * in data for leaves */
+  size_t first;
   int count;
   int level;
-  branch_t branch[FLEXIBLE_SIZE];
 };
-typedef struct Node * node_t;
-#define SIZEOF_NODE SIZEOF_FLEXIBLE(struct Node, branch, MAXCARD)
 
-typedef node_t rtree_t;
-
-struct Partition
+/* buffered insertion, also used to pack the upper levels */
+struct Entry
 {
-  int n;
-  rect_t cover_all;
-  rect_t cover[2];
-  branch_t buffer[FLEXIBLE_SIZE];
+  rect_t mbr;
+  void * data;
 };
-typedef struct Partition * partition_t;
-#define SIZEOF_PARTITION SIZEOF_FLEXIBLE(struct Partition, buffer, MAXCARD + 1)
+typedef struct Entry entry_t;
 
-/* #define ALIGN(addr, size) (((addr)+(size-1))&(~(size-1))) */
-
-#include "rtree.h"
-
-static node_t RTreeNewNode (void);
-static void RTreeDestroyNode (node_t);
-static void RTreeNodeInit (node_t);
-
-static int RTreeSearchNode (node_t, rect_t, SearchHitCallback, void *);
-static int RTreeInsertNode (node_t, int, rect_t,void *,node_t *);
+struct RTree
+{
+  node_t nodes; /* nodes[0] is the root */
+  size_t nnodes;
+  void ** data; /* objects in leaf order */
+  size_t size;
+
+  entry_t * pending;
+  size_t npending;
+  size_t maxpending;
+};
 
-static int RTreePickBranch (rect_t, node_t);
-static int RTreeAddBranch(node_t, branch_t, node_t *);
-static void RTreeSplitNode (node_t, branch_t, node_t *);
+/* kNN queue element, a node or an object (data index) */
+struct Near
+{
+  double dist;
+  size_t id;
+  int object;
+};
+typedef struct Near near_t;
 
-static void RTreePickSeeds(partition_t, node_t, node_t);
-static void RTreeNodeAddBranch(rect_t *, node_t, branch_t);
-static void RTreePickNext(partition_t, node_t, node_t);
+static void RTreeFlush (rtree_t);
+static void RTreePack (rtree_t, entry_t *, size_t);
+static void RTreeTile (entry_t *, size_t);
+static node_t RTreeNewNodes (size_t);
+static rect_t RTreeNodeCover (node_t);
 
-static rect_t RTreeNodeCover(node_t);
+static size_t RTreeSearchNode (rtree_t, node_t, rect_t,
+                               RTreeBatchCallback, void *, int *);
+static size_t RTreeNearestInto (rtree_t, double, double, size_t, void **);
 
-static double RectArea (rect_t);
+static double RectMinDist (double, double, double, double, double, double);
 static rect_t RectCombine (rect_t, rect_t);
-static int RectOverlap (rect_t, rect_t);
-
-static partition_t PartitionNew (void);
-static void PartitionPush (partition_t, branch_t);
-static branch_t PartitionPop (partition_t);
-static branch_t PartitionGet (partition_t, int);
 
 #endif /* __RTREE_PRIVATE_H__ */
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "rtree_udi.h"
 
@@ -16,7 +17,8 @@ void udi_rtree_init(void) {
 
 	cb->init=RtreeUdiInit;
 	cb->insert=RtreeUdiInsert;
-	cb->search=RtreeUdiSearch;
+	cb->search=NULL;
+	cb->search_batch=RtreeUdiSearchBatch;
 	cb->destroy=RtreeUdiDestroy;
 
 	Yap_UdiRegister(cb);
@@ -55,6 +57,8 @@ static rect_t RectOfTerm (YAP_Term term)
         return (RectInit());
       term = YAP_TailOfTerm (term);
     }
+  if (i < 4)
+    return (RectInit());
 
   return (rect);
 }
@@ -76,19 +80,104 @@ RtreeUdiInsert (void *control,
   /*TODO: better check of rect, or even not needing it
    * and use the geometry itself */
   r = RectOfTerm(YAP_ArgOfTerm(arg,term));
-  RTreeInsert(&rtree, r, data);
+  RTreeInsert(rtree, r, data);
 
   return (void *) rtree;
 }
 
+static int DataCompare (const void *a, const void *b)
+{
+  uintptr_t x = (uintptr_t) *(void * const *) a;
+  uintptr_t y = (uintptr_t) *(void * const *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ * Window is a rect or a list of rects, that are searched as a batch:
+ * the clauses overlapping any of them are given once, in clause order.
+ * The tree returns its hits leaf by leaf, so even a single rect goes
+ * through the sort.
+ */
+static int RtreeOverlap (rtree_t rtree, YAP_Term window,
+                         Yap_UdiBatchCallback callback, void *args)
+{
+  rect_t *rects;
+  rtree_hits_t *hits;
+  void **all;
+  size_t n, i, j, total;
+  YAP_Term l;
+  int single;
+
+  if (!YAP_IsPairTerm(window))
+    return -1;
+  single = !YAP_IsPairTerm(YAP_HeadOfTerm(window));
+
+  if (single)
+    n = 1;
+  else
+    for (n = 0, l = window; YAP_IsPairTerm(l); l = YAP_TailOfTerm(l))
+      n++;
+  rects = (rect_t *) malloc (n * sizeof(rect_t));
+  hits = (rtree_hits_t *) malloc (n * sizeof(rtree_hits_t));
+  assert(rects && hits);
+  if (single)
+    rects[0] = RectOfTerm(window);
+  else
+    for (i = 0, l = window; i < n; i++, l = YAP_TailOfTerm(l))
+      rects[i] = RectOfTerm(YAP_HeadOfTerm(l));
+  RTreeSearchMany(rtree, rects, n, hits);
+
+  for (i = 0, total = 0; i < n; i++)
+    total += hits[i].n;
+  all = (void **) malloc ((total + 1) * sizeof(void *));
+  assert(all);
+  for (i = 0, total = 0; i < n; i++)
+    {
+      memcpy(all + total, hits[i].data, hits[i].n * sizeof(void *));
+      total += hits[i].n;
+    }
+  qsort(all, total, sizeof(void *), DataCompare);
+  for (i = 0, j = 0; i < total; i++)
+    if (j == 0 || all[j - 1] != all[i])
+      all[j++] = all[i];
+  if (j > 0)
+    callback(all, j, args);
+
+  RTreeHitsFree(hits, n);
+  free(hits);
+  free(rects);
+  free(all);
+  return (int) j;
+}
+
+/* nearest(_, [X,Y], K): the K clauses closest to the point */
+static int RtreeNearest (rtree_t rtree, YAP_Term point, YAP_Term k,
+                         Yap_UdiBatchCallback callback, void *args)
+{
+  YAP_Float x, y;
+
+  if (!YAP_IsPairTerm(point) ||
+      !YAP_IsNumberTermToFloat(YAP_HeadOfTerm(point), &x))
+    return -1;
+  point = YAP_TailOfTerm(point);
+  if (!YAP_IsPairTerm(point) ||
+      !YAP_IsNumberTermToFloat(YAP_HeadOfTerm(point), &y))
+    return -1;
+  if (!YAP_IsIntTerm(k) || YAP_IntOfTerm(k) < 0)
+    return -1;
+
+  return (int) RTreeNearest(rtree, x, y, (size_t) YAP_IntOfTerm(k),
+                            (RTreeBatchCallback) callback, args);
+}
+
 /*ARGS ARE AVAILABLE*/
-int RtreeUdiSearch (void *control,
-		int arg, Yap_UdiCallback callback, void *args)
+int RtreeUdiSearchBatch (void *control,
+		int arg, Yap_UdiBatchCallback callback, void *args)
 {
-  int i;
   rtree_t rtree = (rtree_t) control;
   YAP_Term Constraints;
-  rect_t r;
+  YAP_Functor f;
 
   assert(rtree);
 
@@ -100,9 +189,14 @@ int RtreeUdiSearch (void *control,
 //        Yap_DebugPlWrite(Constraints);
 	  if (YAP_IsApplTerm(Constraints))
 	  {
-		  r = RectOfTerm(YAP_ArgOfTerm(2,Constraints));
-
-		  return RTreeSearch(rtree, r, callback, args);
+		  f = YAP_FunctorOfTerm(Constraints);
+		  if (YAP_ArityOfFunctor(f) == 3 &&
+		      strcmp(YAP_AtomName(YAP_NameOfFunctor(f)), "nearest") == 0)
+			  return RtreeNearest(rtree, YAP_ArgOfTerm(2,Constraints),
+			                      YAP_ArgOfTerm(3,Constraints),
+			                      callback, args);
+		  return RtreeOverlap(rtree, YAP_ArgOfTerm(2,Constraints),
+		                      callback, args);
       }
   }
 
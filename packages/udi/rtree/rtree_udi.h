@@ -14,8 +14,8 @@ extern void *RtreeUdiInit
 extern void *RtreeUdiInsert
 	(void *control, YAP_Term term, int arg, void *data);
 
-extern int RtreeUdiSearch
-	(void *control, int arg, Yap_UdiCallback callback, void *args);
+extern int RtreeUdiSearchBatch
+	(void *control, int arg, Yap_UdiBatchCallback callback, void *args);
 
 extern int RtreeUdiDestroy(void *control);
 
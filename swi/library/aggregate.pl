@@ -123,8 +123,6 @@ _|The development of this library was sponsored by SecuritEase,
 	term_variables/3 is a SWI-Prolog with a *|different definition|*.
 @tbd	Analysing the aggregation template and compiling a predicate
 	for the list aggregation can be done at compile time.
-@tbd	aggregate_all/3 can be rewritten to run in constant space using
-	non-backtrackable assignment on a term.
 */
 
 		 /*******************************
@@ -155,8 +153,58 @@ aggregate(Template, Discriminator, Goal0, Result) :-
 %%	aggregate_all(+Template, :Goal, -Result) is semidet.
 %
 %	Aggregate bindings in Goal according to Template.  The aggregate_all/3
-%	version performs findall/3 on Goal.
-
+%	version performs findall/3 on Goal.  The count, sum(Expr), max(Expr)
+%	and min(Expr) templates keep a running result instead, so that they
+%	run in constant space.
+
+aggregate_all(Var, _, _) :-
+	var(Var), !,
+	instantiation_error(Var).
+aggregate_all(count, Goal, Count) :- !,
+	nb:nb_create_accumulator(0, Acc),
+	(   call(Goal),
+	    nb:nb_add_to_accumulator(Acc, 1),
+	    fail
+	;   nb:nb_accumulator_value(Acc, Count)
+	).
+aggregate_all(sum(X), Goal, Sum) :- !,
+	nb:nb_create_accumulator(0, Acc),
+	(   call(Goal),
+	    V is X,
+	    nb:nb_add_to_accumulator(Acc, V),
+	    fail
+	;   nb:nb_accumulator_value(Acc, Sum)
+	).
+aggregate_all(max(X), Goal, Max) :- !,
+	State = state(none),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (	M0 == none
+	    ->	nb_setarg(1, State, V)
+	    ;	V > M0
+	    ->	nb_setarg(1, State, V)
+	    ;	true
+	    ),
+	    fail
+	;   arg(1, State, Max),
+	    Max \== none
+	).
+aggregate_all(min(X), Goal, Min) :- !,
+	State = state(none),
+	(   call(Goal),
+	    V is X,
+	    arg(1, State, M0),
+	    (	M0 == none
+	    ->	nb_setarg(1, State, V)
+	    ;	V < M0
+	    ->	nb_setarg(1, State, V)
+	    ;	true
+	    ),
+	    fail
+	;   arg(1, State, Min),
+	    Min \== none
+	).
 aggregate_all(Template, Goal0, Result) :-
 	template_to_pattern(all, Template, Pattern, Goal0, Goal, Aggregate),
 	findall(Pattern, Goal, List),